@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "PointCloudParallel.h"
+
+namespace PointCloudUtil {
+
+// How large point buffers are obtained.
+//  Default        : operator new (64-byte aligned)
+//  TransparentHuge: anonymous mmap, 2 MiB aligned, madvise(MADV_HUGEPAGE) (THP)
+//  ExplicitHuge   : mmap(MAP_HUGETLB) from the reserved hugetlbfs pool, falls back to THP
+// Huge-page modes only apply on Linux and to buffers >= 2 MiB; elsewhere they behave as
+// Default. Pages of mmap'd buffers are placed on first touch, which firstTouch() does from
+// the WorkerPool threads so each chunk lands on the NUMA node of the thread processing it.
+enum class AllocationPolicy { Default, TransparentHuge, ExplicitHuge };
+
+inline std::atomic<AllocationPolicy>& allocationPolicySlot() {
+    static std::atomic<AllocationPolicy> policy{AllocationPolicy::Default};
+    return policy;
+}
+inline void setAllocationPolicy(AllocationPolicy p) { allocationPolicySlot().store(p); }
+inline AllocationPolicy getAllocationPolicy() { return allocationPolicySlot().load(); }
+
+namespace detail {
+
+constexpr size_t kHugePageBytes = size_t(2) << 20;
+constexpr size_t kAllocHeader = 64;   // keeps the payload 64-byte aligned
+
+// Every block carries a header recording how it was obtained, so deallocation is correct
+// even if the policy changed in between.
+struct AllocHeader {
+    uint32_t kind;       // 0 = operator new, 1 = mmap
+    size_t mappedBytes;
+};
+
+inline void* allocateBytes(size_t bytes) {
+    const size_t total = bytes + kAllocHeader;
+    const AllocationPolicy policy = getAllocationPolicy();
+#ifdef __linux__
+    if (policy != AllocationPolicy::Default && total >= kHugePageBytes) {
+        const size_t mapped = (total + kHugePageBytes - 1) & ~(kHugePageBytes - 1);
+        void* base = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        if (policy == AllocationPolicy::ExplicitHuge) {
+            base = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        }
+#endif
+        if (base == MAP_FAILED) {
+            base = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+            if (base != MAP_FAILED) madvise(base, mapped, MADV_HUGEPAGE);
+#endif
+        }
+        if (base != MAP_FAILED) {
+            auto* h = static_cast<AllocHeader*>(base);
+            h->kind = 1;
+            h->mappedBytes = mapped;
+            return static_cast<unsigned char*>(base) + kAllocHeader;
+        }
+    }
+#else
+    (void)policy;
+#endif
+    void* base = ::operator new(total, std::align_val_t(kAllocHeader));
+    auto* h = static_cast<AllocHeader*>(base);
+    h->kind = 0;
+    h->mappedBytes = 0;
+    return static_cast<unsigned char*>(base) + kAllocHeader;
+}
+
+inline void deallocateBytes(void* p) {
+    if (!p) return;
+    void* base = static_cast<unsigned char*>(p) - kAllocHeader;
+    const auto* h = static_cast<const AllocHeader*>(base);
+#ifdef __linux__
+    if (h->kind == 1) { munmap(base, h->mappedBytes); return; }
+#endif
+    (void)h;
+    ::operator delete(base, std::align_val_t(kAllocHeader));
+}
+
+} // namespace detail
+
+// Allocator for point storage. Stateless (all instances compare equal); the policy is
+// read at allocation time. construct() without arguments default-initialises, so
+// resize() does not zero (and thereby first-touch) pages on the calling thread.
+template <typename T>
+struct PointAllocator {
+    using value_type = T;
+
+    PointAllocator() = default;
+    template <typename U> PointAllocator(const PointAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) { return static_cast<T*>(detail::allocateBytes(n * sizeof(T))); }
+    void deallocate(T* p, size_t) noexcept { detail::deallocateBytes(p); }
+
+    template <typename U>
+    void construct(U* p) noexcept(std::is_nothrow_default_constructible<U>::value) { ::new (static_cast<void*>(p)) U; }
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) { ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...); }
+
+    template <typename U> bool operator==(const PointAllocator<U>&) const noexcept { return true; }
+    template <typename U> bool operator!=(const PointAllocator<U>&) const noexcept { return false; }
+};
+
+// Touch [data, data+count) from the worker threads using the same static partition as
+// parallelFor, placing each page on the node of the thread that will later process it.
+template <typename T>
+inline void firstTouch(T* data, size_t count) {
+    parallelFor(count, [data](size_t b, size_t e, unsigned) {
+        std::memset(static_cast<void*>(data + b), 0, (e - b) * sizeof(T));
+    });
+}
+
+} // namespace PointCloudUtil
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PointCloudUtil.h"
+
+namespace PointCloudUtil {
+
+// Loads a PLY file on a background thread and publishes points in chunks. The owner
+// (typically the render loop) calls drainInto() once per frame to move whatever has been
+// parsed so far into its PointCloud, so the first frame does not wait for the whole file.
+class AsyncPlyLoader {
+private:
+    std::thread worker;
+    std::mutex mtx;
+    std::vector<Point> ready;       // parsed, not yet drained (guarded by mtx)
+    std::vector<Vec3d> readyPos;    // their positions in double precision
+    AttributeSet readyAttrs;        // and their extra columns
+    std::vector<Point> draining;    // owner-side swap buffers, reused between drains
+    std::vector<Vec3d> drainingPos;
+    AttributeSet drainingAttrs;
+
+    std::atomic<bool> cancelRequested{false};
+    std::atomic<bool> finished{false};
+    std::atomic<bool> ok{false};
+    std::atomic<bool> normals{false};
+    std::atomic<uint64_t> bytesDone{0};
+    std::atomic<uint64_t> bytesTotal{0};
+    std::atomic<size_t> expected{0};
+
+    void run(std::string filename, size_t chunkPoints) {
+        PlyAsciiReader reader;
+        if (!reader.open(filename)) { finished = true; return; }
+        bytesTotal = reader.totalBytes();
+        expected = reader.vertexCount();
+        normals = reader.hasNormals();
+
+        std::vector<Point> chunk(chunkPoints);
+        std::vector<Vec3d> chunkPos(chunkPoints);
+        AttributeSet chunkAttrs;
+        while (!cancelRequested.load(std::memory_order_relaxed)) {
+            const size_t n = reader.read(chunk.data(), chunk.size(), chunkPos.data(), &chunkAttrs);
+            if (n == 0) break;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                ready.insert(ready.end(), chunk.begin(), chunk.begin() + n);
+                readyPos.insert(readyPos.end(), chunkPos.begin(), chunkPos.begin() + n);
+                readyAttrs.appendRows(chunkAttrs, nullptr, n);
+            }
+            bytesDone = reader.bytesRead();
+        }
+        bytesDone = bytesTotal.load();
+        ok = !reader.failed() && !cancelRequested;
+        finished = true;
+    }
+
+public:
+    AsyncPlyLoader() = default;
+    AsyncPlyLoader(const AsyncPlyLoader&) = delete;
+    AsyncPlyLoader& operator=(const AsyncPlyLoader&) = delete;
+    ~AsyncPlyLoader() { cancel(); join(); }
+
+    // Start loading 'filename'; returns immediately
+    void start(const std::string& filename, size_t chunkPoints = 65536) {
+        cancel();
+        join();
+        cancelRequested = false;
+        finished = false;
+        ok = false;
+        bytesDone = 0;
+        bytesTotal = 0;
+        expected = 0;
+        ready.clear();
+        readyPos.clear();
+        readyAttrs.clear();
+        worker = std::thread(&AsyncPlyLoader::run, this, filename, chunkPoints);
+    }
+
+    // Move the points parsed since the last call into 'cloud'; returns how many
+    size_t drainInto(PointCloud& cloud) {
+        draining.clear();
+        drainingPos.clear();
+        drainingAttrs.resize(0);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            ready.swap(draining);
+            readyPos.swap(drainingPos);
+            std::swap(readyAttrs, drainingAttrs);
+        }
+        cloud.appendGeoreferenced(draining.data(), drainingPos.data(), draining.size(), normals, &drainingAttrs);
+        return draining.size();
+    }
+
+    // Stop parsing; points already published can still be drained
+    void cancel() { cancelRequested = true; }
+
+    void join() { if (worker.joinable()) worker.join(); }
+
+    // Parser has stopped (end of file, error or cancel). Drain once more afterwards.
+    bool done() const { return finished; }
+    bool succeeded() const { return ok; }
+    bool cancelled() const { return cancelRequested && finished && !ok; }
+    size_t expectedPoints() const { return expected; }
+
+    // Fraction of the file consumed, in [0, 1]
+    float progress() const {
+        const uint64_t total = bytesTotal;
+        return total ? static_cast<float>(static_cast<double>(bytesDone) / static_cast<double>(total)) : 0.0f;
+    }
+};
+
+} // namespace PointCloudUtil
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace PointCloudUtil {
+
+// Element type of an attribute column (the PLY scalar types)
+enum class AttributeType : uint8_t { I8, U8, I16, U16, I32, U32, F32, F64 };
+
+inline size_t attributeSize(AttributeType t) {
+    switch (t) {
+        case AttributeType::I8:  case AttributeType::U8:  return 1;
+        case AttributeType::I16: case AttributeType::U16: return 2;
+        case AttributeType::I32: case AttributeType::U32: case AttributeType::F32: return 4;
+        case AttributeType::F64: return 8;
+    }
+    return 1;
+}
+
+inline const char* plyTypeName(AttributeType t) {
+    switch (t) {
+        case AttributeType::I8:  return "char";
+        case AttributeType::U8:  return "uchar";
+        case AttributeType::I16: return "short";
+        case AttributeType::U16: return "ushort";
+        case AttributeType::I32: return "int";
+        case AttributeType::U32: return "uint";
+        case AttributeType::F32: return "float";
+        case AttributeType::F64: return "double";
+    }
+    return "uchar";
+}
+
+// Accepts both PLY spellings (uchar / uint8, float / float32, ...)
+inline bool attributeTypeFromPly(const std::string& s, AttributeType& t) {
+    if (s == "char" || s == "int8")           t = AttributeType::I8;
+    else if (s == "uchar" || s == "uint8")    t = AttributeType::U8;
+    else if (s == "short" || s == "int16")    t = AttributeType::I16;
+    else if (s == "ushort" || s == "uint16")  t = AttributeType::U16;
+    else if (s == "int" || s == "int32")      t = AttributeType::I32;
+    else if (s == "uint" || s == "uint32")    t = AttributeType::U32;
+    else if (s == "float" || s == "float32")  t = AttributeType::F32;
+    else if (s == "double" || s == "float64") t = AttributeType::F64;
+    else return false;
+    return true;
+}
+
+// Calls f(T()) with the C++ type of 't'. Channel operations dispatch once per column and
+// then run a typed loop, so there is no per-point type switch or virtual call.
+template <typename F>
+inline void visitAttributeType(AttributeType t, F&& f) {
+    switch (t) {
+        case AttributeType::I8:  f(int8_t());   break;
+        case AttributeType::U8:  f(uint8_t());  break;
+        case AttributeType::I16: f(int16_t());  break;
+        case AttributeType::U16: f(uint16_t()); break;
+        case AttributeType::I32: f(int32_t());  break;
+        case AttributeType::U32: f(uint32_t()); break;
+        case AttributeType::F32: f(float());    break;
+        case AttributeType::F64: f(double());   break;
+    }
+}
+
+// Narrowest type that holds every value of both a and b (64-bit ints are not column
+// types, so mixed-sign 32-bit and 32-bit int / float pairs go to F64)
+inline AttributeType commonAttributeType(AttributeType a, AttributeType b) {
+    if (a == b) return a;
+    auto isFloat = [](AttributeType t) { return t == AttributeType::F32 || t == AttributeType::F64; };
+    auto isSigned = [](AttributeType t) { return t == AttributeType::I8 || t == AttributeType::I16 || t == AttributeType::I32; };
+    if (isFloat(a) || isFloat(b)) {
+        const AttributeType i = isFloat(a) ? b : a;   // the other one (or F64 when both float)
+        if (a == AttributeType::F64 || b == AttributeType::F64) return AttributeType::F64;
+        return attributeSize(i) <= 2 ? AttributeType::F32 : AttributeType::F64;
+    }
+    const size_t sa = attributeSize(a), sb = attributeSize(b);
+    if (isSigned(a) == isSigned(b)) return sa >= sb ? a : b;
+    // a signed type wider than the unsigned one
+    const size_t u = isSigned(a) ? sb : sa, si = isSigned(a) ? sa : sb;
+    const size_t need = std::max(si, 2 * u);
+    return need <= 1 ? AttributeType::I8 : (need == 2 ? AttributeType::I16 : (need == 4 ? AttributeType::I32 : AttributeType::F64));
+}
+
+// One named per-point column, stored as raw bytes of its type
+struct AttributeChannel {
+    std::string name;
+    AttributeType type = AttributeType::F32;
+    std::vector<unsigned char> bytes;
+
+    size_t elementSize() const { return attributeSize(type); }
+    size_t size() const { return bytes.size() / elementSize(); }
+
+    template <typename T> T* data() { return reinterpret_cast<T*>(bytes.data()); }
+    template <typename T> const T* data() const { return reinterpret_cast<const T*>(bytes.data()); }
+
+    // Per-value conversions for loaders and printing (not for inner loops)
+    void set(size_t i, double v) {
+        visitAttributeType(type, [&](auto tag) {
+            using T = decltype(tag);
+            data<T>()[i] = static_cast<T>(v);
+        });
+    }
+    double get(size_t i) const {
+        double v = 0.0;
+        visitAttributeType(type, [&](auto tag) {
+            using T = decltype(tag);
+            v = static_cast<double>(data<T>()[i]);
+        });
+        return v;
+    }
+
+    // Change the element type, converting every value (static_cast per element)
+    void convertTo(AttributeType to) {
+        if (to == type) return;
+        const size_t n = size();
+        std::vector<unsigned char> out(n * attributeSize(to));
+        visitAttributeType(type, [&](auto fromTag) {
+            using F = decltype(fromTag);
+            const F* in = data<F>();
+            visitAttributeType(to, [&](auto toTag) {
+                using T = decltype(toTag);
+                T* o = reinterpret_cast<T*>(out.data());
+                for (size_t i = 0; i < n; ++i) o[i] = static_cast<T>(in[i]);
+            });
+        });
+        bytes.swap(out);
+        type = to;
+    }
+
+    // Text form of element i as written to ASCII PLY; returns characters written
+    int format(size_t i, char* out, size_t cap) const {
+        switch (type) {
+            case AttributeType::F32: return std::snprintf(out, cap, "%g", static_cast<double>(data<float>()[i]));
+            case AttributeType::F64: return std::snprintf(out, cap, "%.15g", data<double>()[i]);
+            case AttributeType::U32: return std::snprintf(out, cap, "%u", data<uint32_t>()[i]);
+            default:                 return std::snprintf(out, cap, "%lld", static_cast<long long>(get(i)));
+        }
+    }
+};
+
+// Named, typed per-point columns in structure-of-arrays layout. Row i belongs to point i
+// of the owning cloud; PointCloud keeps the row count equal to its point count through
+// loads, appends, filters and downsampling.
+class AttributeSet {
+private:
+    std::vector<AttributeChannel> columns;
+    size_t rowCount = 0;
+
+public:
+    size_t rows() const { return rowCount; }
+    bool empty() const { return columns.empty(); }
+    const std::vector<AttributeChannel>& channels() const { return columns; }
+
+    AttributeChannel* find(const std::string& name) {
+        for (auto& c : columns) if (c.name == name) return &c;
+        return nullptr;
+    }
+    const AttributeChannel* find(const std::string& name) const {
+        for (const auto& c : columns) if (c.name == name) return &c;
+        return nullptr;
+    }
+
+    // Add a zero-filled column, or return the existing one converted to 'type' (its
+    // values are kept, cast per element)
+    AttributeChannel& add(const std::string& name, AttributeType type) {
+        AttributeChannel* c = find(name);
+        if (c) {
+            c->convertTo(type);
+            return *c;
+        }
+        columns.emplace_back();
+        c = &columns.back();
+        c->name = name;
+        c->type = type;
+        c->bytes.assign(rowCount * attributeSize(type), 0);
+        return *c;
+    }
+
+    void remove(const std::string& name) {
+        for (size_t i = 0; i < columns.size(); ++i) {
+            if (columns[i].name == name) { columns.erase(columns.begin() + i); return; }
+        }
+    }
+
+    // Drop all columns
+    void clear() { columns.clear(); rowCount = 0; }
+
+    // Grow (zero-filled) or shrink every column; capacity is kept
+    void resize(size_t n) {
+        for (auto& c : columns) c.bytes.resize(n * c.elementSize(), 0);
+        rowCount = n;
+    }
+
+    // Append n rows taken from 'src' (row k from src row order[k], or k when order is
+    // null). Columns only in src are added; columns missing from src get zeros. A name
+    // present in both with different types is widened to a type holding both
+    // (commonAttributeType), converting the rows already stored.
+    void appendRows(const AttributeSet& src, const uint32_t* order, size_t n) {
+        const size_t base = rowCount;
+        for (const auto& s : src.columns) {
+            const AttributeChannel* d = find(s.name);
+            add(s.name, d ? commonAttributeType(d->type, s.type) : s.type);
+        }
+        resize(base + n);
+        for (const auto& s : src.columns) {
+            AttributeChannel& d = *find(s.name);
+            const size_t es = d.elementSize();
+            unsigned char* out = d.bytes.data() + base * es;
+            const unsigned char* in = s.bytes.data();
+            if (!order && d.type == s.type) { std::memcpy(out, in, n * es); continue; }
+            visitAttributeType(s.type, [&](auto fromTag) {
+                using F = decltype(fromTag);
+                const F* v = reinterpret_cast<const F*>(in);
+                visitAttributeType(d.type, [&](auto toTag) {
+                    using T = decltype(toTag);
+                    T* o = reinterpret_cast<T*>(out);
+                    for (size_t k = 0; k < n; ++k) o[k] = static_cast<T>(v[order ? order[k] : k]);
+                });
+            });
+        }
+    }
+
+    // Move rows [from, from + count) down to 'to' (to <= from)
+    void moveRows(size_t from, size_t to, size_t count) {
+        if (from == to) return;
+        for (auto& c : columns) {
+            const size_t es = c.elementSize();
+            std::memmove(c.bytes.data() + to * es, c.bytes.data() + from * es, count * es);
+        }
+    }
+
+    // Keep rows keep[0..n) (strictly increasing), in place
+    void compact(const uint32_t* keep, size_t n) {
+        for (auto& c : columns) {
+            visitAttributeType(c.type, [&](auto tag) {
+                using T = decltype(tag);
+                T* v = c.data<T>();
+                for (size_t k = 0; k < n; ++k) v[k] = v[keep[k]];
+            });
+        }
+        resize(n);
+    }
+
+    // One output row per run: rows order[runEnd[r-1] .. runEnd[r]) are merged into row r.
+    // Float columns are averaged; integer columns (classes, flags, ids) keep the value
+    // of the run's first row, since averaging them is meaningless.
+    void reduceRuns(const uint32_t* order, const uint32_t* runEnd, size_t runs) {
+        for (auto& c : columns) {
+            std::vector<unsigned char> out(runs * c.elementSize());
+            visitAttributeType(c.type, [&](auto tag) {
+                using T = decltype(tag);
+                const T* v = c.data<T>();
+                T* o = reinterpret_cast<T*>(out.data());
+                uint32_t b = 0;
+                for (size_t r = 0; r < runs; ++r) {
+                    const uint32_t e = runEnd[r];
+                    if (std::is_floating_point<T>::value) {
+                        double sum = 0.0;
+                        for (uint32_t k = b; k < e; ++k) sum += static_cast<double>(v[order[k]]);
+                        o[r] = static_cast<T>(sum / static_cast<double>(e - b));
+                    } else {
+                        o[r] = v[order[b]];
+                    }
+                    b = e;
+                }
+            });
+            c.bytes.swap(out);
+        }
+        rowCount = runs;
+    }
+};
+
+} // namespace PointCloudUtil
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PointCloudPipeline.h"
+
+// Headless batch runner: executes a pipeline description over many files.
+// Files are handed out from a shared job queue (an atomic cursor); each worker keeps
+// one PointCloud whose buffers are reused from file to file.
+
+static void usage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " <pipeline.txt> [-j threads] <input | dir | @list.txt> ...\n"
+              << "  input     : .ply, .las, .pcd or text (.xyz / .txt / .pts / .csv) point file\n"
+              << "  dir       : every supported point file in the directory\n"
+              << "  @list.txt : one input path per line\n";
+}
+
+static void collectInputs(const std::string& arg, std::vector<std::string>& inputs) {
+    namespace fs = std::filesystem;
+    if (!arg.empty() && arg[0] == '@') {
+        std::ifstream list(arg.substr(1));
+        if (!list.is_open()) { std::cerr << "Error: Unable to open list " << arg.substr(1) << std::endl; return; }
+        std::string line;
+        while (std::getline(list, line)) if (!line.empty()) inputs.push_back(line);
+        return;
+    }
+    std::error_code ec;
+    if (fs::is_directory(arg, ec)) {
+        std::vector<std::string> found;
+        for (const auto& e : fs::directory_iterator(arg, ec)) {
+            if (e.is_regular_file() && PointCloudUtil::isSupportedPointFile(e.path().string())) found.push_back(e.path().string());
+        }
+        std::sort(found.begin(), found.end());
+        inputs.insert(inputs.end(), found.begin(), found.end());
+        return;
+    }
+    inputs.push_back(arg);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) { usage(argv[0]); return 1; }
+
+    PointCloudUtil::Pipeline pipeline;
+    if (!pipeline.loadFromFile(argv[1])) return 1;
+
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> inputs;
+    for (int i = 2; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "-j" && i + 1 < argc) { threads = std::max(1, std::atoi(argv[++i])); continue; }
+        collectInputs(a, inputs);
+    }
+    if (inputs.empty()) { usage(argv[0]); return 1; }
+    threads = std::min<unsigned>(threads, static_cast<unsigned>(inputs.size()));
+
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> failed{0};
+    std::mutex logMutex;
+    const auto t0 = std::chrono::steady_clock::now();
+
+    auto worker = [&]() {
+        PointCloudUtil::PointCloud cloud; // reused for every file this worker takes
+        for (size_t i = next.fetch_add(1); i < inputs.size(); i = next.fetch_add(1)) {
+            const auto ts = std::chrono::steady_clock::now();
+            const bool ok = pipeline.run(cloud, inputs[i]);
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - ts).count();
+            if (!ok) failed.fetch_add(1);
+            std::lock_guard<std::mutex> lock(logMutex);
+            std::cout << (ok ? "[ok]   " : "[FAIL] ") << inputs[i] << "  "
+                      << cloud.getPoints().size() << " pts  " << ms << " ms\n";
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& th : pool) th.join();
+
+    const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << inputs.size() << " file(s), " << failed.load() << " failed, "
+              << threads << " thread(s), " << sec << " s" << std::endl;
+    return failed.load() == 0 ? 0 : 2;
+}
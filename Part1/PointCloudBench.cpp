@@ -0,0 +1,89 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "PointCloudUtil.h"
+
+// Measures the stats and bake kernels over a large synthetic cloud under each
+// allocation policy, with and without pinned workers (NUMA first-touch placement).
+//
+//   ./PointCloudBench [points=20000000] [threads=hardware] [repeats=5]
+
+using Clock = std::chrono::steady_clock;
+
+static double msSince(Clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+// Huge pages currently backing anonymous memory (Linux only)
+static std::string anonHugePages() {
+    std::ifstream f("/proc/self/smaps_rollup");
+    std::string line;
+    while (std::getline(f, line)) {
+        if (line.compare(0, 14, "AnonHugePages:") == 0) {
+            const size_t b = line.find_first_not_of(' ', 14);
+            return line.substr(b);
+        }
+    }
+    return "n/a";
+}
+
+static void runCase(const char* name, PointCloudUtil::AllocationPolicy policy, bool pin,
+                    size_t n, unsigned threads, int repeats) {
+    using namespace PointCloudUtil;
+    WorkerPool::configure(threads, pin);
+    setAllocationPolicy(policy);
+
+    PointCloud cloud;
+    auto t0 = Clock::now();
+    cloud.generate(n, [](size_t i) {
+        // cheap deterministic pseudo-random positions
+        uint64_t h = (i + 1) * 0x9E3779B97F4A7C15ull;
+        Point p{};
+        p.x = static_cast<float>((h >> 11) & 0xFFFF) * 0.01f;
+        p.y = static_cast<float>((h >> 27) & 0xFFFF) * 0.01f;
+        p.z = static_cast<float>((h >> 43) & 0xFFFF) * 0.01f;
+        p.r = p.g = p.b = 128;
+        p.nz = 1.0f;
+        return p;
+    });
+    const double genMs = msSince(t0);
+
+    double statsMs = 0.0, bakeMs = 0.0;
+    volatile float sink = 0.0f; // keeps the stats computation observable
+    for (int r = 0; r < repeats; ++r) {
+        cloud.rotate(0.5f, 'y');
+        cloud.translate(0.01f, 0.0f, 0.0f);
+        t0 = Clock::now();
+        cloud.applyPointKernel([](Point&) {}); // bake only
+        bakeMs += msSince(t0);
+
+        t0 = Clock::now();
+        sink = sink + cloud.getStats().cx;
+        statsMs += msSince(t0);
+    }
+    std::cout << name << (pin ? " +pinned" : "        ")
+              << "  generate " << genMs << " ms"
+              << "  bake " << bakeMs / repeats << " ms"
+              << "  stats " << statsMs / repeats << " ms"
+              << "  AnonHugePages " << anonHugePages() << "\n";
+}
+
+int main(int argc, char** argv) {
+    using PointCloudUtil::AllocationPolicy;
+    const size_t n = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 20000000ull;
+    const unsigned threads = (argc > 2) ? static_cast<unsigned>(std::atoi(argv[2]))
+                                        : std::max(1u, std::thread::hardware_concurrency());
+    const int repeats = (argc > 3) ? std::max(1, std::atoi(argv[3])) : 5;
+
+    std::cout << n << " points (" << (n * sizeof(PointCloudUtil::Point) >> 20) << " MiB), "
+              << threads << " thread(s), " << repeats << " repeat(s)\n";
+    for (bool pin : { false, true }) {
+        runCase("default         ", AllocationPolicy::Default, pin, n, threads, repeats);
+        runCase("transparent-huge", AllocationPolicy::TransparentHuge, pin, n, threads, repeats);
+        runCase("explicit-huge   ", AllocationPolicy::ExplicitHuge, pin, n, threads, repeats);
+    }
+    return 0;
+}
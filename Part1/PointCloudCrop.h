@@ -0,0 +1,209 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "PointCloudHull.h"
+
+namespace PointCloudUtil {
+
+// Region kept by PointCloud::crop(). Points are mapped into the region's frame by
+// 'frame' (cloud frame -> region frame, row-major 3x4) and kept when every coordinate k
+// lies in [lo[k], hi[k]] and, for an extruded polygon, (u, v) also lies inside the
+// polygon (even-odd rule). Boxes, oriented boxes and half-spaces are all ranges in a
+// suitable frame; unbounded sides use infinities.
+struct CropRegion {
+    double frame[12] = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0 };
+    float lo[3] = { -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity() };
+    float hi[3] = { std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity() };
+    std::vector<float> edges;   // polygon edges as (x0, y0, y1, dx/dy); none for a plain range
+    bool invert = false;        // keep the points outside instead
+
+    static CropRegion box(const float mn[3], const float mx[3]) {
+        CropRegion r;
+        std::copy(mn, mn + 3, r.lo);
+        std::copy(mx, mx + 3, r.hi);
+        return r;
+    }
+
+    static CropRegion orientedBox(const OrientedBox& b) {
+        CropRegion r;
+        for (int k = 0; k < 3; ++k) {
+            for (int j = 0; j < 3; ++j) r.frame[4 * k + j] = b.axes[k][j];
+            r.frame[4 * k + 3] = -(double(b.axes[k][0]) * b.center[0] + double(b.axes[k][1]) * b.center[1] + double(b.axes[k][2]) * b.center[2]);
+            r.lo[k] = -b.halfExtents[k];
+            r.hi[k] = b.halfExtents[k];
+        }
+        return r;
+    }
+
+    // Keeps the points with n . p <= d
+    static CropRegion halfSpace(float nx, float ny, float nz, float d) {
+        CropRegion r;
+        const double len = std::sqrt(double(nx) * nx + double(ny) * ny + double(nz) * nz);
+        const double inv = len > 0.0 ? 1.0 / len : 1.0;
+        std::fill(r.frame, r.frame + 12, 0.0);
+        r.frame[0] = nx * inv; r.frame[1] = ny * inv; r.frame[2] = nz * inv; r.frame[3] = -d * inv;
+        r.hi[0] = 0.0f;
+        return r;
+    }
+
+    // Polygon 'uv' in the plane through 'origin' spanned by u and v (orthonormalised),
+    // extruded along u x v over [lo, hi]. Fewer than three vertices keep nothing.
+    static CropRegion extrudedPolygon(const std::vector<std::array<float, 2>>& uv, const float origin[3],
+                                      const float u[3], const float v[3], float lo, float hi) {
+        CropRegion r;
+        double e[3][3];
+        double len = std::sqrt(double(u[0]) * u[0] + double(u[1]) * u[1] + double(u[2]) * u[2]);
+        for (int j = 0; j < 3; ++j) e[0][j] = len > 0.0 ? u[j] / len : (j == 0);
+        const double dot = e[0][0] * v[0] + e[0][1] * v[1] + e[0][2] * v[2];
+        for (int j = 0; j < 3; ++j) e[1][j] = v[j] - dot * e[0][j];
+        len = std::sqrt(e[1][0] * e[1][0] + e[1][1] * e[1][1] + e[1][2] * e[1][2]);
+        for (int j = 0; j < 3; ++j) e[1][j] = len > 0.0 ? e[1][j] / len : (j == 1);
+        e[2][0] = e[0][1] * e[1][2] - e[0][2] * e[1][1];
+        e[2][1] = e[0][2] * e[1][0] - e[0][0] * e[1][2];
+        e[2][2] = e[0][0] * e[1][1] - e[0][1] * e[1][0];
+        for (int k = 0; k < 3; ++k) {
+            std::copy(e[k], e[k] + 3, r.frame + 4 * k);
+            r.frame[4 * k + 3] = -(e[k][0] * origin[0] + e[k][1] * origin[1] + e[k][2] * origin[2]);
+        }
+        r.lo[2] = lo;
+        r.hi[2] = hi;
+        // the polygon's bounding rectangle doubles as a cheap range test
+        if (uv.size() < 3) { r.lo[0] = 1.0f; r.hi[0] = 0.0f; return r; }
+        r.lo[0] = r.hi[0] = uv[0][0];
+        r.lo[1] = r.hi[1] = uv[0][1];
+        for (size_t i = 0; i < uv.size(); ++i) {
+            const auto& a = uv[i];
+            const auto& b = uv[(i + 1) % uv.size()];
+            r.lo[0] = std::min(r.lo[0], a[0]); r.hi[0] = std::max(r.hi[0], a[0]);
+            r.lo[1] = std::min(r.lo[1], a[1]); r.hi[1] = std::max(r.hi[1], a[1]);
+            r.edges.insert(r.edges.end(), { a[0], a[1], b[1], b[1] != a[1] ? (b[0] - a[0]) / (b[1] - a[1]) : 0.0f });
+        }
+        return r;
+    }
+
+    // Footprint polygon in x/y, extruded along z over [zMin, zMax]
+    static CropRegion extrudedPolygon(const std::vector<std::array<float, 2>>& xy, float zMin, float zMax) {
+        const float origin[3] = { 0.0f, 0.0f, 0.0f }, u[3] = { 1.0f, 0.0f, 0.0f }, v[3] = { 0.0f, 1.0f, 0.0f };
+        return extrudedPolygon(xy, origin, u, v, zMin, zMax);
+    }
+
+    CropRegion inverted() const {
+        CropRegion r = *this;
+        r.invert = !invert;
+        return r;
+    }
+
+    // Test in the region frame (before 'invert'); the reference for the SIMD kernels
+    bool containsLocal(float u, float v, float w) const {
+        if (!(u >= lo[0] && u <= hi[0] && v >= lo[1] && v <= hi[1] && w >= lo[2] && w <= hi[2])) return false;
+        if (edges.empty()) return true;
+        bool odd = false;
+        for (size_t e = 0; e < edges.size(); e += 4) {
+            const float x0 = edges[e], y0 = edges[e + 1], y1 = edges[e + 2], s = edges[e + 3];
+            if ((y0 > v) != (y1 > v) && u < x0 + s * (v - y0)) odd = !odd;
+        }
+        return odd;
+    }
+};
+
+namespace crop {
+
+// keep[i] = whether the region keeps point i, for positions at xyz + i * stride (floats)
+// mapped into the region frame by m (row-major 3x4). Blocks of 8 (AVX) or 4 (SSE2)
+// points are transformed and range-tested together; the polygon edges are only walked
+// for blocks with a point inside the bounding range.
+inline void classify(const float* xyz, size_t stride, size_t n, const float m[12], const CropRegion& r, uint8_t* keep) {
+    const uint8_t flip = r.invert ? 1 : 0;
+    const size_t edgeCount = r.edges.size() / 4;
+    const float* E = r.edges.data();
+    size_t i = 0;
+#if defined(__AVX__)
+    {
+        __m256 M[12];
+        for (int k = 0; k < 12; ++k) M[k] = _mm256_set1_ps(m[k]);
+        const __m256 lo0 = _mm256_set1_ps(r.lo[0]), lo1 = _mm256_set1_ps(r.lo[1]), lo2 = _mm256_set1_ps(r.lo[2]);
+        const __m256 hi0 = _mm256_set1_ps(r.hi[0]), hi1 = _mm256_set1_ps(r.hi[1]), hi2 = _mm256_set1_ps(r.hi[2]);
+        for (; i + 8 <= n; i += 8) {
+            const float* p = xyz + i * stride;
+            const size_t s = stride;
+            const __m256 x = _mm256_setr_ps(p[0], p[s], p[2 * s], p[3 * s], p[4 * s], p[5 * s], p[6 * s], p[7 * s]);
+            const __m256 y = _mm256_setr_ps(p[1], p[s + 1], p[2 * s + 1], p[3 * s + 1], p[4 * s + 1], p[5 * s + 1], p[6 * s + 1], p[7 * s + 1]);
+            const __m256 z = _mm256_setr_ps(p[2], p[s + 2], p[2 * s + 2], p[3 * s + 2], p[4 * s + 2], p[5 * s + 2], p[6 * s + 2], p[7 * s + 2]);
+            const __m256 u = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(M[0], x), _mm256_mul_ps(M[1], y)), _mm256_add_ps(_mm256_mul_ps(M[2], z), M[3]));
+            const __m256 v = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(M[4], x), _mm256_mul_ps(M[5], y)), _mm256_add_ps(_mm256_mul_ps(M[6], z), M[7]));
+            const __m256 w = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(M[8], x), _mm256_mul_ps(M[9], y)), _mm256_add_ps(_mm256_mul_ps(M[10], z), M[11]));
+            __m256 in = _mm256_and_ps(_mm256_cmp_ps(u, lo0, _CMP_GE_OQ), _mm256_cmp_ps(u, hi0, _CMP_LE_OQ));
+            in = _mm256_and_ps(in, _mm256_and_ps(_mm256_cmp_ps(v, lo1, _CMP_GE_OQ), _mm256_cmp_ps(v, hi1, _CMP_LE_OQ)));
+            in = _mm256_and_ps(in, _mm256_and_ps(_mm256_cmp_ps(w, lo2, _CMP_GE_OQ), _mm256_cmp_ps(w, hi2, _CMP_LE_OQ)));
+            if (edgeCount && _mm256_movemask_ps(in)) {
+                __m256 odd = _mm256_setzero_ps();
+                for (size_t e = 0; e < edgeCount; ++e) {
+                    const float* q = E + 4 * e;
+                    const __m256 y0 = _mm256_set1_ps(q[1]);
+                    const __m256 cross = _mm256_xor_ps(_mm256_cmp_ps(y0, v, _CMP_GT_OQ), _mm256_cmp_ps(_mm256_set1_ps(q[2]), v, _CMP_GT_OQ));
+                    const __m256 xs = _mm256_add_ps(_mm256_set1_ps(q[0]), _mm256_mul_ps(_mm256_set1_ps(q[3]), _mm256_sub_ps(v, y0)));
+                    odd = _mm256_xor_ps(odd, _mm256_and_ps(cross, _mm256_cmp_ps(u, xs, _CMP_LT_OQ)));
+                }
+                in = _mm256_and_ps(in, odd);
+            }
+            const int bits = _mm256_movemask_ps(in);
+            for (int j = 0; j < 8; ++j) keep[i + j] = static_cast<uint8_t>(((bits >> j) & 1) ^ flip);
+        }
+    }
+#elif defined(__SSE2__)
+    {
+        __m128 M[12];
+        for (int k = 0; k < 12; ++k) M[k] = _mm_set1_ps(m[k]);
+        const __m128 lo0 = _mm_set1_ps(r.lo[0]), lo1 = _mm_set1_ps(r.lo[1]), lo2 = _mm_set1_ps(r.lo[2]);
+        const __m128 hi0 = _mm_set1_ps(r.hi[0]), hi1 = _mm_set1_ps(r.hi[1]), hi2 = _mm_set1_ps(r.hi[2]);
+        for (; i + 4 <= n; i += 4) {
+            const float* p = xyz + i * stride;
+            const size_t s = stride;
+            const __m128 x = _mm_setr_ps(p[0], p[s], p[2 * s], p[3 * s]);
+            const __m128 y = _mm_setr_ps(p[1], p[s + 1], p[2 * s + 1], p[3 * s + 1]);
+            const __m128 z = _mm_setr_ps(p[2], p[s + 2], p[2 * s + 2], p[3 * s + 2]);
+            const __m128 u = _mm_add_ps(_mm_add_ps(_mm_mul_ps(M[0], x), _mm_mul_ps(M[1], y)), _mm_add_ps(_mm_mul_ps(M[2], z), M[3]));
+            const __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(M[4], x), _mm_mul_ps(M[5], y)), _mm_add_ps(_mm_mul_ps(M[6], z), M[7]));
+            const __m128 w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(M[8], x), _mm_mul_ps(M[9], y)), _mm_add_ps(_mm_mul_ps(M[10], z), M[11]));
+            __m128 in = _mm_and_ps(_mm_cmpge_ps(u, lo0), _mm_cmple_ps(u, hi0));
+            in = _mm_and_ps(in, _mm_and_ps(_mm_cmpge_ps(v, lo1), _mm_cmple_ps(v, hi1)));
+            in = _mm_and_ps(in, _mm_and_ps(_mm_cmpge_ps(w, lo2), _mm_cmple_ps(w, hi2)));
+            if (edgeCount && _mm_movemask_ps(in)) {
+                __m128 odd = _mm_setzero_ps();
+                for (size_t e = 0; e < edgeCount; ++e) {
+                    const float* q = E + 4 * e;
+                    const __m128 y0 = _mm_set1_ps(q[1]);
+                    const __m128 cross = _mm_xor_ps(_mm_cmpgt_ps(y0, v), _mm_cmpgt_ps(_mm_set1_ps(q[2]), v));
+                    const __m128 xs = _mm_add_ps(_mm_set1_ps(q[0]), _mm_mul_ps(_mm_set1_ps(q[3]), _mm_sub_ps(v, y0)));
+                    odd = _mm_xor_ps(odd, _mm_and_ps(cross, _mm_cmplt_ps(u, xs)));
+                }
+                in = _mm_and_ps(in, odd);
+            }
+            const int bits = _mm_movemask_ps(in);
+            for (int j = 0; j < 4; ++j) keep[i + j] = static_cast<uint8_t>(((bits >> j) & 1) ^ flip);
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        const float* p = xyz + i * stride;
+        // same association as the vector code, so a point gets the same answer either way
+        const float u = (m[0] * p[0] + m[1] * p[1]) + (m[2] * p[2] + m[3]);
+        const float v = (m[4] * p[0] + m[5] * p[1]) + (m[6] * p[2] + m[7]);
+        const float w = (m[8] * p[0] + m[9] * p[1]) + (m[10] * p[2] + m[11]);
+        keep[i] = static_cast<uint8_t>(r.containsLocal(u, v, w) ^ (flip != 0));
+    }
+}
+
+} // namespace crop
+
+} // namespace PointCloudUtil
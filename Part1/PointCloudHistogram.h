@@ -0,0 +1,163 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace PointCloudUtil {
+
+// Per-point quantity counted by a histogram
+enum class HistogramField : uint8_t { Height, Red, Green, Blue, NormalX, NormalY, NormalZ, Density, Attribute };
+
+// Fixed: equal-width bins over [lo, hi]. Adaptive: bins of roughly equal count, cut
+// from a fine fixed histogram of the same pass.
+enum class HistogramBinning : uint8_t { Fixed, Adaptive };
+
+inline const char* histogramFieldName(HistogramField f) {
+    switch (f) {
+        case HistogramField::Height:    return "height";
+        case HistogramField::Red:       return "red";
+        case HistogramField::Green:     return "green";
+        case HistogramField::Blue:      return "blue";
+        case HistogramField::NormalX:   return "normal_x";
+        case HistogramField::NormalY:   return "normal_y";
+        case HistogramField::NormalZ:   return "normal_z";
+        case HistogramField::Density:   return "density";
+        case HistogramField::Attribute: return "attribute";
+    }
+    return "attribute";
+}
+
+struct HistogramSpec {
+    HistogramField field = HistogramField::Height;
+    std::string attribute;      // column name for HistogramField::Attribute
+    size_t bins = 32;
+    HistogramBinning binning = HistogramBinning::Fixed;
+    double lo = 0.0, hi = 0.0;  // value range; taken from the data (or the field's natural range) when lo >= hi
+    float densityCell = 0.0f;   // Density: cell edge; 0 picks about 8 points per occupied surface cell
+
+    static HistogramSpec of(HistogramField f, size_t bins = 32, HistogramBinning binning = HistogramBinning::Fixed) {
+        HistogramSpec s;
+        s.field = f; s.bins = bins; s.binning = binning;
+        return s;
+    }
+    static HistogramSpec ofAttribute(const std::string& name, size_t bins = 32, HistogramBinning binning = HistogramBinning::Fixed) {
+        HistogramSpec s = of(HistogramField::Attribute, bins, binning);
+        s.attribute = name;
+        return s;
+    }
+};
+
+struct Histogram {
+    std::string label;
+    std::vector<double> edges;     // bins + 1 ascending boundaries; bin i is [edges[i], edges[i+1])
+    std::vector<uint64_t> counts;  // the last bin also holds values equal to edges.back()
+    uint64_t total = 0;            // values inside [edges.front(), edges.back()]
+    uint64_t outside = 0;          // values outside the range, or not finite
+
+    size_t bins() const { return counts.size(); }
+    bool empty() const { return total == 0; }
+
+    // Value below which a fraction q of the counted values lie (linear within a bin)
+    double quantile(double q) const {
+        if (!total) return 0.0;
+        const double target = std::clamp(q, 0.0, 1.0) * static_cast<double>(total);
+        double seen = 0.0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            const double c = static_cast<double>(counts[i]);
+            if (seen + c >= target && c > 0.0) return edges[i] + (edges[i + 1] - edges[i]) * ((target - seen) / c);
+            seen += c;
+        }
+        return edges.back();
+    }
+
+    // One line per bin: range, count and a bar scaled to the fullest bin
+    void print(std::ostream& os, int barWidth = 40) const {
+        char buf[160];
+        std::snprintf(buf, sizeof(buf), "%s: %llu value(s)", label.c_str(), static_cast<unsigned long long>(total));
+        os << buf;
+        if (outside) os << ", " << outside << " outside range";
+        os << "\n";
+        if (counts.empty()) return;
+        const uint64_t peak = std::max<uint64_t>(1, *std::max_element(counts.begin(), counts.end()));
+        for (size_t i = 0; i < counts.size(); ++i) {
+            const int len = static_cast<int>((counts[i] * static_cast<uint64_t>(barWidth) + peak - 1) / peak);
+            std::snprintf(buf, sizeof(buf), "  [%12.6g, %12.6g) %10llu ", edges[i], edges[i + 1],
+                          static_cast<unsigned long long>(counts[i]));
+            os << buf << std::string(static_cast<size_t>(len), '#') << "\n";
+        }
+    }
+};
+
+// Maps values to the bins of one histogram pass. Adaptive histograms count into
+// kFineBins equal-width bins first and are cut into equal-count bins by finish().
+// Counters are per worker: count() writes slot 'bins()' for values outside the range,
+// and merged per-worker counters go to finish().
+class HistogramBinner {
+private:
+    double lo = 0.0, hi = 0.0, scale = 0.0;
+    size_t slots = 0;
+
+public:
+    static constexpr size_t kFineBins = 4096;
+
+    HistogramBinner() = default;
+    HistogramBinner(const HistogramSpec& spec, double lo_, double hi_) : lo(lo_), hi(hi_) {
+        slots = spec.binning == HistogramBinning::Adaptive ? kFineBins : std::max<size_t>(spec.bins, 1);
+        scale = hi > lo ? static_cast<double>(slots) / (hi - lo) : 0.0;
+    }
+
+    size_t bins() const { return slots; }
+
+    template <typename T>
+    void count(T value, uint64_t* counters) const {
+        const double v = static_cast<double>(value);
+        // NaN fails both comparisons and lands in the outside slot
+        if (!(v >= lo && v <= hi)) { ++counters[slots]; return; }
+        const size_t i = static_cast<size_t>((v - lo) * scale);
+        ++counters[std::min(i, slots - 1)];
+    }
+
+    // Weighted form (density counts cells, each standing for its points)
+    void count(double v, uint64_t weight, uint64_t* counters) const {
+        if (!(v >= lo && v <= hi)) { counters[slots] += weight; return; }
+        const size_t i = static_cast<size_t>((v - lo) * scale);
+        counters[std::min(i, slots - 1)] += weight;
+    }
+
+    Histogram finish(const HistogramSpec& spec, const std::string& label, const uint64_t* counters) const {
+        Histogram h;
+        h.label = label;
+        h.outside = counters[slots];
+        for (size_t i = 0; i < slots; ++i) h.total += counters[i];
+        const double width = (hi - lo) / static_cast<double>(slots);
+        if (spec.binning == HistogramBinning::Fixed) {
+            h.counts.assign(counters, counters + slots);
+            for (size_t i = 0; i <= slots; ++i) h.edges.push_back(i == slots ? hi : lo + width * static_cast<double>(i));
+            return h;
+        }
+        // Cut when the running count reaches the next multiple of total / bins. Cuts fall
+        // on fine-bin edges, so a single heavy fine bin yields fewer, wider bins.
+        const size_t want = std::max<size_t>(spec.bins, 1);
+        h.edges.push_back(lo);
+        uint64_t run = 0, seen = 0;
+        size_t next = 1;
+        for (size_t i = 0; i < slots; ++i) {
+            run += counters[i];
+            seen += counters[i];
+            const bool last = (i + 1 == slots);
+            if (!last && (h.total == 0 || seen * want < static_cast<uint64_t>(next) * h.total)) continue;
+            h.edges.push_back(last ? hi : lo + width * static_cast<double>(i + 1));
+            h.counts.push_back(run);
+            run = 0;
+            while (h.total && seen * want >= static_cast<uint64_t>(next) * h.total) ++next;
+        }
+        return h;
+    }
+};
+
+} // namespace PointCloudUtil
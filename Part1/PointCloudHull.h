@@ -0,0 +1,623 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "PointCloudNeighbors.h"
+#include "PointCloudParallel.h"
+
+namespace PointCloudUtil {
+
+// Box with arbitrary orientation: center + sum of s_k * halfExtents[k] * axes[k] for
+// s_k in [-1, 1]. Axes are unit length, right-handed and sorted by extent, longest first.
+struct OrientedBox {
+    float center[3] = { 0.0f, 0.0f, 0.0f };
+    float axes[3][3] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+    float halfExtents[3] = { 0.0f, 0.0f, 0.0f };
+    bool valid = false;
+
+    double volume() const {
+        return 8.0 * static_cast<double>(halfExtents[0]) * halfExtents[1] * halfExtents[2];
+    }
+
+    // Corner c lies on the + side of axis k when bit k of c is set
+    void corners(float out[8][3]) const {
+        for (int c = 0; c < 8; ++c)
+            for (int j = 0; j < 3; ++j) {
+                float v = center[j];
+                for (int k = 0; k < 3; ++k) v += ((c >> k) & 1 ? 1.0f : -1.0f) * halfExtents[k] * axes[k][j];
+                out[c][j] = v;
+            }
+    }
+
+    bool contains(float x, float y, float z, float margin = 0.0f) const {
+        const float d[3] = { x - center[0], y - center[1], z - center[2] };
+        for (int k = 0; k < 3; ++k) {
+            const float t = d[0] * axes[k][0] + d[1] * axes[k][1] + d[2] * axes[k][2];
+            if (std::fabs(t) > halfExtents[k] + margin) return false;
+        }
+        return true;
+    }
+};
+
+// Closed triangle mesh around a point set. Faces are counter-clockwise seen from
+// outside; 'valid' is false when the points do not span a volume (fewer than four,
+// or all within tolerance of one plane).
+struct ConvexHull {
+    std::vector<std::array<float, 3>> vertices;
+    std::vector<std::array<uint32_t, 3>> faces;
+    bool valid = false;
+
+    double area() const {
+        double a = 0.0;
+        for (const auto& f : faces) {
+            const auto &p = vertices[f[0]], &q = vertices[f[1]], &r = vertices[f[2]];
+            const double u[3] = { q[0] - p[0], q[1] - p[1], q[2] - p[2] };
+            const double v[3] = { r[0] - p[0], r[1] - p[1], r[2] - p[2] };
+            const double n[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+            a += 0.5 * std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        }
+        return a;
+    }
+
+    // Sum of signed tetrahedra against the first vertex
+    double volume() const {
+        if (vertices.empty()) return 0.0;
+        const auto& o = vertices[0];
+        double v = 0.0;
+        for (const auto& f : faces) {
+            const auto &p = vertices[f[0]], &q = vertices[f[1]], &r = vertices[f[2]];
+            const double a[3] = { p[0] - o[0], p[1] - o[1], p[2] - o[2] };
+            const double b[3] = { q[0] - o[0], q[1] - o[1], q[2] - o[2] };
+            const double c[3] = { r[0] - o[0], r[1] - o[1], r[2] - o[2] };
+            v += a[0] * (b[1] * c[2] - b[2] * c[1]) - a[1] * (b[0] * c[2] - b[2] * c[0]) + a[2] * (b[0] * c[1] - b[1] * c[0]);
+        }
+        return v / 6.0;
+    }
+};
+
+namespace hull {
+
+// Candidate sets at least this large are partitioned among faces in parallel
+constexpr size_t kParallelPartition = size_t(1) << 14;
+
+struct Face {
+    uint32_t v[3];
+    uint32_t nb[3];                 // face across edge v[i] -> v[(i + 1) % 3]
+    double n[3] = { 0.0, 0.0, 0.0 };
+    double d = 0.0;                 // plane n . p = d, n outward and unit length
+    std::vector<uint32_t> outside;  // points above this face and no earlier one
+    uint32_t far = 0;               // the farthest of them
+    double farDist = 0.0;
+    uint32_t mark = 0;
+    bool alive = true;
+};
+
+inline double distance(const Face& f, const float* p) {
+    return f.n[0] * p[0] + f.n[1] * p[1] + f.n[2] * p[2] - f.d;
+}
+
+inline void setPlane(Face& f, const float* xyz) {
+    const float *a = xyz + 3 * size_t(f.v[0]), *b = xyz + 3 * size_t(f.v[1]), *c = xyz + 3 * size_t(f.v[2]);
+    const double u[3] = { double(b[0]) - a[0], double(b[1]) - a[1], double(b[2]) - a[2] };
+    const double w[3] = { double(c[0]) - a[0], double(c[1]) - a[1], double(c[2]) - a[2] };
+    double n[3] = { u[1] * w[2] - u[2] * w[1], u[2] * w[0] - u[0] * w[2], u[0] * w[1] - u[1] * w[0] };
+    const double len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    // a degenerate face keeps a zero plane: nothing is ever above it
+    if (len == 0.0) { f.n[0] = f.n[1] = f.n[2] = f.d = 0.0; return; }
+    for (int k = 0; k < 3; ++k) f.n[k] = n[k] / len;
+    f.d = (f.n[0] * (double(a[0]) + b[0] + c[0]) + f.n[1] * (double(a[1]) + b[1] + c[1]) + f.n[2] * (double(a[2]) + b[2] + c[2])) / 3.0;
+}
+
+// Index maximising score(i) over [0, n), in parallel; best receives the score
+template <typename F>
+inline uint32_t argmax(size_t n, F score, double& best) {
+    std::vector<std::pair<double, uint32_t>> parts(workerCount(), { -std::numeric_limits<double>::infinity(), 0 });
+    parallelFor(n, [&](size_t b, size_t e, unsigned w) {
+        std::pair<double, uint32_t> m = parts[w];
+        for (size_t i = b; i < e; ++i) {
+            const double s = score(i);
+            if (s > m.first) m = { s, static_cast<uint32_t>(i) };
+        }
+        parts[w] = m;
+    });
+    std::pair<double, uint32_t> m = parts[0];
+    for (const auto& p : parts) if (p.first > m.first) m = p;
+    best = m.first;
+    return m.second;
+}
+
+// Assign each point of ids[0, m) to the first face of fs it lies above by more than
+// eps; points above none are inside the hull and dropped. Large sets are split across
+// workers, each filling private per-face lists that are appended in worker order.
+inline void partition(const float* xyz, const uint32_t* ids, size_t m, std::vector<Face>& faces,
+                      const uint32_t* fs, size_t nf, double eps) {
+    auto assign = [&](size_t b, size_t e, std::vector<uint32_t>* lists, std::pair<double, uint32_t>* far) {
+        for (size_t i = b; i < e; ++i) {
+            const float* p = xyz + 3 * size_t(ids[i]);
+            for (size_t j = 0; j < nf; ++j) {
+                const double dist = distance(faces[fs[j]], p);
+                if (dist <= eps) continue;
+                lists[j].push_back(ids[i]);
+                if (dist > far[j].first) far[j] = { dist, ids[i] };
+                break;
+            }
+        }
+    };
+    auto merge = [&](size_t j, std::vector<uint32_t>& list, const std::pair<double, uint32_t>& far) {
+        Face& f = faces[fs[j]];
+        if (list.empty()) return;
+        if (f.outside.empty()) f.outside.swap(list);
+        else f.outside.insert(f.outside.end(), list.begin(), list.end());
+        if (far.first > f.farDist) { f.farDist = far.first; f.far = far.second; }
+    };
+    if (m < kParallelPartition) {
+        std::vector<std::vector<uint32_t>> lists(nf);
+        std::vector<std::pair<double, uint32_t>> far(nf, { 0.0, 0 });
+        assign(0, m, lists.data(), far.data());
+        for (size_t j = 0; j < nf; ++j) merge(j, lists[j], far[j]);
+        return;
+    }
+    const unsigned W = workerCount();
+    std::vector<std::vector<std::vector<uint32_t>>> lists(W, std::vector<std::vector<uint32_t>>(nf));
+    std::vector<std::vector<std::pair<double, uint32_t>>> far(W, std::vector<std::pair<double, uint32_t>>(nf, { 0.0, 0 }));
+    parallelFor(m, [&](size_t b, size_t e, unsigned w) { assign(b, e, lists[w].data(), far[w].data()); });
+    for (size_t j = 0; j < nf; ++j) {
+        size_t total = faces[fs[j]].outside.size();
+        for (unsigned w = 0; w < W; ++w) total += lists[w][j].size();
+        faces[fs[j]].outside.reserve(total);
+        for (unsigned w = 0; w < W; ++w) merge(j, lists[w][j], far[w][j]);
+    }
+}
+
+// 2D convex hull (Andrew's monotone chain), counter-clockwise, collinear points dropped
+inline void hull2D(std::vector<std::array<double, 2>>& pts, std::vector<std::array<double, 2>>& out) {
+    out.clear();
+    std::sort(pts.begin(), pts.end());
+    pts.erase(std::unique(pts.begin(), pts.end()), pts.end());
+    if (pts.size() < 3) { out = pts; return; }
+    auto cross = [](const std::array<double, 2>& o, const std::array<double, 2>& a, const std::array<double, 2>& b) {
+        return (a[0] - o[0]) * (b[1] - o[1]) - (a[1] - o[1]) * (b[0] - o[0]);
+    };
+    out.resize(2 * pts.size());
+    size_t k = 0;
+    for (size_t i = 0; i < pts.size(); ++i) {
+        while (k >= 2 && cross(out[k - 2], out[k - 1], pts[i]) <= 0.0) --k;
+        out[k++] = pts[i];
+    }
+    for (size_t i = pts.size() - 1, lower = k + 1; i-- > 0;) {
+        while (k >= lower && cross(out[k - 2], out[k - 1], pts[i]) <= 0.0) --k;
+        out[k++] = pts[i];
+    }
+    out.resize(k - 1);
+}
+
+// Smallest-area rectangle around 2D points by rotating calipers over their hull (one
+// side of the optimum lies on a hull edge). Returns the area; (ux, uy) is the unit
+// direction of that side.
+inline double minAreaRect(std::vector<std::array<double, 2>>& pts, double& ux, double& uy) {
+    std::vector<std::array<double, 2>> H;
+    hull2D(pts, H);
+    ux = 1.0; uy = 0.0;
+    const size_t h = H.size();
+    if (h < 3) {
+        if (h == 2) {
+            const double ex = H[1][0] - H[0][0], ey = H[1][1] - H[0][1], len = std::sqrt(ex * ex + ey * ey);
+            ux = ex / len; uy = ey / len;
+        }
+        return 0.0;
+    }
+    auto along = [&](size_t t, double ax, double ay) { return H[t % h][0] * ax + H[t % h][1] * ay; };
+    double best = std::numeric_limits<double>::infinity();
+    size_t j = 1, k = 1, l = 1;   // farthest along u, farthest along v, least along u
+    for (size_t i = 0; i < h; ++i) {
+        const double ex = H[(i + 1) % h][0] - H[i][0], ey = H[(i + 1) % h][1] - H[i][1];
+        const double len = std::sqrt(ex * ex + ey * ey);
+        const double u0 = ex / len, u1 = ey / len, v0 = -u1, v1 = u0;   // v points inwards
+        j = std::max(j, i + 1);
+        for (size_t s = 0; s < h && along(j + 1, u0, u1) > along(j, u0, u1); ++s) ++j;
+        k = std::max(k, j);
+        for (size_t s = 0; s < h && along(k + 1, v0, v1) > along(k, v0, v1); ++s) ++k;
+        l = std::max(l, k);
+        for (size_t s = 0; s < h && along(l + 1, u0, u1) < along(l, u0, u1); ++s) ++l;
+        const double area = (along(j, u0, u1) - along(l, u0, u1)) * (along(k, v0, v1) - along(i, v0, v1));
+        if (area < best) { best = area; ux = u0; uy = u1; }
+    }
+    return best;
+}
+
+// Extents of pts along the three axes
+inline void extents(const std::vector<std::array<float, 3>>& pts, const double ax[3][3], double mn[3], double mx[3]) {
+    for (int k = 0; k < 3; ++k) { mn[k] = std::numeric_limits<double>::infinity(); mx[k] = -mn[k]; }
+    for (const auto& p : pts)
+        for (int k = 0; k < 3; ++k) {
+            const double t = p[0] * ax[k][0] + p[1] * ax[k][1] + p[2] * ax[k][2];
+            mn[k] = std::min(mn[k], t); mx[k] = std::max(mx[k], t);
+        }
+}
+
+// Local descent on the box volume from the frame 'ax': each step keeps one axis and
+// turns the other two to the smallest rectangle around the projection, which cannot
+// grow the volume. Stops when a round over the three axes gains nothing.
+inline double refineBox(const std::vector<std::array<float, 3>>& pts, double ax[3][3]) {
+    double mn[3], mx[3];
+    extents(pts, ax, mn, mx);
+    double volume = (mx[0] - mn[0]) * (mx[1] - mn[1]) * (mx[2] - mn[2]);
+    std::vector<std::array<double, 2>> plane(pts.size());
+    for (int round = 0; round < 8; ++round) {
+        const double before = volume;
+        for (int m = 0; m < 3; ++m) {
+            const double* b = ax[(m + 1) % 3];
+            const double* c = ax[(m + 2) % 3];
+            for (size_t i = 0; i < pts.size(); ++i) {
+                const auto& p = pts[i];
+                plane[i] = { p[0] * b[0] + p[1] * b[1] + p[2] * b[2], p[0] * c[0] + p[1] * c[1] + p[2] * c[2] };
+            }
+            double ux, uy;
+            const double area = minAreaRect(plane, ux, uy);
+            if (!(area < (mx[(m + 1) % 3] - mn[(m + 1) % 3]) * (mx[(m + 2) % 3] - mn[(m + 2) % 3]))) continue;
+            double nb[3], nc[3];
+            for (int k = 0; k < 3; ++k) { nb[k] = ux * b[k] + uy * c[k]; nc[k] = -uy * b[k] + ux * c[k]; }
+            std::copy(nb, nb + 3, ax[(m + 1) % 3]);
+            std::copy(nc, nc + 3, ax[(m + 2) % 3]);
+            extents(pts, ax, mn, mx);
+            volume = (mx[0] - mn[0]) * (mx[1] - mn[1]) * (mx[2] - mn[2]);
+        }
+        if (!(volume < before * (1.0 - 1e-6))) break;
+    }
+    return volume;
+}
+
+} // namespace hull
+
+// Convex hull of n points (xyz interleaved) by quickhull. The initial simplex comes
+// from parallel extreme-point searches; each face keeps the points above it, and the
+// points of faces removed by a new vertex are redistributed among the new faces in
+// parallel when there are many. Points within a relative tolerance of about 5e-7 of
+// the extent of a face's plane count as on it, so near-coplanar points do not split
+// faces. Returns false (and an invalid hull) when the points span no volume.
+inline bool computeConvexHull(const float* xyz, size_t n, ConvexHull& out) {
+    using hull::Face;
+    out = ConvexHull{};
+    if (n < 4) return false;
+    // axis extremes and the coordinate scale for the tolerance
+    struct Extremes { uint32_t lo[3], hi[3]; float scale[3]; bool used = false; };
+    std::vector<Extremes> parts(workerCount());
+    parallelFor(n, [&](size_t b, size_t e, unsigned w) {
+        Extremes x;
+        for (int k = 0; k < 3; ++k) { x.lo[k] = x.hi[k] = static_cast<uint32_t>(b); x.scale[k] = 0.0f; }
+        for (size_t i = b; i < e; ++i) {
+            const float* p = xyz + 3 * i;
+            for (int k = 0; k < 3; ++k) {
+                if (p[k] < xyz[3 * size_t(x.lo[k]) + k]) x.lo[k] = static_cast<uint32_t>(i);
+                if (p[k] > xyz[3 * size_t(x.hi[k]) + k]) x.hi[k] = static_cast<uint32_t>(i);
+                x.scale[k] = std::max(x.scale[k], std::fabs(p[k]));
+            }
+        }
+        x.used = true;
+        parts[w] = x;
+    });
+    uint32_t ext[6] = { 0, 0, 0, 0, 0, 0 };
+    double scale[3] = { 0.0, 0.0, 0.0 };
+    for (const auto& x : parts) {
+        if (!x.used) continue;
+        for (int k = 0; k < 3; ++k) {
+            if (xyz[3 * size_t(x.lo[k]) + k] < xyz[3 * size_t(ext[k]) + k]) ext[k] = x.lo[k];
+            if (xyz[3 * size_t(x.hi[k]) + k] > xyz[3 * size_t(ext[3 + k]) + k]) ext[3 + k] = x.hi[k];
+            scale[k] = std::max(scale[k], double(x.scale[k]));
+        }
+    }
+    const double eps = 4.0 * FLT_EPSILON * (scale[0] + scale[1] + scale[2]);
+    auto at = [xyz](uint32_t i) { return xyz + 3 * size_t(i); };
+
+    // simplex: the most distant pair of extremes, the point farthest from their line,
+    // then the point farthest from the plane of the three
+    uint32_t s0 = ext[0], s1 = ext[3];
+    double best = -1.0;
+    for (int a = 0; a < 6; ++a)
+        for (int b = a + 1; b < 6; ++b) {
+            const float *p = at(ext[a]), *q = at(ext[b]);
+            const double d = double(p[0] - q[0]) * (p[0] - q[0]) + double(p[1] - q[1]) * (p[1] - q[1]) + double(p[2] - q[2]) * (p[2] - q[2]);
+            if (d > best) { best = d; s0 = ext[a]; s1 = ext[b]; }
+        }
+    if (best <= eps * eps) return false;
+    const float *p0 = at(s0), *p1 = at(s1);
+    const double dir[3] = { double(p1[0]) - p0[0], double(p1[1]) - p0[1], double(p1[2]) - p0[2] };
+    const uint32_t s2 = hull::argmax(n, [&](size_t i) {
+        const float* p = xyz + 3 * i;
+        const double r[3] = { double(p[0]) - p0[0], double(p[1]) - p0[1], double(p[2]) - p0[2] };
+        const double c[3] = { r[1] * dir[2] - r[2] * dir[1], r[2] * dir[0] - r[0] * dir[2], r[0] * dir[1] - r[1] * dir[0] };
+        return c[0] * c[0] + c[1] * c[1] + c[2] * c[2];
+    }, best);
+    if (best <= eps * eps * (dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2])) return false;
+
+    std::vector<Face> faces(1);
+    faces[0].v[0] = s0; faces[0].v[1] = s1; faces[0].v[2] = s2;
+    hull::setPlane(faces[0], xyz);
+    const Face base = faces[0];
+    const uint32_t s3 = hull::argmax(n, [&](size_t i) { return std::fabs(hull::distance(base, xyz + 3 * i)); }, best);
+    const double signedBest = hull::distance(base, at(s3));
+    if (best <= eps) return false;
+
+    // orient so that s3 lies below (s0, s1, s2); the other faces follow from that
+    uint32_t a = s0, b = s1, c = s2;
+    if (signedBest > 0.0) std::swap(b, c);
+    const uint32_t tet[4][3] = { { a, b, c }, { a, s3, b }, { b, s3, c }, { c, s3, a } };
+    faces.assign(4, Face{});
+    for (int f = 0; f < 4; ++f) {
+        std::copy(tet[f], tet[f] + 3, faces[f].v);
+        hull::setPlane(faces[f], xyz);
+    }
+    for (int f = 0; f < 4; ++f)
+        for (int i = 0; i < 3; ++i)
+            for (int g = 0; g < 4; ++g)
+                for (int j = 0; j < 3; ++j)
+                    if (faces[g].v[j] == faces[f].v[(i + 1) % 3] && faces[g].v[(j + 1) % 3] == faces[f].v[i]) faces[f].nb[i] = g;
+
+    {
+        std::vector<uint32_t> all(n);
+        parallelFor(n, [&](size_t b0, size_t e0, unsigned) { for (size_t i = b0; i < e0; ++i) all[i] = static_cast<uint32_t>(i); });
+        const uint32_t fs[4] = { 0, 1, 2, 3 };
+        hull::partition(xyz, all.data(), n, faces, fs, 4, eps);
+    }
+
+    struct HorizonEdge { uint32_t a, b, face; };
+    // faces with outside points, largest set first: the big sets shrink early instead
+    // of being redistributed again by every nearby new vertex. Entries go stale when a
+    // face is removed or reused and are skipped.
+    std::vector<std::pair<size_t, uint32_t>> pending;
+    auto schedule = [&](uint32_t id) {
+        if (faces[id].outside.empty()) return;
+        pending.emplace_back(faces[id].outside.size(), id);
+        std::push_heap(pending.begin(), pending.end());
+    };
+    for (uint32_t id = 0; id < 4; ++id) schedule(id);
+    std::vector<uint32_t> visible, todo, orphans, created, freeFaces;
+    std::vector<HorizonEdge> horizon;
+    uint32_t stamp = 0;
+    while (!pending.empty()) {
+        std::pop_heap(pending.begin(), pending.end());
+        const auto [size, f] = pending.back();
+        pending.pop_back();
+        if (!faces[f].alive || faces[f].outside.size() != size) continue;
+        const uint32_t eye = faces[f].far;
+        const float* pe = at(eye);
+
+        // faces the eye is above, flood-filled from f; edges to the others form the horizon.
+        // Any positive distance counts here, so a nearly coplanar neighbour is replaced
+        // rather than left to fold against the new faces.
+        visible.clear(); horizon.clear();
+        faces[f].mark = ++stamp;
+        todo.assign(1, f);
+        while (!todo.empty()) {
+            const uint32_t g = todo.back();
+            todo.pop_back();
+            visible.push_back(g);
+            for (int i = 0; i < 3; ++i) {
+                const uint32_t h = faces[g].nb[i];
+                if (faces[h].mark == stamp) continue;
+                if (hull::distance(faces[h], pe) > 0.0) { faces[h].mark = stamp; todo.push_back(h); }
+                else horizon.push_back({ faces[g].v[i], faces[g].v[(i + 1) % 3], h });
+            }
+        }
+        // the horizon must be one loop; otherwise rounding made the visible region
+        // ill-formed and the eye is dropped as lying on the hull
+        std::sort(horizon.begin(), horizon.end(), [](const HorizonEdge& x, const HorizonEdge& y) { return x.a < y.a; });
+        auto startingAt = [&](uint32_t v) -> size_t {
+            const auto it = std::lower_bound(horizon.begin(), horizon.end(), v, [](const HorizonEdge& x, uint32_t y) { return x.a < y; });
+            return it != horizon.end() && it->a == v ? static_cast<size_t>(it - horizon.begin()) : horizon.size();
+        };
+        bool loop = horizon.size() >= 3;
+        for (size_t i = 1; loop && i < horizon.size(); ++i) loop = horizon[i].a != horizon[i - 1].a;
+        for (size_t i = 0, steps = 0; loop && steps < horizon.size(); ++steps) {
+            i = startingAt(horizon[i].b);
+            loop = i < horizon.size() && (i != 0 || steps + 1 == horizon.size());
+        }
+        if (!loop) {
+            Face& F = faces[f];
+            F.outside.erase(std::find(F.outside.begin(), F.outside.end(), eye));
+            F.farDist = 0.0;
+            for (uint32_t i : F.outside) {
+                const double d = hull::distance(F, at(i));
+                if (d > F.farDist) { F.farDist = d; F.far = i; }
+            }
+            schedule(f);
+            continue;
+        }
+
+        // remove the visible faces, keeping their outside points
+        orphans.clear();
+        for (uint32_t g : visible) {
+            Face& F = faces[g];
+            for (uint32_t i : F.outside) if (i != eye) orphans.push_back(i);
+            std::vector<uint32_t>().swap(F.outside);
+            F.alive = false;
+            freeFaces.push_back(g);
+        }
+        // cone of new faces (a, b, eye) over the horizon
+        created.resize(horizon.size());
+        for (size_t i = 0; i < horizon.size(); ++i) {
+            uint32_t id;
+            if (!freeFaces.empty()) { id = freeFaces.back(); freeFaces.pop_back(); faces[id] = Face{}; }
+            else { id = static_cast<uint32_t>(faces.size()); faces.emplace_back(); }
+            Face& F = faces[id];
+            F.v[0] = horizon[i].a; F.v[1] = horizon[i].b; F.v[2] = eye;
+            hull::setPlane(F, xyz);
+            F.nb[0] = horizon[i].face;
+            Face& N = faces[horizon[i].face];
+            for (int j = 0; j < 3; ++j)
+                if (N.v[j] == horizon[i].b && N.v[(j + 1) % 3] == horizon[i].a) N.nb[j] = id;
+            created[i] = id;
+        }
+        // edge (b, eye) meets the new face starting at b, across its edge (eye, b)
+        for (size_t i = 0; i < horizon.size(); ++i) {
+            const uint32_t next = created[startingAt(horizon[i].b)];
+            faces[created[i]].nb[1] = next;
+            faces[next].nb[2] = created[i];
+        }
+        hull::partition(xyz, orphans.data(), orphans.size(), faces, created.data(), created.size(), eps);
+        for (uint32_t id : created) schedule(id);
+    }
+
+    // compact the surviving faces and their vertices (in point order)
+    std::vector<uint32_t> used;
+    for (const Face& F : faces)
+        if (F.alive) used.insert(used.end(), F.v, F.v + 3);
+    std::sort(used.begin(), used.end());
+    used.erase(std::unique(used.begin(), used.end()), used.end());
+    out.vertices.reserve(used.size());
+    for (uint32_t i : used) {
+        const float* p = at(i);
+        out.vertices.push_back({ p[0], p[1], p[2] });
+    }
+    for (const Face& F : faces) {
+        if (!F.alive) continue;
+        std::array<uint32_t, 3> t;
+        for (int j = 0; j < 3; ++j) t[j] = static_cast<uint32_t>(std::lower_bound(used.begin(), used.end(), F.v[j]) - used.begin());
+        out.faces.push_back(t);
+    }
+    out.valid = true;
+    return true;
+}
+
+// Tight oriented box around n points (xyz interleaved). The principal axes of the
+// point covariance and the coordinate axes each seed a descent (hull::refineBox) over
+// the hull vertices, and the smaller result is kept. For points spanning no volume the
+// descent runs on the outline of their projection onto the principal plane, and the
+// extents come from a pass over all points.
+inline bool computeOrientedBox(const float* xyz, size_t n, const ConvexHull& hull, OrientedBox& box) {
+    box = OrientedBox{};
+    if (n == 0) return false;
+    // covariance about the first point (for precision), per worker
+    struct Moments { double s[3] = { 0, 0, 0 }, c[6] = { 0, 0, 0, 0, 0, 0 }; };
+    std::vector<Moments> parts(workerCount());
+    const double o[3] = { xyz[0], xyz[1], xyz[2] };
+    parallelFor(n, [&](size_t b, size_t e, unsigned w) {
+        Moments m;
+        for (size_t i = b; i < e; ++i) {
+            const double x = xyz[3 * i] - o[0], y = xyz[3 * i + 1] - o[1], z = xyz[3 * i + 2] - o[2];
+            m.s[0] += x; m.s[1] += y; m.s[2] += z;
+            m.c[0] += x * x; m.c[1] += x * y; m.c[2] += x * z; m.c[3] += y * y; m.c[4] += y * z; m.c[5] += z * z;
+        }
+        parts[w] = m;
+    });
+    Moments sum;
+    for (const auto& m : parts) {
+        for (int k = 0; k < 3; ++k) sum.s[k] += m.s[k];
+        for (int k = 0; k < 6; ++k) sum.c[k] += m.c[k];
+    }
+    const double inv = 1.0 / static_cast<double>(n);
+    const double mean[3] = { sum.s[0] * inv, sum.s[1] * inv, sum.s[2] * inv };
+    const double cov[6] = { sum.c[0] * inv - mean[0] * mean[0], sum.c[1] * inv - mean[0] * mean[1], sum.c[2] * inv - mean[0] * mean[2],
+                            sum.c[3] * inv - mean[1] * mean[1], sum.c[4] * inv - mean[1] * mean[2], sum.c[5] * inv - mean[2] * mean[2] };
+    double lambda[3], pca[3][3];
+    symmetricEigen3(cov, lambda, pca[2]);
+    symmetricEigenvector3(cov, lambda[2], pca[0]);
+    // a repeated eigenvalue leaves the first axis free: any unit vector normal to pca[2]
+    double dot = pca[0][0] * pca[2][0] + pca[0][1] * pca[2][1] + pca[0][2] * pca[2][2];
+    if (std::fabs(dot) > 1e-6 || lambda[2] - lambda[0] <= 1e-12 * std::max(1.0, std::fabs(lambda[2]))) {
+        const int k = std::fabs(pca[2][0]) < 0.9 ? 0 : 1;
+        double e[3] = { 0, 0, 0 };
+        e[k] = 1.0;
+        dot = pca[2][k];
+        for (int j = 0; j < 3; ++j) pca[0][j] = e[j] - dot * pca[2][j];
+    }
+    double len = std::sqrt(pca[0][0] * pca[0][0] + pca[0][1] * pca[0][1] + pca[0][2] * pca[0][2]);
+    for (int j = 0; j < 3; ++j) pca[0][j] /= len;
+    pca[1][0] = pca[2][1] * pca[0][2] - pca[2][2] * pca[0][1];
+    pca[1][1] = pca[2][2] * pca[0][0] - pca[2][0] * pca[0][2];
+    pca[1][2] = pca[2][0] * pca[0][1] - pca[2][1] * pca[0][0];
+
+    // candidate points: hull vertices, or the outline in the principal plane
+    std::vector<std::array<float, 3>> candidates;
+    if (hull.valid) {
+        candidates = hull.vertices;
+    } else {
+        std::vector<std::array<double, 2>> plane(n), outline;
+        for (size_t i = 0; i < n; ++i) {
+            const float* p = xyz + 3 * i;
+            plane[i] = { p[0] * pca[0][0] + p[1] * pca[0][1] + p[2] * pca[0][2], p[0] * pca[1][0] + p[1] * pca[1][1] + p[2] * pca[1][2] };
+        }
+        hull::hull2D(plane, outline);
+        const double offset = (mean[0] + o[0]) * pca[2][0] + (mean[1] + o[1]) * pca[2][1] + (mean[2] + o[2]) * pca[2][2];
+        for (const auto& q : outline) {
+            candidates.push_back({ static_cast<float>(q[0] * pca[0][0] + q[1] * pca[1][0] + offset * pca[2][0]),
+                                   static_cast<float>(q[0] * pca[0][1] + q[1] * pca[1][1] + offset * pca[2][1]),
+                                   static_cast<float>(q[0] * pca[0][2] + q[1] * pca[1][2] + offset * pca[2][2]) });
+        }
+    }
+
+    double ax[3][3], aabb[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+    std::copy(&pca[0][0], &pca[0][0] + 9, &ax[0][0]);
+    // a flat set has zero volume whatever the frame: keep the plane normal fixed then
+    double bestVolume;
+    if (hull.valid) {
+        bestVolume = hull::refineBox(candidates, ax);
+        if (hull::refineBox(candidates, aabb) < bestVolume) std::copy(&aabb[0][0], &aabb[0][0] + 9, &ax[0][0]);
+    } else {
+        std::vector<std::array<double, 2>> plane(candidates.size());
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            const auto& p = candidates[i];
+            plane[i] = { p[0] * ax[0][0] + p[1] * ax[0][1] + p[2] * ax[0][2], p[0] * ax[1][0] + p[1] * ax[1][1] + p[2] * ax[1][2] };
+        }
+        double ux, uy, nb[3], nc[3];
+        hull::minAreaRect(plane, ux, uy);
+        for (int k = 0; k < 3; ++k) { nb[k] = ux * ax[0][k] + uy * ax[1][k]; nc[k] = -uy * ax[0][k] + ux * ax[1][k]; }
+        std::copy(nb, nb + 3, ax[0]);
+        std::copy(nc, nc + 3, ax[1]);
+    }
+
+    double mn[3], mx[3];
+    if (hull.valid) {
+        hull::extents(candidates, ax, mn, mx);
+    } else {
+        struct Range { double mn[3], mx[3]; bool used = false; };
+        std::vector<Range> ranges(workerCount());
+        parallelFor(n, [&](size_t b, size_t e, unsigned w) {
+            Range r;
+            for (int k = 0; k < 3; ++k) { r.mn[k] = std::numeric_limits<double>::infinity(); r.mx[k] = -r.mn[k]; }
+            for (size_t i = b; i < e; ++i) {
+                const float* p = xyz + 3 * i;
+                for (int k = 0; k < 3; ++k) {
+                    const double t = p[0] * ax[k][0] + p[1] * ax[k][1] + p[2] * ax[k][2];
+                    r.mn[k] = std::min(r.mn[k], t); r.mx[k] = std::max(r.mx[k], t);
+                }
+            }
+            r.used = true;
+            ranges[w] = r;
+        });
+        for (int k = 0; k < 3; ++k) { mn[k] = std::numeric_limits<double>::infinity(); mx[k] = -mn[k]; }
+        for (const auto& r : ranges) {
+            if (!r.used) continue;
+            for (int k = 0; k < 3; ++k) { mn[k] = std::min(mn[k], r.mn[k]); mx[k] = std::max(mx[k], r.mx[k]); }
+        }
+    }
+
+    // longest axis first, third axis rebuilt so the frame stays right-handed
+    int idx[3] = { 0, 1, 2 };
+    std::sort(idx, idx + 3, [&](int x, int y) { return mx[x] - mn[x] > mx[y] - mn[y]; });
+    double center[3] = { 0, 0, 0 }, axes[3][3];
+    for (int k = 0; k < 3; ++k) {
+        std::copy(ax[idx[k]], ax[idx[k]] + 3, axes[k]);
+        const double mid = 0.5 * (mn[idx[k]] + mx[idx[k]]);
+        for (int j = 0; j < 3; ++j) center[j] += mid * ax[idx[k]][j];
+        box.halfExtents[k] = static_cast<float>(0.5 * (mx[idx[k]] - mn[idx[k]]));
+    }
+    axes[2][0] = axes[0][1] * axes[1][2] - axes[0][2] * axes[1][1];
+    axes[2][1] = axes[0][2] * axes[1][0] - axes[0][0] * axes[1][2];
+    axes[2][2] = axes[0][0] * axes[1][1] - axes[0][1] * axes[1][0];
+    for (int k = 0; k < 3; ++k) {
+        box.center[k] = static_cast<float>(center[k]);
+        for (int j = 0; j < 3; ++j) box.axes[k][j] = static_cast<float>(axes[k][j]);
+    }
+    box.valid = true;
+    return true;
+}
+
+} // namespace PointCloudUtil
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+
+#include "PointCloudUtil.h"
+#include "PointCloudLas.h"
+#include "PointCloudPcd.h"
+#include "PointCloudTiles.h"
+#include "PointCloudText.h"
+
+namespace PointCloudUtil {
+
+// Lower-case extension of 'path' including the dot ("" if none)
+inline std::string fileExtension(const std::string& path) {
+    const size_t slash = path.find_last_of("/\\");
+    const size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return "";
+    std::string ext = path.substr(dot);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return ext;
+}
+
+// Plain-text point files handled by loadFromText()
+inline bool isTextPointFile(const std::string& path) {
+    const std::string ext = fileExtension(path);
+    return ext == ".xyz" || ext == ".txt" || ext == ".pts" || ext == ".csv";
+}
+
+// Extensions loadPointCloud() understands
+inline bool isSupportedPointFile(const std::string& path) {
+    const std::string ext = fileExtension(path);
+    return ext == ".ply" || ext == ".las" || ext == ".pcd" || isTextPointFile(path);
+}
+
+// Load by extension (.las, .pcd, .xyz/.txt/.pts/.csv, otherwise ASCII PLY)
+inline bool loadPointCloud(PointCloud& cloud, const std::string& path, bool keepSnapshot = true) {
+    const std::string ext = fileExtension(path);
+    if (ext == ".las") return loadFromLAS(cloud, path, keepSnapshot);
+    if (ext == ".pcd") return loadFromPCD(cloud, path, keepSnapshot);
+    if (isTextPointFile(path)) return loadFromText(cloud, path, keepSnapshot);
+    return cloud.loadFromPLY(path, keepSnapshot);
+}
+
+// Save by extension (.las, .pcd as binary_compressed, .tiles as a tile database for
+// streaming, otherwise ASCII PLY)
+inline bool savePointCloud(PointCloud& cloud, const std::string& path) {
+    const std::string ext = fileExtension(path);
+    if (ext == ".las") return saveToLAS(cloud, path);
+    if (ext == ".pcd") return saveToPCD(cloud, path, pcd::Encoding::BinaryCompressed);
+    if (ext == ".tiles") return buildTileDatabase(cloud, path);
+    return cloud.saveToPLY(path);
+}
+
+} // namespace PointCloudUtil
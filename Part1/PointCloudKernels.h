@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+
+#include "PointCloudUtil.h"
+
+namespace PointCloudUtil {
+
+// Per-point operations that can be fused into a single pass over the cloud.
+// Each op is a small value type with 'void operator()(Point&) const'; the fused
+// kernel calls them back to back on a point while it is still in registers.
+
+// General affine transform (positions by M, normals by its linear part)
+struct AffineOp {
+    Mat4 m = Mat4::identity();
+    inline void operator()(Point& p) const { transformPointAndNormal(m, p); }
+};
+
+// Displacement along the point normal
+struct DisplaceOp {
+    float amount = 0.0f;
+    inline void operator()(Point& p) const {
+        p.x += amount * p.nx;
+        p.y += amount * p.ny;
+        p.z += amount * p.nz;
+    }
+};
+
+// Clamp positions into an axis-aligned box
+struct ClampOp {
+    float minX, minY, minZ, maxX, maxY, maxZ;
+    inline void operator()(Point& p) const {
+        p.x = std::min(std::max(p.x, minX), maxX);
+        p.y = std::min(std::max(p.y, minY), maxY);
+        p.z = std::min(std::max(p.z, minZ), maxZ);
+    }
+};
+
+// Colour from a 256-entry lookup table indexed by one coordinate mapped from [lo, hi]
+struct ColorLutOp {
+    std::array<std::array<uint8_t, 3>, 256> lut{};
+    int axis = 1;            // 0=x, 1=y, 2=z
+    float lo = 0.0f, hi = 1.0f;
+
+    // Blue -> cyan -> green -> yellow -> red ramp
+    static ColorLutOp heightRamp(int axis, float lo, float hi) {
+        ColorLutOp op;
+        op.axis = axis; op.lo = lo; op.hi = hi;
+        for (int i = 0; i < 256; ++i) {
+            const float t = i / 255.0f * 4.0f;
+            const int seg = std::min(3, static_cast<int>(t));
+            const float f = t - seg;
+            float r = 0, g = 0, b = 0;
+            switch (seg) {
+                case 0: r = 0;     g = f;     b = 1;     break;
+                case 1: r = 0;     g = 1;     b = 1 - f; break;
+                case 2: r = f;     g = 1;     b = 0;     break;
+                default: r = 1;    g = 1 - f; b = 0;     break;
+            }
+            op.lut[i] = { static_cast<uint8_t>(r * 255.0f + 0.5f),
+                          static_cast<uint8_t>(g * 255.0f + 0.5f),
+                          static_cast<uint8_t>(b * 255.0f + 0.5f) };
+        }
+        return op;
+    }
+
+    inline void operator()(Point& p) const {
+        const float v = (axis == 0) ? p.x : (axis == 1) ? p.y : p.z;
+        const float scale = (hi > lo) ? 255.0f / (hi - lo) : 0.0f;
+        const int idx = static_cast<int>(std::min(255.0f, std::max(0.0f, (v - lo) * scale)));
+        p.r = lut[idx][0]; p.g = lut[idx][1]; p.b = lut[idx][2];
+    }
+};
+
+// K operations composed at compile time into one callable: a chain costs one memory pass
+template <typename... Ops>
+struct FusedKernel {
+    std::tuple<Ops...> ops;
+    inline void operator()(Point& p) const {
+        std::apply([&p](const Ops&... op) { (op(p), ...); }, ops);
+    }
+};
+
+// Builder: PipelineBuilder<>().then(a).then(b).build() -> FusedKernel<A, B>
+template <typename... Ops>
+struct PipelineBuilder {
+    std::tuple<Ops...> ops;
+
+    template <typename Op>
+    PipelineBuilder<Ops..., Op> then(Op op) const {
+        return PipelineBuilder<Ops..., Op>{ std::tuple_cat(ops, std::make_tuple(std::move(op))) };
+    }
+    FusedKernel<Ops...> build() const { return FusedKernel<Ops...>{ ops }; }
+};
+
+template <typename... Ops>
+FusedKernel<Ops...> fuse(Ops... ops) {
+    return FusedKernel<Ops...>{ std::make_tuple(std::move(ops)...) };
+}
+
+} // namespace PointCloudUtil
@@ -0,0 +1,337 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "PointCloudUtil.h"
+
+namespace PointCloudUtil {
+
+// ASPRS LAS 1.2-1.4, point data formats 0-3 and 6-8 (uncompressed only).
+// Coordinates are scaled integers decoded to double and stored georeferenced; intensity,
+// classification, return numbers and GPS time become attribute columns.
+namespace las {
+
+// Little-endian field access (LAS is little-endian; the decoders assume a LE host)
+template <typename T>
+inline T get(const unsigned char* p) { T v; std::memcpy(&v, p, sizeof(T)); return v; }
+template <typename T>
+inline void put(unsigned char* p, T v) { std::memcpy(p, &v, sizeof(T)); }
+
+struct Header {
+    uint8_t versionMajor = 1, versionMinor = 2;
+    uint16_t headerSize = 227;
+    uint32_t pointOffset = 227;
+    uint8_t pointFormat = 0;
+    uint16_t recordLength = 20;
+    uint64_t pointCount = 0;
+    double scale[3] = { 0.001, 0.001, 0.001 };
+    double offset[3] = { 0.0, 0.0, 0.0 };
+    double maxXYZ[3] = { 0.0, 0.0, 0.0 };
+    double minXYZ[3] = { 0.0, 0.0, 0.0 };
+};
+
+// Minimum record size of each supported point format (-1: unsupported)
+inline int recordSize(int format) {
+    static const int sizes[] = { 20, 28, 26, 34, -1, -1, 30, 36, 38 };
+    return (format >= 0 && format <= 8) ? sizes[format] : -1;
+}
+inline bool hasGpsTime(int format) { return format == 1 || format == 3 || format >= 6; }
+inline bool hasRgb(int format) { return format == 2 || format == 3 || format == 7 || format == 8; }
+inline int rgbOffset(int format) { return format == 2 ? 20 : format == 3 ? 28 : 30; }
+
+inline bool readHeader(std::ifstream& file, const std::string& filename, Header& h) {
+    unsigned char b[375] = {};
+    file.read(reinterpret_cast<char*>(b), 227);
+    if (file.gcount() != 227 || std::memcmp(b, "LASF", 4) != 0) {
+        std::cerr << "Error: " << filename << " is not a LAS file" << std::endl;
+        return false;
+    }
+    h.versionMajor = b[24];
+    h.versionMinor = b[25];
+    h.headerSize = get<uint16_t>(b + 94);
+    h.pointOffset = get<uint32_t>(b + 96);
+    h.pointFormat = b[104];
+    h.recordLength = get<uint16_t>(b + 105);
+    h.pointCount = get<uint32_t>(b + 107);
+    for (int k = 0; k < 3; ++k) {
+        h.scale[k] = get<double>(b + 131 + 8 * k);
+        h.offset[k] = get<double>(b + 155 + 8 * k);
+        h.maxXYZ[k] = get<double>(b + 179 + 16 * k);
+        h.minXYZ[k] = get<double>(b + 187 + 16 * k);
+    }
+    if (h.versionMajor == 1 && h.versionMinor >= 4 && h.headerSize >= 375) {
+        file.read(reinterpret_cast<char*>(b + 227), 375 - 227);
+        const uint64_t count64 = get<uint64_t>(b + 247);
+        if (count64) h.pointCount = count64;
+    }
+    if (h.pointFormat & 0x80) {
+        std::cerr << "Error: " << filename << " is LAZ-compressed (not supported)" << std::endl;
+        return false;
+    }
+    const int minRecord = recordSize(h.pointFormat);
+    if (minRecord < 0 || h.recordLength < minRecord) {
+        std::cerr << "Error: Unsupported LAS point format " << int(h.pointFormat) << " in " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace las
+
+// Load a LAS file into 'cloud' (replacing its contents). Records are read in blocks and
+// each block is decoded in parallel over the worker pool before being appended.
+inline bool loadFromLAS(PointCloud& cloud, const std::string& filename, bool keepSnapshot = true) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to open file " << filename << std::endl;
+        return false;
+    }
+    las::Header h;
+    if (!las::readHeader(file, filename, h)) return false;
+    file.seekg(h.pointOffset, std::ios::beg);
+
+    cloud.clear();
+    const int format = h.pointFormat;
+    const bool extended = format >= 6;
+    const size_t stride = h.recordLength;
+
+    AttributeSet block;
+    block.add("intensity", AttributeType::U16);
+    block.add("classification", AttributeType::U8);
+    block.add("return_number", AttributeType::U8);
+    block.add("number_of_returns", AttributeType::U8);
+    if (las::hasGpsTime(format)) block.add("gps_time", AttributeType::F64);
+    if (format == 8) block.add("nir", AttributeType::U16);
+
+    const size_t blockPoints = size_t(1) << 18;
+    std::vector<unsigned char> raw;
+    auto pts = cloud.scratch().borrow<Point>(blockPoints);
+    auto absolute = cloud.scratch().borrow<Vec3d>(blockPoints);
+    std::vector<uint16_t> colorMax(workerCount());
+    uint16_t maxColor = 0;
+
+    for (uint64_t done = 0; done < h.pointCount;) {
+        const size_t n = static_cast<size_t>(std::min<uint64_t>(blockPoints, h.pointCount - done));
+        raw.resize(n * stride);
+        file.read(reinterpret_cast<char*>(raw.data()), static_cast<std::streamsize>(raw.size()));
+        if (static_cast<size_t>(file.gcount()) != raw.size()) {
+            std::cerr << "Error: Truncated point data in " << filename << std::endl;
+            return false;
+        }
+        block.resize(n);
+        uint16_t* intensity = block.find("intensity")->data<uint16_t>();
+        uint8_t* cls = block.find("classification")->data<uint8_t>();
+        uint8_t* ret = block.find("return_number")->data<uint8_t>();
+        uint8_t* rets = block.find("number_of_returns")->data<uint8_t>();
+        double* gps = las::hasGpsTime(format) ? block.find("gps_time")->data<double>() : nullptr;
+        uint16_t* nir = format == 8 ? block.find("nir")->data<uint16_t>() : nullptr;
+        const unsigned char* src = raw.data();
+        Point* out = pts.data();
+        Vec3d* pos = absolute.data();
+        std::fill(colorMax.begin(), colorMax.end(), 0);
+
+        parallelFor(n, [&](size_t b, size_t e, unsigned w) {
+            uint16_t cmax = 0;
+            for (size_t i = b; i < e; ++i) {
+                const unsigned char* r = src + i * stride;
+                pos[i] = Vec3d{ las::get<int32_t>(r) * h.scale[0] + h.offset[0],
+                                las::get<int32_t>(r + 4) * h.scale[1] + h.offset[1],
+                                las::get<int32_t>(r + 8) * h.scale[2] + h.offset[2] };
+                intensity[i] = las::get<uint16_t>(r + 12);
+                if (extended) {
+                    ret[i] = r[14] & 0x0F; rets[i] = r[14] >> 4;
+                    cls[i] = r[16];
+                    gps[i] = las::get<double>(r + 22);
+                } else {
+                    ret[i] = r[14] & 0x07; rets[i] = (r[14] >> 3) & 0x07;
+                    cls[i] = r[15] & 0x1F;
+                    if (gps) gps[i] = las::get<double>(r + 20);
+                }
+                Point p = {};
+                if (las::hasRgb(format)) {
+                    const unsigned char* c = r + las::rgbOffset(format);
+                    const uint16_t cr = las::get<uint16_t>(c), cg = las::get<uint16_t>(c + 2), cb = las::get<uint16_t>(c + 4);
+                    p.r = cr; p.g = cg; p.b = cb;
+                    cmax = std::max(cmax, std::max(cr, std::max(cg, cb)));
+                    if (nir) nir[i] = las::get<uint16_t>(c + 6);
+                } else {
+                    p.r = p.g = p.b = 255;
+                }
+                out[i] = p;
+            }
+            colorMax[w] = std::max(colorMax[w], cmax);
+        });
+        for (uint16_t m : colorMax) maxColor = std::max(maxColor, m);
+        cloud.appendGeoreferenced(out, pos, n, false, &block);
+        done += n;
+    }
+
+    // Colours are 16-bit in the spec, but some writers store 8-bit values: only rescale
+    // when the file actually uses the 16-bit range
+    if (maxColor > 255) {
+        cloud.applyChunkKernel([](const Vec3d&) {
+            return [](Point& p) { p.r >>= 8; p.g >>= 8; p.b >>= 8; };
+        });
+    }
+    if (cloud.size() == 0) {
+        std::cerr << "Error: No points loaded from file." << std::endl;
+        return false;
+    }
+    if (keepSnapshot) cloud.commitSnapshot();
+    return true;
+}
+
+// Save as LAS with millimetre scale. pointFormat -1 picks 3 when the cloud has a
+// gps_time column and 2 otherwise; formats 0-3 are written as LAS 1.2 and 6-8 as 1.4.
+inline bool saveToLAS(PointCloud& cloud, const std::string& filename, int pointFormat = -1) {
+    const AttributeSet& attrs = cloud.attributes();
+    if (pointFormat < 0) pointFormat = attrs.find("gps_time") ? 3 : 2;
+    const int recordLength = las::recordSize(pointFormat);
+    if (recordLength < 0) {
+        std::cerr << "Error: Unsupported LAS point format " << pointFormat << std::endl;
+        return false;
+    }
+    cloud.bake();
+    const bool extended = pointFormat >= 6;
+    const Vec3d origin = cloud.getOrigin();
+    const auto& points = cloud.getPoints();
+    const auto& chunks = cloud.getChunks();
+    const size_t n = points.size();
+
+    // Absolute bounds (double) for the header and the integer offset
+    double mn[3] = { 0, 0, 0 }, mx[3] = { 0, 0, 0 };
+    bool first = true;
+    auto absolute = [&](size_t i, const Vec3d& d) {
+        return Vec3d{ origin.x + d.x + points[i].x, origin.y + d.y + points[i].y, origin.z + d.z + points[i].z };
+    };
+    for (size_t k = 0, b = 0; b < n; ++k) {
+        const size_t e = k + 1 < chunks.size() ? chunks[k + 1].begin : n;
+        const Vec3d d = chunks.empty() ? Vec3d{} : chunks[k].offset;
+        for (size_t i = b; i < e; ++i) {
+            const Vec3d a = absolute(i, d);
+            const double v[3] = { a.x, a.y, a.z };
+            for (int c = 0; c < 3; ++c) {
+                if (first) { mn[c] = mx[c] = v[c]; continue; }
+                mn[c] = std::min(mn[c], v[c]); mx[c] = std::max(mx[c], v[c]);
+            }
+            first = false;
+        }
+        b = e;
+    }
+
+    las::Header h;
+    h.versionMinor = extended ? 4 : 2;
+    h.headerSize = h.pointOffset = extended ? 375 : 227;
+    h.pointFormat = static_cast<uint8_t>(pointFormat);
+    h.recordLength = static_cast<uint16_t>(recordLength);
+    h.pointCount = n;
+    for (int c = 0; c < 3; ++c) {
+        h.offset[c] = std::floor(mn[c]);
+        h.minXYZ[c] = mn[c];
+        h.maxXYZ[c] = mx[c];
+        // Records are int32: coarsen the millimetre scale by decades until the extent fits
+        const double span = mx[c] - h.offset[c];
+        if (!std::isfinite(span)) {
+            std::cerr << "Error: Non-finite coordinates cannot be written to LAS" << std::endl;
+            return false;
+        }
+        while (span / h.scale[c] + 0.5 > static_cast<double>(std::numeric_limits<int32_t>::max()))
+            h.scale[c] *= 10.0;
+    }
+    if (!extended && n > 0xFFFFFFFFull) {
+        std::cerr << "Error: Too many points for LAS point format " << pointFormat << std::endl;
+        return false;
+    }
+
+    unsigned char hb[375] = {};
+    std::memcpy(hb, "LASF", 4);
+    hb[24] = h.versionMajor; hb[25] = h.versionMinor;
+    std::memcpy(hb + 58, "PointCloudUtil", 14);
+    las::put<uint16_t>(hb + 94, h.headerSize);
+    las::put<uint32_t>(hb + 96, h.pointOffset);
+    hb[104] = h.pointFormat;
+    las::put<uint16_t>(hb + 105, h.recordLength);
+    // legacy point count (and the legacy per-return counts at 111, left zero) must be 0
+    // for formats 6-10; readers take the 64-bit count at 247
+    las::put<uint32_t>(hb + 107, extended ? 0u : static_cast<uint32_t>(n));
+    for (int c = 0; c < 3; ++c) {
+        las::put<double>(hb + 131 + 8 * c, h.scale[c]);
+        las::put<double>(hb + 155 + 8 * c, h.offset[c]);
+        las::put<double>(hb + 179 + 16 * c, h.maxXYZ[c]);
+        las::put<double>(hb + 187 + 16 * c, h.minXYZ[c]);
+    }
+    if (extended) {
+        las::put<uint16_t>(hb + 6, 0x10);       // global encoding: WKT bit (required for 6-10)
+        las::put<uint64_t>(hb + 247, n);
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to write file " << filename << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(hb), h.headerSize);
+
+    auto column = [&](const char* name) { return attrs.find(name); };
+    const AttributeChannel* intensity = column("intensity");
+    const AttributeChannel* cls = column("classification");
+    const AttributeChannel* ret = column("return_number");
+    const AttributeChannel* rets = column("number_of_returns");
+    const AttributeChannel* gps = column("gps_time");
+    const AttributeChannel* nir = column("nir");
+    auto value = [](const AttributeChannel* c, size_t i, double fallback) { return c ? c->get(i) : fallback; };
+
+    // Encode blocks in parallel, write them sequentially
+    const size_t blockPoints = size_t(1) << 18;
+    std::vector<unsigned char> raw;
+    for (size_t base = 0; base < n; base += blockPoints) {
+        const size_t m = std::min(blockPoints, n - base);
+        raw.assign(m * recordLength, 0);
+        parallelFor(m, [&](size_t b, size_t e, unsigned) {
+            size_t k = 0;
+            if (!chunks.empty()) {
+                k = static_cast<size_t>(std::upper_bound(chunks.begin(), chunks.end(), base + b,
+                    [](size_t v, const PointCloud::Chunk& c) { return v < c.begin; }) - chunks.begin()) - 1;
+            }
+            for (size_t j = b; j < e; ++j) {
+                const size_t i = base + j;
+                while (k + 1 < chunks.size() && chunks[k + 1].begin <= i) ++k;
+                const Vec3d a = absolute(i, chunks.empty() ? Vec3d{} : chunks[k].offset);
+                unsigned char* r = raw.data() + j * recordLength;
+                las::put<int32_t>(r,     static_cast<int32_t>(std::llround((a.x - h.offset[0]) / h.scale[0])));
+                las::put<int32_t>(r + 4, static_cast<int32_t>(std::llround((a.y - h.offset[1]) / h.scale[1])));
+                las::put<int32_t>(r + 8, static_cast<int32_t>(std::llround((a.z - h.offset[2]) / h.scale[2])));
+                las::put<uint16_t>(r + 12, static_cast<uint16_t>(value(intensity, i, 0)));
+                const unsigned rn = static_cast<unsigned>(value(ret, i, 1)), nr = static_cast<unsigned>(value(rets, i, 1));
+                if (extended) {
+                    r[14] = static_cast<unsigned char>((rn & 0x0F) | ((nr & 0x0F) << 4));
+                    r[16] = static_cast<unsigned char>(value(cls, i, 0));
+                    las::put<double>(r + 22, value(gps, i, 0.0));
+                } else {
+                    r[14] = static_cast<unsigned char>((rn & 0x07) | ((nr & 0x07) << 3));
+                    r[15] = static_cast<unsigned char>(static_cast<unsigned>(value(cls, i, 0)) & 0x1F);
+                    if (las::hasGpsTime(pointFormat)) las::put<double>(r + 20, value(gps, i, 0.0));
+                }
+                if (las::hasRgb(pointFormat)) {
+                    const Point& p = points[i];
+                    unsigned char* c = r + las::rgbOffset(pointFormat);
+                    las::put<uint16_t>(c,     static_cast<uint16_t>(std::clamp(p.r, 0, 255) * 257));
+                    las::put<uint16_t>(c + 2, static_cast<uint16_t>(std::clamp(p.g, 0, 255) * 257));
+                    las::put<uint16_t>(c + 4, static_cast<uint16_t>(std::clamp(p.b, 0, 255) * 257));
+                    if (pointFormat == 8) las::put<uint16_t>(c + 6, static_cast<uint16_t>(value(nir, i, 0)));
+                }
+            }
+        });
+        file.write(reinterpret_cast<const char*>(raw.data()), static_cast<std::streamsize>(raw.size()));
+    }
+    return static_cast<bool>(file);
+}
+
+} // namespace PointCloudUtil
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "PointCloudParallel.h"
+
+namespace PointCloudUtil {
+
+// Colour of a point kept by PointCloud::merge() in a voxel that other inputs also hit.
+// KeepFirst leaves it unchanged; Average takes the mean over every input's points in
+// the voxel; KeepLast takes the mean of the last input's points there (newer scans win).
+enum class ColorBlend : uint8_t { KeepFirst, Average, KeepLast };
+
+// Open-addressed voxel table shared by the workers of a merge. Slots are claimed with a
+// compare-and-swap on the key, so all inputs insert concurrently. Per voxel it records
+// the first and last input that hit it and, when a blend needs them, colour sums.
+// 12 bytes per slot, plus 16 with colours.
+class VoxelMergeTable {
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> keys;
+    std::unique_ptr<std::atomic<uint16_t>[]> firstInput, lastInput;
+    std::unique_ptr<std::atomic<uint32_t>[]> sums;   // r, g, b, count per slot
+    size_t mask = 0;
+    unsigned shift = 64;
+
+public:
+    static constexpr uint64_t kEmpty = ~uint64_t(0);
+    static constexpr size_t kMaxInputs = 0xFFFF;
+
+    // Room for up to 'expected' voxels at a load factor of at most 2/3
+    void reset(size_t expected, bool withColours) {
+        size_t cap = 16;
+        shift = 60;
+        while (cap < expected + expected / 2) { cap <<= 1; --shift; }
+        mask = cap - 1;
+        keys.reset(new std::atomic<uint64_t>[cap]);
+        firstInput.reset(new std::atomic<uint16_t>[cap]);
+        lastInput.reset(new std::atomic<uint16_t>[cap]);
+        sums.reset(withColours ? new std::atomic<uint32_t>[4 * cap] : nullptr);
+        parallelFor(cap, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i) {
+                keys[i].store(kEmpty, std::memory_order_relaxed);
+                firstInput[i].store(0xFFFF, std::memory_order_relaxed);
+                lastInput[i].store(0, std::memory_order_relaxed);
+                if (sums) for (int k = 0; k < 4; ++k) sums[4 * i + k].store(0, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    // Slot of 'key', claimed if new; 'input' is folded into its first/last inputs
+    uint32_t insert(uint64_t key, uint16_t input) {
+        size_t i = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> shift) & mask;
+        for (;; i = (i + 1) & mask) {
+            uint64_t k = keys[i].load(std::memory_order_relaxed);
+            if (k == kEmpty && keys[i].compare_exchange_strong(k, key, std::memory_order_relaxed)) break;
+            if (k == key) break;
+        }
+        uint16_t f = firstInput[i].load(std::memory_order_relaxed);
+        while (input < f && !firstInput[i].compare_exchange_weak(f, input, std::memory_order_relaxed)) {}
+        uint16_t l = lastInput[i].load(std::memory_order_relaxed);
+        while (input > l && !lastInput[i].compare_exchange_weak(l, input, std::memory_order_relaxed)) {}
+        return static_cast<uint32_t>(i);
+    }
+
+    uint16_t first(uint32_t slot) const { return firstInput[slot].load(std::memory_order_relaxed); }
+    uint16_t last(uint32_t slot) const { return lastInput[slot].load(std::memory_order_relaxed); }
+
+    void addColour(uint32_t slot, int r, int g, int b) {
+        std::atomic<uint32_t>* s = sums.get() + 4 * size_t(slot);
+        s[0].fetch_add(static_cast<uint32_t>(std::clamp(r, 0, 255)), std::memory_order_relaxed);
+        s[1].fetch_add(static_cast<uint32_t>(std::clamp(g, 0, 255)), std::memory_order_relaxed);
+        s[2].fetch_add(static_cast<uint32_t>(std::clamp(b, 0, 255)), std::memory_order_relaxed);
+        s[3].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Mean of the colours added to 'slot'; false when none were
+    bool meanColour(uint32_t slot, int& r, int& g, int& b) const {
+        const std::atomic<uint32_t>* s = sums.get() + 4 * size_t(slot);
+        const uint32_t n = s[3].load(std::memory_order_relaxed);
+        if (!n) return false;
+        r = static_cast<int>((s[0].load(std::memory_order_relaxed) + n / 2) / n);
+        g = static_cast<int>((s[1].load(std::memory_order_relaxed) + n / 2) / n);
+        b = static_cast<int>((s[2].load(std::memory_order_relaxed) + n / 2) / n);
+        return true;
+    }
+};
+
+} // namespace PointCloudUtil
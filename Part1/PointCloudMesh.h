@@ -0,0 +1,301 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "PointCloudAttributes.h"
+#include "PointCloudParallel.h"
+
+namespace PointCloudUtil {
+
+// Indexed triangle mesh. Faces are counter-clockwise seen from outside; per-vertex
+// colours and normals are optional (empty when absent).
+struct TriangleMesh {
+    std::vector<std::array<float, 3>> vertices;
+    std::vector<std::array<uint8_t, 3>> colours;
+    std::vector<std::array<float, 3>> normals;
+    std::vector<std::array<uint32_t, 3>> faces;
+
+    void clear() { vertices.clear(); colours.clear(); normals.clear(); faces.clear(); }
+
+    // Unnormalised face normal: its length is twice the triangle's area
+    std::array<double, 3> faceNormal(size_t f) const {
+        const auto& a = vertices[faces[f][0]];
+        const auto& b = vertices[faces[f][1]];
+        const auto& c = vertices[faces[f][2]];
+        const double u[3] = { double(b[0]) - a[0], double(b[1]) - a[1], double(b[2]) - a[2] };
+        const double v[3] = { double(c[0]) - a[0], double(c[1]) - a[1], double(c[2]) - a[2] };
+        return { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+    }
+
+    double area() const {
+        double sum = 0.0;
+        for (size_t f = 0; f < faces.size(); ++f) {
+            const auto n = faceNormal(f);
+            sum += 0.5 * std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        }
+        return sum;
+    }
+
+    // Vertex normals as the area-weighted mean of the adjacent face normals
+    void computeNormals() {
+        std::vector<std::array<double, 3>> sum(vertices.size(), std::array<double, 3>{ 0.0, 0.0, 0.0 });
+        for (size_t f = 0; f < faces.size(); ++f) {
+            const auto n = faceNormal(f);
+            for (uint32_t v : faces[f])
+                for (int k = 0; k < 3; ++k) sum[v][k] += n[k];
+        }
+        normals.resize(vertices.size());
+        parallelFor(vertices.size(), [&](size_t b, size_t e, unsigned) {
+            for (size_t v = b; v < e; ++v) {
+                const double len = std::sqrt(sum[v][0] * sum[v][0] + sum[v][1] * sum[v][1] + sum[v][2] * sum[v][2]);
+                for (int k = 0; k < 3; ++k) normals[v][k] = len > 0.0 ? static_cast<float>(sum[v][k] / len) : 0.0f;
+            }
+        });
+    }
+};
+
+// Binary little-endian PLY with vertex positions, then normals and colours when
+// present, and a 'vertex_indices' face list (written from a little-endian host)
+inline bool saveMeshPLY(const TriangleMesh& mesh, const std::string& filename) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to open file for writing: " << filename << std::endl;
+        return false;
+    }
+    const bool withNormals = mesh.normals.size() == mesh.vertices.size() && !mesh.vertices.empty();
+    const bool withColours = mesh.colours.size() == mesh.vertices.size() && !mesh.vertices.empty();
+    file << "ply\nformat binary_little_endian 1.0\n";
+    file << "element vertex " << mesh.vertices.size() << "\n";
+    file << "property float x\nproperty float y\nproperty float z\n";
+    if (withNormals) file << "property float nx\nproperty float ny\nproperty float nz\n";
+    if (withColours) file << "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+    file << "element face " << mesh.faces.size() << "\n";
+    file << "property list uchar int vertex_indices\nend_header\n";
+
+    const size_t vertexBytes = 12 + (withNormals ? 12 : 0) + (withColours ? 3 : 0);
+    std::vector<char> buf(vertexBytes * mesh.vertices.size());
+    parallelFor(mesh.vertices.size(), [&](size_t b, size_t e, unsigned) {
+        for (size_t i = b; i < e; ++i) {
+            char* out = buf.data() + i * vertexBytes;
+            std::memcpy(out, mesh.vertices[i].data(), 12);
+            out += 12;
+            if (withNormals) { std::memcpy(out, mesh.normals[i].data(), 12); out += 12; }
+            if (withColours) std::memcpy(out, mesh.colours[i].data(), 3);
+        }
+    });
+    file.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+    buf.resize(13 * mesh.faces.size());
+    for (size_t f = 0; f < mesh.faces.size(); ++f) {
+        char* out = buf.data() + 13 * f;
+        out[0] = 3;
+        std::memcpy(out + 1, mesh.faces[f].data(), 12);
+    }
+    file.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+    return static_cast<bool>(file);
+}
+
+namespace meshply {
+
+struct Property {
+    std::string name;
+    AttributeType type = AttributeType::F32;
+    bool list = false;
+    AttributeType countType = AttributeType::U8;
+};
+
+struct Element {
+    std::string name;
+    size_t count = 0;
+    std::vector<Property> properties;
+};
+
+// Reads scalars from the body of an ASCII or binary PLY held in memory
+class Cursor {
+    const char* c;
+    const char* end;
+    bool binary, swap;
+
+public:
+    Cursor(const char* begin, const char* stop, bool isBinary, bool bigEndian)
+        : c(begin), end(stop), binary(isBinary), swap(bigEndian) {}
+
+    // Lower bound on the bytes one element of 'props' takes, so a declared count can be
+    // checked against what is left before anything is sized from it
+    size_t minimumBytes(const std::vector<Property>& props) const {
+        size_t bytes = 0;
+        for (const auto& p : props) bytes += binary ? attributeSize(p.list ? p.countType : p.type) : 2;
+        return bytes;
+    }
+    size_t remaining() const { return static_cast<size_t>(end - c) + (binary ? 0 : 1); }   // a final value needs no separator
+
+    bool next(AttributeType t, double& v) {
+        if (!binary) {
+            while (c < end && (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n')) ++c;
+            if (c == end) return false;
+            char* stop = nullptr;
+            v = std::strtod(c, &stop);
+            if (stop == c) return false;
+            c = stop;
+            return true;
+        }
+        const size_t n = attributeSize(t);
+        if (static_cast<size_t>(end - c) < n) return false;
+        char bytes[8];
+        std::memcpy(bytes, c, n);
+        if (swap) std::reverse(bytes, bytes + n);   // the host is little-endian
+        c += n;
+        visitAttributeType(t, [&](auto zero) {
+            decltype(zero) x;
+            std::memcpy(&x, bytes, sizeof(x));
+            v = static_cast<double>(x);
+        });
+        return true;
+    }
+};
+
+} // namespace meshply
+
+// Triangle mesh from an ASCII or binary PLY: vertex x/y/z with optional nx/ny/nz and
+// red/green/blue, and a face list ('vertex_indices' or 'vertex_index'). Polygons are
+// split into fans; other elements and properties are skipped.
+inline bool loadMeshPLY(TriangleMesh& mesh, const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to open file " << filename << std::endl;
+        return false;
+    }
+    std::string line, format;
+    std::vector<meshply::Element> elements;
+    bool header = false;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line == "end_header") { header = true; break; }
+        std::istringstream words(line);
+        std::string keyword;
+        words >> keyword;
+        if (keyword == "format") {
+            words >> format;
+        } else if (keyword == "element") {
+            meshply::Element e;
+            words >> e.name >> e.count;
+            elements.push_back(e);
+        } else if (keyword == "property" && !elements.empty()) {
+            meshply::Property prop;
+            std::string type;
+            words >> type;
+            bool ok = true;
+            if (type == "list") {
+                std::string countType, itemType;
+                words >> countType >> itemType;
+                prop.list = true;
+                ok = attributeTypeFromPly(countType, prop.countType) && attributeTypeFromPly(itemType, prop.type);
+            } else {
+                ok = attributeTypeFromPly(type, prop.type);
+            }
+            words >> prop.name;
+            if (!ok) {
+                std::cerr << "Error: Unsupported property '" << line << "' in " << filename << std::endl;
+                return false;
+            }
+            elements.back().properties.push_back(prop);
+        }
+    }
+    if (!header || (format != "ascii" && format != "binary_little_endian" && format != "binary_big_endian")) {
+        std::cerr << "Error: " << filename << " is not a PLY file with a supported format" << std::endl;
+        return false;
+    }
+    const std::streampos bodyStart = file.tellg();
+    file.seekg(0, std::ios::end);
+    std::vector<char> body(static_cast<size_t>(file.tellg() - bodyStart));
+    file.seekg(bodyStart);
+    file.read(body.data(), static_cast<std::streamsize>(body.size()));
+    meshply::Cursor cursor(body.data(), body.data() + body.size(), format != "ascii", format == "binary_big_endian");
+
+    mesh.clear();
+    bool hasVertices = false, hasFaces = false;
+    for (const auto& e : elements) {
+        const auto& props = e.properties;
+        // role of each property: x, y, z, nx, ny, nz, red, green, blue, face list, or -1
+        std::vector<int> role(props.size(), -1);
+        bool roles[10] = {};
+        for (size_t k = 0; k < props.size(); ++k) {
+            static const char* const names[][3] = {
+                { "x", "", "" }, { "y", "", "" }, { "z", "", "" },
+                { "nx", "normal_x", "" }, { "ny", "normal_y", "" }, { "nz", "normal_z", "" },
+                { "red", "r", "diffuse_red" }, { "green", "g", "diffuse_green" }, { "blue", "b", "diffuse_blue" },
+                { "vertex_indices", "vertex_index", "" },
+            };
+            for (int r = 0; r < 10; ++r)
+                for (const char* n : names[r])
+                    if (*n && props[k].name == n && props[k].list == (r == 9)) role[k] = r;
+            if (role[k] >= 0) roles[role[k]] = true;
+        }
+        if (props.empty()) continue;
+        if (e.count > cursor.remaining() / cursor.minimumBytes(props)) {
+            std::cerr << "Error: " << filename << " declares more '" << e.name << "' data than it holds" << std::endl;
+            return false;
+        }
+        const bool vertex = e.name == "vertex" && roles[0] && roles[1] && roles[2];
+        const bool face = e.name == "face" && roles[9];
+        if (vertex) {
+            hasVertices = true;
+            mesh.vertices.resize(e.count);
+            if (roles[3] && roles[4] && roles[5]) mesh.normals.resize(e.count);
+            if (roles[6] && roles[7] && roles[8]) mesh.colours.resize(e.count);
+        }
+        hasFaces = hasFaces || face;
+        std::vector<uint32_t> polygon;
+        for (size_t i = 0; i < e.count; ++i) {
+            for (size_t k = 0; k < props.size(); ++k) {
+                double v = 0.0;
+                if (!cursor.next(props[k].list ? props[k].countType : props[k].type, v)) {
+                    std::cerr << "Error: Truncated or invalid data in " << filename << std::endl;
+                    return false;
+                }
+                if (props[k].list) {
+                    const size_t items = static_cast<size_t>(v);
+                    polygon.clear();
+                    for (size_t j = 0; j < items; ++j) {
+                        double index = 0.0;
+                        if (!cursor.next(props[k].type, index)) {
+                            std::cerr << "Error: Truncated or invalid data in " << filename << std::endl;
+                            return false;
+                        }
+                        polygon.push_back(static_cast<uint32_t>(index));
+                    }
+                    if (!face || role[k] != 9) continue;
+                    for (uint32_t index : polygon) {
+                        if (index >= mesh.vertices.size()) {
+                            std::cerr << "Error: Face refers to missing vertex " << index << " in " << filename << std::endl;
+                            return false;
+                        }
+                    }
+                    for (size_t j = 2; j < polygon.size(); ++j) mesh.faces.push_back({ polygon[0], polygon[j - 1], polygon[j] });
+                    continue;
+                }
+                if (!vertex) continue;
+                const int r = role[k];
+                if (r >= 0 && r < 3) mesh.vertices[i][r] = static_cast<float>(v);
+                else if (r >= 3 && r < 6 && !mesh.normals.empty()) mesh.normals[i][r - 3] = static_cast<float>(v);
+                else if (r >= 6 && r < 9 && !mesh.colours.empty()) mesh.colours[i][r - 6] = static_cast<uint8_t>(std::clamp(v, 0.0, 255.0));
+            }
+        }
+    }
+    if (!hasVertices || !hasFaces) {
+        std::cerr << "Error: " << filename << " has no vertex positions or face list" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace PointCloudUtil
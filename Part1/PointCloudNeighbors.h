@@ -0,0 +1,361 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "PointCloudParallel.h"
+
+namespace PointCloudUtil {
+
+// k nearest neighbours of every point of a cloud (the point itself excluded). Rows are
+// sorted by distance; rows of isolated points are padded with kNoNeighbor.
+struct NeighborGraph {
+    static constexpr uint32_t kNoNeighbor = ~uint32_t(0);
+
+    size_t k = 0;                  // row length
+    std::vector<uint32_t> indices; // n * k
+    std::vector<float> dist2;      // squared distances matching 'indices'
+
+    size_t size() const { return k ? indices.size() / k : 0; }
+    const uint32_t* row(size_t i) const { return indices.data() + i * k; }
+    const float* rowDist2(size_t i) const { return dist2.data() + i * k; }
+    void clear() { k = 0; indices.clear(); dist2.clear(); }
+};
+
+// Unit eigenvector of the symmetric 3x3 matrix c = {xx, xy, xz, yy, yz, zz} for the
+// (simple) eigenvalue l: orthogonal to the rows of (C - l I), so the longest row cross
+// product. Falls back to +z when l is not simple.
+inline void symmetricEigenvector3(const double c[6], double l, double v[3]) {
+    const double xx = c[0], xy = c[1], xz = c[2], yy = c[3], yz = c[4], zz = c[5];
+    const double r0[3] = { xx - l, xy, xz };
+    const double r1[3] = { xy, yy - l, yz };
+    const double r2[3] = { xz, yz, zz - l };
+    const double a[3] = { r0[1] * r1[2] - r0[2] * r1[1], r0[2] * r1[0] - r0[0] * r1[2], r0[0] * r1[1] - r0[1] * r1[0] };
+    const double b[3] = { r0[1] * r2[2] - r0[2] * r2[1], r0[2] * r2[0] - r0[0] * r2[2], r0[0] * r2[1] - r0[1] * r2[0] };
+    const double d[3] = { r1[1] * r2[2] - r1[2] * r2[1], r1[2] * r2[0] - r1[0] * r2[2], r1[0] * r2[1] - r1[1] * r2[0] };
+    const double la = a[0] * a[0] + a[1] * a[1] + a[2] * a[2];
+    const double lb = b[0] * b[0] + b[1] * b[1] + b[2] * b[2];
+    const double ld = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+    const double* best = la >= lb && la >= ld ? a : (lb >= ld ? b : d);
+    const double len = std::sqrt(std::max({ la, lb, ld }));
+    if (len > 0.0) {
+        v[0] = best[0] / len; v[1] = best[1] / len; v[2] = best[2] / len;
+    } else {
+        v[0] = 0.0; v[1] = 0.0; v[2] = 1.0;
+    }
+}
+
+// Eigen decomposition of a symmetric 3x3 matrix c = {xx, xy, xz, yy, yz, zz}: eigenvalues
+// ascending in 'lambda' (closed form, trigonometric) and a unit eigenvector of the
+// smallest one in 'v0' (the normal of a neighbourhood covariance)
+inline void symmetricEigen3(const double c[6], double lambda[3], double v0[3]) {
+    const double xx = c[0], xy = c[1], xz = c[2], yy = c[3], yz = c[4], zz = c[5];
+    const double q = (xx + yy + zz) / 3.0;
+    const double p1 = xy * xy + xz * xz + yz * yz;
+    const double p2 = (xx - q) * (xx - q) + (yy - q) * (yy - q) + (zz - q) * (zz - q) + 2.0 * p1;
+    const double p = std::sqrt(p2 / 6.0);
+    if (p <= 1e-30 * std::max(1.0, std::fabs(q))) {
+        lambda[0] = lambda[1] = lambda[2] = q;
+        v0[0] = 0.0; v0[1] = 0.0; v0[2] = 1.0;
+        return;
+    }
+    const double bxx = (xx - q) / p, byy = (yy - q) / p, bzz = (zz - q) / p;
+    const double bxy = xy / p, bxz = xz / p, byz = yz / p;
+    const double det = bxx * (byy * bzz - byz * byz) - bxy * (bxy * bzz - byz * bxz) + bxz * (bxy * byz - byy * bxz);
+    const double phi = std::acos(std::clamp(det / 2.0, -1.0, 1.0)) / 3.0;
+    lambda[2] = q + 2.0 * p * std::cos(phi);
+    lambda[0] = q + 2.0 * p * std::cos(phi + 2.0943951023931953); // + 2 pi / 3
+    lambda[1] = 3.0 * q - lambda[0] - lambda[2];
+    symmetricEigenvector3(c, lambda[0], v0);
+}
+
+// Uniform grid over a set of points. Points are sorted by cell and copied into
+// structure-of-arrays order, so the candidates of one cell are contiguous and their
+// distances are computed in a vectorisable loop. Cells are found through an
+// open-addressed table keyed by packed cell coordinates.
+class NeighborGrid {
+private:
+    struct Slot { uint64_t key; uint32_t begin; uint32_t end; };
+
+    static constexpr uint64_t kEmpty = ~uint64_t(0);
+    static constexpr int kMaxRing = 24;   // give up beyond this many rings (isolated points)
+
+    std::vector<float> xs, ys, zs;        // positions in cell order
+    std::vector<uint32_t> ids;            // cell order -> point index
+    std::vector<Slot> table;
+    std::vector<uint64_t> cellKeys;       // occupied cells in sorted order
+    uint64_t mask = 0;
+    float minX = 0.f, minY = 0.f, minZ = 0.f;
+    float cell = 1.f, inv = 1.f;
+    size_t cells = 0;
+
+    static uint64_t pack(int64_t x, int64_t y, int64_t z) {
+        return (static_cast<uint64_t>(x & 0x1FFFFF) << 42) | (static_cast<uint64_t>(y & 0x1FFFFF) << 21) |
+               static_cast<uint64_t>(z & 0x1FFFFF);
+    }
+    // The product alone would leave x (bits 42+) out of the low bits the mask keeps
+    static uint64_t hash(uint64_t key) {
+        const uint64_t h = key * 0x9E3779B97F4A7C15ull;
+        return h ^ (h >> 29) ^ (h >> 47);
+    }
+
+    const Slot* find(int64_t x, int64_t y, int64_t z) const {
+        if (x < 0 || y < 0 || z < 0 || x > 0x1FFFFF || y > 0x1FFFFF || z > 0x1FFFFF) return nullptr;
+        const uint64_t key = pack(x, y, z);
+        for (uint64_t h = hash(key) & mask;; h = (h + 1) & mask) {
+            const Slot& s = table[h];
+            if (s.key == key) return &s;
+            if (s.key == kEmpty) return nullptr;
+        }
+    }
+
+    // Keep the k smallest (d2, id) pairs in ascending order; returns the new count
+    static size_t offer(float d, uint32_t id, size_t found, size_t k, uint32_t* idx, float* d2) {
+        if (found == k && d >= d2[k - 1]) return found;
+        size_t j = found < k ? found++ : k - 1;
+        while (j > 0 && d2[j - 1] > d) { d2[j] = d2[j - 1]; idx[j] = idx[j - 1]; --j; }
+        d2[j] = d; idx[j] = id;
+        return found;
+    }
+
+    template <typename F>
+    void sortInto(size_t n, F position, float cellSize, std::vector<uint64_t>& keys) {
+        cell = cellSize;
+        inv = 1.0f / cellSize;
+        keys.resize(n);
+        parallelFor(n, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i) {
+                float p[3];
+                position(i, p);
+                keys[i] = pack(static_cast<int64_t>((p[0] - minX) * inv), static_cast<int64_t>((p[1] - minY) * inv),
+                               static_cast<int64_t>((p[2] - minZ) * inv));
+            }
+        });
+        ids.resize(n);
+        for (size_t i = 0; i < n; ++i) ids[i] = static_cast<uint32_t>(i);
+        std::sort(ids.begin(), ids.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b] || (keys[a] == keys[b] && a < b); });
+        cells = 0;
+        for (size_t i = 0; i < n; ++i) cells += (i == 0 || keys[ids[i]] != keys[ids[i - 1]]);
+    }
+
+public:
+    size_t size() const { return ids.size(); }
+    float cellSize() const { return cell; }
+
+    // Raw cell access for algorithms that walk the grid themselves (PointCloudSampling.h).
+    // Positions i are in cell order; id(i) maps back to the point index.
+    size_t cellCount() const { return cellKeys.size(); }
+    uint64_t cellKey(size_t c) const { return cellKeys[c]; }
+    static void unpack(uint64_t key, int64_t& x, int64_t& y, int64_t& z) {
+        x = static_cast<int64_t>(key >> 42); y = static_cast<int64_t>((key >> 21) & 0x1FFFFF); z = static_cast<int64_t>(key & 0x1FFFFF);
+    }
+    void cellOf(const float q[3], int64_t c[3]) const {
+        c[0] = static_cast<int64_t>(std::floor((q[0] - minX) * inv));
+        c[1] = static_cast<int64_t>(std::floor((q[1] - minY) * inv));
+        c[2] = static_cast<int64_t>(std::floor((q[2] - minZ) * inv));
+    }
+    // Positions [begin, end) of cell (x, y, z); false when it is empty
+    bool cellRange(int64_t x, int64_t y, int64_t z, uint32_t& begin, uint32_t& end) const {
+        const Slot* s = find(x, y, z);
+        if (!s) return false;
+        begin = s->begin; end = s->end;
+        return true;
+    }
+    const float* xData() const { return xs.data(); }
+    const float* yData() const { return ys.data(); }
+    const float* zData() const { return zs.data(); }
+    uint32_t id(uint32_t i) const { return ids[i]; }
+
+    // Index n points; position(i, float out[3]). cellSize <= 0 picks a size giving about
+    // 'perCell' points per occupied cell (refined once from the actual occupancy).
+    template <typename F>
+    void build(size_t n, F position, float cellSize = 0.0f, size_t perCell = 8) {
+        xs.clear(); ys.clear(); zs.clear(); ids.clear(); table.clear(); cellKeys.clear(); cells = 0;
+        if (n == 0) return;
+        float mx[3] = { -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+        minX = minY = minZ = std::numeric_limits<float>::max();
+        for (size_t i = 0; i < n; ++i) {
+            float p[3];
+            position(i, p);
+            minX = std::min(minX, p[0]); minY = std::min(minY, p[1]); minZ = std::min(minZ, p[2]);
+            mx[0] = std::max(mx[0], p[0]); mx[1] = std::max(mx[1], p[1]); mx[2] = std::max(mx[2], p[2]);
+        }
+        std::vector<uint64_t> keys;
+        if (cellSize > 0.0f) {
+            sortInto(n, position, cellSize, keys);
+        } else {
+            // First guess treats the points as a surface over the box diagonal squared;
+            // the occupancy it yields corrects the guess (surface scaling, sqrt)
+            const double dx = mx[0] - minX, dy = mx[1] - minY, dz = mx[2] - minZ;
+            const double diag = std::sqrt(dx * dx + dy * dy + dz * dz);
+            double c = diag * std::sqrt(static_cast<double>(perCell) / static_cast<double>(n));
+            // keep packed coordinates within 21 bits per axis
+            c = std::max(c, diag / 1.0e6);
+            if (!(c > 0.0)) c = 1.0;
+            sortInto(n, position, static_cast<float>(c), keys);
+            const double occupancy = static_cast<double>(n) / static_cast<double>(cells);
+            if (occupancy > 2.0 * perCell || occupancy * 2.0 < perCell) {
+                c *= std::sqrt(static_cast<double>(perCell) / occupancy);
+                c = std::max(c, diag / 1.0e6);
+                sortInto(n, position, static_cast<float>(c), keys);
+            }
+        }
+        xs.resize(n); ys.resize(n); zs.resize(n);
+        parallelFor(n, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i) {
+                float p[3];
+                position(ids[i], p);
+                xs[i] = p[0]; ys[i] = p[1]; zs[i] = p[2];
+            }
+        });
+        size_t cap = 16;
+        while (cap < cells * 2) cap <<= 1;
+        table.assign(cap, Slot{ kEmpty, 0, 0 });
+        mask = cap - 1;
+        for (size_t b = 0; b < n;) {
+            const uint64_t key = keys[ids[b]];
+            size_t e = b + 1;
+            while (e < n && keys[ids[e]] == key) ++e;
+            uint64_t h = hash(key) & mask;
+            while (table[h].key != kEmpty) h = (h + 1) & mask;
+            table[h] = Slot{ key, static_cast<uint32_t>(b), static_cast<uint32_t>(e) };
+            cellKeys.push_back(key);
+            b = e;
+        }
+    }
+
+    // Up to k nearest points to q (ascending), skipping point 'self'; returns the count.
+    // Rings of cells are searched outwards until no unvisited cell can hold a closer point.
+    size_t nearest(const float q[3], size_t k, uint32_t self, uint32_t* idx, float* d2) const {
+        if (ids.empty() || k == 0) return 0;
+        const float fx = (q[0] - minX) * inv, fy = (q[1] - minY) * inv, fz = (q[2] - minZ) * inv;
+        const int64_t cx = static_cast<int64_t>(std::floor(fx)), cy = static_cast<int64_t>(std::floor(fy)), cz = static_cast<int64_t>(std::floor(fz));
+        // distance from q to the faces of its own cell
+        const float gap = cell * std::min({ fx - cx, cx + 1 - fx, fy - cy, cy + 1 - fy, fz - cz, cz + 1 - fz });
+        float dist[256];
+        size_t found = 0;
+        auto visit = [&](int64_t x, int64_t y, int64_t z) {
+            const Slot* s = find(x, y, z);
+            if (!s) return;
+            for (uint32_t b = s->begin; b < s->end; b += 256) {
+                const uint32_t e = std::min<uint32_t>(s->end, b + 256);
+                for (uint32_t i = b; i < e; ++i) {
+                    const float dx = xs[i] - q[0], dy = ys[i] - q[1], dz = zs[i] - q[2];
+                    dist[i - b] = dx * dx + dy * dy + dz * dz;
+                }
+                for (uint32_t i = b; i < e; ++i) {
+                    if (ids[i] == self) continue;
+                    found = offer(dist[i - b], ids[i], found, k, idx, d2);
+                }
+            }
+        };
+        for (int r = 0; r <= kMaxRing; ++r) {
+            for (int64_t dz = -r; dz <= r; ++dz) {
+                for (int64_t dy = -r; dy <= r; ++dy) {
+                    if (dz == -r || dz == r || dy == -r || dy == r) {
+                        for (int64_t dx = -r; dx <= r; ++dx) visit(cx + dx, cy + dy, cz + dz);
+                    } else {
+                        visit(cx - r, cy + dy, cz + dz);
+                        if (r) visit(cx + r, cy + dy, cz + dz);
+                    }
+                }
+            }
+            const float reach = gap + cell * static_cast<float>(r);
+            if (found == k && d2[k - 1] <= reach * reach) break;
+            if (cells <= 1) break;
+        }
+        return found;
+    }
+
+    // Calls f(index, d2) for every point within 'radius' of q
+    template <typename F>
+    void forEachWithin(const float q[3], float radius, F f) const {
+        if (ids.empty()) return;
+        const float r2 = radius * radius;
+        const int64_t x0 = static_cast<int64_t>(std::floor((q[0] - radius - minX) * inv)), x1 = static_cast<int64_t>(std::floor((q[0] + radius - minX) * inv));
+        const int64_t y0 = static_cast<int64_t>(std::floor((q[1] - radius - minY) * inv)), y1 = static_cast<int64_t>(std::floor((q[1] + radius - minY) * inv));
+        const int64_t z0 = static_cast<int64_t>(std::floor((q[2] - radius - minZ) * inv)), z1 = static_cast<int64_t>(std::floor((q[2] + radius - minZ) * inv));
+        for (int64_t z = z0; z <= z1; ++z)
+            for (int64_t y = y0; y <= y1; ++y)
+                for (int64_t x = x0; x <= x1; ++x) {
+                    const Slot* s = find(x, y, z);
+                    if (!s) continue;
+                    for (uint32_t i = s->begin; i < s->end; ++i) {
+                        const float dx = xs[i] - q[0], dy = ys[i] - q[1], dz = zs[i] - q[2];
+                        const float d = dx * dx + dy * dy + dz * dz;
+                        if (d <= r2) f(ids[i], d);
+                    }
+                }
+    }
+
+    // k nearest neighbours of every indexed point. Queries run per occupied cell: the
+    // 3x3x3 block around it is gathered once into contiguous arrays and shared by all
+    // points of the cell, whose distances to it are computed in one vectorisable loop.
+    // Points whose k-th neighbour may lie outside the block fall back to nearest().
+    void buildGraph(size_t k, NeighborGraph& g) const {
+        const size_t n = ids.size();
+        g.k = k;
+        g.indices.assign(n * k, NeighborGraph::kNoNeighbor);
+        g.dist2.assign(n * k, std::numeric_limits<float>::infinity());
+        if (k == 0) return;
+        parallelFor(cellKeys.size(), [&](size_t b, size_t e, unsigned) {
+            std::vector<float> bx, by, bz, dist;
+            std::vector<uint32_t> bid;
+            for (size_t c = b; c < e; ++c) {
+                const uint64_t key = cellKeys[c];
+                const int64_t cx = static_cast<int64_t>(key >> 42), cy = static_cast<int64_t>((key >> 21) & 0x1FFFFF),
+                              cz = static_cast<int64_t>(key & 0x1FFFFF);
+                bx.clear(); by.clear(); bz.clear(); bid.clear();
+                for (int64_t dz = -1; dz <= 1; ++dz)
+                    for (int64_t dy = -1; dy <= 1; ++dy)
+                        for (int64_t dx = -1; dx <= 1; ++dx) {
+                            const Slot* s = find(cx + dx, cy + dy, cz + dz);
+                            if (!s) continue;
+                            bx.insert(bx.end(), xs.begin() + s->begin, xs.begin() + s->end);
+                            by.insert(by.end(), ys.begin() + s->begin, ys.begin() + s->end);
+                            bz.insert(bz.end(), zs.begin() + s->begin, zs.begin() + s->end);
+                            bid.insert(bid.end(), ids.begin() + s->begin, ids.begin() + s->end);
+                        }
+                const size_t m = bid.size();
+                dist.resize(m);
+                const Slot* own = find(cx, cy, cz);
+                float bound = std::numeric_limits<float>::infinity();
+                for (uint32_t i = own->begin; i < own->end; ++i) {
+                    const float qx = xs[i], qy = ys[i], qz = zs[i];
+                    for (size_t j = 0; j < m; ++j) {
+                        const float ax = bx[j] - qx, ay = by[j] - qy, az = bz[j] - qz;
+                        dist[j] = ax * ax + ay * ay + az * az;
+                    }
+                    const uint32_t id = ids[i];
+                    uint32_t* idx = g.indices.data() + static_cast<size_t>(id) * k;
+                    float* d2 = g.dist2.data() + static_cast<size_t>(id) * k;
+                    // Points of one cell have similar neighbour distances: candidates beyond
+                    // 1.5x the previous point's k-th squared distance are skipped unless that
+                    // leaves fewer than k
+                    size_t found = 0;
+                    for (int attempt = 0; attempt < 2 && found < k; ++attempt) {
+                        const float limit = attempt == 0 ? bound : std::numeric_limits<float>::infinity();
+                        found = 0;
+                        for (size_t j = 0; j < m; ++j) {
+                            if (dist[j] > limit || (found == k && dist[j] >= d2[k - 1])) continue;
+                            if (bid[j] == id) continue;
+                            found = offer(dist[j], bid[j], found, k, idx, d2);
+                        }
+                    }
+                    if (found == k) bound = 1.5f * d2[k - 1];
+                    // anything outside the block is at least 'reach' away
+                    const float fx = (qx - minX) * inv - cx, fy = (qy - minY) * inv - cy, fz = (qz - minZ) * inv - cz;
+                    const float reach = cell * (1.0f + std::min({ fx, 1 - fx, fy, 1 - fy, fz, 1 - fz }));
+                    if (found == k && d2[k - 1] <= reach * reach) continue;
+                    const float q[3] = { qx, qy, qz };
+                    nearest(q, k, id, idx, d2);
+                }
+            }
+        }, 64);
+    }
+};
+
+} // namespace PointCloudUtil
@@ -0,0 +1,383 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "PointCloudUtil.h"
+#include "PointCloudRaycast.h"
+#include "PointCloudVoxelBlocks.h"
+
+namespace PointCloudUtil {
+
+// Probabilistic occupancy grid (log-odds, clamped as in OctoMap) over sparse 8x8x8 voxel
+// blocks. A scan marks the voxels each sensor ray crosses as free and the voxel of its
+// end point as occupied, so free space is carved as well as surfaces recorded.
+//
+// Insertion runs in bulk: rays are traversed in parallel with a 3D DDA and only set
+// per-voxel "seen free" / "seen hit" bits (atomic OR, skipped when already set), so a
+// voxel crossed by many rays of one scan is updated once, hits winning over misses.
+// The touched blocks then apply the updates in parallel and refresh a max pyramid of
+// 2^3, 4^3 and 8^3 voxel cells, which answers coarse queries without a scan.
+class OccupancyMap {
+public:
+    enum class State : uint8_t { Unknown, Free, Occupied };
+
+    struct Params {
+        float hit = 0.85f;          // log-odds added for an end point (p = 0.7)
+        float miss = -0.4f;         // log-odds added for a crossing (p = 0.4)
+        float clampMin = -2.0f;     // log-odds bounds, so the map stays responsive to change
+        float clampMax = 3.5f;
+        float occupied = 0.0f;      // log-odds above which a voxel counts as occupied
+        float maxRange = std::numeric_limits<float>::infinity();   // rays are cut here; cut rays record no hit
+        bool discretize = true;     // one ray per end voxel rather than per point (much faster on dense scans)
+    };
+
+    static constexpr int kLevels = 4;   // voxels, then cells of 2, 4 and 8 voxels per edge
+
+private:
+    using Blocks = VoxelBlockHash<float>;
+    static constexpr int kEdge = Blocks::kEdge;
+    static constexpr size_t kPyramid = 64 + 8 + 1;   // levels 1, 2, 3 per block
+    static constexpr size_t kMarkWords = Blocks::kVoxels / 64;
+    static constexpr float kUnknown = -std::numeric_limits<float>::infinity();
+    static constexpr int64_t kVoxelLimit = (int64_t(1) << 20) - 1;   // voxel coordinates pack into 21 bits
+
+    float voxel;
+    Params params;
+    Blocks blocks;                                   // log-odds per voxel, kUnknown until observed
+    std::vector<float> pyramid;                      // kPyramid per block
+    std::unique_ptr<std::atomic<uint64_t>[]> marks;  // free then hit bits, 2 * kMarkWords per block
+    size_t markBlocks = 0;
+
+    static size_t pyramidOffset(int level) { return level == 1 ? 0 : (level == 2 ? 64 : 72); }
+
+    void refreshPyramid(size_t b) {
+        const float* v = blocks.block(b);
+        float* p = pyramid.data() + b * kPyramid;
+        std::fill(p, p + kPyramid, kUnknown);
+        for (int z = 0; z < kEdge; ++z)
+            for (int y = 0; y < kEdge; ++y)
+                for (int x = 0; x < kEdge; ++x) {
+                    float& c = p[((z >> 1) * 4 + (y >> 1)) * 4 + (x >> 1)];
+                    c = std::max(c, v[(z * kEdge + y) * kEdge + x]);
+                }
+        for (int z = 0; z < 4; ++z)
+            for (int y = 0; y < 4; ++y)
+                for (int x = 0; x < 4; ++x) {
+                    float& c = p[64 + ((z >> 1) * 2 + (y >> 1)) * 2 + (x >> 1)];
+                    c = std::max(c, p[(z * 4 + y) * 4 + x]);
+                }
+        for (int k = 0; k < 8; ++k) p[72] = std::max(p[72], p[64 + k]);
+    }
+
+    // Allocate blocks and keep the pyramid and mark storage in step
+    void allocate(const std::vector<uint64_t>& keys) {
+        if (blocks.allocate(keys, kUnknown) == 0) return;
+        pyramid.resize(blocks.size() * kPyramid, kUnknown);
+        if (blocks.size() > markBlocks) {
+            markBlocks = std::max(blocks.size(), markBlocks + markBlocks / 2);
+            marks.reset(new std::atomic<uint64_t>[markBlocks * 2 * kMarkWords]);
+            parallelFor(markBlocks * 2 * kMarkWords, [&](size_t b, size_t e, unsigned) {
+                for (size_t i = b; i < e; ++i) marks[i].store(0, std::memory_order_relaxed);
+            });
+        }
+    }
+
+    static void mark(std::atomic<uint64_t>& word, uint64_t bit) {
+        if (!(word.load(std::memory_order_relaxed) & bit)) word.fetch_or(bit, std::memory_order_relaxed);
+    }
+
+    float valueAt(int64_t x, int64_t y, int64_t z, int level) const {
+        if (level == 0) {
+            const float* v = blocks.voxel(x, y, z);
+            return v ? *v : kUnknown;
+        }
+        if (level <= 3) {
+            // cell (x, y, z) at this level covers voxels (x, y, z) << level
+            const uint32_t b = blocks.find(Blocks::keyOf(x << level, y << level, z << level));
+            if (b == Blocks::kNone) return kUnknown;
+            const int per = kEdge >> level;
+            auto local = [&](int64_t c) { return static_cast<int>(c - Blocks::blockOf(c << level) * per); };
+            return pyramid[b * kPyramid + pyramidOffset(level) + (local(z) * per + local(y)) * per + local(x)];
+        }
+        // coarser than a block: the maximum over the blocks it covers
+        const int64_t span = int64_t(1) << (level - 3);
+        float best = kUnknown;
+        for (int64_t bz = z * span; bz < (z + 1) * span; ++bz)
+            for (int64_t by = y * span; by < (y + 1) * span; ++by)
+                for (int64_t bx = x * span; bx < (x + 1) * span; ++bx) {
+                    const uint32_t b = blocks.find(Blocks::pack(bx, by, bz));
+                    if (b != Blocks::kNone) best = std::max(best, pyramid[b * kPyramid + 72]);
+                }
+        return best;
+    }
+
+public:
+    explicit OccupancyMap(float voxelSize) : OccupancyMap(voxelSize, Params()) {}
+    OccupancyMap(float voxelSize, const Params& p) : voxel(voxelSize), params(p) {
+        if (!(voxel > 0.0f)) {
+            std::cerr << "Error: Occupancy voxel size must be positive, using 1" << std::endl;
+            voxel = 1.0f;
+        }
+    }
+
+    float voxelSize() const { return voxel; }
+    const Params& parameters() const { return params; }
+    size_t blockCount() const { return blocks.size(); }
+    size_t memoryBytes() const {
+        return blocks.memoryBytes() + pyramid.capacity() * sizeof(float) + markBlocks * 2 * kMarkWords * sizeof(uint64_t);
+    }
+    void clear() { blocks.clear(); pyramid.clear(); marks.reset(); markBlocks = 0; }
+
+    // Insert one scan: 'pose' maps its cloud frame (as displayed) into the map frame and
+    // the sensor sits at the scan origin
+    bool insertScan(const PointCloud& scan, const Mat4& pose) {
+        const size_t n = scan.size();
+        if (n == 0) return true;
+        const double origin[3] = { pose.m[12], pose.m[13], pose.m[14] };
+        const double limit = static_cast<double>(kVoxelLimit) * voxel;
+        if (!(std::fabs(origin[0]) < limit && std::fabs(origin[1]) < limit && std::fabs(origin[2]) < limit)) {
+            std::cerr << "Error: Scan origin is outside the occupancy map's range" << std::endl;
+            return false;
+        }
+        std::vector<float> xyz(3 * n);
+        const Point* pts = scan.getPoints().data();
+        scan.forEachDisplayedSpan([&](size_t b, size_t e, const Mat4& M, unsigned) {
+            const Mat4 C = M * pose;
+            for (size_t i = b; i < e; ++i) transformPoint(C, pts[i].x, pts[i].y, pts[i].z, xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2]);
+        });
+
+        // the end of each ray (cut at maxRange) as a packed voxel, kHit set when it records
+        // a hit; in discrete mode equal ends are merged and rays aim at the voxel centre
+        constexpr uint64_t kHit = uint64_t(1) << 63, kNoRay = ~uint64_t(0);
+        std::vector<uint64_t> ends(n);
+        auto endOf = [&](size_t i, double end[3]) {
+            double d[3], len = 0.0;
+            for (int k = 0; k < 3; ++k) {
+                end[k] = xyz[3 * i + k];
+                d[k] = end[k] - origin[k];
+                len += d[k] * d[k];
+            }
+            len = std::sqrt(len);
+            const bool hit = len <= params.maxRange;
+            if (!hit)
+                for (int k = 0; k < 3; ++k) end[k] = origin[k] + d[k] * (params.maxRange / len);
+            return hit;
+        };
+        parallelFor(n, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i) {
+                double end[3];
+                const bool hit = endOf(i, end);
+                if (!(std::fabs(end[0]) < limit && std::fabs(end[1]) < limit && std::fabs(end[2]) < limit)) { ends[i] = kNoRay; continue; }
+                ends[i] = Blocks::pack(static_cast<int64_t>(std::floor(end[0] / voxel)), static_cast<int64_t>(std::floor(end[1] / voxel)),
+                                       static_cast<int64_t>(std::floor(end[2] / voxel))) | (hit ? kHit : 0);
+            }
+        });
+        if (params.discretize) {
+            std::sort(ends.begin(), ends.end());
+            ends.erase(std::unique(ends.begin(), ends.end()), ends.end());
+            if (!ends.empty() && ends.back() == kNoRay) ends.pop_back();
+        }
+        auto ray = [&](size_t r, double end[3], int64_t v[3]) {
+            Blocks::unpack(ends[r] & ~kHit, v[0], v[1], v[2]);
+            if (params.discretize)
+                for (int k = 0; k < 3; ++k) end[k] = (v[k] + 0.5) * voxel;
+            else
+                endOf(r, end);
+            return ends[r] != kNoRay;
+        };
+
+        // blocks crossed by any ray; a small per-worker cache drops the many repeats near
+        // the sensor and each list is compacted whenever it doubles
+        const double blockSize = static_cast<double>(voxel) * kEdge;
+        std::vector<std::vector<uint64_t>> touched(workerCount());
+        parallelFor(ends.size(), [&](size_t b, size_t e, unsigned w) {
+            auto& out = touched[w];
+            std::vector<uint64_t> recent(4096, kNoRay);
+            size_t compactAt = 1 << 16;
+            for (size_t r = b; r < e; ++r) {
+                double end[3];
+                int64_t v[3];
+                if (!ray(r, end, v)) continue;
+                auto add = [&](uint64_t key) {
+                    uint64_t& seen = recent[(key * 0x9E3779B97F4A7C15ull) >> 52];
+                    if (seen != key) { seen = key; out.push_back(key); }
+                };
+                traverseCells(origin, end, blockSize, [&](int64_t x, int64_t y, int64_t z) {
+                    add(Blocks::pack(x, y, z));
+                    return true;
+                });
+                add(Blocks::keyOf(v[0], v[1], v[2]));   // the end voxel's block, whatever the rounding
+                if (out.size() >= compactAt) {
+                    std::sort(out.begin(), out.end());
+                    out.erase(std::unique(out.begin(), out.end()), out.end());
+                    compactAt = std::max(compactAt, 2 * out.size());
+                }
+            }
+            std::sort(out.begin(), out.end());
+            out.erase(std::unique(out.begin(), out.end()), out.end());
+        }, 1 << 10);
+        std::vector<uint64_t> keys;
+        for (auto& t : touched) { keys.insert(keys.end(), t.begin(), t.end()); std::vector<uint64_t>().swap(t); }
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        allocate(keys);
+
+        // mark crossed and end voxels; every block marked (new or not) is listed for the
+        // apply pass, since the voxel walk can clip blocks the block walk rounded past
+        std::vector<std::vector<uint32_t>> marked(workerCount());
+        parallelFor(ends.size(), [&](size_t b, size_t e, unsigned w) {
+            auto& out = marked[w];
+            std::vector<uint32_t> recent(1024, Blocks::kNone);
+            for (size_t r = b; r < e; ++r) {
+                double end[3];
+                int64_t ev[3];
+                if (!ray(r, end, ev)) continue;
+                uint64_t cachedKey = kNoRay;
+                std::atomic<uint64_t>* words = nullptr;
+                auto markVoxel = [&](int64_t x, int64_t y, int64_t z, bool occupied) {
+                    const uint64_t key = Blocks::keyOf(x, y, z);
+                    if (key != cachedKey) {
+                        const uint32_t blk = blocks.find(key);
+                        cachedKey = key;
+                        words = blk == Blocks::kNone ? nullptr : marks.get() + size_t(blk) * 2 * kMarkWords;
+                        if (words) {
+                            uint32_t& seen = recent[blk & 1023];
+                            if (seen != blk) { seen = blk; out.push_back(blk); }
+                        }
+                    }
+                    if (!words) return;
+                    const int v = Blocks::localIndex(x, y, z);
+                    mark(words[(occupied ? kMarkWords : 0) + v / 64], uint64_t(1) << (v % 64));
+                };
+                traverseCells(origin, end, voxel, [&](int64_t x, int64_t y, int64_t z) {
+                    if (x != ev[0] || y != ev[1] || z != ev[2]) markVoxel(x, y, z, false);
+                    return true;
+                });
+                if (ends[r] & kHit) markVoxel(ev[0], ev[1], ev[2], true);
+            }
+            std::sort(out.begin(), out.end());
+            out.erase(std::unique(out.begin(), out.end()), out.end());
+        }, 1 << 10);
+
+        // apply the marks block by block
+        std::vector<uint32_t> ids;
+        for (auto& m : marked) { ids.insert(ids.end(), m.begin(), m.end()); std::vector<uint32_t>().swap(m); }
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        parallelFor(ids.size(), [&](size_t b, size_t e, unsigned) {
+            for (size_t k = b; k < e; ++k) {
+                const size_t blk = ids[k];
+                float* v = blocks.block(blk);
+                std::atomic<uint64_t>* words = marks.get() + blk * 2 * kMarkWords;
+                for (size_t w = 0; w < kMarkWords; ++w) {
+                    const uint64_t hits = words[kMarkWords + w].load(std::memory_order_relaxed);
+                    uint64_t any = hits | words[w].load(std::memory_order_relaxed);
+                    words[w].store(0, std::memory_order_relaxed);
+                    words[kMarkWords + w].store(0, std::memory_order_relaxed);
+                    for (; any; any &= any - 1) {
+                        const int bit = __builtin_ctzll(any);
+                        float& l = v[w * 64 + bit];
+                        const float delta = (hits >> bit) & 1 ? params.hit : params.miss;
+                        l = std::clamp((l == kUnknown ? 0.0f : l) + delta, params.clampMin, params.clampMax);
+                    }
+                }
+                refreshPyramid(blk);
+            }
+        }, 16);
+        return true;
+    }
+
+    // Log-odds of cell (x, y, z) at 'level' (a cell spans 2^level voxels per edge, voxel
+    // (i, j, k) spans [i, i + 1) * voxelSize): the maximum over its observed voxels, so a
+    // coarse cell is occupied when any voxel in it is; -infinity when none was observed
+    float logOdds(int64_t x, int64_t y, int64_t z, int level = 0) const {
+        return valueAt(x, y, z, std::max(level, 0));
+    }
+
+    State state(int64_t x, int64_t y, int64_t z, int level = 0) const {
+        const float l = logOdds(x, y, z, level);
+        return l == kUnknown ? State::Unknown : (l > params.occupied ? State::Occupied : State::Free);
+    }
+
+    // State of the level cell containing map-frame position p
+    State stateAt(const float p[3], int level = 0) const {
+        const double cell = static_cast<double>(voxel) * static_cast<double>(int64_t(1) << std::max(level, 0));
+        return state(static_cast<int64_t>(std::floor(p[0] / cell)), static_cast<int64_t>(std::floor(p[1] / cell)),
+                     static_cast<int64_t>(std::floor(p[2] / cell)), level);
+    }
+
+    // First occupied voxel on the segment from -> to; its centre goes to 'hit'. Blocks
+    // with nothing occupied are crossed at block granularity.
+    bool castRay(const double from[3], const double to[3], double hit[3]) const {
+        const double blockSize = static_cast<double>(voxel) * kEdge;
+        bool found = false;
+        traverseCells(from, to, blockSize, [&](int64_t bx, int64_t by, int64_t bz) {
+            const uint32_t b = blocks.find(Blocks::pack(bx, by, bz));
+            if (b == Blocks::kNone || !(pyramid[b * kPyramid + 72] > params.occupied)) return true;
+            // the part of the segment inside this block, slightly widened
+            double lo[3], hi[3], t0 = 0.0, t1 = 1.0;
+            for (int k = 0; k < 3; ++k) {
+                const double c = (k == 0 ? bx : (k == 1 ? by : bz)) * blockSize;
+                lo[k] = c; hi[k] = c + blockSize;
+                const double d = to[k] - from[k];
+                if (d == 0.0) continue;
+                double ta = (lo[k] - from[k]) / d, tb = (hi[k] - from[k]) / d;
+                if (ta > tb) std::swap(ta, tb);
+                t0 = std::max(t0, ta);
+                t1 = std::min(t1, tb);
+            }
+            const double eps = 1e-9;
+            double a[3], e[3];
+            for (int k = 0; k < 3; ++k) {
+                a[k] = from[k] + (to[k] - from[k]) * std::max(0.0, t0 - eps);
+                e[k] = from[k] + (to[k] - from[k]) * std::min(1.0, t1 + eps);
+            }
+            traverseCells(a, e, voxel, [&](int64_t x, int64_t y, int64_t z) {
+                if (Blocks::keyOf(x, y, z) != Blocks::pack(bx, by, bz)) return true;
+                if (!(blocks.block(b)[Blocks::localIndex(x, y, z)] > params.occupied)) return true;
+                hit[0] = (x + 0.5) * voxel; hit[1] = (y + 0.5) * voxel; hit[2] = (z + 0.5) * voxel;
+                found = true;
+                return false;
+            });
+            return !found;
+        });
+        return found;
+    }
+
+    // Centres of the occupied cells at 'level' (up to 3) as a cloud, in block order
+    void toPointCloud(PointCloud& out, int level = 0) const {
+        level = std::clamp(level, 0, kLevels - 1);
+        const int per = kEdge >> level;
+        const double cell = static_cast<double>(voxel) * (1 << level);
+        std::vector<std::vector<Point>> parts(workerCount());
+        parallelFor(blocks.size(), [&](size_t b, size_t e, unsigned w) {
+            for (size_t blk = b; blk < e; ++blk) {
+                int64_t bx, by, bz;
+                Blocks::unpack(blocks.key(blk), bx, by, bz);
+                const float* v = level == 0 ? blocks.block(blk) : pyramid.data() + blk * kPyramid + pyramidOffset(level);
+                for (int z = 0; z < per; ++z)
+                    for (int y = 0; y < per; ++y)
+                        for (int x = 0; x < per; ++x) {
+                            if (!(v[(z * per + y) * per + x] > params.occupied)) continue;
+                            Point p{};
+                            p.x = static_cast<float>((bx * per + x + 0.5) * cell);
+                            p.y = static_cast<float>((by * per + y + 0.5) * cell);
+                            p.z = static_cast<float>((bz * per + z + 0.5) * cell);
+                            p.r = p.g = p.b = 255;
+                            parts[w].push_back(p);
+                        }
+            }
+        });
+        out.clear();
+        for (const auto& p : parts) out.appendPoints(p.data(), p.size(), false);
+    }
+};
+
+} // namespace PointCloudUtil
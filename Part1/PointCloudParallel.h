@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace PointCloudUtil {
+
+// Persistent worker pool with a fixed, static partition: parallelFor splits [0, n) into
+// one contiguous chunk per worker, and chunk w always runs on worker w. Because the
+// mapping never changes, memory first touched by worker w (see PointAllocator) stays
+// local to the thread that processes it in every later pass.
+//
+// Worker 0 is the calling thread. Calls from inside a worker, or while another thread
+// is already using the pool (e.g. file-level workers in PointCloudBatch), run inline.
+class WorkerPool {
+private:
+    std::vector<std::thread> threads;
+    std::mutex mtx;
+    std::mutex callMtx;   // one parallelFor at a time; concurrent callers run inline
+    std::condition_variable wake, done;
+    std::function<void(size_t, size_t, unsigned)> job;
+    size_t jobSize = 0;
+    unsigned generation = 0;
+    unsigned pending = 0;
+    bool stopping = false;
+    unsigned count = 1;
+
+    static bool& insideWorker() { static thread_local bool flag = false; return flag; }
+
+    static void pinToCpu(unsigned cpu) {
+#ifdef __linux__
+        const unsigned ncpu = std::max(1u, std::thread::hardware_concurrency());
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu % ncpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+        (void)cpu; // no portable affinity API; the OS scheduler decides
+#endif
+    }
+
+    void chunk(size_t n, unsigned w, size_t& b, size_t& e) const {
+        b = n * w / count;
+        e = n * (w + 1) / count;
+    }
+
+    void workerLoop(unsigned w, bool pin) {
+        if (pin) pinToCpu(w);
+        insideWorker() = true;
+        unsigned seen = 0;
+        for (;;) {
+            std::unique_lock<std::mutex> lock(mtx);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            const size_t n = jobSize;
+            lock.unlock();
+
+            size_t b, e;
+            chunk(n, w, b, e);
+            if (b < e) job(b, e, w);
+
+            lock.lock();
+            if (--pending == 0) done.notify_one();
+        }
+    }
+
+    void start(unsigned workers, bool pin) {
+        count = std::max(1u, workers);
+        stopping = false;
+        for (unsigned w = 1; w < count; ++w) threads.emplace_back(&WorkerPool::workerLoop, this, w, pin);
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : threads) t.join();
+        threads.clear();
+    }
+
+public:
+    explicit WorkerPool(unsigned workers = std::thread::hardware_concurrency(), bool pin = false) {
+        start(workers, pin);
+    }
+    ~WorkerPool() { stop(); }
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Process-wide pool used by PointCloud kernels
+    static WorkerPool& global() { return *globalSlot(); }
+
+    // Recreate the global pool (e.g. pin=true to keep threads on their NUMA node).
+    // Must not be called while parallel work is running.
+    static void configure(unsigned workers, bool pin) { globalSlot().reset(new WorkerPool(workers, pin)); }
+
+    unsigned size() const { return count; }
+
+    // f(begin, end, worker) over contiguous chunks of [0, n). Runs inline when n is
+    // below 'grain' or when already on a worker thread.
+    template <typename F>
+    void parallelFor(size_t n, F&& f, size_t grain = 1 << 15) {
+        if (n == 0) return;
+        if (count == 1 || n < grain || insideWorker()) { f(size_t(0), n, 0u); return; }
+        std::unique_lock<std::mutex> callLock(callMtx, std::try_to_lock);
+        if (!callLock.owns_lock()) { f(size_t(0), n, 0u); return; }
+        std::unique_lock<std::mutex> lock(mtx);
+        job = [&f](size_t b, size_t e, unsigned w) { f(b, e, w); };
+        jobSize = n;
+        pending = count - 1;
+        ++generation;
+        lock.unlock();
+        wake.notify_all();
+
+        size_t b, e;
+        chunk(n, 0, b, e);
+        insideWorker() = true;
+        if (b < e) f(b, e, 0u);
+        insideWorker() = false;
+
+        lock.lock();
+        done.wait(lock, [&] { return pending == 0; });
+        job = nullptr;
+    }
+
+private:
+    static std::unique_ptr<WorkerPool>& globalSlot() {
+        static std::unique_ptr<WorkerPool> pool(new WorkerPool());
+        return pool;
+    }
+};
+
+inline unsigned workerCount() { return WorkerPool::global().size(); }
+
+template <typename F>
+inline void parallelFor(size_t n, F&& f, size_t grain = 1 << 15) {
+    WorkerPool::global().parallelFor(n, std::forward<F>(f), grain);
+}
+
+} // namespace PointCloudUtil
@@ -0,0 +1,665 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "PointCloudUtil.h"
+#include "PointCloudText.h"
+
+namespace PointCloudUtil {
+
+// Point Cloud Library .pcd files (v0.7): DATA ascii, binary and binary_compressed.
+// Every encoding is decoded through one binary record layout: ASCII rows are parsed into
+// records, and binary_compressed data (LZF, one column after another) is addressed per
+// field. Blocks of records are decoded in parallel straight into the point, double
+// position and attribute buffers handed to appendGeoreferenced().
+namespace pcd {
+
+template <typename T>
+inline T get(const unsigned char* p) { T v; std::memcpy(&v, p, sizeof(T)); return v; }
+template <typename T>
+inline void put(unsigned char* p, T v) { std::memcpy(p, &v, sizeof(T)); }
+
+enum class Encoding { Ascii, Binary, BinaryCompressed };
+
+enum Role : int { X, Y, Z, Rgb, NX, NY, NZ, Attribute, Skip };
+
+struct Field {
+    std::string name;
+    char type = 'F';        // 'I', 'U' or 'F'
+    int size = 4;           // bytes per value
+    int count = 1;          // values per point
+    size_t offset = 0;      // byte offset within a record
+    int role = Skip;
+    AttributeType attrType = AttributeType::F32;
+
+    size_t bytes() const { return static_cast<size_t>(size) * static_cast<size_t>(count); }
+};
+
+struct Header {
+    std::vector<Field> fields;
+    size_t recordSize = 0;
+    uint64_t points = 0;
+    Encoding encoding = Encoding::Ascii;
+};
+
+// Attribute column type for a PCD TYPE/SIZE pair; 64-bit integers widen to F64
+inline bool attributeTypeFromPcd(char type, int size, AttributeType& t) {
+    if (type == 'F') {
+        if (size == 4) t = AttributeType::F32;
+        else if (size == 8) t = AttributeType::F64;
+        else return false;
+        return true;
+    }
+    if (type != 'I' && type != 'U') return false;
+    const bool s = type == 'I';
+    switch (size) {
+        case 1: t = s ? AttributeType::I8 : AttributeType::U8; break;
+        case 2: t = s ? AttributeType::I16 : AttributeType::U16; break;
+        case 4: t = s ? AttributeType::I32 : AttributeType::U32; break;
+        case 8: t = AttributeType::F64; break;
+        default: return false;
+    }
+    return true;
+}
+
+inline void pcdTypeOf(AttributeType t, char& type, int& size) {
+    size = static_cast<int>(attributeSize(t));
+    switch (t) {
+        case AttributeType::I8: case AttributeType::I16: case AttributeType::I32: type = 'I'; break;
+        case AttributeType::F32: case AttributeType::F64: type = 'F'; break;
+        default: type = 'U'; break;
+    }
+}
+
+inline double readValue(const unsigned char* p, char type, int size) {
+    switch (size) {
+        case 1: return type == 'I' ? static_cast<double>(static_cast<int8_t>(*p)) : static_cast<double>(*p);
+        case 2: return type == 'I' ? static_cast<double>(get<int16_t>(p)) : static_cast<double>(get<uint16_t>(p));
+        case 4: return type == 'F' ? static_cast<double>(get<float>(p))
+                     : type == 'I' ? static_cast<double>(get<int32_t>(p)) : static_cast<double>(get<uint32_t>(p));
+        default: return type == 'F' ? get<double>(p)
+                      : type == 'I' ? static_cast<double>(get<int64_t>(p)) : static_cast<double>(get<uint64_t>(p));
+    }
+}
+
+inline void writeValue(unsigned char* p, char type, int size, double v) {
+    switch (size) {
+        case 1: if (type == 'I') put<int8_t>(p, static_cast<int8_t>(v)); else *p = static_cast<uint8_t>(v); break;
+        case 2: if (type == 'I') put<int16_t>(p, static_cast<int16_t>(v)); else put<uint16_t>(p, static_cast<uint16_t>(v)); break;
+        case 4:
+            if (type == 'F') put<float>(p, static_cast<float>(v));
+            else if (type == 'I') put<int32_t>(p, static_cast<int32_t>(v));
+            else put<uint32_t>(p, static_cast<uint32_t>(v));
+            break;
+        default:
+            if (type == 'F') put<double>(p, v);
+            else if (type == 'I') put<int64_t>(p, static_cast<int64_t>(v));
+            else put<uint64_t>(p, static_cast<uint64_t>(v));
+            break;
+    }
+}
+
+// Shortest text that reads back to the same value
+inline char* formatValue(char* c, char* end, const unsigned char* p, char type, int size) {
+    if (type == 'F') {
+        return size == 4 ? std::to_chars(c, end, get<float>(p)).ptr : std::to_chars(c, end, get<double>(p)).ptr;
+    }
+    if (size == 8 && type == 'U') return std::to_chars(c, end, get<uint64_t>(p)).ptr;
+    return std::to_chars(c, end, static_cast<long long>(readValue(p, type, size))).ptr;
+}
+
+// LZF (liblzf stream format), used by binary_compressed. A control byte below 32 starts
+// a run of ctrl + 1 literals; otherwise its top 3 bits are the match length - 2 (7: add
+// the next byte) and the low 5 bits with the next byte are the back-reference distance - 1.
+namespace lzf {
+
+inline bool decompress(const unsigned char* in, size_t inSize, unsigned char* out, size_t outSize) {
+    const unsigned char* ip = in;
+    const unsigned char* inEnd = in + inSize;
+    unsigned char* op = out;
+    unsigned char* outEnd = out + outSize;
+    while (ip < inEnd) {
+        const unsigned ctrl = *ip++;
+        if (ctrl < 32) {
+            const size_t len = ctrl + 1;
+            if (static_cast<size_t>(inEnd - ip) < len || static_cast<size_t>(outEnd - op) < len) return false;
+            std::memcpy(op, ip, len);
+            ip += len; op += len;
+            continue;
+        }
+        size_t len = ctrl >> 5;
+        if (len == 7) {
+            if (ip >= inEnd) return false;
+            len += *ip++;
+        }
+        if (ip >= inEnd) return false;
+        const size_t back = ((ctrl & 0x1F) << 8) + *ip++ + 1;
+        len += 2;
+        if (back > static_cast<size_t>(op - out) || static_cast<size_t>(outEnd - op) < len) return false;
+        const unsigned char* ref = op - back;
+        if (back >= len) { std::memcpy(op, ref, len); op += len; }
+        else for (size_t k = 0; k < len; ++k) *op++ = *ref++; // overlapping: repeats the pattern
+    }
+    return op == outEnd;
+}
+
+// Worst-case compressed size of n bytes
+inline size_t bound(size_t n) { return n + n / 16 + 64; }
+
+// Returns the compressed size, or 0 when it does not fit in 'cap' (or n == 0)
+inline size_t compress(const unsigned char* in, size_t n, unsigned char* out, size_t cap) {
+    if (n == 0 || cap < 2) return 0;
+    const int hashBits = 14;
+    std::vector<uint32_t> table(size_t(1) << hashBits, 0); // last position + 1 of each 3-byte hash
+    auto hash = [&](size_t i) {
+        const uint32_t v = (uint32_t(in[i]) << 16) | (uint32_t(in[i + 1]) << 8) | in[i + 2];
+        return (v * 2654435761u) >> (32 - hashBits);
+    };
+    size_t ip = 0, op = 1, lit = 0; // out[op - lit - 1] is the length byte of the open literal run
+    auto literal = [&]() {
+        out[op++] = in[ip++];
+        if (++lit == 32) { out[op - lit - 1] = 31; lit = 0; ++op; }
+    };
+    while (ip + 2 < n) {
+        const uint32_t h = hash(ip);
+        const size_t ref = table[h];
+        table[h] = static_cast<uint32_t>(ip + 1);
+        const size_t r = ref - 1, off = ip - r - 1;
+        if (ref && off < 8192 && in[r] == in[ip] && in[r + 1] == in[ip + 1] && in[r + 2] == in[ip + 2]) {
+            size_t len = 2;
+            const size_t maxLen = std::min<size_t>(n - ip - 2, 264);
+            do ++len; while (len < maxLen && in[r + len] == in[ip + len]);
+            if (op + 4 > cap) return 0;
+            out[op - lit - 1] = static_cast<unsigned char>(lit - 1); // close the run (dropped if empty)
+            op -= !lit;
+            len -= 2;
+            if (len < 7) {
+                out[op++] = static_cast<unsigned char>((off >> 8) + (len << 5));
+            } else {
+                out[op++] = static_cast<unsigned char>((off >> 8) + (7 << 5));
+                out[op++] = static_cast<unsigned char>(len - 7);
+            }
+            out[op++] = static_cast<unsigned char>(off);
+            lit = 0;
+            ++op;
+            ip += len + 2;
+            // index the two positions just before the next one so nearby repeats are found
+            for (size_t k = ip - 2; k < ip && k + 2 < n; ++k) table[hash(k)] = static_cast<uint32_t>(k + 1);
+            continue;
+        }
+        if (op + 2 > cap) return 0;
+        literal();
+    }
+    while (ip < n) {
+        if (op + 2 > cap) return 0;
+        literal();
+    }
+    out[op - lit - 1] = static_cast<unsigned char>(lit - 1);
+    op -= !lit;
+    return op;
+}
+
+} // namespace lzf
+
+inline bool readHeader(std::ifstream& file, const std::string& filename, Header& h) {
+    std::vector<int> sizes, counts;
+    std::vector<char> types;
+    uint64_t width = 0, height = 1;
+    bool havePoints = false, haveData = false;
+    std::string line;
+    while (!haveData && std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream words(line);
+        std::string key;
+        words >> key;
+        if (key == "FIELDS" || key == "COLUMNS") {
+            for (std::string w; words >> w;) { h.fields.emplace_back(); h.fields.back().name = w; }
+        } else if (key == "SIZE") {
+            for (int v; words >> v;) sizes.push_back(v);
+        } else if (key == "TYPE") {
+            for (std::string w; words >> w;) types.push_back(w.empty() ? '?' : w[0]);
+        } else if (key == "COUNT") {
+            for (int v; words >> v;) counts.push_back(v);
+        } else if (key == "WIDTH") {
+            words >> width;
+        } else if (key == "HEIGHT") {
+            words >> height;
+        } else if (key == "POINTS") {
+            words >> h.points;
+            havePoints = true;
+        } else if (key == "DATA") {
+            std::string mode;
+            words >> mode;
+            if (mode == "ascii") h.encoding = Encoding::Ascii;
+            else if (mode == "binary") h.encoding = Encoding::Binary;
+            else if (mode == "binary_compressed") h.encoding = Encoding::BinaryCompressed;
+            else {
+                std::cerr << "Error: Unsupported PCD data encoding '" << mode << "' in " << filename << std::endl;
+                return false;
+            }
+            haveData = true;
+        }
+        // VERSION and VIEWPOINT are not needed (the viewpoint is not applied to points)
+    }
+    const size_t nf = h.fields.size();
+    if (!haveData || nf == 0 || sizes.size() != nf || types.size() != nf || (!counts.empty() && counts.size() != nf)) {
+        std::cerr << "Error: Malformed PCD header in " << filename << std::endl;
+        return false;
+    }
+    if (!havePoints) h.points = width * height;
+
+    bool hasRole[Attribute] = {};
+    for (size_t f = 0; f < nf; ++f) {
+        Field& d = h.fields[f];
+        d.size = sizes[f];
+        d.type = types[f];
+        d.count = counts.empty() ? 1 : counts[f];
+        AttributeType t;
+        if (d.count < 1 || !attributeTypeFromPcd(d.type, d.size, t)) {
+            std::cerr << "Error: Unsupported PCD field " << d.name << " in " << filename << std::endl;
+            return false;
+        }
+        d.offset = h.recordSize;
+        h.recordSize += d.bytes();
+
+        // multi-valued fields (descriptor histograms) and "_" padding are skipped
+        const std::string& n = d.name;
+        int role = Skip;
+        if (d.count != 1 || n == "_") role = Skip;
+        else if (n == "x") role = X;
+        else if (n == "y") role = Y;
+        else if (n == "z") role = Z;
+        else if ((n == "rgb" || n == "rgba") && d.size == 4) role = Rgb;
+        else if (n == "normal_x") role = NX;
+        else if (n == "normal_y") role = NY;
+        else if (n == "normal_z") role = NZ;
+        else role = Attribute;
+        if (role < Attribute) {
+            if (hasRole[role]) role = Skip; // rgb and rgba both present: keep the first
+            else hasRole[role] = true;
+        }
+        if ((role == X || role == Y || role == Z || role == NX || role == NY || role == NZ) && d.type != 'F') role = Attribute;
+        d.role = role;
+        d.attrType = t;
+    }
+    int xyz = 0;
+    for (const Field& d : h.fields) xyz += d.role == X || d.role == Y || d.role == Z;
+    if (xyz != 3) {
+        std::cerr << "Error: PCD file " << filename << " has no float x/y/z fields" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Decode records [0, n): field f of record i is at base[f] + i * stride[f]. Returns false
+// if a position is NaN or infinite (the caller drops those points afterwards).
+inline bool decodeRecords(const Header& h, size_t n, const unsigned char* const* base, const size_t* stride,
+                          Point* pts, Vec3d* absolute, AttributeSet& block) {
+    const size_t nf = h.fields.size();
+    bool colour = false;
+    std::vector<AttributeChannel*> column(nf, nullptr);
+    for (size_t f = 0; f < nf; ++f) {
+        if (h.fields[f].role == Attribute) column[f] = block.find(h.fields[f].name);
+        colour = colour || h.fields[f].role == Rgb;
+    }
+    std::vector<unsigned char> finite(workerCount(), 1);
+    parallelFor(n, [&](size_t b, size_t e, unsigned w) {
+        bool allFinite = true;
+        for (size_t i = b; i < e; ++i) {
+            Point q = {};
+            double xyz[3] = { 0.0, 0.0, 0.0 };
+            for (size_t f = 0; f < nf; ++f) {
+                const Field& d = h.fields[f];
+                const unsigned char* p = base[f] + i * stride[f];
+                switch (d.role) {
+                    case X: case Y: case Z: xyz[d.role] = readValue(p, d.type, d.size); break;
+                    case Rgb: {
+                        const uint32_t c = get<uint32_t>(p); // packed 0x00RRGGBB (alpha in the top byte)
+                        q.r = (c >> 16) & 0xFF; q.g = (c >> 8) & 0xFF; q.b = c & 0xFF;
+                        break;
+                    }
+                    case NX: q.nx = static_cast<float>(readValue(p, d.type, d.size)); break;
+                    case NY: q.ny = static_cast<float>(readValue(p, d.type, d.size)); break;
+                    case NZ: q.nz = static_cast<float>(readValue(p, d.type, d.size)); break;
+                    case Attribute:
+                        if (column[f]->elementSize() == static_cast<size_t>(d.size)) std::memcpy(column[f]->bytes.data() + i * d.size, p, d.size);
+                        else column[f]->set(i, readValue(p, d.type, d.size));
+                        break;
+                    default: break;
+                }
+            }
+            if (!colour) q.r = q.g = q.b = 255;
+            allFinite = allFinite && std::isfinite(xyz[0]) && std::isfinite(xyz[1]) && std::isfinite(xyz[2]);
+            absolute[i] = Vec3d{ xyz[0], xyz[1], xyz[2] };
+            pts[i] = q;
+        }
+        if (!allFinite) finite[w] = 0;
+    });
+    return std::find(finite.begin(), finite.end(), 0) == finite.end();
+}
+
+} // namespace pcd
+
+// Load a PCD file into 'cloud' (replacing its contents). Points with NaN coordinates
+// (the invalid entries of organised clouds) are dropped; the WIDTH x HEIGHT organisation
+// and the VIEWPOINT are not kept.
+inline bool loadFromPCD(PointCloud& cloud, const std::string& filename, bool keepSnapshot = true) {
+    using namespace pcd;
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to open file " << filename << std::endl;
+        return false;
+    }
+    Header h;
+    if (!readHeader(file, filename, h)) return false;
+    cloud.clear();
+
+    const size_t nf = h.fields.size();
+    bool normals[3] = {};
+    AttributeSet block;
+    for (const Field& d : h.fields) {
+        if (d.role == Attribute) block.add(d.name, d.attrType);
+        if (d.role >= NX && d.role <= NZ) normals[d.role - NX] = true;
+    }
+    const bool withNormals = normals[0] && normals[1] && normals[2];
+    bool allFinite = true;
+
+    const size_t blockPoints = size_t(1) << 18;
+    auto pts = cloud.scratch().borrow<Point>(blockPoints);
+    auto absolute = cloud.scratch().borrow<Vec3d>(blockPoints);
+    std::vector<const unsigned char*> base(nf);
+    std::vector<size_t> stride(nf);
+    auto decode = [&](size_t n) {
+        block.resize(n);
+        allFinite = decodeRecords(h, n, base.data(), stride.data(), pts.data(), absolute.data(), block) && allFinite;
+        cloud.appendGeoreferenced(pts.data(), absolute.data(), n, withNormals, &block);
+    };
+    auto truncated = [&]() {
+        std::cerr << "Error: Truncated point data in " << filename << std::endl;
+        return false;
+    };
+
+    std::vector<unsigned char> raw;
+    if (h.encoding == Encoding::Binary) {
+        for (uint64_t done = 0; done < h.points;) {
+            const size_t n = static_cast<size_t>(std::min<uint64_t>(blockPoints, h.points - done));
+            raw.resize(n * h.recordSize);
+            file.read(reinterpret_cast<char*>(raw.data()), static_cast<std::streamsize>(raw.size()));
+            if (static_cast<size_t>(file.gcount()) != raw.size()) return truncated();
+            for (size_t f = 0; f < nf; ++f) { base[f] = raw.data() + h.fields[f].offset; stride[f] = h.recordSize; }
+            decode(n);
+            done += n;
+        }
+    } else if (h.encoding == Encoding::BinaryCompressed) {
+        unsigned char sizes[8];
+        file.read(reinterpret_cast<char*>(sizes), 8);
+        if (file.gcount() != 8) return truncated();
+        const uint32_t packedSize = get<uint32_t>(sizes), unpackedSize = get<uint32_t>(sizes + 4);
+        if (unpackedSize != h.points * h.recordSize) {
+            std::cerr << "Error: PCD compressed size does not match the header in " << filename << std::endl;
+            return false;
+        }
+        std::vector<unsigned char> packed(packedSize);
+        file.read(reinterpret_cast<char*>(packed.data()), packedSize);
+        if (static_cast<size_t>(file.gcount()) != packedSize) return truncated();
+        raw.resize(unpackedSize);
+        if (unpackedSize && !lzf::decompress(packed.data(), packed.size(), raw.data(), raw.size())) {
+            std::cerr << "Error: Corrupt LZF data in " << filename << std::endl;
+            return false;
+        }
+        packed = std::vector<unsigned char>();
+        // one column per field: all points' values of field 0, then field 1, ...
+        const size_t total = static_cast<size_t>(h.points);
+        std::vector<size_t> columnStart(nf);
+        for (size_t f = 0, at = 0; f < nf; ++f) { columnStart[f] = at; at += total * h.fields[f].bytes(); }
+        for (size_t done = 0; done < total;) {
+            const size_t n = std::min(blockPoints, total - done);
+            for (size_t f = 0; f < nf; ++f) {
+                stride[f] = h.fields[f].bytes();
+                base[f] = raw.data() + columnStart[f] + done * stride[f];
+            }
+            decode(n);
+            done += n;
+        }
+    } else {
+        // ASCII rows are packed into binary records in parallel pieces, like loadFromText()
+        std::vector<unsigned char> needed;
+        std::vector<std::pair<size_t, int>> valueField; // record byte offset, field index of each needed value
+        for (size_t f = 0; f < nf; ++f) {
+            const Field& d = h.fields[f];
+            for (int k = 0; k < d.count; ++k) {
+                needed.push_back(d.role != Skip);
+                valueField.emplace_back(d.offset + static_cast<size_t>(k) * d.size, static_cast<int>(f));
+            }
+        }
+        const int values = static_cast<int>(needed.size());
+        std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        const char* begin = text.data();
+        const char* end = begin + text.size();
+        const unsigned pieces = workerCount();
+        std::vector<const char*> pieceBegin(pieces + 1);
+        std::vector<size_t> pieceFirst(pieces + 1), pieceGot(pieces);
+        pieceBegin[0] = begin;
+        pieceBegin[pieces] = end;
+        for (unsigned k = 1; k < pieces; ++k) {
+            const char* p = std::max(begin + (end - begin) * k / pieces, pieceBegin[k - 1]);
+            const char* nl = textscan::findNewline(p, end);
+            pieceBegin[k] = nl < end ? nl + 1 : end;
+        }
+        pieceFirst[0] = 0;
+        for (unsigned k = 0; k < pieces; ++k) pieceFirst[k + 1] = pieceFirst[k] + textscan::countNewlines(pieceBegin[k], pieceBegin[k + 1]) + 1;
+        raw.assign(pieceFirst[pieces] * h.recordSize, 0);
+        parallelFor(pieces, [&](size_t b, size_t e, unsigned) {
+            std::vector<double> v(values);
+            for (size_t k = b; k < e; ++k) {
+                size_t row = pieceFirst[k];
+                for (const char* p = pieceBegin[k]; p < pieceBegin[k + 1];) {
+                    const char* nl = textscan::findNewline(p, pieceBegin[k + 1]);
+                    if (textscan::parseLine(p, nl, ' ', needed.data(), values, v.data())) {
+                        unsigned char* r = raw.data() + row++ * h.recordSize;
+                        for (int c = 0; c < values; ++c) {
+                            if (!needed[c]) continue;
+                            const Field& d = h.fields[valueField[c].second];
+                            writeValue(r + valueField[c].first, d.type, d.size, v[c]);
+                        }
+                    }
+                    p = nl < pieceBegin[k + 1] ? nl + 1 : nl;
+                }
+                pieceGot[k] = row - pieceFirst[k];
+            }
+        }, 1);
+        // close the gaps left by blank lines
+        size_t rows = 0;
+        for (unsigned k = 0; k < pieces; ++k) {
+            std::memmove(raw.data() + rows * h.recordSize, raw.data() + pieceFirst[k] * h.recordSize, pieceGot[k] * h.recordSize);
+            rows += pieceGot[k];
+        }
+        text = std::string();
+        rows = std::min<size_t>(rows, static_cast<size_t>(h.points));
+        for (size_t done = 0; done < rows;) {
+            const size_t n = std::min(blockPoints, rows - done);
+            for (size_t f = 0; f < nf; ++f) { base[f] = raw.data() + done * h.recordSize + h.fields[f].offset; stride[f] = h.recordSize; }
+            decode(n);
+            done += n;
+        }
+    }
+
+    if (!allFinite) cloud.removeNonFinite();
+    if (cloud.size() == 0) {
+        std::cerr << "Error: No points loaded from file." << std::endl;
+        return false;
+    }
+    if (keepSnapshot) cloud.commitSnapshot();
+    return true;
+}
+
+// Save as PCD v0.7. Fields: x y z (F 8 absolute coordinates when georeferenced, else
+// F 4), rgb (U 4, packed 0x00RRGGBB), normal_x/y/z when the cloud has normals, then one
+// field per attribute column with its own type.
+inline bool saveToPCD(PointCloud& cloud, const std::string& filename, pcd::Encoding encoding = pcd::Encoding::Binary) {
+    using namespace pcd;
+    cloud.bake();
+    const auto& points = cloud.getPoints();
+    const auto& chunks = cloud.getChunks();
+    const AttributeSet& attrs = cloud.attributes();
+    const Vec3d origin = cloud.getOrigin();
+    const bool geo = cloud.isGeoreferenced();
+    const bool normals = cloud.hasNormals();
+    const size_t n = points.size();
+
+    Header h;
+    auto addField = [&](const std::string& name, char type, int size, int role) {
+        Field d;
+        d.name = name; d.type = type; d.size = size; d.role = role;
+        d.offset = h.recordSize;
+        h.recordSize += d.bytes();
+        h.fields.push_back(d);
+    };
+    for (const char* c : { "x", "y", "z" }) addField(c, 'F', geo ? 8 : 4, X + (c[0] - 'x'));
+    addField("rgb", 'U', 4, Rgb);
+    if (normals) for (int k = 0; k < 3; ++k) addField(std::string("normal_") + char('x' + k), 'F', 4, NX + k);
+    for (const auto& c : attrs.channels()) {
+        char type; int size;
+        pcdTypeOf(c.type, type, size);
+        addField(c.name, type, size, Attribute);
+    }
+    const size_t nf = h.fields.size();
+    if (encoding == Encoding::BinaryCompressed && n * h.recordSize > 0xFFFFFFFFull) {
+        std::cerr << "Error: Too many points for PCD binary_compressed" << std::endl;
+        return false;
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to write file " << filename << std::endl;
+        return false;
+    }
+    std::string header = "# .PCD v0.7 - Point Cloud Data file format\nVERSION 0.7\nFIELDS";
+    for (const Field& d : h.fields) header += " " + d.name;
+    header += "\nSIZE";
+    for (const Field& d : h.fields) header += " " + std::to_string(d.size);
+    header += "\nTYPE";
+    for (const Field& d : h.fields) { header += ' '; header += d.type; }
+    header += "\nCOUNT";
+    for (size_t f = 0; f < nf; ++f) header += " 1";
+    header += "\nWIDTH " + std::to_string(n) + "\nHEIGHT 1\nVIEWPOINT 0 0 0 1 0 0 0\nPOINTS " + std::to_string(n) + "\nDATA ";
+    header += encoding == Encoding::Ascii ? "ascii\n" : encoding == Encoding::Binary ? "binary\n" : "binary_compressed\n";
+    file.write(header.data(), static_cast<std::streamsize>(header.size()));
+
+    std::vector<const AttributeChannel*> column(nf, nullptr);
+    for (size_t f = 0; f < nf; ++f) if (h.fields[f].role == Attribute) column[f] = attrs.find(h.fields[f].name);
+
+    // Encode points [first, first + m) as records; field f of point j goes to
+    // out + offset[f] + j * stride[f]
+    auto encode = [&](size_t first, size_t m, unsigned char* out, const size_t* offset, const size_t* stride) {
+        parallelFor(m, [&](size_t b, size_t e, unsigned) {
+            size_t k = 0;
+            if (!chunks.empty()) {
+                k = static_cast<size_t>(std::upper_bound(chunks.begin(), chunks.end(), first + b,
+                    [](size_t v, const PointCloud::Chunk& c) { return v < c.begin; }) - chunks.begin()) - 1;
+            }
+            for (size_t j = b; j < e; ++j) {
+                const size_t i = first + j;
+                while (k + 1 < chunks.size() && chunks[k + 1].begin <= i) ++k;
+                const Point& p = points[i];
+                for (size_t f = 0; f < nf; ++f) {
+                    const Field& d = h.fields[f];
+                    unsigned char* r = out + offset[f] + j * stride[f];
+                    switch (d.role) {
+                        case X: case Y: case Z: {
+                            const float v = d.role == X ? p.x : d.role == Y ? p.y : p.z;
+                            if (geo) {
+                                const Vec3d off = chunks.empty() ? Vec3d{} : chunks[k].offset;
+                                const double o = d.role == X ? origin.x + off.x : d.role == Y ? origin.y + off.y : origin.z + off.z;
+                                put<double>(r, o + v);
+                            } else {
+                                put<float>(r, v);
+                            }
+                            break;
+                        }
+                        case Rgb:
+                            put<uint32_t>(r, (uint32_t(std::clamp(p.r, 0, 255)) << 16) |
+                                             (uint32_t(std::clamp(p.g, 0, 255)) << 8) | uint32_t(std::clamp(p.b, 0, 255)));
+                            break;
+                        case NX: put<float>(r, p.nx); break;
+                        case NY: put<float>(r, p.ny); break;
+                        case NZ: put<float>(r, p.nz); break;
+                        default: std::memcpy(r, column[f]->bytes.data() + i * d.size, d.size); break;
+                    }
+                }
+            }
+        });
+    };
+
+    std::vector<size_t> offset(nf), stride(nf);
+    std::vector<unsigned char> raw;
+    const size_t blockPoints = size_t(1) << 18;
+    if (encoding == Encoding::BinaryCompressed) {
+        // field-major layout, compressed as one LZF stream
+        for (size_t f = 0, at = 0; f < nf; ++f) {
+            stride[f] = h.fields[f].bytes();
+            offset[f] = at;
+            at += n * stride[f];
+        }
+        raw.resize(n * h.recordSize);
+        encode(0, n, raw.data(), offset.data(), stride.data());
+        std::vector<unsigned char> packed(lzf::bound(raw.size()));
+        const size_t packedSize = raw.empty() ? 0 : lzf::compress(raw.data(), raw.size(), packed.data(), packed.size());
+        if (!raw.empty() && packedSize == 0) {
+            std::cerr << "Error: LZF compression failed for " << filename << std::endl;
+            return false;
+        }
+        unsigned char sizes[8];
+        put<uint32_t>(sizes, static_cast<uint32_t>(packedSize));
+        put<uint32_t>(sizes + 4, static_cast<uint32_t>(raw.size()));
+        file.write(reinterpret_cast<const char*>(sizes), 8);
+        file.write(reinterpret_cast<const char*>(packed.data()), static_cast<std::streamsize>(packedSize));
+        return static_cast<bool>(file);
+    }
+
+    for (size_t f = 0; f < nf; ++f) { offset[f] = h.fields[f].offset; stride[f] = h.recordSize; }
+    const unsigned pieces = workerCount();
+    std::vector<std::string> text(pieces);
+    for (size_t first = 0; first < n; first += blockPoints) {
+        const size_t m = std::min(blockPoints, n - first);
+        raw.resize(m * h.recordSize);
+        encode(first, m, raw.data(), offset.data(), stride.data());
+        if (encoding == Encoding::Binary) {
+            file.write(reinterpret_cast<const char*>(raw.data()), static_cast<std::streamsize>(raw.size()));
+            continue;
+        }
+        // ASCII: format each worker's share of the records, write in order
+        parallelFor(pieces, [&](size_t b, size_t e, unsigned) {
+            for (size_t k = b; k < e; ++k) {
+                std::string& s = text[k];
+                s.clear();
+                char line[64 * 40];
+                for (size_t j = m * k / pieces; j < m * (k + 1) / pieces; ++j) {
+                    const unsigned char* r = raw.data() + j * h.recordSize;
+                    char* c = line;
+                    for (size_t f = 0; f < nf; ++f) {
+                        if (f) *c++ = ' ';
+                        c = formatValue(c, line + sizeof(line), r + h.fields[f].offset, h.fields[f].type, h.fields[f].size);
+                        if (c > line + sizeof(line) - 40) { s.append(line, c); c = line; }
+                    }
+                    *c++ = '\n';
+                    s.append(line, c);
+                }
+            }
+        }, 1);
+        for (const std::string& s : text) file.write(s.data(), static_cast<std::streamsize>(s.size()));
+    }
+    return static_cast<bool>(file);
+}
+
+} // namespace PointCloudUtil
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "PointCloudUtil.h"
+#include "PointCloudIO.h"
+#include "PointCloudKernels.h"
+
+namespace PointCloudUtil {
+
+// One step of a headless processing pipeline. The pipeline text format is one
+// step per line ('#' starts a comment):
+//
+//   load                                  (optional, the input file is loaded implicitly)
+//   translate <tx> <ty> <tz>
+//   rotate <degrees> <x|y|z>
+//   filter box <minX> <minY> <minZ> <maxX> <maxY> <maxZ>
+//   filter plane <nx> <ny> <nz> <d>        (keeps n . p <= d; the pending transform stays pending)
+//   downsample <voxelSize>
+//   downsample poisson <radius>           (blue-noise subset, no two points closer than radius)
+//   downsample farthest <count>           (farthest-point subset of count points)
+//   normals
+//   features <k>                          (kNN normals, surface_variation, curvature, planarity, linearity)
+//   displace normals <amount>
+//   displace symmetric <amount>
+//   colormap <x|y|z> <lo> <hi>            (height ramp; fused with any pending transform)
+//   export <path>                         ({stem}, {name} and {dir} expand per input)
+struct PipelineStep {
+    enum class Op { Translate, Rotate, FilterBox, FilterPlane, Downsample, PoissonDisk, FarthestPoint, Normals, Features, DisplaceNormals, DisplaceSymmetric, ColorMap, Export };
+    Op op = Op::Translate;
+    std::array<float, 6> args{};
+    char axis = 'x';
+    size_t count = 0;   // FarthestPoint
+    std::string path;
+    int line = 0;
+};
+
+class Pipeline {
+private:
+    std::vector<PipelineStep> steps;
+
+    static std::string expandPath(const std::string& pattern, const std::string& input) {
+        const size_t slash = input.find_last_of("/\\");
+        const std::string dir  = (slash == std::string::npos) ? std::string(".") : input.substr(0, slash);
+        const std::string name = (slash == std::string::npos) ? input : input.substr(slash + 1);
+        const size_t dot = name.find_last_of('.');
+        const std::string stem = (dot == std::string::npos) ? name : name.substr(0, dot);
+
+        std::string out;
+        for (size_t i = 0; i < pattern.size();) {
+            if (pattern.compare(i, 6, "{stem}") == 0) { out += stem; i += 6; }
+            else if (pattern.compare(i, 6, "{name}") == 0) { out += name; i += 6; }
+            else if (pattern.compare(i, 5, "{dir}") == 0) { out += dir; i += 5; }
+            else out += pattern[i++];
+        }
+        return out;
+    }
+
+    // Positive whole number: digits only, so "0.5" or "-3" fail rather than truncate or wrap
+    static bool parseCount(const std::string& token, size_t& count) {
+        if (token.empty() || token.find_first_not_of("0123456789") != std::string::npos) return false;
+        std::istringstream value(token);
+        return (value >> count) && count > 0;
+    }
+
+public:
+    // Parse a pipeline description; reports the first bad line on std::cerr
+    bool parse(std::istream& in) {
+        steps.clear();
+        std::string line;
+        int lineNo = 0;
+        while (std::getline(in, line)) {
+            ++lineNo;
+            const size_t hash = line.find('#');
+            if (hash != std::string::npos) line.erase(hash);
+            std::istringstream iss(line);
+            std::string cmd;
+            if (!(iss >> cmd)) continue;
+
+            PipelineStep st;
+            st.line = lineNo;
+            bool ok = true;
+            if (cmd == "load") {
+                continue;
+            } else if (cmd == "translate") {
+                st.op = PipelineStep::Op::Translate;
+                ok = static_cast<bool>(iss >> st.args[0] >> st.args[1] >> st.args[2]);
+            } else if (cmd == "rotate") {
+                st.op = PipelineStep::Op::Rotate;
+                ok = (iss >> st.args[0] >> st.axis) && (st.axis == 'x' || st.axis == 'y' || st.axis == 'z');
+            } else if (cmd == "filter") {
+                std::string kind;
+                ok = (iss >> kind) && (kind == "box" || kind == "plane");
+                st.op = (kind == "plane") ? PipelineStep::Op::FilterPlane : PipelineStep::Op::FilterBox;
+                const int count = (kind == "plane") ? 4 : 6;
+                for (int k = 0; ok && k < count; ++k) ok = static_cast<bool>(iss >> st.args[k]);
+            } else if (cmd == "downsample") {
+                std::string arg;
+                ok = static_cast<bool>(iss >> arg);
+                if (ok && arg == "poisson") {
+                    st.op = PipelineStep::Op::PoissonDisk;
+                    ok = (iss >> st.args[0]) && st.args[0] > 0.0f;
+                } else if (ok && arg == "farthest") {
+                    st.op = PipelineStep::Op::FarthestPoint;
+                    std::string token;
+                    ok = (iss >> token) && parseCount(token, st.count);
+                } else if (ok) {
+                    st.op = PipelineStep::Op::Downsample;
+                    std::istringstream value(arg);
+                    ok = (value >> st.args[0]) && st.args[0] > 0.0f;
+                }
+            } else if (cmd == "normals") {
+                st.op = PipelineStep::Op::Normals;
+            } else if (cmd == "features") {
+                st.op = PipelineStep::Op::Features;
+                ok = (iss >> st.args[0]) && st.args[0] >= 3.0f;
+            } else if (cmd == "displace") {
+                std::string kind;
+                ok = (iss >> kind >> st.args[0]) && (kind == "normals" || kind == "symmetric");
+                st.op = (kind == "normals") ? PipelineStep::Op::DisplaceNormals : PipelineStep::Op::DisplaceSymmetric;
+            } else if (cmd == "colormap") {
+                st.op = PipelineStep::Op::ColorMap;
+                ok = (iss >> st.axis >> st.args[0] >> st.args[1]) && (st.axis == 'x' || st.axis == 'y' || st.axis == 'z');
+            } else if (cmd == "export") {
+                st.op = PipelineStep::Op::Export;
+                ok = static_cast<bool>(iss >> st.path);
+            } else {
+                ok = false;
+            }
+            if (!ok) {
+                std::cerr << "Error: pipeline line " << lineNo << ": cannot parse '" << line << "'" << std::endl;
+                return false;
+            }
+            steps.push_back(st);
+        }
+        return true;
+    }
+
+    bool loadFromFile(const std::string& filename) {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            std::cerr << "Error: Unable to open pipeline " << filename << std::endl;
+            return false;
+        }
+        return parse(file);
+    }
+
+    const std::vector<PipelineStep>& getSteps() const { return steps; }
+
+    // Load 'input' into 'cloud' (reusing its storage) and execute every step
+    bool run(PointCloud& cloud, const std::string& input) const {
+        if (!loadPointCloud(cloud, input, /*keepSnapshot=*/false)) return false;
+        for (const auto& st : steps) {
+            switch (st.op) {
+                case PipelineStep::Op::Translate:         cloud.translate(st.args[0], st.args[1], st.args[2]); break;
+                case PipelineStep::Op::Rotate:            cloud.rotate(st.args[0], st.axis); break;
+                case PipelineStep::Op::FilterBox:         cloud.filterBox(st.args[0], st.args[1], st.args[2],
+                                                                          st.args[3], st.args[4], st.args[5]); break;
+                case PipelineStep::Op::FilterPlane:       cloud.crop(CropRegion::halfSpace(st.args[0], st.args[1], st.args[2], st.args[3])); break;
+                case PipelineStep::Op::Downsample:        cloud.voxelDownsample(st.args[0]); break;
+                case PipelineStep::Op::PoissonDisk:       cloud.poissonDiskSample(st.args[0]); break;
+                case PipelineStep::Op::FarthestPoint:     cloud.farthestPointSample(st.count); break;
+                case PipelineStep::Op::Normals:           cloud.estimateNormals(); break;
+                case PipelineStep::Op::Features:          cloud.estimateFeatures(static_cast<size_t>(st.args[0])); break;
+                case PipelineStep::Op::DisplaceNormals:   cloud.displaceAlongNormals(st.args[0]); break;
+                case PipelineStep::Op::DisplaceSymmetric: cloud.displaceSymmetrically(st.args[0]); break;
+                case PipelineStep::Op::ColorMap:
+                    cloud.applyPointKernel(ColorLutOp::heightRamp(st.axis - 'x', st.args[0], st.args[1]));
+                    break;
+                case PipelineStep::Op::Export:
+                    if (!savePointCloud(cloud, expandPath(st.path, input))) return false;
+                    break;
+            }
+        }
+        return true;
+    }
+};
+
+} // namespace PointCloudUtil
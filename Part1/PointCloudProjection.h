@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace PointCloudUtil {
+
+// Pinhole camera in the OpenCV convention: x right, y down, z along the optical axis.
+// Pixel (u, v) is centred on u = fx * x / z + cx, v = fy * y / z + cy. 'pose' maps
+// camera coordinates into the cloud frame (row-major 3x4, rigid); points outside
+// [minDepth, maxDepth] along the axis are not imaged.
+struct PinholeCamera {
+    int width = 0, height = 0;
+    double fx = 1.0, fy = 1.0, cx = 0.0, cy = 0.0;
+    double pose[12] = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0 };
+    float minDepth = 1e-3f, maxDepth = std::numeric_limits<float>::infinity();
+
+    // Square pixels, principal point at the image centre, vertical field of view in degrees
+    static PinholeCamera fromFov(int width, int height, double fovYDegrees) {
+        PinholeCamera c;
+        c.width = width;
+        c.height = height;
+        c.fy = c.fx = 0.5 * height / std::tan(0.5 * fovYDegrees * 3.14159265358979323846 / 180.0);
+        c.cx = 0.5 * (width - 1);
+        c.cy = 0.5 * (height - 1);
+        return c;
+    }
+
+    // Place the camera at 'eye' looking at 'target'; 'up' points up in the image
+    void lookAt(const double eye[3], const double target[3], const double up[3]) {
+        double z[3] = { target[0] - eye[0], target[1] - eye[1], target[2] - eye[2] };
+        double len = std::sqrt(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+        for (double& a : z) a = len > 0.0 ? a / len : 0.0;
+        // image y runs down, so x = z x up
+        double x[3] = { z[1] * up[2] - z[2] * up[1], z[2] * up[0] - z[0] * up[2], z[0] * up[1] - z[1] * up[0] };
+        len = std::sqrt(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]);
+        for (double& a : x) a = len > 0.0 ? a / len : 0.0;
+        const double y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+        for (int r = 0; r < 3; ++r) {
+            pose[4 * r] = x[r]; pose[4 * r + 1] = y[r]; pose[4 * r + 2] = z[r]; pose[4 * r + 3] = eye[r];
+        }
+    }
+
+    // Cloud frame -> camera (row-major 3x4): the rigid inverse of 'pose'
+    void viewFrame(double F[12]) const {
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 3; ++c) F[4 * r + c] = pose[4 * c + r];
+            F[4 * r + 3] = -(pose[r] * pose[3] + pose[4 + r] * pose[7] + pose[8 + r] * pose[11]);
+        }
+    }
+};
+
+// Depth and colour rendered from (or captured by) a pinhole camera, row-major.
+// Depth is the distance along the optical axis; 0 marks pixels without a return.
+struct DepthImage {
+    int width = 0, height = 0;
+    std::vector<float> depth;
+    std::vector<uint8_t> colour;   // rgb per pixel; empty when not rendered or captured
+
+    void resize(int w, int h, bool withColour) {
+        width = w;
+        height = h;
+        depth.assign(static_cast<size_t>(w) * h, 0.0f);
+        colour.assign(withColour ? static_cast<size_t>(w) * h * 3 : 0, uint8_t(0));
+    }
+    float at(int u, int v) const { return depth[static_cast<size_t>(v) * width + u]; }
+};
+
+namespace projection {
+
+constexpr int kTile = 64;                          // z-buffer tile edge in pixels
+constexpr uint32_t kNoPixel = ~uint32_t(0);
+
+// Pixel index (kNoPixel when not imaged) and depth of n points 'stride' floats apart
+// under m (cloud or chunk frame -> camera, row-major 3x4). Branch-free so the loop
+// vectorises.
+inline void projectBlock(const float* src, size_t stride, size_t n, const float m[12], const PinholeCamera& cam,
+                         uint32_t* pixel, float* depth) {
+    const float fx = static_cast<float>(cam.fx), fy = static_cast<float>(cam.fy);
+    const float cx = static_cast<float>(cam.cx) + 0.5f, cy = static_cast<float>(cam.cy) + 0.5f;
+    const float w = static_cast<float>(cam.width), h = static_cast<float>(cam.height);
+    const float zMin = std::max(cam.minDepth, 1e-12f), zMax = cam.maxDepth;
+    const uint32_t width = static_cast<uint32_t>(cam.width);
+    for (size_t i = 0; i < n; ++i) {
+        const float* p = src + i * stride;
+        const float x = m[0] * p[0] + m[1] * p[1] + m[2] * p[2] + m[3];
+        const float y = m[4] * p[0] + m[5] * p[1] + m[6] * p[2] + m[7];
+        const float z = m[8] * p[0] + m[9] * p[1] + m[10] * p[2] + m[11];
+        const float iz = 1.0f / std::max(z, zMin);
+        const float u = fx * x * iz + cx, v = fy * y * iz + cy;
+        const bool inside = z >= zMin && z <= zMax && u >= 0.0f && u < w && v >= 0.0f && v < h;
+        const uint32_t pu = static_cast<uint32_t>(inside ? u : 0.0f), pv = static_cast<uint32_t>(inside ? v : 0.0f);
+        pixel[i] = inside ? pv * width + pu : kNoPixel;
+        depth[i] = z;
+    }
+}
+
+// Camera-frame positions of the pixels of row v with depth in range; returns the count.
+// The per-pixel loop is branch-free and vectorises; the compaction that follows is not.
+inline size_t backProjectRow(const DepthImage& image, const PinholeCamera& cam, int v, float* x, float* y, float* z,
+                             uint32_t* column) {
+    const float* d = image.depth.data() + static_cast<size_t>(v) * image.width;
+    const float ifx = static_cast<float>(1.0 / cam.fx);
+    const float ox = static_cast<float>(-cam.cx / cam.fx), ry = static_cast<float>((v - cam.cy) / cam.fy);
+    for (int u = 0; u < image.width; ++u) {
+        x[u] = (static_cast<float>(u) * ifx + ox) * d[u];
+        y[u] = ry * d[u];
+    }
+    size_t n = 0;
+    for (int u = 0; u < image.width; ++u) {
+        const float depth = d[u];
+        if (!(depth >= cam.minDepth && depth <= cam.maxDepth && depth > 0.0f)) continue;
+        x[n] = x[u]; y[n] = y[u]; z[n] = depth; column[n] = static_cast<uint32_t>(u);
+        ++n;
+    }
+    return n;
+}
+
+} // namespace projection
+
+// Depth as a 16-bit binary PGM in 'unitsPerMetre' (1000: millimetres, as most depth
+// cameras store it); depths beyond the 16-bit range are clamped
+inline bool saveDepthPGM(const DepthImage& image, const std::string& filename, float unitsPerMetre = 1000.0f) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to open file for writing: " << filename << std::endl;
+        return false;
+    }
+    file << "P5\n" << image.width << " " << image.height << "\n65535\n";
+    std::vector<uint8_t> row(2 * static_cast<size_t>(image.width));
+    for (int v = 0; v < image.height; ++v) {
+        for (int u = 0; u < image.width; ++u) {
+            const float d = std::min(65535.0f, std::round(image.at(u, v) * unitsPerMetre));
+            const uint16_t q = static_cast<uint16_t>(std::max(0.0f, d));
+            row[2 * u] = static_cast<uint8_t>(q >> 8);
+            row[2 * u + 1] = static_cast<uint8_t>(q & 0xFF);
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size()));
+    }
+    return static_cast<bool>(file);
+}
+
+// Reads a binary PGM (8 or 16 bit) written by saveDepthPGM() or a depth camera
+inline bool loadDepthPGM(DepthImage& image, const std::string& filename, float unitsPerMetre = 1000.0f) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to open file " << filename << std::endl;
+        return false;
+    }
+    std::string magic;
+    int w = 0, h = 0, maxVal = 0;
+    file >> magic;
+    // header fields may be separated by comments
+    auto field = [&](int& out) {
+        while (file >> std::ws && file.peek() == '#') file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        return static_cast<bool>(file >> out);
+    };
+    if (magic != "P5" || !field(w) || !field(h) || !field(maxVal) || w <= 0 || h <= 0 || maxVal <= 0 || maxVal > 65535) {
+        std::cerr << "Error: " << filename << " is not a binary PGM depth image" << std::endl;
+        return false;
+    }
+    file.get();
+    const size_t bytes = maxVal > 255 ? 2 : 1;
+    std::vector<uint8_t> raw(static_cast<size_t>(w) * h * bytes);
+    if (!file.read(reinterpret_cast<char*>(raw.data()), static_cast<std::streamsize>(raw.size()))) {
+        std::cerr << "Error: " << filename << " is truncated" << std::endl;
+        return false;
+    }
+    image.resize(w, h, false);
+    const float scale = 1.0f / unitsPerMetre;
+    for (size_t i = 0; i < image.depth.size(); ++i) {
+        const unsigned q = bytes == 2 ? (unsigned(raw[2 * i]) << 8) | raw[2 * i + 1] : raw[i];
+        image.depth[i] = static_cast<float>(q) * scale;
+    }
+    return true;
+}
+
+// Colour as a binary PPM; black where nothing was rendered
+inline bool saveColourPPM(const DepthImage& image, const std::string& filename) {
+    if (image.colour.empty()) {
+        std::cerr << "Error: the image has no colour to save" << std::endl;
+        return false;
+    }
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to open file for writing: " << filename << std::endl;
+        return false;
+    }
+    file << "P6\n" << image.width << " " << image.height << "\n255\n";
+    file.write(reinterpret_cast<const char*>(image.colour.data()), static_cast<std::streamsize>(image.colour.size()));
+    return static_cast<bool>(file);
+}
+
+} // namespace PointCloudUtil
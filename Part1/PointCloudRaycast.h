@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+
+namespace PointCloudUtil {
+
+// Visits the cells of a grid of edge 'cell' (cell (i, j, k) spans [i, i + 1) * cell per
+// axis) crossed by the segment a -> b, in order from a, with a 3D DDA (Amanatides and
+// Woo 1987): one comparison and one add per step. f(i, j, k) returns false to stop early.
+// Returns the number of cells visited.
+template <typename F>
+inline size_t traverseCells(const double a[3], const double b[3], double cell, F f) {
+    const double inv = 1.0 / cell;
+    int64_t c[3], last[3], step[3];
+    double tMax[3], tDelta[3];
+    for (int k = 0; k < 3; ++k) {
+        const double p = a[k] * inv, q = b[k] * inv, d = q - p;
+        c[k] = static_cast<int64_t>(std::floor(p));
+        last[k] = static_cast<int64_t>(std::floor(q));
+        step[k] = d > 0.0 ? 1 : (d < 0.0 ? -1 : 0);
+        if (step[k] == 0) {
+            tMax[k] = tDelta[k] = std::numeric_limits<double>::infinity();
+        } else {
+            // segment parameter at the first boundary, and per cell
+            const double boundary = step[k] > 0 ? std::floor(p) + 1.0 : std::floor(p);
+            tMax[k] = (boundary - p) / d;
+            tDelta[k] = static_cast<double>(step[k]) / d;
+        }
+    }
+    // a path of |di| + |dj| + |dk| steps; counting them keeps rounding from overshooting
+    int64_t steps = std::llabs(last[0] - c[0]) + std::llabs(last[1] - c[1]) + std::llabs(last[2] - c[2]);
+    size_t visited = 1;
+    if (!f(c[0], c[1], c[2])) return visited;
+    for (; steps > 0; --steps) {
+        const int k = tMax[0] < tMax[1] ? (tMax[0] < tMax[2] ? 0 : 2) : (tMax[1] < tMax[2] ? 1 : 2);
+        c[k] += step[k];
+        tMax[k] += tDelta[k];
+        ++visited;
+        if (!f(c[0], c[1], c[2])) break;
+    }
+    return visited;
+}
+
+} // namespace PointCloudUtil
@@ -0,0 +1,452 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "PointCloudUtil.h"
+
+namespace PointCloudUtil {
+
+// Fast Point Feature Histograms (Rusu et al. 2009) and feature-matching global
+// registration. Descriptors are computed on voxel-downsampled keypoints; the kNN graph
+// cached by PointCloud::neighbors() serves both the keypoint normals and the
+// descriptors. Registration matches descriptors, then runs RANSAC over triples of
+// correspondences in parallel blocks and refines on the inliers. The result is an
+// initial guess for a local method such as ICP.
+
+constexpr size_t kFpfhBins = 11;                 // per angular feature
+constexpr size_t kFpfhSize = 3 * kFpfhBins;      // descriptor length
+
+struct RegistrationOptions {
+    float voxelSize = 0.0f;          // keypoint voxel; 0 uses 1/100 of the larger box diagonal
+    size_t normalNeighbors = 16;     // k for the keypoint normals
+    size_t featureNeighbors = 32;    // k for the descriptors (the same cached graph, longer rows)
+    float maxDistance = 0.0f;        // inlier distance; 0 uses 1.5 * voxelSize
+    size_t iterations = 40000;       // RANSAC triples
+    float edgeSimilarity = 0.9f;     // triples whose edge lengths differ more are rejected early
+    bool mutualFilter = true;        // keep only matches that are each other's nearest descriptor
+    uint32_t seed = 1;
+};
+
+struct RegistrationResult {
+    Mat4 transform = Mat4::identity(); // source cloud frame -> target cloud frame
+    Similarity rigid;                  // the same transform (unit scale)
+    size_t keypoints[2] = { 0, 0 };    // source, target
+    size_t correspondences = 0;
+    size_t inliers = 0;
+    float fitness = 0.0f;              // inliers / correspondences
+    float rmse = 0.0f;                 // over the inliers
+};
+
+namespace registration {
+
+// Symmetric 4x4 eigenvector of the largest eigenvalue (cyclic Jacobi, row-major a)
+inline void largestEigenvector4(double a[16], double v[4]) {
+    double V[16] = { 1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1 };
+    for (int sweep = 0; sweep < 32; ++sweep) {
+        double off = 0.0;
+        for (int p = 0; p < 4; ++p) for (int q = p + 1; q < 4; ++q) off += a[p * 4 + q] * a[p * 4 + q];
+        if (off < 1e-30) break;
+        for (int p = 0; p < 4; ++p) {
+            for (int q = p + 1; q < 4; ++q) {
+                const double apq = a[p * 4 + q];
+                if (std::fabs(apq) < 1e-300) continue;
+                const double theta = (a[q * 4 + q] - a[p * 4 + p]) / (2.0 * apq);
+                const double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+                const double c = 1.0 / std::sqrt(t * t + 1.0), s = t * c;
+                for (int k = 0; k < 4; ++k) {
+                    const double akp = a[k * 4 + p], akq = a[k * 4 + q];
+                    a[k * 4 + p] = c * akp - s * akq;
+                    a[k * 4 + q] = s * akp + c * akq;
+                }
+                for (int k = 0; k < 4; ++k) {
+                    const double apk = a[p * 4 + k], aqk = a[q * 4 + k];
+                    a[p * 4 + k] = c * apk - s * aqk;
+                    a[q * 4 + k] = s * apk + c * aqk;
+                }
+                for (int k = 0; k < 4; ++k) {
+                    const double vkp = V[k * 4 + p], vkq = V[k * 4 + q];
+                    V[k * 4 + p] = c * vkp - s * vkq;
+                    V[k * 4 + q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+    int best = 0;
+    for (int i = 1; i < 4; ++i) if (a[i * 4 + i] > a[best * 4 + best]) best = i;
+    for (int k = 0; k < 4; ++k) v[k] = V[k * 4 + best];
+}
+
+// Least-squares rigid transform taking src[i] onto dst[i] (Horn's quaternion method)
+inline Similarity fitRigid(const float* src, const float* dst, size_t n) {
+    Similarity S;
+    if (n == 0) return S;
+    double cs[3] = { 0, 0, 0 }, cd[3] = { 0, 0, 0 };
+    for (size_t i = 0; i < n; ++i) for (int k = 0; k < 3; ++k) { cs[k] += src[3 * i + k]; cd[k] += dst[3 * i + k]; }
+    for (int k = 0; k < 3; ++k) { cs[k] /= static_cast<double>(n); cd[k] /= static_cast<double>(n); }
+    double H[9] = { 0, 0, 0, 0, 0, 0, 0, 0, 0 }; // H[r * 3 + c] = sum (src - cs)_r (dst - cd)_c
+    for (size_t i = 0; i < n; ++i) {
+        const double a[3] = { src[3 * i] - cs[0], src[3 * i + 1] - cs[1], src[3 * i + 2] - cs[2] };
+        const double b[3] = { dst[3 * i] - cd[0], dst[3 * i + 1] - cd[1], dst[3 * i + 2] - cd[2] };
+        for (int r = 0; r < 3; ++r) for (int c = 0; c < 3; ++c) H[r * 3 + c] += a[r] * b[c];
+    }
+    const double sxx = H[0], sxy = H[1], sxz = H[2], syx = H[3], syy = H[4], syz = H[5], szx = H[6], szy = H[7], szz = H[8];
+    double N[16] = {
+        sxx + syy + szz, syz - szy,        szx - sxz,        sxy - syx,
+        syz - szy,       sxx - syy - szz,  sxy + syx,        szx + sxz,
+        szx - sxz,       sxy + syx,        -sxx + syy - szz, syz + szy,
+        sxy - syx,       szx + sxz,        syz + szy,        -sxx - syy + szz };
+    double q[4];
+    largestEigenvector4(N, q);
+    S.qw = q[0]; S.qx = q[1]; S.qy = q[2]; S.qz = q[3];
+    S.renormalize();
+    const Vec3d rc = S.rotate(Vec3d{ cs[0], cs[1], cs[2] });
+    S.t = Vec3d{ cd[0] - rc.x, cd[1] - rc.y, cd[2] - rc.z };
+    return S;
+}
+
+// Keypoints: voxel averages of the cloud's transformed positions, shifted by 'shift'
+// (double, so clouds with distant origins meet in one float frame). The result is a
+// small cloud whose own kNN cache serves normals and descriptors.
+inline void extractKeypoints(const PointCloud& cloud, float voxel, const Vec3d& shift, PointCloud& out) {
+    out.clear();
+    const size_t n = cloud.size();
+    if (n == 0) return;
+    std::vector<float> xyz(3 * n);
+    size_t i = 0;
+    // added in double: a large shift rounded to float first would quantise every point
+    cloud.forEachTransformedPoint([&](float x, float y, float z, int, int, int) {
+        xyz[3 * i] = static_cast<float>(double(x) + shift.x);
+        xyz[3 * i + 1] = static_cast<float>(double(y) + shift.y);
+        xyz[3 * i + 2] = static_cast<float>(double(z) + shift.z);
+        ++i;
+    });
+    float mn[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+    for (size_t j = 0; j < n; ++j) for (int k = 0; k < 3; ++k) mn[k] = std::min(mn[k], xyz[3 * j + k]);
+    const float inv = 1.0f / voxel;
+    std::vector<std::pair<uint64_t, uint32_t>> keys(n);
+    parallelFor(n, [&](size_t b, size_t e, unsigned) {
+        for (size_t j = b; j < e; ++j) {
+            const uint64_t ix = static_cast<uint64_t>((xyz[3 * j] - mn[0]) * inv) & 0x1FFFFF;
+            const uint64_t iy = static_cast<uint64_t>((xyz[3 * j + 1] - mn[1]) * inv) & 0x1FFFFF;
+            const uint64_t iz = static_cast<uint64_t>((xyz[3 * j + 2] - mn[2]) * inv) & 0x1FFFFF;
+            keys[j] = { (ix << 42) | (iy << 21) | iz, static_cast<uint32_t>(j) };
+        }
+    });
+    std::sort(keys.begin(), keys.end());
+    std::vector<Point> kp;
+    for (size_t b = 0; b < n;) {
+        size_t e = b;
+        double s[3] = { 0, 0, 0 };
+        while (e < n && keys[e].first == keys[b].first) {
+            for (int k = 0; k < 3; ++k) s[k] += xyz[3 * keys[e].second + k];
+            ++e;
+        }
+        Point p{};
+        const double c = static_cast<double>(e - b);
+        p.x = static_cast<float>(s[0] / c); p.y = static_cast<float>(s[1] / c); p.z = static_cast<float>(s[2] / c);
+        kp.push_back(p);
+        b = e;
+    }
+    out.appendPoints(kp.data(), kp.size(), false);
+}
+
+// Nearest descriptor in 'to' for every descriptor in 'from'. Squared distances are
+// |b|^2 - 2 a.b (|a|^2 is common to a row); 'to' is transposed so each dimension adds
+// into a row of distances with one vector multiply-add per 8 (AVX) or 4 (SSE2) targets.
+inline void nearestDescriptors(const std::vector<float>& from, const std::vector<float>& to, std::vector<uint32_t>& match) {
+    const size_t nf = from.size() / kFpfhSize, nt = to.size() / kFpfhSize;
+    match.assign(nf, 0);
+    if (nt == 0) return;
+    // rows padded to whole vectors of 8; padding columns get a huge norm so they never win
+    const size_t stride = (nt + 7) & ~size_t(7);
+    std::vector<float> columns(kFpfhSize * stride, 0.0f), norms(stride, std::numeric_limits<float>::max());
+    for (size_t j = 0; j < nt; ++j) {
+        norms[j] = 0.0f;
+        for (size_t k = 0; k < kFpfhSize; ++k) {
+            const float v = to[j * kFpfhSize + k];
+            columns[k * stride + j] = v;
+            norms[j] += v * v;
+        }
+    }
+    // targets in tiles of 512 so the running distances stay in L1 across the dimensions
+    constexpr size_t kTile = 512;
+    parallelFor(nf, [&](size_t b, size_t e, unsigned) {
+        alignas(32) float d[kTile];
+        for (size_t i = b; i < e; ++i) {
+            const float* a = from.data() + i * kFpfhSize;
+            float best = std::numeric_limits<float>::max();
+            uint32_t arg = 0;
+            for (size_t t0 = 0; t0 < stride; t0 += kTile) {
+                const size_t len = std::min(kTile, stride - t0);
+                std::copy(norms.begin() + t0, norms.begin() + t0 + len, d);
+                for (size_t k = 0; k < kFpfhSize; ++k) {
+                    const float w = -2.0f * a[k];
+                    const float* c = columns.data() + k * stride + t0;
+#if defined(__AVX__)
+                    const __m256 wv = _mm256_set1_ps(w);
+                    for (size_t j = 0; j < len; j += 8)
+                        _mm256_store_ps(d + j, _mm256_add_ps(_mm256_load_ps(d + j), _mm256_mul_ps(wv, _mm256_loadu_ps(c + j))));
+#elif defined(__SSE2__)
+                    const __m128 wv = _mm_set1_ps(w);
+                    for (size_t j = 0; j < len; j += 4)
+                        _mm_store_ps(d + j, _mm_add_ps(_mm_load_ps(d + j), _mm_mul_ps(wv, _mm_loadu_ps(c + j))));
+#else
+                    for (size_t j = 0; j < len; ++j) d[j] += w * c[j];
+#endif
+                }
+                for (size_t j = 0; j < len; ++j) {
+                    if (d[j] < best) { best = d[j]; arg = static_cast<uint32_t>(t0 + j); }
+                }
+            }
+            match[i] = arg;
+        }
+    }, 64);
+}
+
+} // namespace registration
+
+// FPFH descriptor (kFpfhSize floats per point, each 11-bin block summing to 100) for
+// every point of 'cloud', from its k nearest neighbours. Normals are estimated from the
+// same cached kNN graph when the cloud has none.
+inline void computeFPFH(PointCloud& cloud, size_t k, std::vector<float>& descriptors) {
+    const size_t n = cloud.size();
+    descriptors.assign(n * kFpfhSize, 0.0f);
+    if (n == 0) return;
+    const NeighborGraph& g = cloud.neighbors(k);
+    if (!cloud.hasNormals()) cloud.estimateFeatures(std::min<size_t>(k, 16), PointCloud::FeatureNormals);
+    const auto& pts = cloud.getPoints();
+
+    // Simplified PFH of each point against its neighbours
+    std::vector<float> spfh(n * kFpfhSize, 0.0f);
+    parallelFor(n, [&](size_t b, size_t e, unsigned) {
+        for (size_t i = b; i < e; ++i) {
+            const Point& p = pts[i];
+            const uint32_t* row = g.row(i);
+            float* h = spfh.data() + i * kFpfhSize;
+            size_t used = 0;
+            for (size_t j = 0; j < k; ++j) {
+                if (row[j] == NeighborGraph::kNoNeighbor) break;
+                const Point& q = pts[row[j]];
+                float d[3] = { q.x - p.x, q.y - p.y, q.z - p.z };
+                const float len = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+                if (!(len > 0.0f)) continue;
+                d[0] /= len; d[1] /= len; d[2] /= len;
+                // the source of the Darboux frame is the end whose normal is closer to the line
+                const float* n1 = &p.nx;
+                const float* n2 = &q.nx;
+                float a1 = n1[0] * d[0] + n1[1] * d[1] + n1[2] * d[2];
+                const float a2 = n2[0] * d[0] + n2[1] * d[1] + n2[2] * d[2];
+                if (std::fabs(a1) < std::fabs(a2)) {
+                    std::swap(n1, n2);
+                    d[0] = -d[0]; d[1] = -d[1]; d[2] = -d[2];
+                    a1 = -a2;
+                }
+                float v[3] = { d[1] * n1[2] - d[2] * n1[1], d[2] * n1[0] - d[0] * n1[2], d[0] * n1[1] - d[1] * n1[0] };
+                const float vl = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+                if (!(vl > 0.0f)) continue;
+                v[0] /= vl; v[1] /= vl; v[2] /= vl;
+                const float w[3] = { n1[1] * v[2] - n1[2] * v[1], n1[2] * v[0] - n1[0] * v[2], n1[0] * v[1] - n1[1] * v[0] };
+                const float alpha = v[0] * n2[0] + v[1] * n2[1] + v[2] * n2[2];
+                const float theta = std::atan2(w[0] * n2[0] + w[1] * n2[1] + w[2] * n2[2], n1[0] * n2[0] + n1[1] * n2[1] + n1[2] * n2[2]);
+                auto bin = [](float x, float lo, float hi) {
+                    const int bi = static_cast<int>((x - lo) / (hi - lo) * static_cast<float>(kFpfhBins));
+                    return static_cast<size_t>(std::clamp(bi, 0, static_cast<int>(kFpfhBins) - 1));
+                };
+                h[bin(theta, -3.14159265f, 3.14159265f)] += 1.0f;
+                h[kFpfhBins + bin(alpha, -1.0f, 1.0f)] += 1.0f;
+                h[2 * kFpfhBins + bin(a1, -1.0f, 1.0f)] += 1.0f;
+                ++used;
+            }
+            if (used) for (size_t c = 0; c < kFpfhSize; ++c) h[c] *= 100.0f / static_cast<float>(used);
+        }
+    }, 1024);
+
+    // FPFH = own SPFH + inverse-squared-distance weighted mean of the neighbours' SPFH
+    parallelFor(n, [&](size_t b, size_t e, unsigned) {
+        for (size_t i = b; i < e; ++i) {
+            const uint32_t* row = g.row(i);
+            const float* dist2 = g.rowDist2(i);
+            float* out = descriptors.data() + i * kFpfhSize;
+            float acc[kFpfhSize] = {};
+            size_t m = 0;
+            for (size_t j = 0; j < k && row[j] != NeighborGraph::kNoNeighbor; ++j, ++m) {
+                if (!(dist2[j] > 0.0f)) continue;
+                const float wgt = 1.0f / dist2[j];
+                const float* s = spfh.data() + static_cast<size_t>(row[j]) * kFpfhSize;
+                for (size_t c = 0; c < kFpfhSize; ++c) acc[c] += wgt * s[c];
+            }
+            const float* own = spfh.data() + i * kFpfhSize;
+            const float scale = m ? 1.0f / static_cast<float>(m) : 0.0f;
+            for (size_t c = 0; c < kFpfhSize; ++c) out[c] = own[c] + scale * acc[c];
+            for (size_t block = 0; block < 3; ++block) {
+                float sum = 0.0f;
+                for (size_t c = 0; c < kFpfhBins; ++c) sum += out[block * kFpfhBins + c];
+                if (sum > 0.0f) for (size_t c = 0; c < kFpfhBins; ++c) out[block * kFpfhBins + c] *= 100.0f / sum;
+            }
+        }
+    }, 1024);
+}
+
+// Align 'source' to 'target' from FPFH matches on downsampled keypoints. The transform
+// maps the source cloud frame (positions as forEachTransformedPoint reports them) into
+// the target cloud frame; different georeferenced origins are accounted for. Returns
+// false when there are too few consistent matches.
+inline bool globalRegistration(const PointCloud& source, const PointCloud& target, const RegistrationOptions& opt,
+                               RegistrationResult& result) {
+    result = RegistrationResult{};
+    if (source.size() < 3 || target.size() < 3) {
+        std::cerr << "Error: Registration needs at least 3 points in each cloud.\n";
+        return false;
+    }
+    float voxel = opt.voxelSize;
+    if (!(voxel > 0.0f)) {
+        float diag = 0.0f;
+        for (const PointCloud* c : { &source, &target }) {
+            float mn[3] = { 0, 0, 0 }, mx[3] = { 0, 0, 0 };
+            if (!c->getBounds(mn, mx)) continue;
+            diag = std::max(diag, std::sqrt((mx[0] - mn[0]) * (mx[0] - mn[0]) + (mx[1] - mn[1]) * (mx[1] - mn[1]) + (mx[2] - mn[2]) * (mx[2] - mn[2])));
+        }
+        voxel = diag > 0.0f ? diag / 100.0f : 1.0f;
+    }
+    const float maxDistance = opt.maxDistance > 0.0f ? opt.maxDistance : 1.5f * voxel;
+
+    // Both keypoint sets live in the target cloud frame
+    const Vec3d shift = source.getOrigin() - target.getOrigin();
+    PointCloud kpSource, kpTarget;
+    registration::extractKeypoints(source, voxel, shift, kpSource);
+    registration::extractKeypoints(target, voxel, Vec3d{}, kpTarget);
+    result.keypoints[0] = kpSource.size();
+    result.keypoints[1] = kpTarget.size();
+    const size_t kMax = std::max(opt.normalNeighbors, opt.featureNeighbors);
+    std::vector<float> fs, ft;
+    for (PointCloud* c : { &kpSource, &kpTarget }) {
+        c->neighbors(kMax); // one graph for normals and descriptors
+        c->estimateFeatures(opt.normalNeighbors, PointCloud::FeatureNormals);
+    }
+    computeFPFH(kpSource, opt.featureNeighbors, fs);
+    computeFPFH(kpTarget, opt.featureNeighbors, ft);
+
+    std::vector<uint32_t> forward, backward;
+    registration::nearestDescriptors(fs, ft, forward);
+    if (opt.mutualFilter) registration::nearestDescriptors(ft, fs, backward);
+    std::vector<float> cs, ct; // matched positions, xyz interleaved
+    const auto& ps = kpSource.getPoints();
+    const auto& pt = kpTarget.getPoints();
+    for (size_t i = 0; i < forward.size(); ++i) {
+        const uint32_t j = forward[i];
+        if (opt.mutualFilter && backward[j] != i) continue;
+        cs.insert(cs.end(), { ps[i].x, ps[i].y, ps[i].z });
+        ct.insert(ct.end(), { pt[j].x, pt[j].y, pt[j].z });
+    }
+    const size_t m = cs.size() / 3;
+    result.correspondences = m;
+    if (m < 3) {
+        std::cerr << "Error: Registration found only " << m << " feature correspondence(s).\n";
+        return false;
+    }
+
+    // RANSAC in fixed blocks of iterations, each with its own random stream, so the
+    // outcome does not depend on the worker count
+    const float maxD2 = maxDistance * maxDistance;
+    auto countInliers = [&](const Similarity& S) {
+        const Mat4 M = S.toMatrix().cast<float>();
+        size_t count = 0;
+        for (size_t i = 0; i < m; ++i) {
+            float x, y, z;
+            transformPoint(M, cs[3 * i], cs[3 * i + 1], cs[3 * i + 2], x, y, z);
+            const float dx = x - ct[3 * i], dy = y - ct[3 * i + 1], dz = z - ct[3 * i + 2];
+            count += (dx * dx + dy * dy + dz * dz <= maxD2);
+        }
+        return count;
+    };
+    constexpr size_t kBlock = 512;
+    const size_t blocks = (std::max<size_t>(opt.iterations, 1) + kBlock - 1) / kBlock;
+    struct Best { size_t inliers = 0; Similarity S; };
+    std::vector<Best> best(blocks);
+    const float sim = opt.edgeSimilarity;
+    parallelFor(blocks, [&](size_t b, size_t e, unsigned) {
+        for (size_t blk = b; blk < e; ++blk) {
+            uint64_t state = (static_cast<uint64_t>(opt.seed) << 32) ^ (blk * 0x9E3779B97F4A7C15ull) ^ 0xD1B54A32D192ED03ull;
+            auto next = [&state]() { state ^= state >> 12; state ^= state << 25; state ^= state >> 27; return state * 0x2545F4914F6CDD1Dull; };
+            for (size_t it = 0; it < kBlock; ++it) {
+                uint32_t idx[3];
+                for (int s = 0; s < 3; ++s) idx[s] = static_cast<uint32_t>(next() % m);
+                if (idx[0] == idx[1] || idx[1] == idx[2] || idx[0] == idx[2]) continue;
+                // matching triangles have matching edge lengths under a rigid motion
+                bool consistent = true;
+                for (int s = 0; s < 3 && consistent; ++s) {
+                    const uint32_t a = idx[s], c = idx[(s + 1) % 3];
+                    float ls = 0.0f, lt = 0.0f;
+                    for (int k = 0; k < 3; ++k) {
+                        const float ds = cs[3 * a + k] - cs[3 * c + k], dt = ct[3 * a + k] - ct[3 * c + k];
+                        ls += ds * ds; lt += dt * dt;
+                    }
+                    ls = std::sqrt(ls); lt = std::sqrt(lt);
+                    consistent = ls >= sim * lt && lt >= sim * ls && ls > maxDistance;
+                }
+                if (!consistent) continue;
+                float src[9], dst[9];
+                for (int s = 0; s < 3; ++s) for (int k = 0; k < 3; ++k) { src[3 * s + k] = cs[3 * idx[s] + k]; dst[3 * s + k] = ct[3 * idx[s] + k]; }
+                const Similarity S = registration::fitRigid(src, dst, 3);
+                const size_t count = countInliers(S);
+                if (count > best[blk].inliers) best[blk] = Best{ count, S };
+            }
+        }
+    }, 1);
+    Best top;
+    for (const auto& b : best) if (b.inliers > top.inliers) top = b;
+    if (top.inliers < 3) {
+        std::cerr << "Error: Registration found no consistent correspondence triple.\n";
+        return false;
+    }
+
+    // Refit on the inliers a few times (the inlier set can grow as the fit improves)
+    Similarity S = top.S;
+    std::vector<float> is, it;
+    for (int round = 0; round < 4; ++round) {
+        const Mat4 M = S.toMatrix().cast<float>();
+        is.clear(); it.clear();
+        for (size_t i = 0; i < m; ++i) {
+            float x, y, z;
+            transformPoint(M, cs[3 * i], cs[3 * i + 1], cs[3 * i + 2], x, y, z);
+            const float dx = x - ct[3 * i], dy = y - ct[3 * i + 1], dz = z - ct[3 * i + 2];
+            if (dx * dx + dy * dy + dz * dz > maxD2) continue;
+            is.insert(is.end(), { cs[3 * i], cs[3 * i + 1], cs[3 * i + 2] });
+            it.insert(it.end(), { ct[3 * i], ct[3 * i + 1], ct[3 * i + 2] });
+        }
+        if (is.size() < 9) break;
+        S = registration::fitRigid(is.data(), it.data(), is.size() / 3);
+    }
+    const Mat4 M = S.toMatrix().cast<float>();
+    double sq = 0.0;
+    size_t inliers = 0;
+    for (size_t i = 0; i < m; ++i) {
+        float x, y, z;
+        transformPoint(M, cs[3 * i], cs[3 * i + 1], cs[3 * i + 2], x, y, z);
+        const float dx = x - ct[3 * i], dy = y - ct[3 * i + 1], dz = z - ct[3 * i + 2];
+        const float d2 = dx * dx + dy * dy + dz * dz;
+        if (d2 <= maxD2) { sq += d2; ++inliers; }
+    }
+
+    // Fold the origin shift in: p -> R (p + shift) + t
+    const Vec3d rs = S.rotate(shift);
+    S.t = Vec3d{ S.t.x + rs.x, S.t.y + rs.y, S.t.z + rs.z };
+    result.rigid = S;
+    result.transform = S.toMatrix().cast<float>();
+    result.inliers = inliers;
+    result.fitness = static_cast<float>(inliers) / static_cast<float>(m);
+    result.rmse = inliers ? static_cast<float>(std::sqrt(sq / static_cast<double>(inliers))) : 0.0f;
+    return true;
+}
+
+} // namespace PointCloudUtil
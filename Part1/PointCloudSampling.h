@@ -0,0 +1,259 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "PointCloudNeighbors.h"
+#include "PointCloudParallel.h"
+
+namespace PointCloudUtil {
+
+namespace sampling {
+
+// splitmix64 finaliser: a cheap, well-mixed per-point priority
+inline uint64_t mix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// splitmix64 generator: one independent stream per seed
+struct Stream {
+    uint64_t state;
+    explicit Stream(uint64_t seed) : state(mix(seed)) {}
+    uint64_t next() { state += 0x9E3779B97F4A7C15ull; return mix(state); }
+    double uniform() { return static_cast<double>(next() >> 11) * 0x1.0p-53; }   // [0, 1)
+};
+
+// Walker's alias method (Vose's construction): after an O(n) build, draws index i with
+// probability weights[i] / sum in O(1), with one uniform number
+class AliasTable {
+    std::vector<double> prob;
+    std::vector<uint32_t> alias;
+
+public:
+    // False when no weight is positive
+    bool build(const double* weights, size_t n) {
+        double sum = 0.0;
+        for (size_t i = 0; i < n; ++i) sum += weights[i] > 0.0 ? weights[i] : 0.0;
+        prob.assign(n, 1.0);
+        alias.resize(n);
+        if (!(sum > 0.0) || !std::isfinite(sum)) { prob.clear(); alias.clear(); return false; }
+        std::vector<uint32_t> small, large;
+        for (size_t i = 0; i < n; ++i) {
+            prob[i] = (weights[i] > 0.0 ? weights[i] : 0.0) * static_cast<double>(n) / sum;
+            alias[i] = static_cast<uint32_t>(i);
+            (prob[i] < 1.0 ? small : large).push_back(static_cast<uint32_t>(i));
+        }
+        while (!small.empty() && !large.empty()) {
+            const uint32_t s = small.back(), l = large.back();
+            small.pop_back();
+            alias[s] = l;
+            prob[l] -= 1.0 - prob[s];
+            if (prob[l] < 1.0) { large.pop_back(); small.push_back(l); }
+        }
+        // leftovers are 1 up to rounding
+        for (uint32_t i : small) prob[i] = 1.0;
+        for (uint32_t i : large) prob[i] = 1.0;
+        return true;
+    }
+
+    size_t size() const { return prob.size(); }
+
+    // u uniform in [0, 1): its integer part picks a column, the fraction the coin
+    uint32_t draw(double u) const {
+        const double x = u * static_cast<double>(prob.size());
+        const size_t i = std::min(static_cast<size_t>(x), prob.size() - 1);
+        return x - static_cast<double>(i) < prob[i] ? static_cast<uint32_t>(i) : alias[i];
+    }
+};
+
+} // namespace sampling
+
+// Poisson-disk (blue-noise) selection: sets chosen[id] for a maximal subset of the grid's
+// points in which no two are closer than 'radius', leaving other entries untouched. The
+// grid's cell size must be at least 'radius', so conflicts only come from the 3x3x3 block
+// around a cell. Cells are processed in 27 phases by (x, y, z) mod 3: cells of one phase
+// are at least two cells apart, so their blocks never contain each other and the cells of
+// a phase run in parallel without locks. Within a cell, candidates are tried in an order
+// shuffled by 'seed'. Accepted positions are kept at the front of their cell's range in
+// scratch arrays, so a conflict check only looks at samples.
+inline void poissonDiskSelect(const NeighborGrid& grid, float radius, uint64_t seed, uint8_t* chosen) {
+    const size_t n = grid.size();
+    if (n == 0) return;
+    const float r2 = radius * radius;
+    const float* xs = grid.xData();
+    const float* ys = grid.yData();
+    const float* zs = grid.zData();
+    std::vector<float> sx(n), sy(n), sz(n);
+    std::vector<uint32_t> taken(n, 0);   // sample count, at each cell's first position
+
+    // cells grouped by phase (counting sort)
+    const size_t cells = grid.cellCount();
+    std::vector<uint32_t> phaseStart(28, 0), order(cells);
+    auto phaseOf = [&](size_t c) {
+        int64_t x, y, z;
+        NeighborGrid::unpack(grid.cellKey(c), x, y, z);
+        return static_cast<size_t>((x % 3) * 9 + (y % 3) * 3 + z % 3);
+    };
+    for (size_t c = 0; c < cells; ++c) ++phaseStart[phaseOf(c) + 1];
+    for (size_t p = 0; p < 27; ++p) phaseStart[p + 1] += phaseStart[p];
+    {
+        std::vector<uint32_t> fill(phaseStart.begin(), phaseStart.end() - 1);
+        for (size_t c = 0; c < cells; ++c) order[fill[phaseOf(c)]++] = static_cast<uint32_t>(c);
+    }
+
+    for (size_t p = 0; p < 27; ++p) {
+        const size_t pb = phaseStart[p];
+        parallelFor(phaseStart[p + 1] - pb, [&](size_t b, size_t e, unsigned) {
+            std::vector<std::pair<uint64_t, uint32_t>> candidates;
+            uint32_t block[27];
+            for (size_t k = b; k < e; ++k) {
+                int64_t cx, cy, cz;
+                NeighborGrid::unpack(grid.cellKey(order[pb + k]), cx, cy, cz);
+                uint32_t own = 0, ownEnd = 0;
+                grid.cellRange(cx, cy, cz, own, ownEnd);
+                // first positions of the occupied cells around this one
+                size_t m = 0;
+                for (int64_t dz = -1; dz <= 1; ++dz)
+                    for (int64_t dy = -1; dy <= 1; ++dy)
+                        for (int64_t dx = -1; dx <= 1; ++dx) {
+                            uint32_t cb, ce;
+                            if (grid.cellRange(cx + dx, cy + dy, cz + dz, cb, ce)) block[m++] = cb;
+                        }
+                candidates.clear();
+                for (uint32_t i = own; i < ownEnd; ++i) candidates.emplace_back(sampling::mix(grid.id(i) ^ seed), i);
+                std::sort(candidates.begin(), candidates.end());
+                for (const auto& cand : candidates) {
+                    const uint32_t i = cand.second;
+                    const float qx = xs[i], qy = ys[i], qz = zs[i];
+                    bool free = true;
+                    for (size_t c = 0; free && c < m; ++c) {
+                        for (uint32_t j = block[c], je = block[c] + taken[block[c]]; j < je; ++j) {
+                            const float ax = sx[j] - qx, ay = sy[j] - qy, az = sz[j] - qz;
+                            if (ax * ax + ay * ay + az * az < r2) { free = false; break; }
+                        }
+                    }
+                    if (!free) continue;
+                    const uint32_t slot = own + taken[own]++;
+                    sx[slot] = qx; sy[slot] = qy; sz[slot] = qz;
+                    chosen[grid.id(i)] = 1;
+                }
+            }
+        }, 64);
+    }
+}
+
+// Greedy farthest-point sampling: out[0] is point 'start' and each next point is the one
+// farthest from all points chosen before it, so every prefix of the order is a
+// well-spread subset. Returns the number written (fewer than 'count' once only
+// duplicates of chosen points remain).
+//
+// Every point keeps its squared distance to the chosen set and every cell the maximum
+// of its points. A new sample at squared distance D from the set can only lower the
+// distances of points closer than sqrt(D) to it, so only the cells overlapping that ball
+// are updated (all of them, in parallel, for the first few samples; a handful once
+// the sampling is dense). The next sample comes from a max-heap over the cell maxima,
+// in which entries superseded by a later update are skipped.
+inline size_t farthestPointSelect(const NeighborGrid& grid, size_t count, uint32_t start, uint32_t* out) {
+    const size_t n = grid.size();
+    count = std::min(count, n);
+    if (count == 0) return 0;
+    const float* xs = grid.xData();
+    const float* ys = grid.yData();
+    const float* zs = grid.zData();
+    const float cell = grid.cellSize();
+    const size_t cells = grid.cellCount();
+
+    std::vector<uint32_t> cellBegin(cells), cellEnd(cells);
+    std::vector<int64_t> cellXyz(3 * cells);
+    for (size_t c = 0; c < cells; ++c) {
+        int64_t* q = &cellXyz[3 * c];
+        NeighborGrid::unpack(grid.cellKey(c), q[0], q[1], q[2]);
+        grid.cellRange(q[0], q[1], q[2], cellBegin[c], cellEnd[c]);
+    }
+    auto cellIndexAt = [&](uint32_t begin) {
+        return static_cast<uint32_t>(std::upper_bound(cellBegin.begin(), cellBegin.end(), begin) - cellBegin.begin()) - 1;
+    };
+
+    std::vector<float> d2(n, std::numeric_limits<float>::infinity());
+    std::vector<float> cellMax(cells, std::numeric_limits<float>::infinity());
+    std::vector<uint32_t> cellArg(cellBegin);
+    std::priority_queue<std::pair<float, uint32_t>> heap;
+    std::vector<std::vector<uint32_t>> changed(workerCount());
+    std::vector<uint32_t> box;
+
+    uint32_t sel = 0;
+    while (grid.id(sel) != start) ++sel;
+    float selD2 = std::numeric_limits<float>::infinity();
+    size_t written = 0;
+    for (;;) {
+        out[written++] = grid.id(sel);
+        if (written == count) break;
+        const float q[3] = { xs[sel], ys[sel], zs[sel] };
+
+        // Lower the distances in cell c and its maximum; remember it when that changed
+        auto update = [&](uint32_t c, unsigned w) {
+            float best = -1.0f;
+            uint32_t arg = cellBegin[c];
+            for (uint32_t i = cellBegin[c]; i < cellEnd[c]; ++i) {
+                const float ax = xs[i] - q[0], ay = ys[i] - q[1], az = zs[i] - q[2];
+                const float d = std::min(d2[i], ax * ax + ay * ay + az * az);
+                d2[i] = d;
+                if (d > best) { best = d; arg = i; }
+            }
+            if (best != cellMax[c]) {
+                cellMax[c] = best;
+                cellArg[c] = arg;
+                changed[w].push_back(c);
+            }
+        };
+        int64_t qc[3];
+        grid.cellOf(q, qc);
+        const double reach = std::isinf(selD2) ? std::numeric_limits<double>::infinity() : std::sqrt(static_cast<double>(selD2)) / cell;
+        const double side = 2.0 * std::ceil(reach) + 1.0;
+        if (side * side * side >= static_cast<double>(cells)) {
+            parallelFor(cells, [&](size_t b, size_t e, unsigned w) {
+                for (size_t c = b; c < e; ++c) {
+                    const int64_t* p = &cellXyz[3 * c];
+                    // cells wholly outside the ball cannot change
+                    if (std::max({ std::llabs(p[0] - qc[0]), std::llabs(p[1] - qc[1]), std::llabs(p[2] - qc[2]) }) > reach + 1.0) continue;
+                    update(static_cast<uint32_t>(c), w);
+                }
+            }, 256);
+        } else {
+            const int64_t r = static_cast<int64_t>(std::ceil(reach));
+            box.clear();
+            for (int64_t z = qc[2] - r; z <= qc[2] + r; ++z)
+                for (int64_t y = qc[1] - r; y <= qc[1] + r; ++y)
+                    for (int64_t x = qc[0] - r; x <= qc[0] + r; ++x) {
+                        uint32_t cb, ce;
+                        if (grid.cellRange(x, y, z, cb, ce)) box.push_back(cellIndexAt(cb));
+                    }
+            parallelFor(box.size(), [&](size_t b, size_t e, unsigned w) {
+                for (size_t k = b; k < e; ++k) update(box[k], w);
+            }, 256);
+        }
+        for (auto& list : changed) {
+            for (uint32_t c : list) heap.emplace(cellMax[c], c);
+            list.clear();
+        }
+
+        // farthest remaining point; stale heap entries no longer match their cell
+        while (!heap.empty() && heap.top().first != cellMax[heap.top().second]) heap.pop();
+        if (heap.empty() || !(heap.top().first > 0.0f)) break;
+        const uint32_t c = heap.top().second;
+        sel = cellArg[c];
+        selD2 = cellMax[c];
+    }
+    return written;
+}
+
+} // namespace PointCloudUtil
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "PointCloudUtil.h"
+
+namespace PointCloudUtil {
+
+struct Aabb {
+    float min[3] = { 0.f, 0.f, 0.f };
+    float max[3] = { 0.f, 0.f, 0.f };
+    bool valid = false;
+
+    void expand(const Aabb& o) {
+        if (!o.valid) return;
+        if (!valid) { *this = o; return; }
+        for (int k = 0; k < 3; ++k) { min[k] = std::min(min[k], o.min[k]); max[k] = std::max(max[k], o.max[k]); }
+    }
+    float center(int axis) const { return 0.5f * (min[axis] + max[axis]); }
+
+    // Box enclosing this box transformed by M (8 corners)
+    Aabb transformed(const Mat4& M) const {
+        Aabb r;
+        if (!valid) return r;
+        for (int c = 0; c < 8; ++c) {
+            float ox, oy, oz;
+            transformPoint(M, (c & 1) ? max[0] : min[0], (c & 2) ? max[1] : min[1], (c & 4) ? max[2] : min[2], ox, oy, oz);
+            Aabb p;
+            p.min[0] = p.max[0] = ox; p.min[1] = p.max[1] = oy; p.min[2] = p.max[2] = oz; p.valid = true;
+            r.expand(p);
+        }
+        return r;
+    }
+};
+
+// Six clip planes (a,b,c,d with ax+by+cz+d >= 0 inside) from a column-major
+// clip-from-world matrix, as used by OpenGL (Gribb/Hartmann extraction)
+struct Frustum {
+    float planes[6][4];
+
+    static Frustum fromMatrix(const Mat4& clip) {
+        Frustum f;
+        const auto& m = clip.m;
+        auto row = [&](int r, int c) { return m[r + 4 * c]; };
+        for (int i = 0; i < 3; ++i) {
+            for (int s = 0; s < 2; ++s) {
+                const float sign = s ? -1.f : 1.f;
+                float* p = f.planes[2 * i + s];
+                for (int c = 0; c < 4; ++c) p[c] = row(3, c) + sign * row(i, c);
+            }
+        }
+        return f;
+    }
+
+    // False only when the box is entirely outside one plane
+    bool intersects(const Aabb& b) const {
+        if (!b.valid) return false;
+        for (const auto& p : planes) {
+            // corner farthest along the plane normal
+            const float x = p[0] >= 0.f ? b.max[0] : b.min[0];
+            const float y = p[1] >= 0.f ? b.max[1] : b.min[1];
+            const float z = p[2] >= 0.f ? b.max[2] : b.min[2];
+            if (p[0] * x + p[1] * y + p[2] * z + p[3] < 0.f) return false;
+        }
+        return true;
+    }
+};
+
+// A set of point clouds placed in one world. Each object has its own model matrix that
+// is never baked into the points (the renderer applies it), cached world bounds derived
+// from the cloud's cached stats, and a BVH over object bounds for frustum culling.
+// Objects may share one PointCloud (instances of the same tile keep one copy of the
+// point attributes). Georeferenced clouds are placed relative to the scene origin (the
+// origin of the first non-empty cloud), so tiles of one survey line up while all float
+// math stays near zero.
+class Scene {
+public:
+    struct Object {
+        std::shared_ptr<PointCloud> cloud;
+        Mat4 model = Mat4::identity();
+        std::string name;
+        bool visible = true;
+
+    private:
+        friend class Scene;
+        mutable Aabb worldBounds;
+        mutable Mat4 world = Mat4::identity();          // origin shift, then model
+        mutable uint64_t boundsVersion = ~uint64_t(0); // cloud version the bounds were built from
+        mutable bool modelChanged = true;
+    };
+
+private:
+    struct BvhNode {
+        Aabb box;
+        int left = -1, right = -1;   // children (inner nodes)
+        int first = 0, count = 0;    // range in 'order' (leaves)
+    };
+
+    std::vector<Object> objects;
+    std::vector<BvhNode> nodes;
+    std::vector<int> order;          // object indices, grouped by leaf
+    bool bvhStale = true;
+    mutable Vec3d origin;
+    mutable bool originSet = false;
+
+    static constexpr int kLeafSize = 4;
+
+    bool refreshBounds(const Object& o) const {
+        const uint64_t v = o.cloud ? o.cloud->getVersion() : 0;
+        if (!o.modelChanged && v == o.boundsVersion) return false;
+        Aabb local;
+        if (o.cloud) local.valid = o.cloud->getBounds(local.min, local.max);
+        if (local.valid && !originSet) { origin = o.cloud->getOrigin(); originSet = true; }
+        const Vec3d shift = o.cloud ? o.cloud->getOrigin() - origin : Vec3d{};
+        o.world = Mat4::translation(static_cast<float>(shift.x), static_cast<float>(shift.y), static_cast<float>(shift.z)) * o.model;
+        o.worldBounds = local.transformed(o.world);
+        o.boundsVersion = v;
+        o.modelChanged = false;
+        return true;
+    }
+
+    int build(int first, int count) {
+        BvhNode node;
+        for (int i = first; i < first + count; ++i) node.box.expand(objects[order[i]].worldBounds);
+        const int idx = static_cast<int>(nodes.size());
+        nodes.push_back(node);
+        if (count <= kLeafSize) {
+            nodes[idx].first = first;
+            nodes[idx].count = count;
+            return idx;
+        }
+        // median split of object centers along the widest axis
+        Aabb centers;
+        for (int i = first; i < first + count; ++i) {
+            const Aabb& b = objects[order[i]].worldBounds;
+            Aabb c;
+            for (int k = 0; k < 3; ++k) c.min[k] = c.max[k] = b.valid ? b.center(k) : 0.f;
+            c.valid = true;
+            centers.expand(c);
+        }
+        int axis = 0;
+        for (int k = 1; k < 3; ++k) {
+            if (centers.max[k] - centers.min[k] > centers.max[axis] - centers.min[axis]) axis = k;
+        }
+        const int mid = first + count / 2;
+        std::nth_element(order.begin() + first, order.begin() + mid, order.begin() + first + count, [&](int a, int b) {
+            return objects[a].worldBounds.center(axis) < objects[b].worldBounds.center(axis);
+        });
+        const int l = build(first, mid - first);
+        const int r = build(mid, first + count - mid);
+        nodes[idx].left = l;
+        nodes[idx].right = r;
+        return idx;
+    }
+
+    // Children are always stored after their parent, so a reverse sweep refits bottom-up
+    void refit() {
+        for (int i = static_cast<int>(nodes.size()) - 1; i >= 0; --i) {
+            BvhNode& n = nodes[i];
+            n.box = Aabb();
+            if (n.left < 0) {
+                for (int k = n.first; k < n.first + n.count; ++k) n.box.expand(objects[order[k]].worldBounds);
+            } else {
+                n.box.expand(nodes[n.left].box);
+                n.box.expand(nodes[n.right].box);
+            }
+        }
+    }
+
+    // Bring cached bounds and the BVH up to date: rebuild after adds, refit after moves/edits
+    void update() {
+        bool moved = false;
+        for (const auto& o : objects) moved = refreshBounds(o) || moved;
+        if (bvhStale) {
+            nodes.clear();
+            order.resize(objects.size());
+            for (size_t i = 0; i < objects.size(); ++i) order[i] = static_cast<int>(i);
+            if (!objects.empty()) build(0, static_cast<int>(objects.size()));
+            bvhStale = false;
+        } else if (moved) {
+            refit();
+        }
+    }
+
+public:
+    size_t add(std::shared_ptr<PointCloud> cloud, const Mat4& model = Mat4::identity(), const std::string& name = "") {
+        Object o;
+        o.cloud = std::move(cloud);
+        o.model = model;
+        o.name = name;
+        objects.push_back(std::move(o));
+        bvhStale = true;
+        return objects.size() - 1;
+    }
+
+    // Another placement of an existing object's cloud (no point copy)
+    size_t addInstance(size_t of, const Mat4& model) {
+        return add(objects[of].cloud, model, objects[of].name);
+    }
+
+    size_t size() const { return objects.size(); }
+
+    // Double-precision position of the scene's coordinate zero
+    const Vec3d& getOrigin() const { return origin; }
+
+    // Matrix to render object i's cloud-frame points with (origin shift, then model)
+    const Mat4& worldMatrix(size_t i) const { refreshBounds(objects[i]); return objects[i].world; }
+    const Object& get(size_t i) const { return objects[i]; }
+    PointCloud& cloud(size_t i) { return *objects[i].cloud; }
+
+    void setModel(size_t i, const Mat4& model) { objects[i].model = model; objects[i].modelChanged = true; }
+
+    // Compose onto the object's model (O(1), points untouched)
+    void translate(size_t i, float tx, float ty, float tz) { setModel(i, objects[i].model * Mat4::translation(tx, ty, tz)); }
+
+    void rotateAroundPivot(size_t i, float angleDeg, char axis, float px, float py, float pz) {
+        const float radians = angleDeg * static_cast<float>(M_PI) / 180.0f;
+        Mat4 R;
+        switch (axis) {
+            case 'x': R = Mat4::rotationX(radians); break;
+            case 'y': R = Mat4::rotationY(radians); break;
+            case 'z': R = Mat4::rotationZ(radians); break;
+            default: return;
+        }
+        setModel(i, objects[i].model * Mat4::translation(-px, -py, -pz) * R * Mat4::translation(px, py, pz));
+    }
+
+    void setVisible(size_t i, bool v) { objects[i].visible = v; }
+
+    const Aabb& worldBounds(size_t i) {
+        refreshBounds(objects[i]);
+        return objects[i].worldBounds;
+    }
+
+    Aabb bounds() {
+        update();
+        return nodes.empty() ? Aabb() : nodes[0].box;
+    }
+
+    // Calls f(index, object) for every visible object whose bounds intersect the frustum.
+    // Whole subtrees outside the frustum are skipped.
+    template <typename F>
+    size_t forEachVisible(const Frustum& frustum, F f) {
+        update();
+        if (nodes.empty()) return 0;
+        size_t drawn = 0;
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const BvhNode& n = nodes[stack[--top]];
+            if (!frustum.intersects(n.box)) continue;
+            if (n.left < 0) {
+                for (int k = n.first; k < n.first + n.count; ++k) {
+                    const Object& o = objects[order[k]];
+                    if (o.visible && frustum.intersects(o.worldBounds)) { f(static_cast<size_t>(order[k]), o); ++drawn; }
+                }
+            } else {
+                stack[top++] = n.left;
+                stack[top++] = n.right;
+            }
+        }
+        return drawn;
+    }
+};
+
+} // namespace PointCloudUtil
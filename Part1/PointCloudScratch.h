@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace PointCloudUtil {
+
+// Pool of reusable raw blocks for transient per-operation work (sort keys, index lists,
+// temporary points...). Operations borrow a typed buffer, use it, and the lease returns
+// the block to the pool on destruction, so repeated filters/downsamples stop hitting the
+// allocator. Blocks are never shrunk until trim().
+//
+// Not thread-safe: borrow from the owning thread, then hand the raw pointers to workers.
+// Copying a pool yields an empty pool (scratch memory is not cloud state).
+class ScratchPool {
+private:
+    struct Block {
+        std::unique_ptr<unsigned char[]> data;
+        size_t bytes = 0;
+        bool inUse = false;
+    };
+    std::vector<Block> blocks;
+
+    size_t acquire(size_t bytes) {
+        // Smallest free block that fits; otherwise grow the largest free one or add a new block
+        size_t best = blocks.size(), largest = blocks.size();
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            if (blocks[i].inUse) continue;
+            if (blocks[i].bytes >= bytes && (best == blocks.size() || blocks[i].bytes < blocks[best].bytes)) best = i;
+            if (largest == blocks.size() || blocks[i].bytes > blocks[largest].bytes) largest = i;
+        }
+        if (best == blocks.size()) {
+            if (largest == blocks.size()) { blocks.emplace_back(); largest = blocks.size() - 1; }
+            // 64-byte aligned payload; over-allocate by a cache line
+            blocks[largest].data.reset(new unsigned char[bytes + 64]);
+            blocks[largest].bytes = bytes;
+            best = largest;
+        }
+        blocks[best].inUse = true;
+        return best;
+    }
+
+public:
+    template <typename T>
+    class Lease {
+        static_assert(std::is_trivially_copyable<T>::value, "scratch buffers hold trivially copyable types");
+        ScratchPool* pool = nullptr;
+        size_t block = 0;
+        T* ptr = nullptr;
+        size_t count = 0;
+        friend class ScratchPool;
+
+    public:
+        Lease() = default;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        Lease(Lease&& o) noexcept : pool(o.pool), block(o.block), ptr(o.ptr), count(o.count) { o.pool = nullptr; }
+        Lease& operator=(Lease&& o) noexcept {
+            if (this != &o) { reset(); pool = o.pool; block = o.block; ptr = o.ptr; count = o.count; o.pool = nullptr; }
+            return *this;
+        }
+        ~Lease() { reset(); }
+
+        void reset() {
+            if (pool) pool->blocks[block].inUse = false;
+            pool = nullptr; ptr = nullptr; count = 0;
+        }
+
+        T* data() const { return ptr; }
+        size_t size() const { return count; }
+        T* begin() const { return ptr; }
+        T* end() const { return ptr + count; }
+        T& operator[](size_t i) const { return ptr[i]; }
+    };
+
+    ScratchPool() = default;
+    ScratchPool(const ScratchPool&) {}
+    ScratchPool& operator=(const ScratchPool&) { return *this; }
+    ScratchPool(ScratchPool&&) = default;
+    ScratchPool& operator=(ScratchPool&&) = default;
+
+    // Borrow an uninitialised buffer of 'count' elements
+    template <typename T>
+    Lease<T> borrow(size_t count) {
+        Lease<T> l;
+        l.block = acquire(count * sizeof(T));
+        unsigned char* raw = blocks[l.block].data.get();
+        const uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + 63) & ~static_cast<uintptr_t>(63);
+        l.pool = this;
+        l.ptr = reinterpret_cast<T*>(aligned);
+        l.count = count;
+        return l;
+    }
+
+    // Free every block not currently borrowed
+    void trim() {
+        for (auto& b : blocks) if (!b.inUse) { b.data.reset(); b.bytes = 0; }
+    }
+
+    size_t bytesReserved() const {
+        size_t total = 0;
+        for (const auto& b : blocks) total += b.bytes;
+        return total;
+    }
+};
+
+} // namespace PointCloudUtil
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace PointCloudUtil {
+
+// KLL quantile sketch (Karnin, Lang, Liberty 2016) over float values. Level h holds
+// items of weight 2^h; when the sketch is full, the lowest level over its capacity is
+// sorted and every other item (random phase) is promoted one level up. Once there are
+// more than kWindow levels, the bottom ones are replaced by KLL's sampler: one random
+// value out of each block of 2^s enters level s directly, and addRange() only reads the
+// values it keeps. Memory is O(k log(n/k)) and the rank error about 2/k of n.
+// Sketches built over disjoint parts of the data merge into one (per-worker sketches of
+// a parallel pass).
+class QuantileSketch {
+private:
+    std::vector<std::vector<float>> levels;
+    std::vector<size_t> caps;   // capacity of each level
+    size_t k = 200;
+    size_t stored = 0;          // items across all levels
+    size_t maxStored = 0;       // sum of level capacities
+    uint64_t count = 0;         // values added
+    uint32_t rng = 0x9E3779B9u; // deterministic phase choice (xorshift32)
+    unsigned shift = 0;         // sampler level: values enter at level 'shift'
+    uint64_t skip = 0;          // values to pass over before the next kept one
+    uint64_t pick = 0;          // offset of the last kept value within its block
+
+    static constexpr size_t kWindow = 6;
+
+    uint32_t random() { rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5; return rng; }
+
+    void grow() {
+        // top level holds k items, each level below 2/3 of the one above (at least 2)
+        levels.emplace_back();
+        caps.resize(levels.size());
+        maxStored = 0;
+        double c = static_cast<double>(k);
+        for (size_t h = levels.size(); h-- > 0; c *= 2.0 / 3.0) {
+            caps[h] = std::max<size_t>(2, static_cast<size_t>(std::ceil(c)));
+            maxStored += caps[h];
+        }
+    }
+
+    void compress() {
+        for (size_t h = 0; h < levels.size(); ++h) {
+            if (levels[h].size() < caps[h]) continue;
+            if (h + 1 == levels.size()) grow();
+            std::vector<float>& from = levels[h];
+            std::sort(from.begin(), from.end());
+            const unsigned phase = random() & 1;
+            // an odd leftover stays at this level
+            const size_t pairs = from.size() / 2;
+            const size_t first = from.size() & 1;
+            std::vector<float>& to = levels[h + 1];
+            for (size_t i = 0; i < pairs; ++i) to.push_back(from[first + 2 * i + phase]);
+            from.resize(first);
+            stored -= pairs;
+            if (levels.size() > shift + kWindow) ++shift;
+            return;
+        }
+    }
+
+    // Store a value the sampler kept and schedule the next one: the rest of this
+    // block, then a random offset into the next block of 2^shift
+    void insert(float v) {
+        while (levels.size() <= shift) grow();
+        levels[shift].push_back(v);
+        if (++stored >= maxStored) compress();
+        const uint64_t block = uint64_t(1) << shift;
+        const uint64_t next = random() & (block - 1);
+        skip = (block - 1 - std::min(pick, block - 1)) + next;
+        pick = next;
+    }
+
+public:
+    explicit QuantileSketch(size_t capacity = 200) : k(std::max<size_t>(capacity, 8)) {}
+
+    void clear() { levels.clear(); caps.clear(); stored = maxStored = 0; count = 0; shift = 0; skip = pick = 0; }
+    bool empty() const { return count == 0; }
+    uint64_t size() const { return count; }
+
+    // Hint for an empty sketch that about n values follow: the sampler starts at the
+    // level it would reach anyway, skipping the costly early compactions
+    void expect(uint64_t n) {
+        if (count) return;
+        shift = 0;
+        while ((n >> (shift + 1)) >= (uint64_t(k) << kWindow)) ++shift;
+        pick = random() & ((uint64_t(1) << shift) - 1);
+        skip = pick;
+    }
+
+    void add(float v) { addRange(1, [v](uint64_t) { return v; }); }
+
+    // Add n values given by valueAt(i), i in [0, n). Only the values the sampler keeps
+    // are read, so a pass over a large range costs little beyond those.
+    template <typename F>
+    void addRange(uint64_t n, F valueAt) {
+        count += n;
+        uint64_t i = 0;
+        while (n - i > skip) {
+            i += skip;
+            insert(valueAt(i));
+            ++i;
+        }
+        skip -= n - i;
+    }
+
+    void merge(const QuantileSketch& o) {
+        while (levels.size() < o.levels.size()) grow();
+        for (size_t h = 0; h < o.levels.size(); ++h) levels[h].insert(levels[h].end(), o.levels[h].begin(), o.levels[h].end());
+        stored += o.stored;
+        count += o.count;
+        shift = std::max(shift, o.shift);
+        while (stored >= maxStored) {
+            const size_t before = stored;
+            compress();
+            if (stored == before) break;
+        }
+    }
+
+    // Value at rank q in [0, 1] (0 for an empty sketch)
+    float quantile(double q) const {
+        float v = 0.0f;
+        quantiles(&q, &v, 1);
+        return v;
+    }
+
+    // Several quantiles from one sort of the retained items; qs ascending
+    void quantiles(const double* qs, float* out, size_t n) const {
+        std::vector<std::pair<float, uint64_t>> items;
+        items.reserve(stored);
+        uint64_t total = 0;
+        for (size_t h = 0; h < levels.size(); ++h) {
+            for (float v : levels[h]) items.emplace_back(v, uint64_t(1) << h);
+            total += levels[h].size() << h;
+        }
+        std::sort(items.begin(), items.end());
+        uint64_t seen = 0;
+        size_t j = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (items.empty()) { out[i] = 0.0f; continue; }
+            const double target = std::clamp(qs[i], 0.0, 1.0) * static_cast<double>(total);
+            while (j + 1 < items.size() && static_cast<double>(seen + items[j].second) <= target) seen += items[j++].second;
+            out[i] = items[j].first;
+        }
+    }
+};
+
+} // namespace PointCloudUtil
@@ -0,0 +1,359 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "PointCloudUtil.h"
+
+namespace PointCloudUtil {
+
+// Importers for plain-text point files (.xyz, .txt, .pts, .csv): one point per line,
+// columns separated by whitespace, ',' or ';'. The file is read in large blocks; each
+// block is split at line boundaries into one piece per worker, newlines are counted with
+// a vector scan to size the output, and the pieces are parsed in parallel.
+namespace textscan {
+
+// First '\n' in [p, end), or end. Compares 32 bytes per step (AVX2, or two SSE2 loads).
+inline const char* findNewline(const char* p, const char* end) {
+#if defined(__AVX2__)
+    const __m256i nl = _mm256_set1_epi8('\n');
+    for (; p + 32 <= end; p += 32) {
+        const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), nl)));
+        if (mask) return p + __builtin_ctz(mask);
+    }
+#elif defined(__SSE2__)
+    const __m128i nl = _mm_set1_epi8('\n');
+    for (; p + 32 <= end; p += 32) {
+        const unsigned lo = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), nl)));
+        const unsigned hi = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16)), nl)));
+        const unsigned mask = lo | (hi << 16);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+#endif
+    const void* hit = std::memchr(p, '\n', static_cast<size_t>(end - p));
+    return hit ? static_cast<const char*>(hit) : end;
+}
+
+// Number of '\n' in [p, end)
+inline size_t countNewlines(const char* p, const char* end) {
+    size_t n = 0;
+#if defined(__AVX2__)
+    const __m256i nl = _mm256_set1_epi8('\n');
+    for (; p + 32 <= end; p += 32) {
+        n += static_cast<size_t>(__builtin_popcount(static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), nl)))));
+    }
+#elif defined(__SSE2__)
+    const __m128i nl = _mm_set1_epi8('\n');
+    for (; p + 32 <= end; p += 32) {
+        const unsigned lo = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), nl)));
+        const unsigned hi = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16)), nl)));
+        n += static_cast<size_t>(__builtin_popcount(lo | (hi << 16)));
+    }
+#endif
+    for (; p < end; ++p) n += (*p == '\n');
+    return n;
+}
+
+} // namespace textscan
+
+// Column layout of a text file. Each entry names what a column holds: x y z, red green
+// blue (or r g b), nx ny nz, "_" to skip it, or any other name for a double attribute
+// column (e.g. "intensity").
+struct TextFormat {
+    char delimiter = ' ';               // ' ' = runs of spaces/tabs; otherwise ',' ';' '\t'...
+    std::vector<std::string> columns;
+
+    // "x y z intensity r g b" or "x,y,z,_,intensity"
+    static TextFormat fromSpec(const std::string& spec, char delimiter = ' ') {
+        TextFormat f;
+        f.delimiter = delimiter;
+        std::string s = spec;
+        std::replace(s.begin(), s.end(), ',', ' ');
+        std::istringstream words(s);
+        for (std::string w; words >> w;) f.columns.push_back(w);
+        return f;
+    }
+};
+
+namespace textscan {
+
+enum Role : int { X, Y, Z, Red, Green, Blue, NX, NY, NZ, Skip, Attribute };
+
+inline int roleOf(std::string name) {
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (name == "x") return X;
+    if (name == "y") return Y;
+    if (name == "z") return Z;
+    if (name == "r" || name == "red") return Red;
+    if (name == "g" || name == "green") return Green;
+    if (name == "b" || name == "blue") return Blue;
+    if (name == "nx" || name == "normal_x") return NX;
+    if (name == "ny" || name == "normal_y") return NY;
+    if (name == "nz" || name == "normal_z") return NZ;
+    if (name.empty() || name == "_" || name == "skip") return Skip;
+    return Attribute;
+}
+
+inline bool isSeparator(char c, char delimiter) {
+    return c == ' ' || c == '\t' || c == '\r' || c == delimiter;
+}
+
+// Parse one line into fields[0..count). Returns false for blank lines, comments, header
+// rows and lines with too few numeric columns, which are skipped.
+inline bool parseLine(const char* p, const char* end, char delimiter, const unsigned char* needed, int count, double* fields) {
+    for (int col = 0; col < count; ++col) {
+        // one explicit delimiter between fields; whitespace around fields is ignored
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+        if (col > 0 && delimiter != ' ') {
+            if (p >= end || *p != delimiter) return false;
+            ++p;
+            while (p < end && (*p == ' ' || *p == '\t')) ++p;
+        }
+        if (p >= end) return false;
+        if (!needed[col]) {
+            while (p < end && !isSeparator(*p, delimiter)) ++p;
+            continue;
+        }
+        if (p < end && *p == '"') ++p;
+        if (p < end && *p == '+') ++p;
+        const auto r = std::from_chars(p, end, fields[col]);
+        if (r.ec != std::errc()) return false;
+        p = r.ptr;
+        if (p < end && *p == '"') ++p;
+    }
+    return true;
+}
+
+} // namespace textscan
+
+// Guess the layout from the first lines: the delimiter, a header row of column names if
+// there is one, otherwise a column order by count (and .pts convention: x y z intensity
+// r g b). Returns false if no line with at least three numbers is found.
+inline bool detectTextFormat(const std::string& filename, TextFormat& format) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to open file " << filename << std::endl;
+        return false;
+    }
+    std::vector<std::string> header;
+    std::string line;
+    for (int lineNo = 0; lineNo < 1000 && std::getline(file, line); ++lineNo) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#' || line.compare(0, 2, "//") == 0) continue;
+        const char delimiter = line.find(',') != std::string::npos ? ',' : line.find(';') != std::string::npos ? ';' : ' ';
+        std::string s = line;
+        if (delimiter != ' ') std::replace(s.begin(), s.end(), delimiter, ' ');
+        std::vector<std::string> tokens;
+        std::istringstream words(s);
+        for (std::string w; words >> w;) tokens.push_back(w);
+
+        bool numeric = true;
+        for (auto& t : tokens) {
+            t.erase(std::remove(t.begin(), t.end(), '"'), t.end());
+            double v;
+            const char* b = t.c_str() + (!t.empty() && t[0] == '+');
+            const auto r = std::from_chars(b, t.c_str() + t.size(), v);
+            if (r.ec != std::errc() || r.ptr != t.c_str() + t.size()) numeric = false;
+        }
+        if (!numeric) { header = tokens; continue; }
+        if (tokens.size() < 3) continue; // e.g. the point count line of .pts
+
+        format.delimiter = delimiter;
+        if (header.size() == tokens.size()) {
+            format.columns = header;
+            return true;
+        }
+        std::string ext = filename.substr(filename.find_last_of('.') + 1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        const size_t n = tokens.size();
+        const char* spec =
+            n >= 9 ? "x y z r g b nx ny nz" :
+            (n >= 7 || (ext == "pts" && n >= 4)) ? "x y z intensity r g b" :
+            n >= 6 ? "x y z r g b" :
+            n >= 4 ? "x y z intensity" : "x y z";
+        format.columns = TextFormat::fromSpec(spec).columns;
+        if (format.columns.size() > n) format.columns.resize(n);
+        return true;
+    }
+    std::cerr << "Error: No numeric x y z rows found in " << filename << std::endl;
+    return false;
+}
+
+// Load a text point file with an explicit column layout (replacing the cloud's contents)
+inline bool loadFromText(PointCloud& cloud, const std::string& filename, const TextFormat& format, bool keepSnapshot = true) {
+    using namespace textscan;
+    const int count = static_cast<int>(format.columns.size());
+    std::vector<int> roles(count);
+    std::vector<unsigned char> needed(count, 0);
+    bool hasRole[Skip] = {};
+    AttributeSet block;
+    for (int c = 0; c < count; ++c) {
+        roles[c] = roleOf(format.columns[c]);
+        needed[c] = roles[c] != Skip;
+        if (roles[c] < Skip) hasRole[roles[c]] = true;
+        if (roles[c] == Attribute) block.add(format.columns[c], AttributeType::F64);
+    }
+    if (!hasRole[X] || !hasRole[Y] || !hasRole[Z]) {
+        std::cerr << "Error: Column layout has no x/y/z for " << filename << std::endl;
+        return false;
+    }
+    const bool normals = hasRole[NX] && hasRole[NY] && hasRole[NZ];
+    int fieldsUsed = 0;
+    for (int c = 0; c < count; ++c) if (needed[c]) fieldsUsed = c + 1;
+    std::vector<AttributeChannel*> attrColumn(count, nullptr);
+
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to open file " << filename << std::endl;
+        return false;
+    }
+    cloud.clear();
+
+    const size_t blockBytes = size_t(32) << 20;
+    std::vector<char> buf(blockBytes);
+    size_t carry = 0;
+    const unsigned pieces = workerCount();
+    std::vector<const char*> pieceBegin(pieces + 1);
+    std::vector<size_t> pieceRows(pieces), pieceFirst(pieces + 1), pieceGot(pieces);
+    // Colours are kept x255 until the file shows whether they are 0-255 integers or
+    // [0, 1] fractions (all values <= 1, some not whole)
+    std::vector<double> pieceColourMax(pieces, 0.0);
+    std::vector<uint8_t> pieceFraction(pieces, 0);
+
+    for (bool eof = false; !eof;) {
+        file.read(buf.data() + carry, static_cast<std::streamsize>(buf.size() - carry));
+        const size_t got = static_cast<size_t>(file.gcount());
+        eof = got < buf.size() - carry;
+        const char* begin = buf.data();
+        const char* end = begin + carry + got;
+        const char* dataEnd = end;
+        if (!eof) {
+            // parse whole lines only; the tail is carried into the next block
+            const char* last = end;
+            while (last > begin && last[-1] != '\n') --last;
+            if (last == begin) {
+                std::cerr << "Error: Line longer than " << (blockBytes >> 20) << " MiB in " << filename << std::endl;
+                return false;
+            }
+            dataEnd = last;
+        }
+
+        // Split at line starts, size each piece by its newline count
+        pieceBegin[0] = begin;
+        pieceBegin[pieces] = dataEnd;
+        for (unsigned k = 1; k < pieces; ++k) {
+            const char* p = begin + (dataEnd - begin) * k / pieces;
+            p = std::max(p, pieceBegin[k - 1]);
+            const char* nl = findNewline(p, dataEnd);
+            pieceBegin[k] = nl < dataEnd ? nl + 1 : dataEnd;
+        }
+        parallelFor(pieces, [&](size_t b, size_t e, unsigned) {
+            for (size_t k = b; k < e; ++k) pieceRows[k] = countNewlines(pieceBegin[k], pieceBegin[k + 1]) + 1;
+        }, 1);
+        pieceFirst[0] = 0;
+        for (unsigned k = 0; k < pieces; ++k) pieceFirst[k + 1] = pieceFirst[k] + pieceRows[k];
+        const size_t rows = pieceFirst[pieces];
+
+        auto pts = cloud.scratch().borrow<Point>(rows);
+        auto absolute = cloud.scratch().borrow<Vec3d>(rows);
+        block.resize(rows);
+        for (int c = 0; c < count; ++c) if (roles[c] == Attribute) attrColumn[c] = block.find(format.columns[c]);
+
+        parallelFor(pieces, [&](size_t b, size_t e, unsigned) {
+            std::vector<double> fields(count);
+            for (size_t k = b; k < e; ++k) {
+                size_t row = pieceFirst[k];
+                auto colour = [&](double v) {
+                    pieceColourMax[k] = std::max(pieceColourMax[k], v);
+                    pieceFraction[k] |= v != std::floor(v);
+                    return static_cast<int>(std::lround(std::clamp(v, 0.0, 65535.0) * 255.0));
+                };
+                const char* pieceEnd = pieceBegin[k + 1];
+                for (const char* p = pieceBegin[k]; p < pieceEnd;) {
+                    const char* nl = findNewline(p, pieceEnd);
+                    if (parseLine(p, nl, format.delimiter, needed.data(), fieldsUsed, fields.data())) {
+                        Point q = {};
+                        double xyz[3] = { 0.0, 0.0, 0.0 };
+                        for (int c = 0; c < fieldsUsed; ++c) {
+                            const double v = fields[c];
+                            switch (roles[c]) {
+                                case X: case Y: case Z: xyz[roles[c]] = v; break;
+                                case Red:   q.r = colour(v); break;
+                                case Green: q.g = colour(v); break;
+                                case Blue:  q.b = colour(v); break;
+                                case NX: q.nx = static_cast<float>(v); break;
+                                case NY: q.ny = static_cast<float>(v); break;
+                                case NZ: q.nz = static_cast<float>(v); break;
+                                case Attribute: attrColumn[c]->data<double>()[row] = v; break;
+                                default: break;
+                            }
+                        }
+                        if (!hasRole[Red]) q.r = q.g = q.b = 255;
+                        absolute[row] = Vec3d{ xyz[0], xyz[1], xyz[2] };
+                        pts[row++] = q;
+                    }
+                    if (nl == pieceEnd) break;
+                    p = nl + 1;
+                }
+                pieceGot[k] = row - pieceFirst[k];
+            }
+        }, 1);
+
+        // Close the gaps left by skipped lines, then append the block
+        size_t total = 0;
+        for (unsigned k = 0; k < pieces; ++k) {
+            const size_t from = pieceFirst[k], n = pieceGot[k];
+            if (from != total) {
+                std::memmove(static_cast<void*>(pts.data() + total), pts.data() + from, n * sizeof(Point));
+                std::memmove(static_cast<void*>(absolute.data() + total), absolute.data() + from, n * sizeof(Vec3d));
+                block.moveRows(from, total, n);
+            }
+            total += n;
+        }
+        cloud.appendGeoreferenced(pts.data(), absolute.data(), total, normals, &block);
+
+        carry = static_cast<size_t>(end - dataEnd);
+        std::memmove(buf.data(), dataEnd, carry);
+    }
+
+    // Whole-number colours (the usual 0-255) go back to their values, exactly
+    const double colourMax = *std::max_element(pieceColourMax.begin(), pieceColourMax.end());
+    const bool fractional = std::find(pieceFraction.begin(), pieceFraction.end(), 1) != pieceFraction.end();
+    if (hasRole[Red] && (colourMax > 1.0 || !fractional)) {
+        cloud.applyChunkKernel([](const Vec3d&) {
+            return [](Point& p) { p.r /= 255; p.g /= 255; p.b /= 255; };
+        });
+    }
+    if (cloud.size() == 0) {
+        std::cerr << "Error: No points loaded from file." << std::endl;
+        return false;
+    }
+    if (keepSnapshot) cloud.commitSnapshot();
+    return true;
+}
+
+// Load with the layout guessed by detectTextFormat()
+inline bool loadFromText(PointCloud& cloud, const std::string& filename, bool keepSnapshot = true) {
+    TextFormat format;
+    if (!detectTextFormat(filename, format)) return false;
+    return loadFromText(cloud, filename, format, keepSnapshot);
+}
+
+} // namespace PointCloudUtil
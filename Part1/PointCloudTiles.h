@@ -0,0 +1,463 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PointCloudUtil.h"
+#include "PointCloudScene.h"
+
+namespace PointCloudUtil {
+
+// Multi-resolution tile database for clouds too large to keep in memory. The builder
+// writes an octree whose nodes each hold a subsample of their region (one point per cell
+// of a gridResolution^3 grid; the remaining points go to the children, leaves keep
+// everything), so drawing a node and its ancestors shows the full density there.
+// TileStreamer reads the nodes the camera needs on background threads into an LRU cache.
+//
+// File layout (little-endian host): TileFileHeader, the point records of every node
+// (TilePoint, relative to the node centre), then the node table in breadth-first order
+// with each node's children stored next to each other.
+struct TilePoint {
+    float x, y, z;          // relative to the node's box centre
+    uint8_t r, g, b, a;
+};
+
+struct TileNodeRecord {
+    float min[3], max[3];   // cube, in the database frame (relative to the origin)
+    uint64_t offset;        // byte offset of the node's points
+    uint32_t count;
+    int32_t firstChild;     // -1 for leaves
+    float spacing;          // distance between the node's subsampled points
+    uint8_t childMask;      // bit k: octant k has a child (children in octant order)
+    uint8_t pad[3];
+};
+static_assert(sizeof(TilePoint) == 16, "TilePoint is written as raw bytes");
+static_assert(sizeof(TileNodeRecord) == 48, "TileNodeRecord is written as raw bytes");
+
+struct TileFileHeader {
+    char magic[8];          // "PCTILES"
+    uint32_t version;
+    uint32_t nodeCount;
+    double origin[3];       // absolute position of the database frame's zero
+    uint64_t nodeTable;     // byte offset of the node table
+    uint64_t totalPoints;
+};
+
+struct TileBuildOptions {
+    uint32_t leafPoints = 65536;     // nodes with more points are split
+    uint32_t gridResolution = 128;   // subsampling grid per node (cells per axis, <= 1024)
+    int maxDepth = 20;               // nodes at this depth become leaves regardless
+};
+
+// Convert 'cloud' into a tile database. The nodes of one octree level are processed in
+// parallel; the cloud's pending model is baked first.
+inline bool buildTileDatabase(PointCloud& cloud, const std::string& filename, const TileBuildOptions& options = TileBuildOptions()) {
+    cloud.bake();
+    const auto& points = cloud.getPoints();
+    const auto& chunks = cloud.getChunks();
+    const size_t n = points.size();
+    if (n == 0 || n > 0xFFFFFFFFull) {
+        std::cerr << "Error: Cannot build tiles from " << n << " points" << std::endl;
+        return false;
+    }
+    const uint32_t grid = std::clamp<uint32_t>(options.gridResolution, 1, 1024);
+
+    // Cloud-frame positions in double (chunk offset + stored float)
+    std::vector<Vec3d> pos(n);
+    parallelFor(n, [&](size_t b, size_t e, unsigned) {
+        size_t k = 0;
+        if (!chunks.empty()) {
+            k = static_cast<size_t>(std::upper_bound(chunks.begin(), chunks.end(), b,
+                [](size_t v, const PointCloud::Chunk& c) { return v < c.begin; }) - chunks.begin()) - 1;
+        }
+        for (size_t i = b; i < e; ++i) {
+            while (k + 1 < chunks.size() && chunks[k + 1].begin <= i) ++k;
+            const Vec3d d = chunks.empty() ? Vec3d{} : chunks[k].offset;
+            pos[i] = Vec3d{ d.x + points[i].x, d.y + points[i].y, d.z + points[i].z };
+        }
+    });
+    double lo[3] = { pos[0].x, pos[0].y, pos[0].z }, hi[3] = { lo[0], lo[1], lo[2] };
+    for (const Vec3d& p : pos) {
+        const double v[3] = { p.x, p.y, p.z };
+        for (int c = 0; c < 3; ++c) { lo[c] = std::min(lo[c], v[c]); hi[c] = std::max(hi[c], v[c]); }
+    }
+    const double rootSize = std::max({ hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2], 1e-3 }) * (1.0 + 1e-6);
+
+    struct BuildNode {
+        double min[3];
+        double size;
+        int depth;
+        std::vector<uint32_t> members;   // point indices in this node's region
+        // results
+        std::vector<TilePoint> out;
+        std::vector<uint32_t> child[8];
+        uint8_t childMask = 0;
+    };
+    struct CellKey { uint32_t key; uint32_t index; };
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to write file " << filename << std::endl;
+        return false;
+    }
+    TileFileHeader header = {};
+    std::memcpy(header.magic, "PCTILES", 8);
+    header.version = 1;
+    const Vec3d origin = cloud.getOrigin();
+    header.origin[0] = origin.x; header.origin[1] = origin.y; header.origin[2] = origin.z;
+    header.totalPoints = n;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    uint64_t offset = sizeof(header);
+
+    std::vector<TileNodeRecord> table;
+    std::vector<BuildNode> level(1);
+    for (int c = 0; c < 3; ++c) level[0].min[c] = lo[c];
+    level[0].size = rootSize;
+    level[0].depth = 0;
+    level[0].members.resize(n);
+    for (size_t i = 0; i < n; ++i) level[0].members[i] = static_cast<uint32_t>(i);
+
+    while (!level.empty()) {
+        parallelFor(level.size(), [&](size_t b, size_t e, unsigned) {
+            std::vector<CellKey> keys;
+            for (size_t k = b; k < e; ++k) {
+                BuildNode& node = level[k];
+                const double half = 0.5 * node.size;
+                const Vec3d center{ node.min[0] + half, node.min[1] + half, node.min[2] + half };
+                auto emit = [&](uint32_t i) {
+                    const Point& p = points[i];
+                    const Vec3d rel = pos[i] - center;
+                    node.out.push_back(TilePoint{ static_cast<float>(rel.x), static_cast<float>(rel.y), static_cast<float>(rel.z),
+                                                  static_cast<uint8_t>(std::clamp(p.r, 0, 255)), static_cast<uint8_t>(std::clamp(p.g, 0, 255)),
+                                                  static_cast<uint8_t>(std::clamp(p.b, 0, 255)), 255 });
+                };
+                if (node.members.size() <= options.leafPoints || node.depth >= options.maxDepth) {
+                    for (uint32_t i : node.members) emit(i);
+                    continue;
+                }
+                // One point per grid cell (the one nearest the cell centre), found by
+                // sorting cell keys like voxelDownsample()
+                const double cell = node.size / grid;
+                auto cellOf = [&](double v, int c) {
+                    return std::min<uint32_t>(grid - 1, static_cast<uint32_t>(std::max(0.0, (v - node.min[c]) / cell)));
+                };
+                keys.resize(node.members.size());
+                for (size_t j = 0; j < node.members.size(); ++j) {
+                    const Vec3d& p = pos[node.members[j]];
+                    keys[j] = CellKey{ (cellOf(p.x, 0) * grid + cellOf(p.y, 1)) * grid + cellOf(p.z, 2), node.members[j] };
+                }
+                std::sort(keys.begin(), keys.end(), [](const CellKey& a, const CellKey& c) {
+                    return a.key < c.key || (a.key == c.key && a.index < c.index);
+                });
+                for (size_t r = 0; r < keys.size();) {
+                    size_t end = r + 1;
+                    while (end < keys.size() && keys[end].key == keys[r].key) ++end;
+                    const uint32_t key = keys[r].key;
+                    const Vec3d cc{ node.min[0] + (key / (grid * grid) + 0.5) * cell,
+                                    node.min[1] + ((key / grid) % grid + 0.5) * cell,
+                                    node.min[2] + (key % grid + 0.5) * cell };
+                    size_t best = r;
+                    double bestD = 0.0;
+                    for (size_t j = r; j < end; ++j) {
+                        const Vec3d d = pos[keys[j].index] - cc;
+                        const double d2 = d.x * d.x + d.y * d.y + d.z * d.z;
+                        if (j == r || d2 < bestD) { best = j; bestD = d2; }
+                    }
+                    for (size_t j = r; j < end; ++j) {
+                        const uint32_t i = keys[j].index;
+                        if (j == best) { emit(i); continue; }
+                        const Vec3d& p = pos[i];
+                        const int octant = (p.x >= center.x ? 1 : 0) | (p.y >= center.y ? 2 : 0) | (p.z >= center.z ? 4 : 0);
+                        node.child[octant].push_back(i);
+                    }
+                    r = end;
+                }
+                node.members = std::vector<uint32_t>();
+                for (int o = 0; o < 8; ++o) if (!node.child[o].empty()) node.childMask |= static_cast<uint8_t>(1u << o);
+            }
+        }, 1);
+
+        // Write this level's points and records; gather the next level in order so each
+        // node's children are contiguous
+        std::vector<BuildNode> next;
+        const size_t nextBase = table.size() + level.size();
+        for (BuildNode& node : level) {
+            TileNodeRecord rec = {};
+            for (int c = 0; c < 3; ++c) {
+                rec.min[c] = static_cast<float>(node.min[c]);
+                rec.max[c] = static_cast<float>(node.min[c] + node.size);
+            }
+            rec.offset = offset;
+            rec.count = static_cast<uint32_t>(node.out.size());
+            rec.spacing = static_cast<float>(node.size / grid);
+            rec.childMask = node.childMask;
+            rec.firstChild = node.childMask ? static_cast<int32_t>(nextBase + next.size()) : -1;
+            file.write(reinterpret_cast<const char*>(node.out.data()), static_cast<std::streamsize>(node.out.size() * sizeof(TilePoint)));
+            offset += node.out.size() * sizeof(TilePoint);
+            table.push_back(rec);
+            for (int o = 0; o < 8; ++o) {
+                if (node.child[o].empty()) continue;
+                BuildNode child;
+                const double half = 0.5 * node.size;
+                child.min[0] = node.min[0] + ((o & 1) ? half : 0.0);
+                child.min[1] = node.min[1] + ((o & 2) ? half : 0.0);
+                child.min[2] = node.min[2] + ((o & 4) ? half : 0.0);
+                child.size = half;
+                child.depth = node.depth + 1;
+                child.members.swap(node.child[o]);
+                next.push_back(std::move(child));
+            }
+        }
+        level.swap(next);
+    }
+
+    header.nodeCount = static_cast<uint32_t>(table.size());
+    header.nodeTable = offset;
+    file.write(reinterpret_cast<const char*>(table.data()), static_cast<std::streamsize>(table.size() * sizeof(TileNodeRecord)));
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    return static_cast<bool>(file);
+}
+
+// Streams the nodes of a tile database by camera distance. update() runs once per frame
+// on the render thread: it picks the nodes to draw (frustum-visible, refined while their
+// point spacing covers more than minSpacingPixels on screen, within a point budget),
+// queues the missing ones for the loader threads in priority order, moves finished
+// loads into the cache and evicts the least recently drawn nodes over the cache budget.
+// The cache is only touched by the render thread; loaders share a request queue and a
+// completion list with it.
+class TileStreamer {
+public:
+    struct Settings {
+        size_t pointBudget = 5000000;      // points drawn per frame
+        size_t cacheBudget = 20000000;     // points kept resident
+        float minSpacingPixels = 2.0f;     // refine while spacing projects larger than this
+        size_t maxPending = 32;            // queued requests per frame
+    };
+    Settings settings;
+
+private:
+    enum State : uint8_t { Absent, Queued, Resident };
+    struct Node {
+        TileNodeRecord rec;
+        std::vector<TilePoint> points;
+        std::list<uint32_t>::iterator lru;
+        uint64_t lastDrawn = 0;
+        State state = Absent;
+    };
+
+    std::string path;
+    TileFileHeader header = {};
+    std::vector<Node> nodes;
+    std::list<uint32_t> lru;            // resident nodes, most recently drawn first
+    size_t resident = 0;
+    uint64_t frame = 0;
+    std::vector<uint32_t> drawList;
+
+    std::vector<std::thread> loaders;
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::deque<uint32_t> requests;                                   // guarded by mtx
+    std::vector<std::pair<uint32_t, std::vector<TilePoint>>> done;  // guarded by mtx
+    bool stopping = false;                                           // guarded by mtx
+    std::atomic<size_t> failures{0};
+
+    void loaderMain() {
+        std::ifstream file(path, std::ios::binary);
+        for (;;) {
+            uint32_t id;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                wake.wait(lock, [&] { return stopping || !requests.empty(); });
+                if (stopping) return;
+                id = requests.front();
+                requests.pop_front();
+            }
+            const TileNodeRecord& rec = nodes[id].rec; // the node table is immutable while loaders run
+            std::vector<TilePoint> pts(rec.count);
+            file.clear();
+            file.seekg(static_cast<std::streamoff>(rec.offset));
+            file.read(reinterpret_cast<char*>(pts.data()), static_cast<std::streamsize>(pts.size() * sizeof(TilePoint)));
+            if (static_cast<size_t>(file.gcount()) != pts.size() * sizeof(TilePoint)) { ++failures; pts.clear(); }
+            std::lock_guard<std::mutex> lock(mtx);
+            done.emplace_back(id, std::move(pts));
+        }
+    }
+
+    static float center(const TileNodeRecord& r, int c) { return 0.5f * (r.min[c] + r.max[c]); }
+
+    static Aabb box(const TileNodeRecord& r) {
+        Aabb b;
+        for (int c = 0; c < 3; ++c) { b.min[c] = r.min[c]; b.max[c] = r.max[c]; }
+        b.valid = true;
+        return b;
+    }
+
+public:
+    TileStreamer() = default;
+    TileStreamer(const TileStreamer&) = delete;
+    TileStreamer& operator=(const TileStreamer&) = delete;
+    ~TileStreamer() { close(); }
+
+    // Read the node table and start 'threads' loader threads
+    bool open(const std::string& filename, unsigned threads = 2) {
+        close();
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Error: Unable to open file " << filename << std::endl;
+            return false;
+        }
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (file.gcount() != sizeof(header) || std::memcmp(header.magic, "PCTILES", 8) != 0 || header.version != 1 || header.nodeCount == 0) {
+            std::cerr << "Error: " << filename << " is not a tile database" << std::endl;
+            return false;
+        }
+        std::vector<TileNodeRecord> table(header.nodeCount);
+        file.seekg(static_cast<std::streamoff>(header.nodeTable));
+        file.read(reinterpret_cast<char*>(table.data()), static_cast<std::streamsize>(table.size() * sizeof(TileNodeRecord)));
+        if (static_cast<size_t>(file.gcount()) != table.size() * sizeof(TileNodeRecord)) {
+            std::cerr << "Error: Truncated node table in " << filename << std::endl;
+            return false;
+        }
+        path = filename;
+        nodes.resize(table.size());
+        for (size_t i = 0; i < table.size(); ++i) nodes[i].rec = table[i];
+        stopping = false;
+        for (unsigned t = 0; t < std::max(1u, threads); ++t) loaders.emplace_back(&TileStreamer::loaderMain, this);
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+            requests.clear();
+            done.clear();
+        }
+        wake.notify_all();
+        for (auto& t : loaders) t.join();
+        loaders.clear();
+        nodes.clear();
+        lru.clear();
+        drawList.clear();
+        resident = 0;
+    }
+
+    bool isOpen() const { return !nodes.empty(); }
+    Vec3d getOrigin() const { return Vec3d{ header.origin[0], header.origin[1], header.origin[2] }; }
+    uint64_t totalPoints() const { return header.totalPoints; }
+    Aabb bounds() const { return nodes.empty() ? Aabb() : box(nodes[0].rec); }
+    size_t residentPoints() const { return resident; }
+    size_t readFailures() const { return failures; }
+
+    // 'frustum' and 'eye' are in the database frame; 'pixelsPerUnit' is the screen size
+    // in pixels of one unit at distance 1 (viewport height / (2 tan(fovY / 2))).
+    void update(const Frustum& frustum, float eyeX, float eyeY, float eyeZ, float pixelsPerUnit) {
+        if (nodes.empty()) return;
+        ++frame;
+
+        // Finished loads enter the cache
+        std::vector<std::pair<uint32_t, std::vector<TilePoint>>> arrived;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            arrived.swap(done);
+        }
+        for (auto& a : arrived) {
+            Node& node = nodes[a.first];
+            node.points.swap(a.second);
+            node.state = Resident;
+            lru.push_front(a.first);
+            node.lru = lru.begin();
+            resident += node.points.size();
+        }
+
+        // Largest projected spacing first
+        struct Candidate { float priority; uint32_t id; };
+        auto lower = [](const Candidate& a, const Candidate& b) { return a.priority < b.priority; };
+        auto priorityOf = [&](const TileNodeRecord& r) {
+            const float dx = center(r, 0) - eyeX, dy = center(r, 1) - eyeY, dz = center(r, 2) - eyeZ;
+            const float radius = 0.8660254f * (r.max[0] - r.min[0]);
+            const float dist = std::max(std::sqrt(dx * dx + dy * dy + dz * dz) - radius, 1e-6f);
+            return r.spacing * pixelsPerUnit / dist;
+        };
+        std::vector<Candidate> heap, wanted;
+        drawList.clear();
+        if (frustum.intersects(box(nodes[0].rec))) heap.push_back({ priorityOf(nodes[0].rec), 0 });
+        size_t budgetUsed = 0;
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), lower);
+            const Candidate c = heap.back();
+            heap.pop_back();
+            Node& node = nodes[c.id];
+            if (node.state != Resident) {
+                // coarse levels load first: nothing below a missing node is requested yet
+                if (node.state == Absent) wanted.push_back(c);
+                continue;
+            }
+            if (budgetUsed + node.rec.count > settings.pointBudget && !drawList.empty()) break;
+            budgetUsed += node.rec.count;
+            drawList.push_back(c.id);
+            node.lastDrawn = frame;
+            lru.splice(lru.begin(), lru, node.lru);
+            if (node.rec.firstChild < 0 || c.priority <= settings.minSpacingPixels) continue;
+            uint32_t child = static_cast<uint32_t>(node.rec.firstChild);
+            for (int o = 0; o < 8; ++o) {
+                if (!(node.rec.childMask & (1u << o))) continue;
+                const TileNodeRecord& cr = nodes[child].rec;
+                if (frustum.intersects(box(cr))) {
+                    heap.push_back({ priorityOf(cr), child });
+                    std::push_heap(heap.begin(), heap.end(), lower);
+                }
+                ++child;
+            }
+        }
+
+        // Replace the request queue with this frame's most important missing nodes
+        std::sort(wanted.begin(), wanted.end(), [](const Candidate& a, const Candidate& b) { return a.priority > b.priority; });
+        if (wanted.size() > settings.maxPending) wanted.resize(settings.maxPending);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            for (uint32_t id : requests) nodes[id].state = Absent; // still waiting: no longer needed
+            requests.clear();
+            for (const Candidate& c : wanted) { nodes[c.id].state = Queued; requests.push_back(c.id); }
+        }
+        wake.notify_all();
+
+        // Evict least recently drawn nodes (never the ones drawn this frame)
+        while (resident > settings.cacheBudget && !lru.empty()) {
+            Node& node = nodes[lru.back()];
+            if (node.lastDrawn == frame) break;
+            resident -= node.points.size();
+            node.points = std::vector<TilePoint>();
+            node.state = Absent;
+            lru.pop_back();
+        }
+    }
+
+    // Calls f(cx, cy, cz, points, count) for each node selected by the last update();
+    // point positions are relative to (cx, cy, cz) in the database frame
+    template <typename F>
+    void forEachDrawn(F f) const {
+        for (uint32_t id : drawList) {
+            const Node& node = nodes[id];
+            f(center(node.rec, 0), center(node.rec, 1), center(node.rec, 2), node.points.data(), node.points.size());
+        }
+    }
+
+    size_t drawnNodes() const { return drawList.size(); }
+};
+
+} // namespace PointCloudUtil
@@ -0,0 +1,367 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "PointCloudUtil.h"
+#include "PointCloudMesh.h"
+#include "PointCloudRaycast.h"
+#include "PointCloudVoxelBlocks.h"
+
+namespace PointCloudUtil {
+
+// Truncated signed distance field fused from posed scans (Curless and Levoy 1996), stored
+// in 8x8x8 voxel blocks that are allocated only along the observed surface and found
+// through an open-addressed hash (after Niessner et al. 2013), so memory follows the
+// surface area rather than the bounding volume.
+//
+// Each point updates the voxels its sensor ray crosses within 'truncation' of it (3D DDA)
+// with the distance to the point along the ray, weight 1 per observation up to
+// 'maxWeight'. The truncation is at most one block, so a point only touches the 3x3x3
+// blocks around the block it lies in; points are grouped by that block and blocks are
+// processed in 27 phases by coordinate mod 3, so the blocks of one phase update
+// disjoint voxels in parallel without locks.
+class TsdfVolume {
+public:
+    struct Voxel {
+        float sdf = 1.0f;      // distance / truncation in [-1, 1], positive in front of the surface
+        float weight = 0.0f;
+        uint8_t r = 0, g = 0, b = 0;
+    };
+
+    static constexpr int kBlockEdge = VoxelBlockHash<Voxel>::kEdge;
+    static constexpr int kBlockVoxels = VoxelBlockHash<Voxel>::kVoxels;
+
+private:
+    using Blocks = VoxelBlockHash<Voxel>;
+    static constexpr uint32_t kNone = Blocks::kNone;
+    // voxel coordinates stay within +-2^19, so mesh edge keys pack 20 bits per axis
+    static constexpr int64_t kVoxelLimit = (int64_t(1) << 19) - 4 * kBlockEdge;
+
+    float voxel = 0.0f, trunc = 0.0f, maxWeight = 0.0f;
+    Blocks blocks;
+
+    // Mesh edge from voxel (x, y, z) to (x, y, z) + offset(dir), dir a nonzero xyz bit set
+    static uint64_t edgeKey(int64_t x, int64_t y, int64_t z, int dir) {
+        return (static_cast<uint64_t>(x + (1 << 19)) << 43) | (static_cast<uint64_t>(y + (1 << 19)) << 23) |
+               (static_cast<uint64_t>(z + (1 << 19)) << 3) | static_cast<uint64_t>(dir);
+    }
+
+public:
+    // 'truncation' defaults to three voxels and is clamped to [1, 8] voxels
+    explicit TsdfVolume(float voxelSize, float truncation = 0.0f, float maxWeight_ = 64.0f)
+        : voxel(voxelSize), maxWeight(maxWeight_) {
+        if (!(voxel > 0.0f)) {
+            std::cerr << "Error: TSDF voxel size must be positive, using 1" << std::endl;
+            voxel = 1.0f;
+        }
+        trunc = truncation > 0.0f ? truncation : 3.0f * voxel;
+        trunc = std::clamp(trunc, voxel, kBlockEdge * voxel);
+    }
+
+    float voxelSize() const { return voxel; }
+    float truncation() const { return trunc; }
+    size_t blockCount() const { return blocks.size(); }
+    size_t memoryBytes() const { return blocks.memoryBytes(); }
+    void clear() { blocks.clear(); }
+
+    // Voxel (x, y, z) spans [x, x + 1) * voxelSize per axis; nullptr where nothing was observed
+    const Voxel* find(int64_t x, int64_t y, int64_t z) const { return blocks.voxel(x, y, z); }
+
+    // Fuse scans into the volume. poses[k] maps scan k's cloud frame (as displayed, any
+    // pending model included) into the volume frame; the sensor sits at the origin of
+    // the scan frame. All scans go through one parallel pass. Points beyond +-2^19
+    // voxels from the origin are skipped.
+    bool integrate(const std::vector<const PointCloud*>& scans, const std::vector<Mat4>& poses) {
+        if (scans.size() != poses.size()) {
+            std::cerr << "Error: TSDF integration needs one pose per scan" << std::endl;
+            return false;
+        }
+        std::vector<size_t> start(scans.size() + 1, 0);
+        for (size_t k = 0; k < scans.size(); ++k) start[k + 1] = start[k] + scans[k]->size();
+        const size_t total = start.back();
+        if (total == 0) return true;
+        if (total >= kNone) {
+            std::cerr << "Error: Too many points for one TSDF integration pass" << std::endl;
+            return false;
+        }
+
+        // volume-frame positions
+        std::vector<float> xyz(3 * total);
+        for (size_t k = 0; k < scans.size(); ++k) {
+            const Point* pts = scans[k]->getPoints().data();
+            float* dst = xyz.data() + 3 * start[k];
+            scans[k]->forEachDisplayedSpan([&](size_t b, size_t e, const Mat4& M, unsigned) {
+                const Mat4 C = M * poses[k];   // stored -> scan frame, then the pose
+                for (size_t i = b; i < e; ++i) transformPoint(C, pts[i].x, pts[i].y, pts[i].z, dst[3 * i], dst[3 * i + 1], dst[3 * i + 2]);
+            });
+        }
+        auto scanOf = [&](size_t i) { return static_cast<size_t>(std::upper_bound(start.begin(), start.end(), i) - start.begin()) - 1; };
+        const double limit = static_cast<double>(kVoxelLimit) * voxel;
+        // the band of point i: from 'trunc' in front of it (or the sensor) to 'trunc' behind
+        auto band = [&](size_t i, double p[3], double d[3], double a[3], double b[3]) {
+            const Mat4& P = poses[scanOf(i)];
+            double len = 0.0;
+            for (int k = 0; k < 3; ++k) {
+                p[k] = xyz[3 * i + k];
+                if (!(std::fabs(p[k]) < limit)) return false;
+                d[k] = p[k] - P.m[12 + k];
+                len += d[k] * d[k];
+            }
+            len = std::sqrt(len);
+            if (!(len > 1e-9)) return false;
+            const double front = std::min<double>(trunc, len);
+            for (int k = 0; k < 3; ++k) {
+                d[k] /= len;
+                a[k] = p[k] - front * d[k];
+                b[k] = p[k] + trunc * d[k];
+            }
+            return true;
+        };
+
+        // allocate every block a band crosses
+        const double blockSize = static_cast<double>(voxel) * kBlockEdge;
+        std::vector<std::vector<uint64_t>> touched(workerCount());
+        parallelFor(total, [&](size_t b, size_t e, unsigned w) {
+            auto& out = touched[w];
+            for (size_t i = b; i < e; ++i) {
+                double p[3], d[3], s0[3], s1[3];
+                if (!band(i, p, d, s0, s1)) continue;
+                traverseCells(s0, s1, blockSize, [&](int64_t x, int64_t y, int64_t z) {
+                    const uint64_t key = Blocks::pack(x, y, z);
+                    if (out.empty() || out.back() != key) out.push_back(key);
+                    return true;
+                });
+            }
+            std::sort(out.begin(), out.end());
+            out.erase(std::unique(out.begin(), out.end()), out.end());
+        });
+        std::vector<uint64_t> keys;
+        for (auto& t : touched) { keys.insert(keys.end(), t.begin(), t.end()); std::vector<uint64_t>().swap(t); }
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        blocks.allocate(keys);
+
+        // points by home block, then runs of one block grouped by phase
+        std::vector<uint64_t> order(total);
+        parallelFor(total, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i) {
+                double p[3], d[3], s0[3], s1[3];
+                uint64_t home = kNone;
+                if (band(i, p, d, s0, s1)) {
+                    const int64_t x = static_cast<int64_t>(std::floor(p[0] / blockSize)), y = static_cast<int64_t>(std::floor(p[1] / blockSize)),
+                                  z = static_cast<int64_t>(std::floor(p[2] / blockSize));
+                    home = blocks.find(Blocks::pack(x, y, z));
+                }
+                order[i] = (home << 32) | i;
+            }
+        });
+        std::sort(order.begin(), order.end());
+        struct Run { size_t begin, end; };
+        std::vector<Run> runs;
+        std::vector<uint32_t> phaseStart(28, 0);
+        auto phaseOf = [&](size_t block) { return Blocks::phaseOf(blocks.key(block)); };
+        for (size_t b = 0; b < total && (order[b] >> 32) != kNone;) {
+            size_t e = b + 1;
+            while (e < total && (order[e] >> 32) == (order[b] >> 32)) ++e;
+            runs.push_back(Run{ b, e });
+            ++phaseStart[phaseOf(order[b] >> 32) + 1];
+            b = e;
+        }
+        for (size_t p = 0; p < 27; ++p) phaseStart[p + 1] += phaseStart[p];
+        std::vector<uint32_t> runOrder(runs.size());
+        {
+            std::vector<uint32_t> fill(phaseStart.begin(), phaseStart.end() - 1);
+            for (size_t r = 0; r < runs.size(); ++r) runOrder[fill[phaseOf(order[runs[r].begin] >> 32)]++] = static_cast<uint32_t>(r);
+        }
+
+        const float invTrunc = 1.0f / trunc;
+        for (size_t phase = 0; phase < 27; ++phase) {
+            const size_t pb = phaseStart[phase];
+            parallelFor(phaseStart[phase + 1] - pb, [&](size_t b, size_t e, unsigned) {
+                for (size_t r = b; r < e; ++r) {
+                    const Run& run = runs[runOrder[pb + r]];
+                    uint64_t cachedKey = ~uint64_t(0);
+                    Voxel* cached = nullptr;
+                    for (size_t k = run.begin; k < run.end; ++k) {
+                        const size_t i = order[k] & 0xFFFFFFFFu;
+                        double p[3], d[3], s0[3], s1[3];
+                        band(i, p, d, s0, s1);
+                        const size_t s = scanOf(i);
+                        const Point& src = scans[s]->getPoints()[i - start[s]];
+                        traverseCells(s0, s1, voxel, [&](int64_t x, int64_t y, int64_t z) {
+                            const double cx = (x + 0.5) * voxel, cy = (y + 0.5) * voxel, cz = (z + 0.5) * voxel;
+                            const float sdf = static_cast<float>((p[0] - cx) * d[0] + (p[1] - cy) * d[1] + (p[2] - cz) * d[2]) * invTrunc;
+                            const uint64_t key = Blocks::keyOf(x, y, z);
+                            if (key != cachedKey) {
+                                const uint32_t blk = blocks.find(key);
+                                cachedKey = key;
+                                cached = blk == kNone ? nullptr : blocks.block(blk);
+                            }
+                            if (!cached) return true;
+                            Voxel& v = cached[Blocks::localIndex(x, y, z)];
+                            const float w = v.weight, inv = 1.0f / (w + 1.0f);
+                            v.sdf = (v.sdf * w + std::clamp(sdf, -1.0f, 1.0f)) * inv;
+                            v.r = static_cast<uint8_t>((v.r * w + std::clamp(src.r, 0, 255)) * inv + 0.5f);
+                            v.g = static_cast<uint8_t>((v.g * w + std::clamp(src.g, 0, 255)) * inv + 0.5f);
+                            v.b = static_cast<uint8_t>((v.b * w + std::clamp(src.b, 0, 255)) * inv + 0.5f);
+                            v.weight = std::min(w + 1.0f, maxWeight);
+                            return true;
+                        });
+                    }
+                }
+            }, 4);
+        }
+        return true;
+    }
+
+    bool integrate(const PointCloud& scan, const Mat4& pose) { return integrate({ &scan }, { pose }); }
+
+    // Zero level set as a triangle mesh (marching tetrahedra: six per voxel cube, split
+    // along its main diagonal), using voxels observed with at least 'minWeight'. Faces
+    // face the sensor side; vertices are shared through their lattice edge and carry
+    // interpolated colours and area-weighted normals. Blocks run in parallel.
+    void extractMesh(TriangleMesh& mesh, float minWeight = 1.0f) const {
+        mesh.clear();
+        static const int kTets[6][4] = { { 0, 1, 3, 7 }, { 0, 3, 2, 7 }, { 0, 2, 6, 7 }, { 0, 6, 4, 7 }, { 0, 4, 5, 7 }, { 0, 5, 1, 7 } };
+        std::vector<std::vector<std::array<uint64_t, 3>>> parts(workerCount());
+        parallelFor(blocks.size(), [&](size_t bb, size_t be, unsigned w) {
+            auto& tris = parts[w];
+            for (size_t blk = bb; blk < be; ++blk) {
+                int64_t bx, by, bz;
+                Blocks::unpack(blocks.key(blk), bx, by, bz);
+                // this block and its +x/+y/+z neighbours, indexed by offset bits
+                const Voxel* nb[8];
+                for (int o = 0; o < 8; ++o) {
+                    const uint32_t n = o == 0 ? static_cast<uint32_t>(blk) : blocks.find(Blocks::pack(bx + (o & 1), by + ((o >> 1) & 1), bz + ((o >> 2) & 1)));
+                    nb[o] = n == kNone ? nullptr : blocks.block(n);
+                }
+                for (int z = 0; z < kBlockEdge; ++z)
+                    for (int y = 0; y < kBlockEdge; ++y)
+                        for (int x = 0; x < kBlockEdge; ++x) {
+                            float s[8];
+                            bool ok = true, neg = false, pos = false;
+                            for (int c = 0; c < 8 && ok; ++c) {
+                                const int lx = x + (c & 1), ly = y + ((c >> 1) & 1), lz = z + ((c >> 2) & 1);
+                                const Voxel* base = nb[(lx >> 3) | ((ly >> 3) << 1) | ((lz >> 3) << 2)];
+                                if (!base) { ok = false; break; }
+                                const Voxel& v = base[((lz & 7) * kBlockEdge + (ly & 7)) * kBlockEdge + (lx & 7)];
+                                ok = v.weight >= minWeight && v.weight > 0.0f;
+                                s[c] = v.sdf;
+                                (s[c] < 0.0f ? neg : pos) = true;
+                            }
+                            if (!ok || !neg || !pos) continue;
+                            const int64_t gx = bx * kBlockEdge + x, gy = by * kBlockEdge + y, gz = bz * kBlockEdge + z;
+                            auto corner = [](int c, float out[3]) { out[0] = float(c & 1); out[1] = float((c >> 1) & 1); out[2] = float((c >> 2) & 1); };
+                            // crossing on edge a-b (one corner's bits contain the other's)
+                            auto crossing = [&](int a, int b, float out[3], uint64_t& key) {
+                                const int lo = (a & b) == a ? a : b, hi = lo == a ? b : a;
+                                float pa[3], pb[3];
+                                corner(a, pa); corner(b, pb);
+                                const float t = s[a] / (s[a] - s[b]);
+                                for (int k = 0; k < 3; ++k) out[k] = pa[k] + t * (pb[k] - pa[k]);
+                                key = edgeKey(gx + (lo & 1), gy + ((lo >> 1) & 1), gz + ((lo >> 2) & 1), hi ^ lo);
+                            };
+                            for (const auto& T : kTets) {
+                                int in[4], out[4], ni = 0, no = 0;
+                                for (int c : T) (s[c] < 0.0f ? in[ni++] : out[no++]) = c;
+                                if (ni == 0 || no == 0) continue;
+                                // faces point from the inside corners to the outside ones
+                                float g[3] = { 0, 0, 0 }, p[3];
+                                for (int k = 0; k < no; ++k) { corner(out[k], p); for (int j = 0; j < 3; ++j) g[j] += p[j] / no; }
+                                for (int k = 0; k < ni; ++k) { corner(in[k], p); for (int j = 0; j < 3; ++j) g[j] -= p[j] / ni; }
+                                float q[4][3];
+                                uint64_t e[4];
+                                int m = 0;
+                                if (ni == 1 || no == 1) {
+                                    const int apex = ni == 1 ? in[0] : out[0];
+                                    const int* rest = ni == 1 ? out : in;
+                                    for (int k = 0; k < 3; ++k) crossing(apex, rest[k], q[m], e[m]), ++m;
+                                } else {
+                                    crossing(in[0], out[0], q[0], e[0]);
+                                    crossing(in[0], out[1], q[1], e[1]);
+                                    crossing(in[1], out[1], q[2], e[2]);
+                                    crossing(in[1], out[0], q[3], e[3]);
+                                    m = 4;
+                                }
+                                // polygon normal (Newell) against the inside -> outside direction
+                                float n[3] = { 0, 0, 0 };
+                                for (int k = 0; k < m; ++k) {
+                                    const float* a = q[k];
+                                    const float* b = q[(k + 1) % m];
+                                    n[0] += (a[1] - b[1]) * (a[2] + b[2]);
+                                    n[1] += (a[2] - b[2]) * (a[0] + b[0]);
+                                    n[2] += (a[0] - b[0]) * (a[1] + b[1]);
+                                }
+                                const bool flip = n[0] * g[0] + n[1] * g[1] + n[2] * g[2] < 0.0f;
+                                for (int k = 1; k + 1 < m; ++k) {
+                                    if (flip) tris.push_back({ e[0], e[k + 1], e[k] });
+                                    else tris.push_back({ e[0], e[k], e[k + 1] });
+                                }
+                            }
+                        }
+            }
+        });
+
+        // one vertex per crossed edge
+        std::vector<uint64_t> edges;
+        for (const auto& t : parts)
+            for (const auto& f : t) edges.insert(edges.end(), f.begin(), f.end());
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+        mesh.vertices.resize(edges.size());
+        mesh.colours.resize(edges.size());
+        parallelFor(edges.size(), [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i) {
+                const uint64_t key = edges[i];
+                const int dir = static_cast<int>(key & 7);
+                const int64_t x = static_cast<int64_t>(key >> 43) - (1 << 19), y = static_cast<int64_t>((key >> 23) & 0xFFFFF) - (1 << 19),
+                              z = static_cast<int64_t>((key >> 3) & 0xFFFFF) - (1 << 19);
+                const int64_t x1 = x + (dir & 1), y1 = y + ((dir >> 1) & 1), z1 = z + ((dir >> 2) & 1);
+                const Voxel* a = blocks.voxel(x, y, z);
+                const Voxel* c = blocks.voxel(x1, y1, z1);
+                const float t = a->sdf / (a->sdf - c->sdf);
+                mesh.vertices[i] = { (static_cast<float>(x) + 0.5f + t * (x1 - x)) * voxel, (static_cast<float>(y) + 0.5f + t * (y1 - y)) * voxel,
+                                     (static_cast<float>(z) + 0.5f + t * (z1 - z)) * voxel };
+                mesh.colours[i] = { static_cast<uint8_t>(a->r + t * (c->r - a->r) + 0.5f), static_cast<uint8_t>(a->g + t * (c->g - a->g) + 0.5f),
+                                    static_cast<uint8_t>(a->b + t * (c->b - a->b) + 0.5f) };
+            }
+        });
+        size_t faces = 0;
+        for (const auto& t : parts) faces += t.size();
+        mesh.faces.resize(faces);
+        size_t at = 0;
+        for (const auto& t : parts) {
+            parallelFor(t.size(), [&](size_t b, size_t e, unsigned) {
+                for (size_t f = b; f < e; ++f)
+                    for (int k = 0; k < 3; ++k)
+                        mesh.faces[at + f][k] = static_cast<uint32_t>(std::lower_bound(edges.begin(), edges.end(), t[f][k]) - edges.begin());
+            });
+            at += t.size();
+        }
+        mesh.computeNormals();
+    }
+
+    // The mesh vertices as a cloud: points on the surface with normals and colours
+    void extractPointCloud(PointCloud& out, float minWeight = 1.0f) const {
+        TriangleMesh mesh;
+        extractMesh(mesh, minWeight);
+        std::vector<Point> pts(mesh.vertices.size());
+        parallelFor(pts.size(), [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i) {
+                Point& p = pts[i];
+                p.x = mesh.vertices[i][0]; p.y = mesh.vertices[i][1]; p.z = mesh.vertices[i][2];
+                p.r = mesh.colours[i][0]; p.g = mesh.colours[i][1]; p.b = mesh.colours[i][2];
+                p.nx = mesh.normals[i][0]; p.ny = mesh.normals[i][1]; p.nz = mesh.normals[i][2];
+            }
+        });
+        out.clear();
+        out.appendPoints(pts.data(), pts.size(), true);
+    }
+};
+
+} // namespace PointCloudUtil
@@ -1,44 +1,78 @@
+#pragma once
+
 #include <iostream>
 #include <vector>
 #include <fstream>
 #include <sstream>
 #include <cmath>
+#include <cstdio>
+#include <cstdint>
 #include <string>
 #include <array>
+#include <algorithm>
+#include <limits>
+
+#include "PointCloudAlloc.h"
+#include "PointCloudAttributes.h"
+#include "PointCloudCrop.h"
+#include "PointCloudHistogram.h"
+#include "PointCloudHull.h"
+#include "PointCloudMerge.h"
+#include "PointCloudMesh.h"
+#include "PointCloudProjection.h"
+#include "PointCloudSampling.h"
+#include "PointCloudNeighbors.h"
+#include "PointCloudParallel.h"
+#include "PointCloudScratch.h"
+#include "PointCloudSketch.h"
 
 namespace PointCloudUtil {
 
-struct Mat4 {
-    std::array<float,16> m;
-    static Mat4 identity() {
-        return Mat4{{1,0,0,0,
-                     0,1,0,0,
-                     0,0,1,0,
-                     0,0,0,1}};
+// 4x4 matrix, column-major (m[12..14] = translation), same layout as OpenGL.
+// A * B applies A first, then B. Mat4 (float) is used for rendering and kernels;
+// Mat4d is the double counterpart used when forming matrices for georeferenced clouds.
+template <typename T>
+struct Mat4T {
+    std::array<T,16> m;
+    static Mat4T identity() {
+        return Mat4T{{1,0,0,0,
+                      0,1,0,0,
+                      0,0,1,0,
+                      0,0,0,1}};
+    }
+    static Mat4T translation(T tx,T ty,T tz){
+        Mat4T M = identity();
+        M.m[12]=tx; M.m[13]=ty; M.m[14]=tz;
+        return M;
     }
-    static Mat4 translation(float tx,float ty,float tz){
-        Mat4 T = identity();
-        T.m[12]=tx; T.m[13]=ty; T.m[14]=tz;
-        return T;
+    static Mat4T rotationX(T radians){
+        T c=std::cos(radians), s=std::sin(radians);
+        return Mat4T{{1,0,0,0,  0,c,-s,0,  0,s,c,0,  0,0,0,1}};
     }
-    static Mat4 rotationX(float radians){
-        float c=std::cos(radians), s=std::sin(radians);
-        return Mat4{{1,0,0,0,  0,c,-s,0,  0,s,c,0,  0,0,0,1}};
+    static Mat4T rotationY(T radians){
+        T c=std::cos(radians), s=std::sin(radians);
+        return Mat4T{{c,0,s,0,  0,1,0,0,  -s,0,c,0,  0,0,0,1}};
     }
-    static Mat4 rotationY(float radians){
-        float c=std::cos(radians), s=std::sin(radians);
-        return Mat4{{c,0,s,0,  0,1,0,0,  -s,0,c,0,  0,0,0,1}};
+    static Mat4T rotationZ(T radians){
+        T c=std::cos(radians), s=std::sin(radians);
+        return Mat4T{{c,-s,0,0,  s,c,0,0,  0,0,1,0,  0,0,0,1}};
     }
-    static Mat4 rotationZ(float radians){
-        float c=std::cos(radians), s=std::sin(radians);
-        return Mat4{{c,-s,0,0,  s,c,0,0,  0,0,1,0,  0,0,0,1}};
+    template <typename U>
+    Mat4T<U> cast() const {
+        Mat4T<U> R;
+        for (int i = 0; i < 16; ++i) R.m[i] = static_cast<U>(m[i]);
+        return R;
     }
 };
-inline Mat4 operator*(const Mat4& A, const Mat4& B){
-    Mat4 R = Mat4::identity();
+using Mat4 = Mat4T<float>;
+using Mat4d = Mat4T<double>;
+
+template <typename T>
+inline Mat4T<T> operator*(const Mat4T<T>& A, const Mat4T<T>& B){
+    Mat4T<T> R = Mat4T<T>::identity();
     for(int r=0;r<4;++r){
         for(int c=0;c<4;++c){
-            R.m[c+4*r] = 0.f;
+            R.m[c+4*r] = 0;
             for(int k=0;k<4;++k){
                 R.m[c+4*r] += A.m[k+4*r]*B.m[c+4*k];
             }
@@ -52,19 +86,329 @@ inline void transformPoint(const Mat4& M, float x, float y, float z, float& ox,
     oz = M.m[2]*x + M.m[6]*y + M.m[10]*z + M.m[14];
 }
 
+struct Vec3d {
+    double x = 0.0, y = 0.0, z = 0.0;
+    bool isZero() const { return x == 0.0 && y == 0.0 && z == 0.0; }
+};
+inline Vec3d operator+(const Vec3d& a, const Vec3d& b) { return Vec3d{ a.x + b.x, a.y + b.y, a.z + b.z }; }
+inline Vec3d operator-(const Vec3d& a, const Vec3d& b) { return Vec3d{ a.x - b.x, a.y - b.y, a.z - b.z }; }
+
+// Similarity transform p' = s * R(q) * p + t with a unit quaternion q, kept in double.
+// Composition follows Mat4 (A * B applies A first, then B) but costs a quaternion
+// product instead of a 4x4 multiply, and renormalize() removes accumulated drift.
+// Rotations match Mat4::rotationX/Y/Z.
+struct Similarity {
+    double qw = 1.0, qx = 0.0, qy = 0.0, qz = 0.0;
+    Vec3d t;
+    double s = 1.0;
+
+    static Similarity identity() { return Similarity{}; }
+    static Similarity translation(double tx, double ty, double tz) {
+        Similarity S;
+        S.t = Vec3d{ tx, ty, tz };
+        return S;
+    }
+    // Same sense as Mat4::rotationX/Y/Z; identity for an unknown axis
+    static Similarity rotation(double radians, char axis) {
+        Similarity S;
+        const double h = -0.5 * radians;
+        const double c = std::cos(h), sn = std::sin(h);
+        switch (axis) {
+            case 'x': S.qw = c; S.qx = sn; break;
+            case 'y': S.qw = c; S.qy = sn; break;
+            case 'z': S.qw = c; S.qz = sn; break;
+            default: break;
+        }
+        return S;
+    }
+    static Similarity scaling(double factor) {
+        Similarity S;
+        S.s = factor;
+        return S;
+    }
+
+    bool hasRotation() const { return qx != 0.0 || qy != 0.0 || qz != 0.0; }
+
+    // R(q) * v
+    Vec3d rotate(const Vec3d& v) const {
+        // v + 2w (u x v) + 2 u x (u x v), u = (qx, qy, qz)
+        const double cx = qy * v.z - qz * v.y, cy = qz * v.x - qx * v.z, cz = qx * v.y - qy * v.x;
+        return Vec3d{ v.x + 2.0 * (qw * cx + qy * cz - qz * cy),
+                      v.y + 2.0 * (qw * cy + qz * cx - qx * cz),
+                      v.z + 2.0 * (qw * cz + qx * cy - qy * cx) };
+    }
+
+    Vec3d apply(const Vec3d& p) const {
+        const Vec3d r = rotate(p);
+        return Vec3d{ s * r.x + t.x, s * r.y + t.y, s * r.z + t.z };
+    }
+
+    void renormalize() {
+        const double len = std::sqrt(qw * qw + qx * qx + qy * qy + qz * qz);
+        if (len > 0.0) { qw /= len; qx /= len; qy /= len; qz /= len; }
+    }
+
+    // Rotation part as a column-major 3x3 (r[row + 3*col])
+    void rotationMatrix(double r[9]) const {
+        r[0] = 1 - 2 * (qy*qy + qz*qz); r[3] = 2 * (qx*qy - qw*qz);     r[6] = 2 * (qx*qz + qw*qy);
+        r[1] = 2 * (qx*qy + qw*qz);     r[4] = 1 - 2 * (qx*qx + qz*qz); r[7] = 2 * (qy*qz - qw*qx);
+        r[2] = 2 * (qx*qz - qw*qy);     r[5] = 2 * (qy*qz + qw*qx);     r[8] = 1 - 2 * (qx*qx + qy*qy);
+    }
+
+    Mat4d toMatrix() const {
+        double r[9];
+        rotationMatrix(r);
+        Mat4d M = Mat4d::identity();
+        for (int c = 0; c < 3; ++c) {
+            for (int row = 0; row < 3; ++row) M.m[row + 4 * c] = s * r[row + 3 * c];
+        }
+        M.m[12] = t.x; M.m[13] = t.y; M.m[14] = t.z;
+        return M;
+    }
+};
+
+// A then B
+inline Similarity operator*(const Similarity& A, const Similarity& B) {
+    Similarity R;
+    R.qw = B.qw * A.qw - B.qx * A.qx - B.qy * A.qy - B.qz * A.qz;
+    R.qx = B.qw * A.qx + B.qx * A.qw + B.qy * A.qz - B.qz * A.qy;
+    R.qy = B.qw * A.qy - B.qx * A.qz + B.qy * A.qw + B.qz * A.qx;
+    R.qz = B.qw * A.qz + B.qx * A.qy - B.qy * A.qx + B.qz * A.qw;
+    const Vec3d bt = B.rotate(A.t);
+    R.t = Vec3d{ B.s * bt.x + B.t.x, B.s * bt.y + B.t.y, B.s * bt.z + B.t.z };
+    R.s = A.s * B.s;
+    return R;
+}
+
+// Float matrix for offsets stored relative to 'in' that applies M to in + offset and
+// expresses the result relative to 'out':  offset' = L*offset + (L*in + t - out).
+// The translation is formed in double, so large coordinates never reach float math.
+inline Mat4 rebasedMatrix(const Similarity& S, const Vec3d& in, const Vec3d& out) {
+    const Mat4d M = S.toMatrix();
+    Mat4 R = M.cast<float>();
+    R.m[12] = static_cast<float>(M.m[0]*in.x + M.m[4]*in.y + M.m[8]*in.z  + M.m[12] - out.x);
+    R.m[13] = static_cast<float>(M.m[1]*in.x + M.m[5]*in.y + M.m[9]*in.z  + M.m[13] - out.y);
+    R.m[14] = static_cast<float>(M.m[2]*in.x + M.m[6]*in.y + M.m[10]*in.z + M.m[14] - out.z);
+    return R;
+}
+
 struct Point {
     float x, y, z;
     int r, g, b; // color components
     float nx, ny, nz; // normal components
 };
 
-class PointCloud {
+// Positions by M, normals by its linear part (translation ignored)
+inline void transformPointAndNormal(const Mat4& M, Point& p) {
+    float ox, oy, oz;
+    transformPoint(M, p.x, p.y, p.z, ox, oy, oz);
+    p.x = ox; p.y = oy; p.z = oz;
+    const float nx = M.m[0]*p.nx + M.m[4]*p.ny + M.m[8]*p.nz;
+    const float ny = M.m[1]*p.nx + M.m[5]*p.ny + M.m[9]*p.nz;
+    const float nz = M.m[2]*p.nx + M.m[6]*p.ny + M.m[10]*p.nz;
+    p.nx = nx; p.ny = ny; p.nz = nz;
+}
+
+// Similarity applied to points (and normals, which only rotate) in float, rebased like
+// rebasedMatrix(). A pure translation skips the rotation work entirely.
+struct SimilarityKernel {
+    float sr[9];   // s * R, column-major 3x3
+    float r[9];    // R, for normals (unit length is preserved)
+    float tx, ty, tz;
+    bool translateOnly;
+
+    SimilarityKernel(const Similarity& S, const Vec3d& in, const Vec3d& out) {
+        double rd[9];
+        S.rotationMatrix(rd);
+        for (int i = 0; i < 9; ++i) { r[i] = static_cast<float>(rd[i]); sr[i] = static_cast<float>(S.s * rd[i]); }
+        const Vec3d m = S.apply(in);
+        tx = static_cast<float>(m.x - out.x);
+        ty = static_cast<float>(m.y - out.y);
+        tz = static_cast<float>(m.z - out.z);
+        translateOnly = !S.hasRotation() && S.s == 1.0;
+    }
+
+    void operator()(Point& p) const {
+        if (translateOnly) { p.x += tx; p.y += ty; p.z += tz; return; }
+        const float x = p.x, y = p.y, z = p.z;
+        p.x = sr[0]*x + sr[3]*y + sr[6]*z + tx;
+        p.y = sr[1]*x + sr[4]*y + sr[7]*z + ty;
+        p.z = sr[2]*x + sr[5]*y + sr[8]*z + tz;
+        const float nx = p.nx, ny = p.ny, nz = p.nz;
+        p.nx = r[0]*nx + r[3]*ny + r[6]*nz;
+        p.ny = r[1]*nx + r[4]*ny + r[7]*nz;
+        p.nz = r[2]*nx + r[5]*ny + r[8]*nz;
+    }
+};
+
+// Incremental reader for ASCII PLY vertex data. Parses the header on open() and then
+// hands out points in caller-sized chunks, so loads can be streamed and interrupted.
+// Vertex properties are mapped by name: x/y/z, red/green/blue and nx/ny/nz fill Point;
+// every other scalar property becomes an attribute column of its declared type.
+class PlyAsciiReader {
 private:
-    std::vector<Point> points;
+    enum Role : int { X, Y, Z, Red, Green, Blue, NX, NY, NZ, Extra };
+    struct Property {
+        std::string name;
+        AttributeType type = AttributeType::F32;
+        int role = Extra;
+    };
 
-    // Snapshot of originally loaded points (for fast reset)
-    std::vector<Point> originalPoints;
+    std::ifstream file;
+    std::string line;
+    size_t vertices = 0;
+    size_t consumed = 0;            // vertex lines returned so far
+    std::vector<Property> schema;   // vertex properties in file order
+    int positionFields = 0;         // fields a line needs to hold x, y and z
+    std::vector<double> row;
+    bool hasRole[Extra] = {};
+    bool error = false;
+    uint64_t fileBytes = 0;
 
+    static int roleOf(const std::string& name) {
+        static const char* const names[][3] = {
+            { "x", "", "" }, { "y", "", "" }, { "z", "", "" },
+            { "red", "r", "diffuse_red" }, { "green", "g", "diffuse_green" }, { "blue", "b", "diffuse_blue" },
+            { "nx", "normal_x", "" }, { "ny", "normal_y", "" }, { "nz", "normal_z", "" },
+        };
+        for (int r = 0; r < Extra; ++r) {
+            for (const char* n : names[r]) if (*n && name == n) return r;
+        }
+        return Extra;
+    }
+
+    // Parse up to 'count' numbers; returns how many were read
+    template <typename T>
+    static int parseNumbers(const char*& c, T* out, int count) {
+        int k = 0;
+        for (; k < count; ++k) {
+            char* end = nullptr;
+            const double v = std::strtod(c, &end);
+            if (end == c) break;
+            out[k] = static_cast<T>(v);
+            c = end;
+        }
+        return k;
+    }
+
+public:
+    bool open(const std::string& filename) {
+        file.open(filename, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Error: Unable to open file " << filename << std::endl;
+            return false;
+        }
+        file.seekg(0, std::ios::end);
+        fileBytes = static_cast<uint64_t>(file.tellg());
+        file.seekg(0, std::ios::beg);
+        bool inVertex = false;
+        while (std::getline(file, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line == "end_header") {
+                if (!hasRole[X] || !hasRole[Y] || !hasRole[Z]) {
+                    std::cerr << "Error: " << filename << " has no x/y/z vertex properties" << std::endl;
+                    return false;
+                }
+                row.resize(schema.size());
+                return true;
+            }
+            std::istringstream words(line);
+            std::string keyword;
+            words >> keyword;
+            if (keyword == "element") {
+                std::string element;
+                words >> element;
+                inVertex = element == "vertex";
+                if (inVertex) words >> vertices;
+            } else if (keyword == "property" && inVertex) {
+                std::string type, name;
+                words >> type >> name;
+                Property prop;
+                if (type == "list" || !attributeTypeFromPly(type, prop.type)) {
+                    std::cerr << "Error: Unsupported vertex property '" << line << "' in " << filename << std::endl;
+                    return false;
+                }
+                prop.name = name;
+                prop.role = roleOf(name);
+                if (prop.role != Extra) hasRole[prop.role] = true;
+                schema.push_back(prop);
+                if (prop.role <= Z) positionFields = static_cast<int>(schema.size());
+            }
+        }
+        std::cerr << "Error: Missing end_header in " << filename << std::endl;
+        return false;
+    }
+
+    // Read up to maxPoints into out; returns 0 at end of data or on error.
+    // When 'absolute' is given it receives the positions in double precision (for
+    // georeferenced data whose coordinates do not fit a float). When 'attributes' is
+    // given it is set up with one column per extra property (declareAttributes) and
+    // rows [0, n) receive the values of the points returned.
+    size_t read(Point* out, size_t maxPoints, Vec3d* absolute = nullptr, AttributeSet* attributes = nullptr) {
+        std::vector<AttributeChannel*> columns;
+        if (attributes) {
+            declareAttributes(*attributes);
+            if (attributes->rows() < maxPoints) attributes->resize(maxPoints);
+            for (const auto& prop : schema) columns.push_back(prop.role == Extra ? attributes->find(prop.name) : nullptr);
+        }
+        const int fields = static_cast<int>(schema.size());
+        size_t n = 0;
+        // Stop at the declared count: other elements (faces...) may follow the vertices
+        while (n < maxPoints && consumed < vertices && std::getline(file, line)) {
+            const char* c = line.c_str();
+            const int got = parseNumbers(c, row.data(), fields);
+            if (got < positionFields) {
+                if (got == 0 && line.find_first_not_of(" \t\r") == std::string::npos) continue;
+                std::cerr << "Error: Invalid point data in file." << std::endl;
+                error = true;
+                return 0;
+            }
+            std::fill(row.begin() + got, row.end(), 0.0); // short lines: missing fields read as 0
+            ++consumed;
+            Point p = {};
+            double xyz[3] = { 0.0, 0.0, 0.0 };
+            for (int k = 0; k < fields; ++k) {
+                const double v = row[k];
+                switch (schema[k].role) {
+                    case X: case Y: case Z: xyz[schema[k].role] = v; break;
+                    case Red:   p.r = static_cast<int>(v); break;
+                    case Green: p.g = static_cast<int>(v); break;
+                    case Blue:  p.b = static_cast<int>(v); break;
+                    case NX: p.nx = static_cast<float>(v); break;
+                    case NY: p.ny = static_cast<float>(v); break;
+                    case NZ: p.nz = static_cast<float>(v); break;
+                    default: if (attributes) columns[k]->set(n, v); break;
+                }
+            }
+            p.x = static_cast<float>(xyz[0]); p.y = static_cast<float>(xyz[1]); p.z = static_cast<float>(xyz[2]);
+            if (absolute) absolute[n] = Vec3d{ xyz[0], xyz[1], xyz[2] };
+            out[n++] = p;
+        }
+        return n;
+    }
+
+    // Add (zero-filled) columns for the extra vertex properties to 'attributes'
+    void declareAttributes(AttributeSet& attributes) const {
+        for (const auto& prop : schema) {
+            if (prop.role == Extra) attributes.add(prop.name, prop.type);
+        }
+    }
+
+    size_t vertexCount() const { return vertices; }
+    bool hasNormals() const { return hasRole[NX] && hasRole[NY] && hasRole[NZ]; }
+    bool failed() const { return error; }
+    uint64_t totalBytes() const { return fileBytes; }
+    uint64_t bytesRead() {
+        const auto pos = file.tellg();
+        return pos < 0 ? fileBytes : static_cast<uint64_t>(pos);
+    }
+};
+
+// Point storage: huge-page/NUMA aware per AllocationPolicy, no zeroing on resize
+using PointBuffer = std::vector<Point, PointAllocator<Point>>;
+
+class PointCloud {
+public:
     // Lightweight cached statistics (AABB + centroid), recomputed on demand
     struct Stats {
         float cx=0.f, cy=0.f, cz=0.f;     // centroid
@@ -72,57 +416,330 @@ private:
         float maxX=0.f, maxY=0.f, maxZ=0.f;
         bool  valid=false;
     };
+
+    // Georeferenced storage: points [begin, next chunk's begin) are float offsets from
+    // the cloud origin + 'offset' (double). A cloud without chunks is a single implicit
+    // chunk at offset zero, which is the usual case for data near the origin.
+    struct Chunk {
+        size_t begin;
+        Vec3d offset;
+    };
+
+    // Largest per-axis float offset from a chunk origin (keeps ~0.25 mm resolution)
+    static constexpr double kChunkExtent = 2048.0;
+
+private:
+    PointBuffer points;
+    std::vector<Chunk> chunks;
+
+    // Double-precision origin of the cloud frame. Stats, bounds, filters and
+    // forEachTransformedPoint work relative to it.
+    Vec3d origin;
+
+    // Extra per-point columns (intensity, classification, ...), one row per point
+    AttributeSet attrs;
+
+    // Snapshot of originally loaded points (for fast reset)
+    PointBuffer originalPoints;
+    std::vector<Chunk> originalChunks;
+    AttributeSet originalAttrs;
+
     mutable Stats stats{};
+    mutable std::array<QuantileSketch, 3> sketches; // per-axis value distribution, kept with stats
     mutable bool statsDirty = true;
+    uint64_t version = 0;            // bumped on every change to points or model
+
+    inline void markDirty() noexcept { statsDirty = true; ++version; }
 
-    Mat4 model = Mat4::identity();   // pending global transform (lazy)
+    Similarity model;                // pending global transform (lazy, composed in double)
     bool hasPendingModel = false;    // true if there's an unapplied model
+    unsigned modelSteps = 0;         // compositions since the last renormalisation
+
+    // Append S to the pending model; the quaternion is renormalised every few steps
+    void composeModel(const Similarity& S) {
+        model = model * S;
+        if (++modelSteps >= 32) { model.renormalize(); modelSteps = 0; }
+        hasPendingModel = true;
+        markDirty();
+    }
+
+    void resetModel() {
+        model = Similarity::identity();
+        hasPendingModel = false;
+        modelSteps = 0;
+    }
+
+    bool normalsValid = false;       // normals loaded from file or estimated
+    bool loadedNormals = false;      // normals present in originalPoints
+
+    // Transient buffers for filters/downsampling, reused between calls (and between
+    // files in batch mode) instead of allocating fresh temporaries each time. Only
+    // mutating operations borrow from it: the pool is not thread-safe, so const methods
+    // (callable concurrently on a shared cloud) use local buffers.
+    ScratchPool scratchPool;
+    NeighborGraph knn;                       // cached by neighbors(), valid for knnVersion
+    uint64_t knnVersion = ~uint64_t(0);
+    mutable ConvexHull hull;                 // cached by getConvexHull(), dropped with the stats
+    mutable OrientedBox orientedBox;         // cached by getOrientedBox(), likewise
+    mutable bool hullCached = false, boxCached = false;
+    struct VoxelKey { uint64_t key; uint32_t index; uint32_t chunk; };
+
+    size_t chunkIndexOf(size_t i) const {
+        const auto it = std::upper_bound(chunks.begin(), chunks.end(), i,
+                                         [](size_t v, const Chunk& c) { return v < c.begin; });
+        return it == chunks.begin() ? 0 : static_cast<size_t>(it - chunks.begin()) - 1;
+    }
+
+    // Calls f(begin, end, offset) for the part of [b, e) that lies in each chunk
+    template <typename F>
+    void forEachChunkSpan(size_t b, size_t e, F f) const {
+        if (b >= e) return;
+        if (chunks.empty()) { f(b, e, Vec3d{}); return; }
+        for (size_t k = chunkIndexOf(b); b < e; ++k) {
+            const size_t ce = k + 1 < chunks.size() ? std::min(e, chunks[k + 1].begin) : e;
+            f(b, ce, chunks[k].offset);
+            b = ce;
+        }
+    }
+
+    // Stored positions in the cloud frame (chunk offsets added), xyz interleaved
+    void gatherPositions(float* f) const {
+        parallelFor(points.size(), [&](size_t b, size_t e, unsigned) {
+            forEachChunkSpan(b, e, [&](size_t cb, size_t ce, const Vec3d& d) {
+                const float dx = static_cast<float>(d.x), dy = static_cast<float>(d.y), dz = static_cast<float>(d.z);
+                for (size_t i = cb; i < ce; ++i) {
+                    f[3 * i] = points[i].x + dx; f[3 * i + 1] = points[i].y + dy; f[3 * i + 2] = points[i].z + dz;
+                }
+            });
+        });
+    }
+
+    // Fold points [before, size()) into cached stats that were current before they were added
+    void foldIntoStats(size_t before) {
+        if (statsDirty || !stats.valid) { markDirty(); return; }
+        double sumX = 0.0, sumY = 0.0, sumZ = 0.0;
+        forEachChunkSpan(before, points.size(), [&](size_t b, size_t e, const Vec3d& d) {
+            for (size_t i = b; i < e; ++i) {
+                const float x = static_cast<float>(points[i].x + d.x);
+                const float y = static_cast<float>(points[i].y + d.y);
+                const float z = static_cast<float>(points[i].z + d.z);
+                stats.minX = std::min(stats.minX, x); stats.maxX = std::max(stats.maxX, x);
+                stats.minY = std::min(stats.minY, y); stats.maxY = std::max(stats.maxY, y);
+                stats.minZ = std::min(stats.minZ, z); stats.maxZ = std::max(stats.maxZ, z);
+                sumX += x; sumY += y; sumZ += z;
+            }
+            const Point* p = points.data() + b;
+            sketches[0].addRange(e - b, [&](uint64_t i) { return static_cast<float>(p[i].x + d.x); });
+            sketches[1].addRange(e - b, [&](uint64_t i) { return static_cast<float>(p[i].y + d.y); });
+            sketches[2].addRange(e - b, [&](uint64_t i) { return static_cast<float>(p[i].z + d.z); });
+        });
+        const double total = static_cast<double>(points.size());
+        stats.cx = static_cast<float>((stats.cx * static_cast<double>(before) + sumX) / total);
+        stats.cy = static_cast<float>((stats.cy * static_cast<double>(before) + sumY) / total);
+        stats.cz = static_cast<float>((stats.cz * static_cast<double>(before) + sumZ) / total);
+        hullCached = boxCached = false;
+        ++version;
+    }
+
+    // Ascending indices i with keep[i] != 0
+    std::vector<uint32_t> indicesWhere(const uint8_t* keep) const {
+        std::vector<std::vector<uint32_t>> parts(workerCount());
+        parallelFor(points.size(), [&](size_t b, size_t e, unsigned w) {
+            for (size_t i = b; i < e; ++i)
+                if (keep[i]) parts[w].push_back(static_cast<uint32_t>(i));
+        });
+        // workers hold ascending, disjoint ranges
+        std::sort(parts.begin(), parts.end(), [](const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+            return !a.empty() && (b.empty() || a.front() < b.front());
+        });
+        size_t total = 0;
+        for (const auto& p : parts) total += p.size();
+        std::vector<uint32_t> out;
+        out.reserve(total);
+        for (const auto& p : parts) out.insert(out.end(), p.begin(), p.end());
+        return out;
+    }
 
+    // Grid over the stored positions in the cloud frame. A fixed cell size is raised
+    // where needed to keep cell coordinates within 21 bits per axis.
+    void buildGrid(NeighborGrid& grid, float cellSize, size_t perCell) const {
+        std::vector<float> xyz(points.size() * 3);
+        float* f = xyz.data();
+        gatherPositions(f);
+        if (cellSize > 0.0f) {
+            const auto& s = getStats();
+            const float extent = std::max({ s.maxX - s.minX, s.maxY - s.minY, s.maxZ - s.minZ });
+            cellSize = std::max(cellSize, extent / 1.0e6f);
+        }
+        grid.build(points.size(), [f](size_t i, float p[3]) { p[0] = f[3 * i]; p[1] = f[3 * i + 1]; p[2] = f[3 * i + 2]; },
+                   cellSize, perCell);
+    }
+
+    void poissonDiskMask(float radius, uint64_t seed, uint8_t* keep) const {
+        // stored distances are displayed ones over the pending model's scale
+        const float r = static_cast<float>(radius / std::fabs(model.s));
+        NeighborGrid grid;
+        buildGrid(grid, r, 0);
+        std::fill(keep, keep + points.size(), uint8_t(0));
+        poissonDiskSelect(grid, r, seed, keep);
+    }
+
+    // Stable in-place compaction keeping points for which keep(i, x, y, z) holds, with
+    // (x, y, z) in the cloud frame. Chunk ranges are rebuilt for the survivors.
+    template <typename Pred>
+    void compactWhere(const Pred& keep) {
+        std::vector<Chunk> kept;
+        // surviving indices, only needed to carry attribute columns along
+        auto rows = scratchPool.borrow<uint32_t>(attrs.empty() ? 0 : points.size());
+        size_t out = 0;
+        forEachChunkSpan(0, points.size(), [&](size_t b, size_t e, const Vec3d& d) {
+            const size_t first = out;
+            const float dx = static_cast<float>(d.x), dy = static_cast<float>(d.y), dz = static_cast<float>(d.z);
+            for (size_t i = b; i < e; ++i) {
+                const Point& p = points[i];
+                if (!keep(i, p.x + dx, p.y + dy, p.z + dz)) continue;
+                if (rows.size()) rows[out] = static_cast<uint32_t>(i);
+                points[out++] = p;
+            }
+            if (out > first) kept.push_back(Chunk{ first, d });
+        });
+        points.resize(out);
+        if (!chunks.empty()) chunks.swap(kept);
+        if (!attrs.empty()) attrs.compact(rows.data(), out);
+        markDirty();
+    }
+
+    template <typename Pred>
+    void compactIf(const Pred& keep) {
+        compactWhere([&](size_t, float x, float y, float z) { return keep(x, y, z); });
+    }
+
+    // Map from positions stored relative to chunk offset d to region's frame: the
+    // pending model, then region.frame, composed in double
+    void cropMatrix(const CropRegion& region, const Vec3d& d, float m[12]) const { framedMatrix(region.frame, d, m); }
+
+    // Chunk 'd' -> frame F (row-major 3x4 from the cloud frame), pending model included
+    void framedMatrix(const double F[12], const Vec3d& d, float m[12]) const {
+        const Mat4d M = model.toMatrix();
+        double A[12];
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 3; ++c) A[4 * r + c] = M.m[4 * c + r];
+            A[4 * r + 3] = M.m[12 + r] + M.m[r] * d.x + M.m[4 + r] * d.y + M.m[8 + r] * d.z;
+        }
+        for (int r = 0; r < 3; ++r)
+            for (int c = 0; c < 4; ++c)
+                m[4 * r + c] = static_cast<float>(F[4 * r] * A[c] + F[4 * r + 1] * A[4 + c] + F[4 * r + 2] * A[8 + c] + (c == 3 ? F[4 * r + 3] : 0.0));
+    }
+
+    // keep[i] = whether region keeps point i as displayed, one parallel pass
+    void cropMask(const CropRegion& region, uint8_t* keep) const {
+        const float* base = reinterpret_cast<const float*>(points.data());
+        constexpr size_t stride = sizeof(Point) / sizeof(float);
+        parallelFor(points.size(), [&](size_t b, size_t e, unsigned) {
+            forEachChunkSpan(b, e, [&](size_t cb, size_t ce, const Vec3d& d) {
+                float m[12];
+                cropMatrix(region, d, m);
+                crop::classify(base + cb * stride, stride, ce - cb, m, region, keep + cb);
+            });
+        });
+    }
+
+    // One pass, split over the worker pool; per-worker partials are merged at the end
     inline void recomputeStats() const noexcept {
         Stats s{};
         if (!points.empty()) {
-            s.minX = s.maxX = points[0].x;
-            s.minY = s.maxY = points[0].y;
-            s.minZ = s.maxZ = points[0].z;
+            struct Partial {
+                float minX, minY, minZ, maxX, maxY, maxZ;
+                double sumX = 0.0, sumY = 0.0, sumZ = 0.0;
+                QuantileSketch axis[3];
+                bool used = false;
+            };
+            std::vector<Partial> parts(workerCount());
+            const Point* pts = points.data();
+            parallelFor(points.size(), [&](size_t b, size_t e, unsigned w) {
+                Partial a;
+                for (auto& q : a.axis) q.expect(e - b);
+                a.minX = a.minY = a.minZ = std::numeric_limits<float>::max();
+                a.maxX = a.maxY = a.maxZ = -std::numeric_limits<float>::max();
+                // chunk offsets are added per span; zero for clouds without chunks
+                forEachChunkSpan(b, e, [&](size_t cb, size_t ce, const Vec3d& d) {
+                    const float dx = static_cast<float>(d.x), dy = static_cast<float>(d.y), dz = static_cast<float>(d.z);
+                    for (size_t i = cb; i < ce; ++i) {
+                        const float x = pts[i].x + dx, y = pts[i].y + dy, z = pts[i].z + dz;
+                        a.minX = std::min(a.minX, x); a.maxX = std::max(a.maxX, x);
+                        a.minY = std::min(a.minY, y); a.maxY = std::max(a.maxY, y);
+                        a.minZ = std::min(a.minZ, z); a.maxZ = std::max(a.maxZ, z);
+                        a.sumX += x; a.sumY += y; a.sumZ += z;
+                    }
+                    // the sketches only read the points their samplers keep
+                    const Point* p = pts + cb;
+                    a.axis[0].addRange(ce - cb, [&](uint64_t i) { return p[i].x + dx; });
+                    a.axis[1].addRange(ce - cb, [&](uint64_t i) { return p[i].y + dy; });
+                    a.axis[2].addRange(ce - cb, [&](uint64_t i) { return p[i].z + dz; });
+                });
+                a.used = true;
+                parts[w] = std::move(a);
+            });
             double sumX = 0.0, sumY = 0.0, sumZ = 0.0;
-            for (const auto& p : points) {
-                if (p.x < s.minX) s.minX = p.x; if (p.x > s.maxX) s.maxX = p.x;
-                if (p.y < s.minY) s.minY = p.y; if (p.y > s.maxY) s.maxY = p.y;
-                if (p.z < s.minZ) s.minZ = p.z; if (p.z > s.maxZ) s.maxZ = p.z;
-                sumX += p.x; sumY += p.y; sumZ += p.z;
-            }
-            const float invN = 1.0f / static_cast<float>(points.size());
-            s.cx = static_cast<float>(sumX) * invN;
-            s.cy = static_cast<float>(sumY) * invN;
-            s.cz = static_cast<float>(sumZ) * invN;
+            bool first = true;
+            for (auto& q : sketches) q.clear();
+            for (const auto& a : parts) {
+                if (!a.used) continue;
+                for (int k = 0; k < 3; ++k) sketches[k].merge(a.axis[k]);
+                if (first) {
+                    s.minX = a.minX; s.minY = a.minY; s.minZ = a.minZ;
+                    s.maxX = a.maxX; s.maxY = a.maxY; s.maxZ = a.maxZ;
+                    first = false;
+                }
+                s.minX = std::min(s.minX, a.minX); s.maxX = std::max(s.maxX, a.maxX);
+                s.minY = std::min(s.minY, a.minY); s.maxY = std::max(s.maxY, a.maxY);
+                s.minZ = std::min(s.minZ, a.minZ); s.maxZ = std::max(s.maxZ, a.maxZ);
+                sumX += a.sumX; sumY += a.sumY; sumZ += a.sumZ;
+            }
+            const double invN = 1.0 / static_cast<double>(points.size());
+            s.cx = static_cast<float>(sumX * invN);
+            s.cy = static_cast<float>(sumY * invN);
+            s.cz = static_cast<float>(sumZ * invN);
             s.valid = true;
         }
+        if (points.empty()) for (auto& q : sketches) q.clear();
         stats = s;
         statsDirty = false;
+        hullCached = boxCached = false;
     }
 
-    inline const Stats& getStats() const noexcept {
-        if (statsDirty) recomputeStats();
-        return stats;
+    // Grow the cloud by n points (left uninitialised) relative to the cloud origin and
+    // return the first new index; endAppend() finishes once they are filled in
+    size_t beginAppend(size_t n, bool withNormals) {
+        if (points.empty()) normalsValid = withNormals;
+        else normalsValid = normalsValid && withNormals;
+        const size_t before = points.size();
+        // positions are relative to the cloud origin: continue in a zero-offset chunk
+        if (!chunks.empty() && !chunks.back().offset.isZero()) chunks.push_back(Chunk{ before, Vec3d{} });
+        points.resize(before + n);
+        return before;
+    }
+
+    void endAppend(size_t before) {
+        attrs.resize(points.size());
+        // cached stats that are current get only the new points folded in
+        foldIntoStats(before);
+    }
+
+    // Parallel copy into default-initialised storage, so dst pages are first touched
+    // by the same workers that process them later
+    static void copyPoints(PointBuffer& dst, const PointBuffer& src) {
+        dst.resize(src.size());
+        Point* d = dst.data();
+        const Point* sp = src.data();
+        parallelFor(src.size(), [d, sp](size_t b, size_t e, unsigned) {
+            std::memcpy(static_cast<void*>(d + b), sp + b, (e - b) * sizeof(Point));
+        });
     }
 
     inline void bakePendingModel() {
         if (!hasPendingModel) return;
-        for (auto& p : points) {
-            float ox, oy, oz;
-            transformPoint(model, p.x, p.y, p.z, ox, oy, oz);
-            p.x = ox; p.y = oy; p.z = oz;
-        }
-        // rotate normals by linear part (ignore translation)
-        for (auto& p : points) {
-            float nx = model.m[0]*p.nx + model.m[4]*p.ny + model.m[8]*p.nz;
-            float ny = model.m[1]*p.nx + model.m[5]*p.ny + model.m[9]*p.nz;
-            float nz = model.m[2]*p.nx + model.m[6]*p.ny + model.m[10]*p.nz;
-            p.nx = nx; p.ny = ny; p.nz = nz;
-        }
-        model = Mat4::identity();
-        hasPendingModel = false;
-        statsDirty = true;
+        applyChunkKernel([](const Vec3d&) { return [](Point&) {}; });
     }
 
     // Apply a 4x4 transformation matrix to all points
@@ -133,116 +750,1152 @@ private:
             p.y = matrix[1][0] * x + matrix[1][1] * y + matrix[1][2] * z + matrix[1][3];
             p.z = matrix[2][0] * x + matrix[2][1] * y + matrix[2][2] * z + matrix[2][3];
         }
-        statsDirty = true;
+        markDirty();
+    }
+
+    // Finite min/max of an attribute column (per-worker partials, merged)
+    void columnRange(const AttributeChannel& c, double& lo, double& hi) const {
+        std::vector<std::array<double, 2>> parts(workerCount(), { std::numeric_limits<double>::max(), -std::numeric_limits<double>::max() });
+        visitAttributeType(c.type, [&](auto tag) {
+            using T = decltype(tag);
+            const T* v = c.data<T>();
+            parallelFor(c.size(), [&](size_t b, size_t e, unsigned w) {
+                double mn = parts[w][0], mx = parts[w][1];
+                for (size_t i = b; i < e; ++i) {
+                    const double x = static_cast<double>(v[i]);
+                    if (!std::isfinite(x)) continue;
+                    mn = std::min(mn, x); mx = std::max(mx, x);
+                }
+                parts[w] = { mn, mx };
+            });
+        });
+        lo = std::numeric_limits<double>::max(); hi = -lo;
+        for (const auto& m : parts) { lo = std::min(lo, m[0]); hi = std::max(hi, m[1]); }
+        if (lo > hi) lo = hi = 0.0;
+    }
+
+    // Local density: points per unit volume of the grid cell each point falls in. Cells
+    // come from sorted voxel keys; each occupied cell is counted once, weighted by its
+    // points, so the histogram is over points.
+    Histogram densityHistogram(const HistogramSpec& spec) const {
+        const auto& s = getStats();
+        // cells are laid out over the stored points; a pending model only rescales them
+        // (cell and density are reported in displayed units)
+        const double scale = hasPendingModel ? std::fabs(model.s) : 1.0;
+        double cell = spec.densityCell;
+        if (!(cell > 0.0)) {
+            // Points sample surfaces: n points over an area of about diag^2 put ~8 in a
+            // cell of edge diag * sqrt(8 / n)
+            const double dx = s.maxX - s.minX, dy = s.maxY - s.minY, dz = s.maxZ - s.minZ;
+            cell = scale * std::sqrt(dx * dx + dy * dy + dz * dz) * std::sqrt(8.0 / static_cast<double>(points.size()));
+            if (!(cell > 0.0)) cell = 1.0;
+        }
+        // cell keys hold 21 bits per axis: coarsen the cell rather than alias distant cells
+        const double extent = scale * std::max({ s.maxX - s.minX, s.maxY - s.minY, s.maxZ - s.minZ });
+        cell = std::max(cell, extent / double((1 << 21) - 1));
+        char label[96];
+        std::snprintf(label, sizeof(label), "density (points per unit^3, cell %g)", cell);
+        const double inv = scale / cell;
+        std::vector<uint64_t> keys(points.size());
+        uint64_t* k = keys.data();
+        parallelFor(points.size(), [&](size_t b, size_t e, unsigned) {
+            forEachChunkSpan(b, e, [&](size_t cb, size_t ce, const Vec3d& d) {
+                const double ox = d.x - s.minX, oy = d.y - s.minY, oz = d.z - s.minZ;
+                for (size_t i = cb; i < ce; ++i) {
+                    const auto& p = points[i];
+                    const uint64_t ix = static_cast<uint64_t>((ox + p.x) * inv) & 0x1FFFFF;
+                    const uint64_t iy = static_cast<uint64_t>((oy + p.y) * inv) & 0x1FFFFF;
+                    const uint64_t iz = static_cast<uint64_t>((oz + p.z) * inv) & 0x1FFFFF;
+                    k[i] = (ix << 42) | (iy << 21) | iz;
+                }
+            });
+        });
+        std::sort(keys.begin(), keys.end());
+        // run lengths overwrite the front of the key buffer
+        size_t cells = 0;
+        uint64_t most = 0;
+        for (size_t b = 0; b < keys.size();) {
+            size_t e = b + 1;
+            while (e < keys.size() && k[e] == k[b]) ++e;
+            k[cells++] = e - b;
+            most = std::max<uint64_t>(most, e - b);
+            b = e;
+        }
+        const double volume = cell * cell * cell;
+        double lo = spec.lo, hi = spec.hi;
+        if (!(lo < hi)) {
+            // counts are whole numbers: centre them in bins a whole number of points wide
+            const uint64_t bins = spec.binning == HistogramBinning::Fixed ? std::max<size_t>(spec.bins, 1) : most;
+            const uint64_t step = (most + bins - 1) / bins;
+            lo = 0.5 / volume;
+            hi = lo + static_cast<double>(step * bins) / volume;
+        }
+        const HistogramBinner binner(spec, lo, hi);
+        std::vector<uint64_t> counters(binner.bins() + 1, 0);
+        for (size_t c = 0; c < cells; ++c) binner.count(static_cast<double>(k[c]) / volume, k[c], counters.data());
+        return binner.finish(spec, label, counters.data());
     }
 
 public:
-    // Load point cloud data from a PLY file
-    bool loadFromPLY(const std::string& filename) {
-        std::ifstream file(filename);
-        if (!file.is_open()) {
-            std::cerr << "Error: Unable to open file " << filename << std::endl;
+    // Load point cloud data from a PLY file.
+    // Existing storage is reused (cleared, capacity kept) so a PointCloud can be
+    // recycled across many files. keepSnapshot=false skips the reset copy.
+    bool loadFromPLY(const std::string& filename, bool keepSnapshot = true) {
+        PlyAsciiReader reader;
+        if (!reader.open(filename)) return false;
+
+        clear();
+
+        // Reserve from the declared vertex count (no reallocations) and place the
+        // pages with the worker partition before the sequential parse fills them. A
+        // vertex line takes at least 6 bytes ("0 0 0\n"), which bounds a corrupt count.
+        points.resize(std::min<uint64_t>(reader.vertexCount(), (reader.totalBytes() - reader.bytesRead()) / 6));
+        firstTouch(points.data(), points.size());
+        points.clear();
+
+        // Parsed in double and split into chunks by appendGeoreferenced()
+        auto block = scratchPool.borrow<Point>(8192);
+        auto absolute = scratchPool.borrow<Vec3d>(8192);
+        AttributeSet blockAttrs;
+        reader.declareAttributes(attrs);
+        for (;;) {
+            const size_t n = reader.read(block.data(), block.size(), absolute.data(), &blockAttrs);
+            if (n == 0) break;
+            appendGeoreferenced(block.data(), absolute.data(), n, reader.hasNormals(), &blockAttrs);
+        }
+        if (reader.failed()) return false;
+
+        if (points.empty()) {
+            std::cerr << "Error: No points loaded from file." << std::endl;
             return false;
         }
+        normalsValid = loadedNormals = reader.hasNormals();
 
-        std::string line;
-        bool headerEnded = false;
-        size_t propertyCount = 0;
+        // Keep a pristine copy for quick reset and mark stats dirty
+        if (keepSnapshot) { copyPoints(originalPoints, points); originalChunks = chunks; originalAttrs = attrs; }
+        markDirty();
 
-        // Parse the header
-        while (std::getline(file, line)) {
-            if (!headerEnded) {
-                if (line == "end_header") {
-                    headerEnded = true;
-                    // Pre-reserve some capacity to reduce reallocations during push_back
-                    if (points.capacity() == 0) points.reserve(8192);
-                    continue;
-                }
-                if (line.find("property") != std::string::npos) {
-                    propertyCount++;
-                }
-                continue;
+        return true;
+    }
+
+    // Append points (e.g. chunks published by a background loader). They are taken in
+    // the stored frame, so a pending model applies to them as well.
+    void appendPoints(const Point* src, size_t n, bool withNormals) {
+        if (n == 0) return;
+        const size_t before = beginAppend(n, withNormals);
+        std::copy(src, src + n, points.begin() + before);
+        endAppend(before);
+    }
+
+    // Append points whose positions are given in double precision ('absolute'; the
+    // x/y/z in 'src' are ignored). The first points of an empty cloud choose its origin
+    // when they lie far from zero. Points within kChunkExtent of the current chunk origin
+    // extend it in order; the rest of the batch is grouped by a kChunkExtent grid (so
+    // their order changes) and each occupied cell starts a chunk at the cell centre.
+    // 'attributes' (optional) holds one row per source point and follows the same order.
+    void appendGeoreferenced(const Point* src, const Vec3d* absolute, size_t n, bool withNormals,
+                             const AttributeSet* attributes = nullptr) {
+        if (n == 0) return;
+        auto far = [](const Vec3d& v) {
+            return std::fabs(v.x) > kChunkExtent || std::fabs(v.y) > kChunkExtent || std::fabs(v.z) > kChunkExtent;
+        };
+        if (points.empty()) {
+            normalsValid = withNormals;
+            chunks.clear();
+            const Vec3d& a = absolute[0];
+            origin = far(a) ? Vec3d{ std::round(a.x), std::round(a.y), std::round(a.z) } : Vec3d{};
+        } else {
+            normalsValid = normalsValid && withNormals;
+        }
+        const size_t before = points.size();
+        points.resize(before + n);
+
+        size_t out = before;
+        auto order = scratchPool.borrow<uint32_t>(attributes ? n : 0); // stored row -> source row
+        auto store = [&](size_t i, const Vec3d& rel, const Vec3d& offset) {
+            if (attributes) order[out - before] = static_cast<uint32_t>(i);
+            Point p = src[i];
+            p.x = static_cast<float>(rel.x - offset.x);
+            p.y = static_cast<float>(rel.y - offset.y);
+            p.z = static_cast<float>(rel.z - offset.z);
+            points[out++] = p;
+        };
+        auto cell = [](double v) { return static_cast<int64_t>(std::llround(v / kChunkExtent)); };
+
+        Vec3d current = chunks.empty() ? Vec3d{} : chunks.back().offset;
+        auto spill = scratchPool.borrow<VoxelKey>(n);
+        size_t spilled = 0;
+        for (size_t i = 0; i < n; ++i) {
+            const Vec3d rel = absolute[i] - origin;
+            if (!far(rel - current)) { store(i, rel, current); continue; }
+            const uint64_t ix = static_cast<uint64_t>(cell(rel.x) + (1 << 20)) & 0x1FFFFF;
+            const uint64_t iy = static_cast<uint64_t>(cell(rel.y) + (1 << 20)) & 0x1FFFFF;
+            const uint64_t iz = static_cast<uint64_t>(cell(rel.z) + (1 << 20)) & 0x1FFFFF;
+            spill[spilled++] = { (ix << 42) | (iy << 21) | iz, static_cast<uint32_t>(i), 0 };
+        }
+        std::sort(spill.begin(), spill.begin() + spilled,
+                  [](const VoxelKey& a, const VoxelKey& b) { return a.key < b.key || (a.key == b.key && a.index < b.index); });
+        for (size_t k = 0; k < spilled; ++k) {
+            const Vec3d rel = absolute[spill[k].index] - origin;
+            if (k == 0 || spill[k].key != spill[k - 1].key) {
+                current = Vec3d{ cell(rel.x) * kChunkExtent, cell(rel.y) * kChunkExtent, cell(rel.z) * kChunkExtent };
+                if (chunks.empty()) chunks.push_back(Chunk{ 0, Vec3d{} });
+                if (chunks.back().begin == out) chunks.back().offset = current;
+                else chunks.push_back(Chunk{ out, current });
             }
+            store(spill[k].index, rel, current);
+        }
+        if (attributes) attrs.appendRows(*attributes, order.data(), n);
+        else attrs.resize(points.size());
+        foldIntoStats(before);
+    }
 
-            // Parse point data
-            std::istringstream iss(line);
-            Point p = {};
-            if (!(iss >> p.x >> p.y >> p.z)) {
-                std::cerr << "Error: Invalid point data in file." << std::endl;
+    // Replace this cloud by the union of 'inputs' as displayed (pending models applied;
+    // this cloud may be one of them). Space is cut into voxels of edge 'tolerance' held
+    // in one shared hash: a voxel belongs to the first input with a point in it, and the
+    // points later inputs have there are dropped as duplicates. 'blend' sets the colour
+    // of the kept points in voxels several inputs hit. Every pass runs over the points
+    // of all inputs in parallel blocks; survivors are written once, in input order, into
+    // a single new buffer in the frame of the first non-empty input.
+    bool merge(const std::vector<const PointCloud*>& inputs, float tolerance, ColorBlend blend = ColorBlend::KeepFirst) {
+        if (!(tolerance > 0.0f)) {
+            std::cerr << "Error: merge tolerance must be positive" << std::endl;
+            return false;
+        }
+        if (inputs.size() > VoxelMergeTable::kMaxInputs) {
+            std::cerr << "Error: Too many clouds to merge (" << inputs.size() << ")" << std::endl;
+            return false;
+        }
+        auto far = [](const Vec3d& v) {
+            return std::fabs(v.x) > kChunkExtent || std::fabs(v.y) > kChunkExtent || std::fabs(v.z) > kChunkExtent;
+        };
+
+        // One segment per input chunk. Its points map into the output frame relative to
+        // 'offset', an output chunk origin (zero unless the chunk lands far away).
+        struct Segment { uint16_t input; size_t begin, end, global; Vec3d offset; SimilarityKernel kernel; };
+        std::vector<Segment> segs;
+        Vec3d outOrigin;
+        bool haveOrigin = false, withNormals = true;
+        double lo[3] = { 0, 0, 0 }, hi[3] = { 0, 0, 0 };
+        size_t total = 0;
+        for (size_t k = 0; k < inputs.size(); ++k) {
+            const PointCloud& in = *inputs[k];
+            if (in.points.empty()) continue;
+            if (!haveOrigin) { outOrigin = in.origin; haveOrigin = true; }
+            withNormals = withNormals && in.normalsValid;
+            const Vec3d shift = in.origin - outOrigin;
+            float mn[3], mx[3];
+            in.getBounds(mn, mx);
+            const double a[3] = { mn[0] + shift.x, mn[1] + shift.y, mn[2] + shift.z };
+            const double b[3] = { mx[0] + shift.x, mx[1] + shift.y, mx[2] + shift.z };
+            for (int j = 0; j < 3; ++j) {
+                lo[j] = segs.empty() ? a[j] : std::min(lo[j], a[j]);
+                hi[j] = segs.empty() ? b[j] : std::max(hi[j], b[j]);
+            }
+            in.forEachChunkSpan(0, in.points.size(), [&](size_t b0, size_t e0, const Vec3d& d) {
+                const Vec3d c = in.model.apply(d) + shift;
+                const Vec3d offset = far(c) ? Vec3d{ std::round(c.x), std::round(c.y), std::round(c.z) } : Vec3d{};
+                segs.push_back(Segment{ static_cast<uint16_t>(k), b0, e0, total, offset,
+                                        SimilarityKernel(in.model, d, offset - shift) });
+                total += e0 - b0;
+            });
+        }
+        if (total == 0) { clear(); return true; }
+
+        // Voxel keys: 21 bits per axis, counted from the cell of the joint minimum
+        const double inv = 1.0 / static_cast<double>(tolerance);
+        const double base[3] = { std::floor(lo[0] * inv), std::floor(lo[1] * inv), std::floor(lo[2] * inv) };
+        for (int j = 0; j < 3; ++j) {
+            if (std::floor(hi[j] * inv) - base[j] >= double(1 << 21)) {
+                std::cerr << "Error: merge tolerance " << tolerance << " is too fine for the extent of the clouds" << std::endl;
                 return false;
             }
-            if (propertyCount >= 6) {
-                if (!(iss >> p.r >> p.g >> p.b)) p.r = p.g = p.b = 0;
+        }
+        auto keyOf = [&](const Segment& g, const Point& p) {
+            const uint64_t ix = static_cast<uint64_t>(std::max(0.0, std::floor((g.offset.x + p.x) * inv) - base[0])) & 0x1FFFFF;
+            const uint64_t iy = static_cast<uint64_t>(std::max(0.0, std::floor((g.offset.y + p.y) * inv) - base[1])) & 0x1FFFFF;
+            const uint64_t iz = static_cast<uint64_t>(std::max(0.0, std::floor((g.offset.z + p.z) * inv) - base[2])) & 0x1FFFFF;
+            return (ix << 42) | (iy << 21) | iz;
+        };
+        // f(segment, first index, end index, global index of the first) over blocks of
+        // the concatenated inputs, in parallel
+        constexpr size_t kBlock = size_t(1) << 16;
+        const size_t blocks = (total + kBlock - 1) / kBlock;
+        auto forBlocks = [&](auto f) {
+            parallelFor(blocks, [&](size_t bb, size_t be, unsigned) {
+                for (size_t blk = bb; blk < be; ++blk) {
+                    size_t b = blk * kBlock;
+                    const size_t e = std::min(total, b + kBlock);
+                    size_t s = static_cast<size_t>(std::upper_bound(segs.begin(), segs.end(), b,
+                                   [](size_t v, const Segment& g) { return v < g.global; }) - segs.begin()) - 1;
+                    for (; b < e; ++s) {
+                        const Segment& g = segs[s];
+                        const size_t ge = std::min(e, g.global + (g.end - g.begin));
+                        if (ge > b) f(g, g.begin + (b - g.global), g.begin + (ge - g.global), b);
+                        b = ge;
+                    }
+                }
+            }, 1);
+        };
+
+        VoxelMergeTable table;
+        table.reset(total, blend != ColorBlend::KeepFirst);
+        auto slots = scratchPool.borrow<uint32_t>(total);
+        forBlocks([&](const Segment& g, size_t b, size_t e, size_t at) {
+            const Point* src = inputs[g.input]->points.data();
+            for (size_t i = b; i < e; ++i, ++at) {
+                Point p = src[i];
+                g.kernel(p);
+                slots[at] = table.insert(keyOf(g, p), g.input);
+                if (blend == ColorBlend::Average) table.addColour(slots[at], p.r, p.g, p.b);
+            }
+        });
+        if (blend == ColorBlend::KeepLast) {
+            forBlocks([&](const Segment& g, size_t b, size_t e, size_t at) {
+                const Point* src = inputs[g.input]->points.data();
+                for (size_t i = b; i < e; ++i, ++at)
+                    if (table.last(slots[at]) == g.input) table.addColour(slots[at], src[i].r, src[i].g, src[i].b);
+            });
+        }
+
+        // keep the points of each voxel's first input; count per block for the offsets
+        auto keep = scratchPool.borrow<uint8_t>(total);
+        std::vector<size_t> blockStart(blocks + 1, 0);
+        forBlocks([&](const Segment& g, size_t b, size_t e, size_t at) {
+            size_t n = 0;
+            for (size_t i = b, j = at; i < e; ++i, ++j) n += keep[j] = table.first(slots[j]) == g.input;
+            blockStart[at / kBlock + 1] += n;   // one block is only ever visited by one worker
+        });
+        for (size_t k = 0; k < blocks; ++k) blockStart[k + 1] += blockStart[k];
+        auto keptBefore = [&](size_t at) {
+            size_t n = blockStart[at / kBlock];
+            for (size_t i = at / kBlock * kBlock; i < at; ++i) n += keep[i];
+            return n;
+        };
+
+        PointBuffer merged;
+        merged.resize(blockStart[blocks]);
+        Point* out = merged.data();
+        forBlocks([&](const Segment& g, size_t b, size_t e, size_t at) {
+            const Point* src = inputs[g.input]->points.data();
+            size_t o = keptBefore(at);
+            for (size_t i = b; i < e; ++i, ++at) {
+                if (!keep[at]) continue;
+                Point p = src[i];
+                g.kernel(p);
+                const uint32_t slot = slots[at];
+                if (blend != ColorBlend::KeepFirst && table.first(slot) != table.last(slot)) table.meanColour(slot, p.r, p.g, p.b);
+                out[o++] = p;
             }
-            if (propertyCount == 9) {
-                if (!(iss >> p.nx >> p.ny >> p.nz)) p.nx = p.ny = p.nz = 0;
+        });
+
+        // output chunks where segments landed away from the origin
+        std::vector<Chunk> newChunks;
+        bool offsets = false;
+        for (const Segment& g : segs) offsets = offsets || !g.offset.isZero();
+        if (offsets) {
+            for (const Segment& g : segs) {
+                const size_t begin = keptBefore(g.global);
+                if (begin == keptBefore(g.global + (g.end - g.begin))) continue;
+                if (!newChunks.empty() && newChunks.back().offset.x == g.offset.x && newChunks.back().offset.y == g.offset.y &&
+                    newChunks.back().offset.z == g.offset.z) continue;
+                newChunks.push_back(Chunk{ newChunks.empty() ? 0 : begin, g.offset });
             }
-            points.push_back(p);
         }
 
-        if (points.empty()) {
-            std::cerr << "Error: No points loaded from file." << std::endl;
+        AttributeSet mergedAttrs;
+        bool anyAttrs = false;
+        for (const PointCloud* in : inputs) anyAttrs = anyAttrs || !in->attrs.empty();
+        if (anyAttrs) {
+            std::vector<uint32_t> rows;
+            for (size_t k = 0, s = 0; k < inputs.size(); ++k) {
+                rows.clear();
+                for (; s < segs.size() && segs[s].input == k; ++s)
+                    for (size_t i = segs[s].begin, at = segs[s].global; i < segs[s].end; ++i, ++at)
+                        if (keep[at]) rows.push_back(static_cast<uint32_t>(i));
+                if (!rows.empty()) mergedAttrs.appendRows(inputs[k]->attrs, rows.data(), rows.size());
+            }
+        }
+
+        clear();
+        points.swap(merged);
+        chunks.swap(newChunks);
+        origin = outOrigin;
+        attrs = std::move(mergedAttrs);
+        normalsValid = withNormals;
+        return true;
+    }
+
+    // Apply the pending model to the stored points now (no-op when there is none)
+    void bake() { bakePendingModel(); }
+
+    // Make the current points the state restored by resetToOriginal()
+    void commitSnapshot() {
+        bakePendingModel();
+        copyPoints(originalPoints, points);
+        originalChunks = chunks;
+        originalAttrs = attrs;
+        loadedNormals = normalsValid;
+    }
+
+    size_t size() const { return points.size(); }
+
+    // Save the current (baked) points as an ASCII PLY readable by loadFromPLY.
+    // Normals are written only when they were loaded or estimated. Georeferenced
+    // clouds are written with absolute double coordinates.
+    bool saveToPLY(const std::string& filename) {
+        bakePendingModel();
+        std::ofstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Error: Unable to write file " << filename << std::endl;
             return false;
         }
+        const bool geo = isGeoreferenced();
+        const char* coordType = geo ? "double" : "float";
+        file << "ply\nformat ascii 1.0\n"
+             << "element vertex " << points.size() << "\n"
+             << "property " << coordType << " x\nproperty " << coordType << " y\nproperty " << coordType << " z\n"
+             << "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+        if (normalsValid) file << "property float nx\nproperty float ny\nproperty float nz\n";
+        for (const auto& c : attrs.channels()) file << "property " << plyTypeName(c.type) << " " << c.name << "\n";
+        file << "end_header\n";
 
-        // Keep a pristine copy for quick reset and mark stats dirty
-        originalPoints = points;
-        statsDirty = true;
+        // Format into a block buffer; one ofstream write per block instead of per value
+        std::string block;
+        block.reserve(1 << 20);
+        char buf[256 + 32 * 24];
+        const size_t attrCount = std::min<size_t>(attrs.channels().size(), 32);
+        if (attrs.channels().size() > attrCount) {
+            std::cerr << "Error: Too many attribute columns to save " << filename << std::endl;
+            return false;
+        }
+        forEachChunkSpan(0, points.size(), [&](size_t b, size_t e, const Vec3d& d) {
+            const Vec3d base = origin + d;
+            for (size_t i = b; i < e; ++i) {
+                const Point& p = points[i];
+                char* c = buf;
+                c += geo ? std::snprintf(c, 96, "%.15g %.15g %.15g", base.x + p.x, base.y + p.y, base.z + p.z)
+                         : std::snprintf(c, 96, "%g %g %g", p.x, p.y, p.z);
+                c += normalsValid
+                    ? std::snprintf(c, 160, " %d %d %d %g %g %g", p.r, p.g, p.b, p.nx, p.ny, p.nz)
+                    : std::snprintf(c, 160, " %d %d %d", p.r, p.g, p.b);
+                for (const auto& a : attrs.channels()) { *c++ = ' '; c += a.format(i, c, 24); }
+                *c++ = '\n';
+                block.append(buf, static_cast<size_t>(c - buf));
+                if (block.size() > (1 << 20) - 256) { file.write(block.data(), block.size()); block.clear(); }
+            }
+        });
+        file.write(block.data(), block.size());
+        return static_cast<bool>(file);
+    }
 
-        model = Mat4::identity();
-        hasPendingModel = false;
+    // Drop all points but keep allocated capacity for reuse
+    void clear() {
+        points.clear();
+        originalPoints.clear();
+        chunks.clear();
+        originalChunks.clear();
+        attrs.clear();
+        originalAttrs.clear();
+        origin = Vec3d{};
+        resetModel();
+        normalsValid = loadedNormals = false;
+        markDirty();
+    }
+
+    // Keep only points inside the axis-aligned box [min, max] (cloud frame, after the
+    // pending model)
+    void filterBox(float minX, float minY, float minZ, float maxX, float maxY, float maxZ) {
+        bakePendingModel();
+        compactIf([&](float x, float y, float z) {
+            return !(x < minX || x > maxX || y < minY || y > maxY || z < minZ || z > maxZ);
+        });
+    }
+
+    // Keep the points 'region' keeps (see CropRegion), compacting in place. Points are
+    // tested as displayed, with the pending model applied on the fly; it stays pending.
+    void crop(const CropRegion& region) {
+        if (points.empty()) return;
+        auto keep = scratchPool.borrow<uint8_t>(points.size());
+        cropMask(region, keep.data());
+        compactWhere([&](size_t i, float, float, float) { return keep[i] != 0; });
+    }
 
+    // Ascending indices of the points 'region' keeps: a view of the crop that leaves the
+    // cloud untouched
+    std::vector<uint32_t> cropIndices(const CropRegion& region) const {
+        if (points.empty()) return {};
+        std::vector<uint8_t> keep(points.size());
+        cropMask(region, keep.data());
+        return indicesWhere(keep.data());
+    }
+
+    // Blue-noise subsample: keeps a maximal set of points no two of which are closer than
+    // 'radius' (as displayed; the pending model stays pending), compacting in place.
+    // Unlike voxelDownsample() the survivors are original points with no grid pattern;
+    // 'seed' picks among the possible sets. Returns the number kept.
+    size_t poissonDiskSample(float radius, uint64_t seed = 0) {
+        if (points.empty()) return 0;
+        if (!(radius > 0.0f)) {
+            std::cerr << "Error: Poisson-disk radius must be positive" << std::endl;
+            return points.size();
+        }
+        auto keep = scratchPool.borrow<uint8_t>(points.size());
+        poissonDiskMask(radius, seed, keep.data());
+        compactWhere([&](size_t i, float, float, float) { return keep[i] != 0; });
+        return points.size();
+    }
+
+    // Ascending indices of the points poissonDiskSample() would keep
+    std::vector<uint32_t> poissonDiskIndices(float radius, uint64_t seed = 0) const {
+        if (points.empty() || !(radius > 0.0f)) return {};
+        std::vector<uint8_t> keep(points.size());
+        poissonDiskMask(radius, seed, keep.data());
+        return indicesWhere(keep.data());
+    }
+
+    // Indices of 'count' points in farthest-point order, starting at point 'start': each
+    // is the point farthest from all before it, so any prefix is an evenly spread subset.
+    // Shorter when fewer distinct positions remain.
+    std::vector<uint32_t> farthestPointIndices(size_t count, uint32_t start = 0) const {
+        std::vector<uint32_t> out;
+        if (points.empty() || count == 0) return out;
+        if (start >= points.size()) {
+            std::cerr << "Error: Farthest-point start " << start << " is out of range" << std::endl;
+            return out;
+        }
+        // a uniform scale keeps the order, so the stored positions serve as they are
+        NeighborGrid grid;
+        buildGrid(grid, 0.0f, 32);
+        out.resize(std::min(count, points.size()));
+        out.resize(farthestPointSelect(grid, out.size(), start, out.data()));
+        return out;
+    }
+
+    // Keep the first 'count' points of farthestPointIndices(), compacting in place (in
+    // stored order). Returns the number kept.
+    size_t farthestPointSample(size_t count, uint32_t start = 0) {
+        if (points.empty()) return 0;
+        const std::vector<uint32_t> order = farthestPointIndices(count, start);
+        if (order.empty()) return points.size();
+        auto keep = scratchPool.borrow<uint8_t>(points.size());
+        std::fill(keep.begin(), keep.end(), uint8_t(0));
+        for (uint32_t i : order) keep[i] = 1;
+        compactWhere([&](size_t i, float, float, float) { return keep[i] != 0; });
+        return points.size();
+    }
+
+    // Render the cloud as displayed (pending model applied on the fly) into a depth and,
+    // optionally, colour image, keeping the nearest point per pixel. Points are projected
+    // in parallel and binned by 64x64-pixel tile; the tiles are then z-buffered
+    // independently, so no pixel is written by two workers. Ties go to the lower index.
+    bool renderDepthImage(const PinholeCamera& camera, DepthImage& image, bool withColour = true) const {
+        if (camera.width <= 0 || camera.height <= 0 || !(camera.fx > 0.0) || !(camera.fy > 0.0)) {
+            std::cerr << "Error: Invalid camera for depth rendering" << std::endl;
+            return false;
+        }
+        image.resize(camera.width, camera.height, withColour);
+        const size_t n = points.size();
+        if (n == 0) return true;
+        using projection::kTile;
+        using projection::kNoPixel;
+        const size_t tilesX = (camera.width + kTile - 1) / kTile;
+        const size_t tiles = tilesX * ((camera.height + kTile - 1) / kTile);
+        auto tileOf = [&](uint32_t p) { return (p / camera.width) / kTile * tilesX + (p % camera.width) / kTile; };
+        double F[12];
+        camera.viewFrame(F);
+        const float* base = reinterpret_cast<const float*>(points.data());
+        constexpr size_t stride = sizeof(Point) / sizeof(float);
+
+        // project, counting per fixed block of points and tile: blocks, not workers, own
+        // the cursors, so the two passes agree however parallelFor splits the range
+        constexpr size_t kBlock = size_t(1) << 16;
+        const size_t blocks = (n + kBlock - 1) / kBlock;
+        std::vector<uint32_t> pixel(n);
+        std::vector<float> depth(n);
+        std::vector<size_t> cursor(tiles * blocks, 0);
+        parallelFor(blocks, [&](size_t b, size_t e, unsigned) {
+            for (size_t blk = b; blk < e; ++blk) {
+                const size_t pb = blk * kBlock, pe = std::min(n, pb + kBlock);
+                forEachChunkSpan(pb, pe, [&](size_t cb, size_t ce, const Vec3d& d) {
+                    float m[12];
+                    framedMatrix(F, d, m);
+                    projection::projectBlock(base + cb * stride, stride, ce - cb, m, camera, pixel.data() + cb, depth.data() + cb);
+                });
+                size_t* count = cursor.data() + blk * tiles;
+                for (size_t i = pb; i < pe; ++i)
+                    if (pixel[i] != kNoPixel) ++count[tileOf(pixel[i])];
+            }
+        }, 1);
+        // tile-major order, blocks in index order within a tile
+        std::vector<size_t> tileStart(tiles + 1, 0);
+        for (size_t t = 0, at = 0; t < tiles; ++t) {
+            tileStart[t] = at;
+            for (size_t blk = 0; blk < blocks; ++blk) {
+                const size_t c = cursor[blk * tiles + t];
+                cursor[blk * tiles + t] = at;
+                at += c;
+            }
+            tileStart[t + 1] = at;
+        }
+        std::vector<uint32_t> order(tileStart[tiles]);
+        parallelFor(blocks, [&](size_t b, size_t e, unsigned) {
+            for (size_t blk = b; blk < e; ++blk) {
+                size_t* next = cursor.data() + blk * tiles;
+                for (size_t i = blk * kBlock; i < std::min(n, (blk + 1) * kBlock); ++i)
+                    if (pixel[i] != kNoPixel) order[next[tileOf(pixel[i])]++] = static_cast<uint32_t>(i);
+            }
+        }, 1);
+
+        float* zbuf = image.depth.data();
+        uint8_t* rgb = withColour ? image.colour.data() : nullptr;
+        parallelFor(tiles, [&](size_t b, size_t e, unsigned) {
+            for (size_t t = b; t < e; ++t) {
+                for (size_t k = tileStart[t]; k < tileStart[t + 1]; ++k) {
+                    const uint32_t i = order[k], p = pixel[i];
+                    const float z = depth[i];
+                    if (zbuf[p] != 0.0f && !(z < zbuf[p])) continue;
+                    zbuf[p] = z;
+                    if (!rgb) continue;
+                    const Point& q = points[i];
+                    rgb[3 * size_t(p)] = static_cast<uint8_t>(std::clamp(q.r, 0, 255));
+                    rgb[3 * size_t(p) + 1] = static_cast<uint8_t>(std::clamp(q.g, 0, 255));
+                    rgb[3 * size_t(p) + 2] = static_cast<uint8_t>(std::clamp(q.b, 0, 255));
+                }
+            }
+        }, 1);
+        return true;
+    }
+
+    // Back-project every pixel of 'image' with a depth in the camera's range and append
+    // the points in the cloud frame (any pending model is baked first). Colours come
+    // from the image when it has them, white otherwise. Rows run in parallel: a counting
+    // pass sizes the output, then each row writes its own slice.
+    bool appendDepthImage(const DepthImage& image, const PinholeCamera& camera) {
+        if (image.width <= 0 || image.height <= 0 || image.depth.size() != size_t(image.width) * image.height ||
+            !(camera.fx > 0.0) || !(camera.fy > 0.0)) {
+            std::cerr << "Error: Invalid depth image or camera for back-projection" << std::endl;
+            return false;
+        }
+        const size_t rows = static_cast<size_t>(image.height);
+        std::vector<size_t> rowStart(rows + 1, 0);
+        parallelFor(rows, [&](size_t b, size_t e, unsigned) {
+            for (size_t v = b; v < e; ++v) {
+                const float* d = image.depth.data() + v * image.width;
+                size_t c = 0;
+                for (int u = 0; u < image.width; ++u) c += d[u] >= camera.minDepth && d[u] <= camera.maxDepth && d[u] > 0.0f;
+                rowStart[v + 1] = c;
+            }
+        }, 16);
+        for (size_t v = 0; v < rows; ++v) rowStart[v + 1] += rowStart[v];
+        const size_t total = rowStart[rows];
+        if (total == 0) return true;
+
+        float R[12];
+        for (int k = 0; k < 12; ++k) R[k] = static_cast<float>(camera.pose[k]);
+        const bool coloured = image.colour.size() == image.depth.size() * 3;
+        auto out = scratchPool.borrow<Point>(total);
+        parallelFor(rows, [&](size_t b, size_t e, unsigned) {
+            std::vector<float> x(image.width), y(image.width), z(image.width);
+            std::vector<uint32_t> column(image.width);
+            for (size_t v = b; v < e; ++v) {
+                const size_t m = projection::backProjectRow(image, camera, static_cast<int>(v), x.data(), y.data(), z.data(), column.data());
+                Point* dst = out.data() + rowStart[v];
+                for (size_t k = 0; k < m; ++k) {
+                    Point p{};
+                    p.x = R[0] * x[k] + R[1] * y[k] + R[2] * z[k] + R[3];
+                    p.y = R[4] * x[k] + R[5] * y[k] + R[6] * z[k] + R[7];
+                    p.z = R[8] * x[k] + R[9] * y[k] + R[10] * z[k] + R[11];
+                    const uint8_t* c = coloured ? image.colour.data() + 3 * (v * image.width + column[k]) : nullptr;
+                    p.r = c ? c[0] : 255; p.g = c ? c[1] : 255; p.b = c ? c[2] : 255;
+                    dst[k] = p;
+                }
+            }
+        }, 16);
+        bakePendingModel();
+        appendPoints(out.data(), total, false);
+        return true;
+    }
+
+    // Append 'count' points spread uniformly over the surface of 'mesh' (cloud frame; any
+    // pending model is baked first). Normals and colours are interpolated from the
+    // vertices, falling back to face normals and white. Faces are drawn by area from an
+    // alias table, so a sample costs O(1) whatever the face count. Samples are made in
+    // fixed blocks, each with its own random stream from 'seed' and the block index, and
+    // written in place: the result does not depend on the number of workers.
+    bool appendMeshSamples(const TriangleMesh& mesh, size_t count, uint64_t seed = 0) {
+        const size_t faces = mesh.faces.size();
+        if (faces == 0) {
+            std::cerr << "Error: Mesh has no faces to sample" << std::endl;
+            return false;
+        }
+        if (faces > std::numeric_limits<uint32_t>::max()) {
+            std::cerr << "Error: Mesh has too many faces to sample (at most 2^32 - 1)" << std::endl;
+            return false;
+        }
+        std::vector<double> areas(faces);
+        std::vector<uint8_t> bad(workerCount(), 0);
+        parallelFor(faces, [&](size_t b, size_t e, unsigned w) {
+            for (size_t f = b; f < e; ++f) {
+                const auto& t = mesh.faces[f];
+                if (t[0] >= mesh.vertices.size() || t[1] >= mesh.vertices.size() || t[2] >= mesh.vertices.size()) { bad[w] = 1; areas[f] = 0.0; continue; }
+                const auto n = mesh.faceNormal(f);
+                areas[f] = 0.5 * std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            }
+        });
+        sampling::AliasTable table;
+        if (std::any_of(bad.begin(), bad.end(), [](uint8_t x) { return x != 0; }) || !table.build(areas.data(), faces)) {
+            std::cerr << "Error: Mesh has invalid vertex indices or no area to sample" << std::endl;
+            return false;
+        }
+        std::vector<double>().swap(areas);
+        if (count == 0) return true;
+
+        const bool smooth = mesh.normals.size() == mesh.vertices.size();
+        const bool coloured = mesh.colours.size() == mesh.vertices.size();
+        bakePendingModel();
+        const size_t before = beginAppend(count, true);
+        Point* out = points.data() + before;
+        constexpr size_t kBlock = size_t(1) << 16;
+        parallelFor((count + kBlock - 1) / kBlock, [&](size_t b, size_t e, unsigned) {
+            for (size_t blk = b; blk < e; ++blk) {
+                sampling::Stream rng(seed ^ sampling::mix(blk));
+                const size_t end = std::min(count, (blk + 1) * kBlock);
+                for (size_t i = blk * kBlock; i < end; ++i) {
+                    const uint32_t f = table.draw(rng.uniform());
+                    const auto& t = mesh.faces[f];
+                    // uniform barycentric weights (Osada et al. 2002)
+                    const double s = std::sqrt(rng.uniform()), r = rng.uniform();
+                    const double w[3] = { 1.0 - s, s * (1.0 - r), s * r };
+                    double p[3] = { 0.0, 0.0, 0.0 }, n[3] = { 0.0, 0.0, 0.0 }, c[3] = { 255.0, 255.0, 255.0 };
+                    if (coloured) c[0] = c[1] = c[2] = 0.0;
+                    for (int v = 0; v < 3; ++v)
+                        for (int k = 0; k < 3; ++k) {
+                            p[k] += w[v] * mesh.vertices[t[v]][k];
+                            if (smooth) n[k] += w[v] * mesh.normals[t[v]][k];
+                            if (coloured) c[k] += w[v] * mesh.colours[t[v]][k];
+                        }
+                    double len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                    if (!(len > 0.0)) {
+                        const auto fn = mesh.faceNormal(f);
+                        n[0] = fn[0]; n[1] = fn[1]; n[2] = fn[2];
+                        len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                    }
+                    Point q{};
+                    q.x = static_cast<float>(p[0]); q.y = static_cast<float>(p[1]); q.z = static_cast<float>(p[2]);
+                    q.nx = static_cast<float>(n[0] / len); q.ny = static_cast<float>(n[1] / len); q.nz = static_cast<float>(n[2] / len);
+                    q.r = static_cast<int>(c[0] + 0.5); q.g = static_cast<int>(c[1] + 0.5); q.b = static_cast<int>(c[2] + 0.5);
+                    out[i] = q;
+                }
+            }
+        }, 1);
+        endAppend(before);
         return true;
     }
 
+    // Drop points with a NaN or infinite coordinate (invalid returns in organised scans)
+    void removeNonFinite() {
+        bakePendingModel();
+        compactIf([](float x, float y, float z) { return std::isfinite(x) && std::isfinite(y) && std::isfinite(z); });
+    }
+
+    // Replace the points in each occupied voxel of edge 'voxelSize' by their average.
+    // Sort-based (no hash map); the key buffer is kept between calls.
+    void voxelDownsample(float voxelSize) {
+        if (points.empty() || !(voxelSize > 0.0f)) return;
+        bakePendingModel();
+        const auto& s = getStats();
+        // Voxel keys: 21 bits per axis, counted from the box minimum
+        if (std::max({ s.maxX - s.minX, s.maxY - s.minY, s.maxZ - s.minZ }) / voxelSize >= double((1 << 21) - 1)) {
+            std::cerr << "Error: voxel size " << voxelSize << " is too fine for the extent of the cloud" << std::endl;
+            return;
+        }
+        const float inv = 1.0f / voxelSize;
+        auto voxelKeys = scratchPool.borrow<VoxelKey>(points.size());
+        uint32_t chunk = 0;
+        forEachChunkSpan(0, points.size(), [&](size_t b, size_t e, const Vec3d& d) {
+            // voxel indices in the cloud frame, relative to the box minimum (in double)
+            const double ox = d.x - s.minX, oy = d.y - s.minY, oz = d.z - s.minZ;
+            for (size_t i = b; i < e; ++i) {
+                const auto& p = points[i];
+                const uint64_t ix = static_cast<uint64_t>((ox + p.x) * inv) & 0x1FFFFF;
+                const uint64_t iy = static_cast<uint64_t>((oy + p.y) * inv) & 0x1FFFFF;
+                const uint64_t iz = static_cast<uint64_t>((oz + p.z) * inv) & 0x1FFFFF;
+                voxelKeys[i] = { (ix << 42) | (iy << 21) | iz, static_cast<uint32_t>(i), chunk };
+            }
+            ++chunk;
+        });
+        // Runs never cross chunks: each average stays in its chunk's frame
+        std::sort(voxelKeys.begin(), voxelKeys.end(), [](const VoxelKey& a, const VoxelKey& b) {
+            if (a.chunk != b.chunk) return a.chunk < b.chunk;
+            return a.key < b.key || (a.key == b.key && a.index < b.index);
+        });
+
+        // Runs are visited in key order, not index order, so averages go to a scratch
+        // buffer and are copied back (the result never exceeds the current size)
+        auto reduced = scratchPool.borrow<Point>(points.size());
+        size_t outCount = 0;
+        std::vector<Chunk> kept;
+        // sorted source rows and run ends, for carrying attribute columns along
+        auto rows = scratchPool.borrow<uint32_t>(attrs.empty() ? 0 : points.size());
+        auto runEnds = scratchPool.borrow<uint32_t>(attrs.empty() ? 0 : points.size());
+        for (size_t b = 0; b < voxelKeys.size();) {
+            size_t e = b;
+            double sx = 0, sy = 0, sz = 0, snx = 0, sny = 0, snz = 0;
+            long sr = 0, sg = 0, sb = 0;
+            if (!chunks.empty() && (b == 0 || voxelKeys[b].chunk != voxelKeys[b - 1].chunk)) {
+                kept.push_back(Chunk{ outCount, chunks[voxelKeys[b].chunk].offset });
+            }
+            while (e < voxelKeys.size() && voxelKeys[e].key == voxelKeys[b].key && voxelKeys[e].chunk == voxelKeys[b].chunk) {
+                const auto& p = points[voxelKeys[e].index];
+                sx += p.x; sy += p.y; sz += p.z;
+                sr += p.r; sg += p.g; sb += p.b;
+                snx += p.nx; sny += p.ny; snz += p.nz;
+                ++e;
+            }
+            const double n = static_cast<double>(e - b);
+            Point q{};
+            q.x = static_cast<float>(sx / n); q.y = static_cast<float>(sy / n); q.z = static_cast<float>(sz / n);
+            q.r = static_cast<int>(sr / static_cast<long>(e - b));
+            q.g = static_cast<int>(sg / static_cast<long>(e - b));
+            q.b = static_cast<int>(sb / static_cast<long>(e - b));
+            if (normalsValid) {
+                float nx = static_cast<float>(snx), ny = static_cast<float>(sny), nz = static_cast<float>(snz);
+                const float len = std::sqrt(nx*nx + ny*ny + nz*nz);
+                if (len > 0.0f) { nx /= len; ny /= len; nz /= len; }
+                q.nx = nx; q.ny = ny; q.nz = nz;
+            }
+            if (rows.size()) {
+                for (size_t k = b; k < e; ++k) rows[k] = voxelKeys[k].index;
+                runEnds[outCount] = static_cast<uint32_t>(e);
+            }
+            reduced[outCount++] = q;
+            b = e;
+        }
+        std::copy(reduced.begin(), reduced.begin() + outCount, points.begin());
+        points.resize(outCount);
+        if (!chunks.empty()) chunks.swap(kept);
+        if (!attrs.empty()) attrs.reduceRuns(rows.data(), runEnds.data(), outCount);
+        markDirty();
+    }
+
+    bool hasNormals() const { return normalsValid; }
+
     // Translate all points (in-place, O(N))
     void translate(float tx, float ty, float tz) {
-        {
-            model = model * Mat4::translation(tx,ty,tz);
-            hasPendingModel = true;
-            statsDirty = true;
-        }
+        composeModel(Similarity::translation(tx, ty, tz));
     }
 
     // Rotate all points around origin by angle (degrees) on axis {'x','y','z'}
     void rotate(float angle, char axis) {
         {
-            const float radians = angle * static_cast<float>(M_PI) / 180.0f;
-            Mat4 R = Mat4::identity();
-            switch (axis) {
-                case 'x': R = Mat4::rotationX(radians); break;
-                case 'y': R = Mat4::rotationY(radians); break;
-                case 'z': R = Mat4::rotationZ(radians); break;
-                default: return;
+            if (axis != 'x' && axis != 'y' && axis != 'z') return;
+            composeModel(Similarity::rotation(angle * M_PI / 180.0, axis));
+        }
+    }
+
+    // Rotate around the pivot (px, py, pz): one composition instead of translate/rotate/translate
+    void rotateAroundPivot(float angle, char axis, float px, float py, float pz) {
+        if (axis != 'x' && axis != 'y' && axis != 'z') return;
+        const Similarity R = Similarity::rotation(angle * M_PI / 180.0, axis);
+        const Vec3d pivot{ px, py, pz };
+        const Vec3d rp = R.rotate(pivot);
+        Similarity S = R;
+        S.t = pivot - rp;
+        composeModel(S);
+    }
+
+    // Uniform scale about the cloud origin (lazy, like translate/rotate)
+    void scale(float factor) {
+        if (!(factor > 0.0f)) return;
+        composeModel(Similarity::scaling(factor));
+    }
+
+    // Run 'kernel' (void(Point&)) over every point in a single pass. A pending model is
+    // baked in the same loop, so transform + kernel cost one traversal of 'points'.
+    // The pass is split over the worker pool, so the kernel must be safe to call
+    // concurrently on different points. See PointCloudKernels.h for composable operations.
+    // The kernel sees positions in the cloud frame. For georeferenced clouds with several
+    // chunks prefer applyChunkKernel(), which avoids the round trip through large floats.
+    template <typename Kernel>
+    void applyPointKernel(const Kernel& kernel) {
+        applyChunkKernel([&kernel](const Vec3d& d) {
+            const float dx = static_cast<float>(d.x), dy = static_cast<float>(d.y), dz = static_cast<float>(d.z);
+            const bool shifted = !d.isZero();
+            return [&kernel, dx, dy, dz, shifted](Point& p) {
+                if (!shifted) { kernel(p); return; }
+                p.x += dx; p.y += dy; p.z += dz;
+                kernel(p);
+                p.x -= dx; p.y -= dy; p.z -= dz;
+            };
+        });
+    }
+
+    // Like applyPointKernel, but makeKernel(offset) builds the kernel for each chunk and
+    // that kernel sees positions relative to the chunk origin (cloud origin + offset).
+    // makeKernel is called once per chunk span and must be cheap.
+    template <typename MakeKernel>
+    void applyChunkKernel(const MakeKernel& makeKernel) {
+        Point* pts = points.data();
+        const bool pending = hasPendingModel;
+        parallelFor(points.size(), [&](size_t b, size_t e, unsigned) {
+            forEachChunkSpan(b, e, [&](size_t cb, size_t ce, const Vec3d& d) {
+                const auto kernel = makeKernel(d);
+                if (pending) {
+                    const SimilarityKernel M(model, d, d);
+                    for (size_t i = cb; i < ce; ++i) { M(pts[i]); kernel(pts[i]); }
+                } else {
+                    for (size_t i = cb; i < ce; ++i) kernel(pts[i]);
+                }
+            });
+        });
+        resetModel();
+        markDirty();
+    }
+
+    // Cached AABB + centroid of the stored (baked) points
+    const Stats& getStats() const noexcept {
+        if (statsDirty) recomputeStats();
+        return stats;
+    }
+
+    // AABB of the points as displayed: exact when no model is pending, otherwise the
+    // pending model applied to the stored box's corners (conservative, no point pass).
+    // Returns false for an empty cloud.
+    bool getBounds(float mn[3], float mx[3]) const {
+        const Stats& s = getStats();
+        if (!s.valid) return false;
+        const Mat4 M = model.toMatrix().cast<float>();
+        for (int c = 0; c < 8; ++c) {
+            float x = (c & 1) ? s.maxX : s.minX, y = (c & 2) ? s.maxY : s.minY, z = (c & 4) ? s.maxZ : s.minZ;
+            if (hasPendingModel) { float ox, oy, oz; transformPoint(M, x, y, z, ox, oy, oz); x = ox; y = oy; z = oz; }
+            if (c == 0) { mn[0] = mx[0] = x; mn[1] = mx[1] = y; mn[2] = mx[2] = z; continue; }
+            mn[0] = std::min(mn[0], x); mx[0] = std::max(mx[0], x);
+            mn[1] = std::min(mn[1], y); mx[1] = std::max(mx[1], y);
+            mn[2] = std::min(mn[2], z); mx[2] = std::max(mx[2], z);
+        }
+        return true;
+    }
+
+    // Robust AABB: per axis, the values at ranks qLow and qHigh (e.g. 0.01 and 0.99) from
+    // the quantile sketches kept with the stats, so a few outliers do not inflate it. No
+    // extra point pass; a pending model is applied to the box corners as in getBounds().
+    bool getQuantileBounds(double qLow, double qHigh, float mn[3], float mx[3]) const {
+        if (!getStats().valid) return false;
+        float lo[3], hi[3];
+        const double qs[2] = { qLow, qHigh };
+        for (int k = 0; k < 3; ++k) {
+            float v[2];
+            sketches[k].quantiles(qs, v, 2);
+            lo[k] = v[0]; hi[k] = v[1];
+        }
+        const Mat4 M = model.toMatrix().cast<float>();
+        for (int c = 0; c < 8; ++c) {
+            float x = (c & 1) ? hi[0] : lo[0], y = (c & 2) ? hi[1] : lo[1], z = (c & 4) ? hi[2] : lo[2];
+            if (hasPendingModel) { float ox, oy, oz; transformPoint(M, x, y, z, ox, oy, oz); x = ox; y = oy; z = oz; }
+            if (c == 0) { mn[0] = mx[0] = x; mn[1] = mx[1] = y; mn[2] = mx[2] = z; continue; }
+            mn[0] = std::min(mn[0], x); mx[0] = std::max(mx[0], x);
+            mn[1] = std::min(mn[1], y); mx[1] = std::max(mx[1], y);
+            mn[2] = std::min(mn[2], z); mx[2] = std::max(mx[2], z);
+        }
+        return true;
+    }
+
+    // Value at rank q of axis 0/1/2 of the stored points (cloud frame, approximate)
+    float axisQuantile(int axis, double q) const {
+        getStats();
+        return sketches[axis].quantile(q);
+    }
+
+    // Convex hull of the stored points (cloud frame, pending model not applied), see
+    // computeConvexHull(). Computed on first use and kept until the stats are recomputed.
+    const ConvexHull& getConvexHull() const {
+        getStats();
+        if (!hullCached) {
+            std::vector<float> xyz(points.size() * 3);
+            gatherPositions(xyz.data());
+            computeConvexHull(xyz.data(), points.size(), hull);
+            hullCached = true;
+        }
+        return hull;
+    }
+
+    // Tight oriented box of the stored points (cloud frame), refined over the hull
+    // vertices; cached like getConvexHull()
+    const OrientedBox& getOrientedBox() const {
+        const ConvexHull& h = getConvexHull();
+        if (!boxCached) {
+            std::vector<float> xyz(points.size() * 3);
+            gatherPositions(xyz.data());
+            computeOrientedBox(xyz.data(), points.size(), h, orientedBox);
+            boxCached = true;
+        }
+        return orientedBox;
+    }
+
+    // Oriented box of the points as displayed: the pending model (a similarity) maps the
+    // cached box exactly. Returns false for an empty cloud.
+    bool getOrientedBounds(OrientedBox& box) const {
+        box = getOrientedBox();
+        if (!box.valid || !hasPendingModel) return box.valid;
+        const Vec3d c = model.apply(Vec3d{ box.center[0], box.center[1], box.center[2] });
+        box.center[0] = static_cast<float>(c.x); box.center[1] = static_cast<float>(c.y); box.center[2] = static_cast<float>(c.z);
+        for (int k = 0; k < 3; ++k) {
+            const Vec3d a = model.rotate(Vec3d{ box.axes[k][0], box.axes[k][1], box.axes[k][2] });
+            box.axes[k][0] = static_cast<float>(a.x); box.axes[k][1] = static_cast<float>(a.y); box.axes[k][2] = static_cast<float>(a.z);
+            box.halfExtents[k] = static_cast<float>(box.halfExtents[k] * std::fabs(model.s));
+        }
+        return true;
+    }
+
+    // Histograms for several quantities from one parallel pass over the points: each
+    // worker counts its partition into private bins (in blocks, so a block stays in
+    // cache across the fields) and the bins are summed at the end. Height and normals
+    // are taken as displayed (the pending model is applied on the fly, as in
+    // renderDepthImage()). Colour channels span 0..256 and normal components -1..1
+    // unless a range is given; height takes its default range from getBounds() and
+    // attributes from a min/max reduction over the column. Density needs a sort of the
+    // voxel keys and runs separately. Normal histograms are empty without normals.
+    std::vector<Histogram> histograms(const std::vector<HistogramSpec>& specs) const {
+        const auto& s = getStats();
+        float bmn[3] = { 0, 0, 0 }, bmx[3] = { 0, 0, 0 };
+        getBounds(bmn, bmx);
+        // pending rotation for normals (column-major), identity when none
+        double rd[9];
+        model.rotationMatrix(rd);
+        float R[9];
+        for (int i = 0; i < 9; ++i) R[i] = static_cast<float>(rd[i]);
+        std::vector<Histogram> out(specs.size());
+        std::vector<HistogramBinner> binners(specs.size());
+        std::vector<const AttributeChannel*> columns(specs.size(), nullptr);
+        std::vector<size_t> pass, offsets;  // specs counted in the point pass, their counter slots
+        size_t stride = 0;
+        for (size_t k = 0; k < specs.size(); ++k) {
+            const HistogramSpec& sp = specs[k];
+            out[k].label = sp.field == HistogramField::Attribute ? sp.attribute : histogramFieldName(sp.field);
+            if (!s.valid) continue;
+            double lo = sp.lo, hi = sp.hi;
+            const bool given = lo < hi;
+            switch (sp.field) {
+                case HistogramField::Height:
+                    if (!given) { lo = bmn[2]; hi = bmx[2]; }
+                    break;
+                case HistogramField::Red: case HistogramField::Green: case HistogramField::Blue:
+                    if (!given) { lo = 0.0; hi = 256.0; }
+                    break;
+                case HistogramField::NormalX: case HistogramField::NormalY: case HistogramField::NormalZ:
+                    if (!normalsValid) continue;
+                    if (!given) { lo = -1.0; hi = 1.0; }
+                    break;
+                case HistogramField::Density:
+                    out[k] = densityHistogram(sp);
+                    continue;
+                case HistogramField::Attribute:
+                    columns[k] = attrs.find(sp.attribute);
+                    if (!columns[k]) {
+                        std::cerr << "Error: No attribute '" << sp.attribute << "' for a histogram.\n";
+                        continue;
+                    }
+                    if (!given) columnRange(*columns[k], lo, hi);
+                    break;
             }
-            model = model * R;
-            hasPendingModel = true;
-            statsDirty = true;
+            if (!(hi > lo)) hi = lo + 1.0; // constant value: a unit range around it
+            binners[k] = HistogramBinner(sp, lo, hi);
+            pass.push_back(k);
+            offsets.push_back(stride);
+            stride += binners[k].bins() + 1;
+        }
+        if (pass.empty()) return out;
+
+        std::vector<uint64_t> counters(static_cast<size_t>(workerCount()) * stride, 0);
+        const Point* pts = points.data();
+        parallelFor(points.size(), [&](size_t b, size_t e, unsigned w) {
+            uint64_t* mine = counters.data() + static_cast<size_t>(w) * stride;
+            forEachChunkSpan(b, e, [&](size_t cb, size_t ce, const Vec3d& d) {
+                static const double identity[12] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0 };
+                float m[12];
+                framedMatrix(identity, d, m);
+                for (size_t bb = cb; bb < ce; bb += 4096) {
+                    const size_t be = std::min(ce, bb + 4096);
+                    for (size_t j = 0; j < pass.size(); ++j) {
+                        const size_t k = pass[j];
+                        const HistogramBinner& h = binners[k];
+                        uint64_t* c = mine + offsets[j];
+                        switch (specs[k].field) {
+                            case HistogramField::Height:  for (size_t i = bb; i < be; ++i) h.count(m[8] * pts[i].x + m[9] * pts[i].y + m[10] * pts[i].z + m[11], c); break;
+                            case HistogramField::Red:     for (size_t i = bb; i < be; ++i) h.count(pts[i].r, c); break;
+                            case HistogramField::Green:   for (size_t i = bb; i < be; ++i) h.count(pts[i].g, c); break;
+                            case HistogramField::Blue:    for (size_t i = bb; i < be; ++i) h.count(pts[i].b, c); break;
+                            case HistogramField::NormalX: for (size_t i = bb; i < be; ++i) h.count(R[0] * pts[i].nx + R[3] * pts[i].ny + R[6] * pts[i].nz, c); break;
+                            case HistogramField::NormalY: for (size_t i = bb; i < be; ++i) h.count(R[1] * pts[i].nx + R[4] * pts[i].ny + R[7] * pts[i].nz, c); break;
+                            case HistogramField::NormalZ: for (size_t i = bb; i < be; ++i) h.count(R[2] * pts[i].nx + R[5] * pts[i].ny + R[8] * pts[i].nz, c); break;
+                            case HistogramField::Attribute:
+                                visitAttributeType(columns[k]->type, [&](auto tag) {
+                                    using T = decltype(tag);
+                                    const T* v = columns[k]->data<T>();
+                                    for (size_t i = bb; i < be; ++i) h.count(v[i], c);
+                                });
+                                break;
+                            case HistogramField::Density:
+                                break;
+                        }
+                    }
+                }
+            });
+        });
+        for (unsigned w = 1; w < workerCount(); ++w) {
+            const uint64_t* theirs = counters.data() + static_cast<size_t>(w) * stride;
+            for (size_t i = 0; i < stride; ++i) counters[i] += theirs[i];
+        }
+        for (size_t j = 0; j < pass.size(); ++j) {
+            const size_t k = pass[j];
+            out[k] = binners[k].finish(specs[k], out[k].label, counters.data() + offsets[j]);
         }
+        return out;
+    }
+
+    Histogram histogram(const HistogramSpec& spec) const { return histograms({ spec })[0]; }
+
+    // Changes whenever points or the pending model change (for caches built on top)
+    uint64_t getVersion() const { return version; }
+
+    // Replace the contents with n points produced by gen(i) -> Point, generated in
+    // parallel with the worker partition (first touch matches later passes)
+    template <typename Gen>
+    void generate(size_t n, const Gen& gen) {
+        clear();
+        points.resize(n);
+        Point* pts = points.data();
+        parallelFor(n, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i) pts[i] = gen(i);
+        });
+        markDirty();
     }
 
-    // Displace points along normals
+    // Displace points along normals (fused with baking the pending model)
     void displaceAlongNormals(float displacement) {
-        bakePendingModel();
-        for (auto& p : points) {
-            p.x += displacement * p.nx;
-            p.y += displacement * p.ny;
-            p.z += displacement * p.nz;
-        }
-        statsDirty = true;
+        applyChunkKernel([displacement](const Vec3d&) {
+            return [displacement](Point& p) {
+                p.x += displacement * p.nx;
+                p.y += displacement * p.ny;
+                p.z += displacement * p.nz;
+            };
+        });
     }
 
     // Displace points symmetrically along the vertical axis (outward from the YZ plane).
     void displaceSymmetrically(float displacement) {
         if (points.empty()) return;
         bakePendingModel();
-        const float centerX = getStats().cx; // centroid X (cached)
-        for (auto& p : points) {
-            const float dx = p.x - centerX;
-            const float shift = displacement * std::fabs(dx);
-            p.x += (dx >= 0.0f) ? (+shift) : (-shift);
-        }
-        statsDirty = true;
+        const float cx = getStats().cx; // centroid X (cached)
+        applyChunkKernel([cx, displacement](const Vec3d& d) {
+            const float centerX = static_cast<float>(cx - d.x); // in the chunk's frame
+            return [centerX, displacement](Point& p) {
+                const float dx = p.x - centerX;
+                const float shift = displacement * std::fabs(dx);
+                p.x += (dx >= 0.0f) ? (+shift) : (-shift);
+            };
+        });
     }
 
     // Estimate normals
@@ -251,54 +1904,218 @@ public:
             std::cerr << "Error: No points in the point cloud to estimate normals.\n";
             return;
         }
+        const bool hadModel = hasPendingModel;
         bakePendingModel();
         const auto& s = getStats();
-        const float cx = s.cx, cy = s.cy, cz = s.cz;
-        for (auto& p : points) {
-            const float dx = p.x - cx, dy = p.y - cy, dz = p.z - cz;
-            const float len2 = dx*dx + dy*dy + dz*dz;
-            if (len2 > 0.0f) {
-                const float invLen = 1.0f / std::sqrt(len2);
-                p.nx = dx * invLen; p.ny = dy * invLen; p.nz = dz * invLen;
-            } else {
-                p.nx = p.ny = p.nz = 0.0f;
-            }
+        const Vec3d centroid{ s.cx, s.cy, s.cz };
+        applyChunkKernel([centroid](const Vec3d& d) {
+            const Vec3d c = centroid - d; // centroid in the chunk's frame
+            const float cx = static_cast<float>(c.x), cy = static_cast<float>(c.y), cz = static_cast<float>(c.z);
+            return [cx, cy, cz](Point& p) {
+                const float dx = p.x - cx, dy = p.y - cy, dz = p.z - cz;
+                const float len2 = dx*dx + dy*dy + dz*dz;
+                if (len2 > 0.0f) {
+                    const float invLen = 1.0f / std::sqrt(len2);
+                    p.nx = dx * invLen; p.ny = dy * invLen; p.nz = dz * invLen;
+                } else {
+                    p.nx = p.ny = p.nz = 0.0f;
+                }
+            };
+        });
+        // normals leave the geometry alone: the stats stay valid unless a model was baked here
+        if (!hadModel) statsDirty = false;
+        normalsValid = true;
+    }
+
+    // k nearest neighbours of every point (cloud frame), from a cell-sorted grid. The
+    // graph is cached until the points or the model change; a cached graph with a
+    // longer row serves smaller k (rows are sorted, consumers read the first k).
+    const NeighborGraph& neighbors(size_t k) {
+        bakePendingModel();
+        if (knnVersion == version && knn.k >= k) return knn;
+        auto xyz = scratchPool.borrow<float>(points.size() * 3);
+        float* f = xyz.data();
+        gatherPositions(f);
+        NeighborGrid grid;
+        grid.build(points.size(), [f](size_t i, float p[3]) { p[0] = f[3 * i]; p[1] = f[3 * i + 1]; p[2] = f[3 * i + 2]; },
+                   0.0f, std::max<size_t>(k / 2, 4));
+        grid.buildGraph(k, knn);
+        knnVersion = version;
+        return knn;
+    }
+
+    // Which outputs estimateFeatures() writes
+    enum Feature : unsigned {
+        FeatureNormals          = 1u << 0,  // smallest-eigenvalue direction, oriented away from the centroid
+        FeatureSurfaceVariation = 1u << 1,  // "surface_variation": l0 / (l0 + l1 + l2)
+        FeatureCurvature        = 1u << 2,  // "curvature": fitted to the neighbours, > 0 where the surface bends away from the normal
+        FeaturePlanarity        = 1u << 3,  // "planarity": (l1 - l0) / l2
+        FeatureLinearity        = 1u << 4,  // "linearity": (l2 - l1) / l2
+        FeatureAll              = 0x1F
+    };
+
+    // Normals and geometric features from one kNN covariance pass (eigenvalues
+    // l0 <= l1 <= l2 of each point's neighbourhood, the point included). Features are
+    // stored as float attribute columns. Neighbourhoods are gathered into small
+    // structure-of-arrays batches so the covariance sums vectorise.
+    void estimateFeatures(size_t k = 16, unsigned which = FeatureAll) {
+        if (points.empty()) {
+            std::cerr << "Error: No points in the point cloud to estimate features.\n";
+            return;
         }
-        // normals do not change geometry; stats unchanged
+        k = std::max<size_t>(k, 3);
+        const NeighborGraph& g = neighbors(k);
+        const auto& s = getStats();
+        const float cx = s.cx, cy = s.cy, cz = s.cz;
+        float* outVariation = (which & FeatureSurfaceVariation) ? addAttribute("surface_variation", AttributeType::F32).data<float>() : nullptr;
+        float* outCurvature = (which & FeatureCurvature) ? addAttribute("curvature", AttributeType::F32).data<float>() : nullptr;
+        float* outPlanarity = (which & FeaturePlanarity) ? addAttribute("planarity", AttributeType::F32).data<float>() : nullptr;
+        float* outLinearity = (which & FeatureLinearity) ? addAttribute("linearity", AttributeType::F32).data<float>() : nullptr;
+        const bool writeNormals = (which & FeatureNormals) != 0;
+        parallelFor(points.size(), [&](size_t b, size_t e, unsigned) {
+            std::vector<float> nx(k + 1), ny(k + 1), nz(k + 1);
+            forEachChunkSpan(b, e, [&](size_t cb, size_t ce, const Vec3d& d) {
+                const float dx = static_cast<float>(d.x), dy = static_cast<float>(d.y), dz = static_cast<float>(d.z);
+                for (size_t i = cb; i < ce; ++i) {
+                    // gather the neighbourhood relative to the point, in the point's chunk
+                    // frame (neighbours in other chunks are shifted by the offset difference)
+                    const uint32_t* row = g.row(i);
+                    size_t m = 1;
+                    nx[0] = ny[0] = nz[0] = 0.0f;
+                    for (size_t j = 0; j < k; ++j) {
+                        const uint32_t o = row[j];
+                        if (o == NeighborGraph::kNoNeighbor) break;
+                        float ox = points[o].x - points[i].x, oy = points[o].y - points[i].y, oz = points[o].z - points[i].z;
+                        if (!chunks.empty()) {
+                            const Vec3d od = chunks[chunkIndexOf(o)].offset - d;
+                            ox += static_cast<float>(od.x); oy += static_cast<float>(od.y); oz += static_cast<float>(od.z);
+                        }
+                        nx[m] = ox; ny[m] = oy; nz[m] = oz;
+                        ++m;
+                    }
+                    float mx = 0.f, my = 0.f, mz = 0.f;
+                    for (size_t j = 0; j < m; ++j) { mx += nx[j]; my += ny[j]; mz += nz[j]; }
+                    const float inv = 1.0f / static_cast<float>(m);
+                    mx *= inv; my *= inv; mz *= inv;
+                    float sxx = 0.f, sxy = 0.f, sxz = 0.f, syy = 0.f, syz = 0.f, szz = 0.f;
+                    for (size_t j = 0; j < m; ++j) {
+                        const float ax = nx[j] - mx, ay = ny[j] - my, az = nz[j] - mz;
+                        sxx += ax * ax; sxy += ax * ay; sxz += ax * az;
+                        syy += ay * ay; syz += ay * az; szz += az * az;
+                    }
+                    const double cov[6] = { sxx * inv, sxy * inv, sxz * inv, syy * inv, syz * inv, szz * inv };
+                    double l[3], v[3];
+                    symmetricEigen3(cov, l, v);
+                    l[0] = std::max(l[0], 0.0);
+                    // orient away from the centroid, as estimateNormals() does
+                    const float px = points[i].x + dx - cx, py = points[i].y + dy - cy, pz = points[i].z + dz - cz;
+                    if (v[0] * px + v[1] * py + v[2] * pz < 0.0) { v[0] = -v[0]; v[1] = -v[1]; v[2] = -v[2]; }
+                    const double sum = l[0] + l[1] + l[2];
+                    if (outVariation) outVariation[i] = sum > 0.0 ? static_cast<float>(l[0] / sum) : 0.0f;
+                    if (outPlanarity) outPlanarity[i] = l[2] > 0.0 ? static_cast<float>((l[1] - l[0]) / l[2]) : 0.0f;
+                    if (outLinearity) outLinearity[i] = l[2] > 0.0 ? static_cast<float>((l[2] - l[1]) / l[2]) : 0.0f;
+                    if (outCurvature) {
+                        // least squares for h_j = -kappa / 2 * r_j^2 (height over the tangent
+                        // plane against squared tangential distance)
+                        const float vx = static_cast<float>(v[0]), vy = static_cast<float>(v[1]), vz = static_cast<float>(v[2]);
+                        float shr = 0.f, srr = 0.f;
+                        for (size_t j = 1; j < m; ++j) {
+                            const float h = nx[j] * vx + ny[j] * vy + nz[j] * vz;
+                            const float r2 = nx[j] * nx[j] + ny[j] * ny[j] + nz[j] * nz[j] - h * h;
+                            shr += h * r2; srr += r2 * r2;
+                        }
+                        outCurvature[i] = srr > 0.0f ? -2.0f * shr / srr : 0.0f;
+                    }
+                    if (writeNormals) {
+                        points[i].nx = static_cast<float>(v[0]); points[i].ny = static_cast<float>(v[1]); points[i].nz = static_cast<float>(v[2]);
+                    }
+                }
+            });
+        });
+        // normals and attribute columns leave positions (stats, version) untouched
+        if (writeNormals) normalsValid = true;
     }
 
     // Print all points
     void printPoints() const {
         const_cast<PointCloud*>(this)->bakePendingModel();
-        for (const auto& point : points) {
-            std::cout << "Point(" << point.x << ", " << point.y << ", " << point.z << ") "
-                      << "Color(" << point.r << ", " << point.g << ", " << point.b << ") "
-                      << "Normals(" << point.nx << ", " << point.ny << ", " << point.nz << ")\n";
-        }
+        forEachChunkSpan(0, points.size(), [&](size_t b, size_t e, const Vec3d& d) {
+            for (size_t i = b; i < e; ++i) {
+                const Point& point = points[i];
+                std::cout << "Point(" << point.x + d.x << ", " << point.y + d.y << ", " << point.z + d.z << ") "
+                          << "Color(" << point.r << ", " << point.g << ", " << point.b << ") "
+                          << "Normals(" << point.nx << ", " << point.ny << ", " << point.nz << ")\n";
+            }
+        });
+    }
+
+    // Double-precision origin of the cloud frame, and the chunk table (empty when all
+    // points are stored relative to the origin itself)
+    const Vec3d& getOrigin() const { return origin; }
+    const std::vector<Chunk>& getChunks() const { return chunks; }
+    bool isGeoreferenced() const { return !origin.isZero() || !chunks.empty(); }
+
+    // Extra per-point columns; row i belongs to point i. Use addAttribute() to create
+    // columns so they start with one (zero) row per point.
+    const AttributeSet& attributes() const { return attrs; }
+    AttributeSet& attributes() { return attrs; }
+    AttributeChannel& addAttribute(const std::string& name, AttributeType type) {
+        attrs.resize(points.size());
+        return attrs.add(name, type);
     }
 
+    // Per-cloud scratch arena for transient work by external operations
+    ScratchPool& scratch() { return scratchPool; }
+
     // when hasPendingModel==true, getPoints() returns unbaked positions.
+    // Positions are relative to their chunk's origin (see getChunks()).
     // forEachTransformedPoint(...) for rendering without baking.
     // Get all points
-    const std::vector<Point>& getPoints() const {
+    const PointBuffer& getPoints() const {
         return points;
     }
 
+    // Positions are passed in the cloud frame (relative to getOrigin())
     template <typename F>
     void forEachTransformedPoint(F func) const {
-        for (const auto& p : points) {
-            float ox, oy, oz;
-            if (hasPendingModel) transformPoint(model, p.x, p.y, p.z, ox, oy, oz);
-            else { ox = p.x; oy = p.y; oz = p.z; }
-            func(ox, oy, oz, p.r, p.g, p.b);
-        }
+        forEachChunkSpan(0, points.size(), [&](size_t b, size_t e, const Vec3d& d) {
+            const Mat4 M = rebasedMatrix(model, d, Vec3d{});
+            for (size_t i = b; i < e; ++i) {
+                const Point& p = points[i];
+                float ox, oy, oz;
+                transformPoint(M, p.x, p.y, p.z, ox, oy, oz);
+                func(ox, oy, oz, p.r, p.g, p.b);
+            }
+        });
+    }
+
+    // Parallel counterpart of forEachTransformedPoint(): f(begin, end, M, worker) for
+    // spans of stored points, where M maps them into the cloud frame as displayed
+    template <typename F>
+    void forEachDisplayedSpan(F f) const {
+        parallelFor(points.size(), [&](size_t b, size_t e, unsigned w) {
+            forEachChunkSpan(b, e, [&](size_t cb, size_t ce, const Vec3d& d) { f(cb, ce, rebasedMatrix(model, d, Vec3d{}), w); });
+        });
     }
 
     // Print summary
-    void printSummary() const {
+    // withHistograms adds 16-bin histograms of height, colour, normals, local density
+    // and every attribute column (one pass, see histograms())
+    void printSummary(bool withHistograms = false) const {
         const_cast<PointCloud*>(this)->bakePendingModel();
         std::cout << "PointCloud Summary:\n";
         std::cout << "Total Points: " << points.size() << "\n";
+        if (isGeoreferenced()) {
+            char buf[160];
+            std::snprintf(buf, sizeof(buf), "Origin: (%.3f, %.3f, %.3f), %zu chunk(s)\n",
+                          origin.x, origin.y, origin.z, std::max<size_t>(chunks.size(), 1));
+            std::cout << buf;
+        }
+        if (!attrs.empty()) {
+            std::cout << "Attributes:";
+            for (const auto& c : attrs.channels()) std::cout << " " << c.name << "(" << plyTypeName(c.type) << ")";
+            std::cout << "\n";
+        }
         const auto& s = getStats();
         if (s.valid) {
             std::cout << "AABB min(" << s.minX << ", " << s.minY << ", " << s.minZ << ") "
@@ -307,19 +2124,34 @@ public:
         }
         if (!points.empty()) {
             const auto& p = points[0];
-            std::cout << "First Point: (" << p.x << ", " << p.y << ", " << p.z << ") "
+            const Vec3d d = chunks.empty() ? Vec3d{} : chunks[0].offset;
+            std::cout << "First Point: (" << p.x + d.x << ", " << p.y + d.y << ", " << p.z + d.z << ") "
                       << "Color(" << p.r << ", " << p.g << ", " << p.b << ") "
                       << "Normals(" << p.nx << ", " << p.ny << ", " << p.nz << ")\n";
         }
+        if (withHistograms && !points.empty()) {
+            std::vector<HistogramSpec> specs;
+            for (HistogramField f : { HistogramField::Height, HistogramField::Red, HistogramField::Green, HistogramField::Blue })
+                specs.push_back(HistogramSpec::of(f, 16));
+            if (normalsValid) {
+                for (HistogramField f : { HistogramField::NormalX, HistogramField::NormalY, HistogramField::NormalZ })
+                    specs.push_back(HistogramSpec::of(f, 16));
+            }
+            specs.push_back(HistogramSpec::of(HistogramField::Density, 16));
+            for (const auto& c : attrs.channels()) specs.push_back(HistogramSpec::ofAttribute(c.name, 16));
+            for (const auto& h : histograms(specs)) h.print(std::cout, 30);
+        }
     }
 
     // Reset current points to the original PLY-loaded state
     void resetToOriginal() {
         if (originalPoints.empty()) return;
-        points = originalPoints;
-        model = Mat4::identity();
-        hasPendingModel = false;
-        statsDirty = true;
+        copyPoints(points, originalPoints);
+        chunks = originalChunks;
+        attrs = originalAttrs;
+        resetModel();
+        normalsValid = loadedNormals;
+        markDirty();
     }
 };
 
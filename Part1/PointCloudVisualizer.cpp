@@ -6,6 +6,10 @@
 #include <cmath>
 
 #include "PointCloudUtil.h"
+#include "PointCloudAsyncLoader.h"
+#include "PointCloudScene.h"
+#include "PointCloudIO.h"
+#include "PointCloudTiles.h"
 
 struct Camera {
     float dist = 5.0f;       // distance from origin (target)
@@ -65,16 +69,6 @@ void scrollCallback(GLFWwindow* /*window*/, double /*xoffset*/, double yoffset)
     if (yoffset < 0) zoomBy(gCam, 1.1f);   // zoom out
 }
 
-// Load the point cloud from PointCloudUtil
-PointCloudUtil::PointCloud loadPointCloud(const std::string& filename) {
-    PointCloudUtil::PointCloud cloud;
-    std::vector<float> points;
-    if (!cloud.loadFromPLY(filename)) {
-        std::cerr << "Failed to load point cloud from file" << std::endl;
-    }
-    return cloud;
-}
-
 // OpenGL error callback
 void errorCallback(int error, const char* description) {
     std::cerr << "Error: " << description << std::endl;
@@ -105,69 +99,92 @@ void renderPointCloud(const PointCloudUtil::PointCloud& cloud) {
     glEnd();
 }
 
+// Thin loading bar along the bottom edge, drawn in normalized device coordinates
+void drawProgressBar(float fraction) {
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    glDisable(GL_DEPTH_TEST);
+
+    const float x1 = -1.0f + 2.0f * std::clamp(fraction, 0.0f, 1.0f);
+    glBegin(GL_QUADS);
+        glColor3ub(40, 40, 50);
+        glVertex2f(-1.0f, -1.0f); glVertex2f(1.0f, -1.0f); glVertex2f(1.0f, -0.97f); glVertex2f(-1.0f, -0.97f);
+        glColor3ub(80, 160, 255);
+        glVertex2f(-1.0f, -1.0f); glVertex2f(x1, -1.0f); glVertex2f(x1, -0.97f); glVertex2f(-1.0f, -0.97f);
+    glEnd();
+
+    glEnable(GL_DEPTH_TEST);
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+}
+
 struct AutoXform {
     float cx = 0.f, cy = 0.f, cz = 0.f;
     float scale = 1.0f;  // uniform
 };
 
-AutoXform computeAutoXform(const std::vector<PointCloudUtil::Point>& pts, float targetExtent = 2.0f) {
+// Frame a world-space box (e.g. Scene::bounds(), maintained without a point pass)
+AutoXform computeAutoXform(const PointCloudUtil::Aabb& box, float targetExtent = 2.0f) {
     AutoXform ax;
-    if (pts.empty()) return ax;
-
-    float minx = pts[0].x, miny = pts[0].y, minz = pts[0].z;
-    float maxx = minx,      maxy = miny,      maxz = minz;
-    for (const auto& p : pts) {
-        if (p.x < minx) minx = p.x; if (p.x > maxx) maxx = p.x;
-        if (p.y < miny) miny = p.y; if (p.y > maxy) maxy = p.y;
-        if (p.z < minz) minz = p.z; if (p.z > maxz) maxz = p.z;
-    }
-    ax.cx = 0.5f * (minx + maxx);
-    ax.cy = 0.5f * (miny + maxy);
-    ax.cz = 0.5f * (minz + maxz);
-
-    float ex = maxx - minx;
-    float ey = maxy - miny;
-    float ez = maxz - minz;
-    float maxExtent = std::max(ex, std::max(ey, ez));
+    if (!box.valid) return ax;
+    ax.cx = box.center(0);
+    ax.cy = box.center(1);
+    ax.cz = box.center(2);
+    float maxExtent = std::max(box.max[0] - box.min[0], std::max(box.max[1] - box.min[1], box.max[2] - box.min[2]));
     ax.scale = (maxExtent > 0.0f) ? (targetExtent / maxExtent) : 1.0f;
     return ax;
 }
 
-AutoXform computeAutoXformTransformed(const PointCloudUtil::PointCloud& cloud, float targetExtent = 2.0f) {
-    AutoXform ax;
-    const auto& raw = cloud.getPoints();
-    if (raw.empty()) return ax;
-    bool first = true;
-    float minx=0, miny=0, minz=0, maxx=0, maxy=0, maxz=0;
-    cloud.forEachTransformedPoint([&](float x, float y, float z, int, int, int){
-        if (first) { minx=maxx=x; miny=maxy=y; minz=maxz=z; first=false; return; }
-        if (x < minx) minx = x; if (x > maxx) maxx = x;
-        if (y < miny) miny = y; if (y > maxy) maxy = y;
-        if (z < minz) minz = z; if (z > maxz) maxz = z;
-    });
-    ax.cx = 0.5f * (minx + maxx);
-    ax.cy = 0.5f * (miny + maxy);
-    ax.cz = 0.5f * (minz + maxz);
-    float ex = maxx - minx;
-    float ey = maxy - miny;
-    float ez = maxz - minz;
-    float maxExtent = std::max(ex, std::max(ey, ez));
-    ax.scale = (maxExtent > 0.0f) ? (targetExtent / maxExtent) : 1.0f;
-    return ax;
+// Frame the 1st..99th percentile box of a cloud (quantile sketches kept with its stats),
+// so a handful of stray points far away do not shrink the cloud to a dot. 'world' places
+// the cloud in the scene; the box corners go through it as in Scene::worldBounds.
+AutoXform computeAutoXformRobust(const PointCloudUtil::PointCloud& cloud, const PointCloudUtil::Mat4& world,
+                                 double qLow = 0.01, double qHigh = 0.99, float targetExtent = 2.0f) {
+    PointCloudUtil::Aabb box;
+    if (!cloud.getQuantileBounds(qLow, qHigh, box.min, box.max)) return AutoXform{};
+    box.valid = true;
+    return computeAutoXform(box.transformed(world), targetExtent);
 }
 
 static const float TRANSLATE_STEP = 2.5f;   // meters per tick
 static const float ROTATE_STEP_DEG = 6.0f;   // degrees per tick
 static const float DISP_STEP = 0.5f;        // displacement along normals per tick
 
-inline void rotateAroundPivot(PointCloudUtil::PointCloud& cloud, float angleDeg, char axis, const AutoXform& ax) {
-    // Rotate cloud around its current center (ax.c*)
-    cloud.translate(-ax.cx, -ax.cy, -ax.cz);
-    cloud.rotate(angleDeg, axis);
-    cloud.translate( ax.cx,  ax.cy,  ax.cz);
+// Cloud-frame position of scene-frame point p, for the affine 'world' (cloud -> scene):
+// solves L x = p - t by Cramer's rule on the column-major linear part L
+inline void sceneToCloud(const PointCloudUtil::Mat4& world, float px, float py, float pz, float& x, float& y, float& z) {
+    const auto& m = world.m;
+    const double b[3] = { double(px) - m[12], double(py) - m[13], double(pz) - m[14] };
+    auto det = [](const double c0[3], const double c1[3], const double c2[3]) {
+        return c0[0] * (c1[1] * c2[2] - c1[2] * c2[1]) - c1[0] * (c0[1] * c2[2] - c0[2] * c2[1]) + c2[0] * (c0[1] * c1[2] - c0[2] * c1[1]);
+    };
+    const double c0[3] = { m[0], m[1], m[2] }, c1[3] = { m[4], m[5], m[6] }, c2[3] = { m[8], m[9], m[10] };
+    const double d = det(c0, c1, c2);
+    if (d == 0.0) { x = px; y = py; z = pz; return; }
+    x = static_cast<float>(det(b, c1, c2) / d);
+    y = static_cast<float>(det(c0, b, c2) / d);
+    z = static_cast<float>(det(c0, c1, b) / d);
+}
+
+inline void rotateAroundPivot(PointCloudUtil::PointCloud& cloud, const PointCloudUtil::Mat4& world, float angleDeg, char axis, const AutoXform& ax) {
+    // Rotate cloud around the view center (ax.c*, scene frame, mapped into the cloud's
+    // frame), composed as one rigid step
+    float px, py, pz;
+    sceneToCloud(world, ax.cx, ax.cy, ax.cz, px, py, pz);
+    cloud.rotateAroundPivot(angleDeg, axis, px, py, pz);
 }
 
-void handleInput(GLFWwindow* window, PointCloudUtil::PointCloud& cloud, AutoXform& ax, bool& normalsReady, bool& printedHelp, const std::string& inputPlyFile) {
+// Edits apply to 'cloud' (the active scene object). 'editable' is false while files are
+// still streaming in: only view controls apply. 'viewBox' is what V frames. 'world'
+// places the cloud in the scene (Scene::worldMatrix).
+void handleInput(GLFWwindow* window, const PointCloudUtil::Aabb& viewBox, PointCloudUtil::PointCloud& cloud, const PointCloudUtil::Mat4& world,
+                 AutoXform& ax, bool& printedHelp, bool editable) {
     bool changed = false;
 
     // Print controls once
@@ -178,51 +195,58 @@ void handleInput(GLFWwindow* window, PointCloudUtil::PointCloud& cloud, AutoXfor
                   << "  Displace   : N (-) / M (+) along normals\n"
                   << "  Symmetric X: J (-) / K (+) expand/contract w.r.t. YZ plane\n"
                   << "  Reset     : U  (restore original PLY points, recenter & rescale)\n"
-                  << "  Recenter   : C  (recompute auto-centering & scaling)\n"
+                  << "  Recenter   : C  (frame the 1st-99th percentile box)\n"
+                  << "  Scene      : Tab selects the next cloud for editing, V frames all clouds\n"
+                  << "  Tiles      : .tiles databases stream in by view distance (read-only)\n"
                   << "  Point size : [ to - , ] to +\n"
                   << "  Views      : 1=+Z front, 2=-Z back, 3=+X right, 4=-X left, 5=+Y top, 6=-Y bottom, 0=diag\n"
                   << "  Zoom       : '-' out, '=' in, mouse wheel\n"
+                  << "  Loading    : Esc cancels a load in progress (keeps points read so far)\n"
                   << std::endl;
         printedHelp = true;
     }
 
-    // Translation (WASD + R/F)
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) { cloud.translate(-TRANSLATE_STEP, 0.f, 0.f); changed = true; }
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) { cloud.translate( TRANSLATE_STEP, 0.f, 0.f); changed = true; }
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) { cloud.translate(0.f, 0.f, -TRANSLATE_STEP); changed = true; }
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) { cloud.translate(0.f, 0.f,  TRANSLATE_STEP); changed = true; }
-    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) { cloud.translate(0.f,  TRANSLATE_STEP, 0.f); changed = true; }
-    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) { cloud.translate(0.f, -TRANSLATE_STEP, 0.f); changed = true; }
-
-    // Rotation (arrow keys for X/Y, Z/X keys for roll around Z)
-    if (glfwGetKey(window, GLFW_KEY_UP)    == GLFW_PRESS) { rotateAroundPivot(cloud,  ROTATE_STEP_DEG, 'x', ax); changed = true; }
-    if (glfwGetKey(window, GLFW_KEY_DOWN)  == GLFW_PRESS) { rotateAroundPivot(cloud, -ROTATE_STEP_DEG, 'x', ax); changed = true; }
-    if (glfwGetKey(window, GLFW_KEY_LEFT)  == GLFW_PRESS) { rotateAroundPivot(cloud,  ROTATE_STEP_DEG, 'y', ax); changed = true; }
-    if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) { rotateAroundPivot(cloud, -ROTATE_STEP_DEG, 'y', ax); changed = true; }
-    if (glfwGetKey(window, GLFW_KEY_Z)     == GLFW_PRESS) { rotateAroundPivot(cloud,  ROTATE_STEP_DEG, 'z', ax); changed = true; }
-    if (glfwGetKey(window, GLFW_KEY_X)     == GLFW_PRESS) { rotateAroundPivot(cloud, -ROTATE_STEP_DEG, 'z', ax); changed = true; }
-
-    // Displacement along normals (N = negative, M = positive)
-    if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS) {
-        if (!normalsReady) {
-            cloud.estimateNormals();
-            normalsReady = true;
-            std::cout << "Normals estimated (from centroid). Using them for displacement.\n";
+    if (editable) {
+        // Translation (WASD + R/F)
+        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) { cloud.translate(-TRANSLATE_STEP, 0.f, 0.f); changed = true; }
+        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) { cloud.translate( TRANSLATE_STEP, 0.f, 0.f); changed = true; }
+        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) { cloud.translate(0.f, 0.f, -TRANSLATE_STEP); changed = true; }
+        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) { cloud.translate(0.f, 0.f,  TRANSLATE_STEP); changed = true; }
+        if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) { cloud.translate(0.f,  TRANSLATE_STEP, 0.f); changed = true; }
+        if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) { cloud.translate(0.f, -TRANSLATE_STEP, 0.f); changed = true; }
+
+        // Rotation (arrow keys for X/Y, Z/X keys for roll around Z)
+        if (glfwGetKey(window, GLFW_KEY_UP)    == GLFW_PRESS) { rotateAroundPivot(cloud, world,  ROTATE_STEP_DEG, 'x', ax); changed = true; }
+        if (glfwGetKey(window, GLFW_KEY_DOWN)  == GLFW_PRESS) { rotateAroundPivot(cloud, world, -ROTATE_STEP_DEG, 'x', ax); changed = true; }
+        if (glfwGetKey(window, GLFW_KEY_LEFT)  == GLFW_PRESS) { rotateAroundPivot(cloud, world,  ROTATE_STEP_DEG, 'y', ax); changed = true; }
+        if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) { rotateAroundPivot(cloud, world, -ROTATE_STEP_DEG, 'y', ax); changed = true; }
+        if (glfwGetKey(window, GLFW_KEY_Z)     == GLFW_PRESS) { rotateAroundPivot(cloud, world,  ROTATE_STEP_DEG, 'z', ax); changed = true; }
+        if (glfwGetKey(window, GLFW_KEY_X)     == GLFW_PRESS) { rotateAroundPivot(cloud, world, -ROTATE_STEP_DEG, 'z', ax); changed = true; }
+
+        // Displacement along normals (N = negative, M = positive)
+        if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS) {
+            if (!cloud.hasNormals()) {
+                cloud.estimateNormals();
+                std::cout << "Normals estimated (from centroid). Using them for displacement.\n";
+            }
+            if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS) { cloud.displaceAlongNormals(-DISP_STEP); changed = true; }
+            if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS) { cloud.displaceAlongNormals( DISP_STEP); changed = true; }
         }
-        if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS) { cloud.displaceAlongNormals(-DISP_STEP); changed = true; }
-        if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS) { cloud.displaceAlongNormals( DISP_STEP); changed = true; }
-    }
 
-    // Vertical symmetry-axis displacement
-    if (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS) { cloud.displaceSymmetrically(-DISP_STEP/10); changed = true; }
-    if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS) { cloud.displaceSymmetrically( DISP_STEP/10); changed = true; }
+        // Vertical symmetry-axis displacement
+        if (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS) { cloud.displaceSymmetrically(-DISP_STEP/10); changed = true; }
+        if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS) { cloud.displaceSymmetrically( DISP_STEP/10); changed = true; }
+    }
 
     // Recenter & rescale to view (recompute ax)
     if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) {
-        ax = computeAutoXformTransformed(cloud, 2.0f);
+        ax = computeAutoXformRobust(cloud, world, 0.01, 0.99, 2.0f);
         std::cout << "Recentered. New AutoXform center=(" << ax.cx << "," << ax.cy << "," << ax.cz
                   << ") scale=" << ax.scale << std::endl;
     }
+    if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS) {
+        ax = computeAutoXform(viewBox, 2.0f);
+    }
 
     // Point size adjust
     static float pointSize = 6.0f;
@@ -243,12 +267,12 @@ void handleInput(GLFWwindow* window, PointCloudUtil::PointCloud& cloud, AutoXfor
     if (glfwGetKey(window, GLFW_KEY_EQUAL) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_KP_ADD) == GLFW_PRESS)       { zoomBy(gCam, 0.92f); }
 
     // Reset to original points and recompute view auto-centering/scaling
-    if (glfwGetKey(window, GLFW_KEY_U) == GLFW_PRESS) {
+    // (the in-memory snapshot is copied into existing storage; no file reload)
+    if (editable && glfwGetKey(window, GLFW_KEY_U) == GLFW_PRESS) {
         cloud.resetToOriginal();
-        cloud.loadFromPLY(inputPlyFile); // reload
-
-        auto pts2 = cloud.getPoints();
-        ax = computeAutoXform(pts2, 2.0f);
+        PointCloudUtil::Aabb box;   // the cloud's bounds in the scene frame, as Scene::worldBounds
+        box.valid = cloud.getBounds(box.min, box.max);
+        ax = computeAutoXform(box.transformed(world), 2.0f);
         std::cout << "Reset to original points and recentered view.\n";
     }
 
@@ -260,13 +284,13 @@ void handleInput(GLFWwindow* window, PointCloudUtil::PointCloud& cloud, AutoXfor
 
 int main(int argc, char** argv) {
 
-    std::string inputPlyFile;
+    std::vector<std::string> inputPlyFiles;
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <inputPly.ply>" << std::endl;
-        inputPlyFile = "inputPly.ply";
+        std::cerr << "Usage: " << argv[0] << " <inputPly.ply> [more.ply ...]" << std::endl;
+        inputPlyFiles.push_back("inputPly.ply");
     }
     else
-        inputPlyFile = argv[1];
+        inputPlyFiles.assign(argv + 1, argv + argc);
 
     // Initialize GLFW
     if (!glfwInit()) {
@@ -300,16 +324,49 @@ int main(int argc, char** argv) {
         return -1;
     }
 
-    // Load point cloud data
-    PointCloudUtil::PointCloud cloud = loadPointCloud(inputPlyFile);
-    AutoXform ax = computeAutoXformTransformed(cloud, 2.0f); // scale cloud to ~[-1,1]
-    std::cout << "AutoXform center=(" << ax.cx << "," << ax.cy << "," << ax.cz
-              << ") scale=" << ax.scale << std::endl;
+    // One scene object per file, loaded in the background (a few files at a time);
+    // frames render while chunks arrive. Tile databases are streamed instead.
+    PointCloudUtil::Scene scene;
+    std::vector<std::unique_ptr<PointCloudUtil::TileStreamer>> tileSets;
+    for (const auto& f : inputPlyFiles) {
+        if (PointCloudUtil::fileExtension(f) == ".tiles") {
+            auto t = std::make_unique<PointCloudUtil::TileStreamer>();
+            if (t->open(f)) tileSets.push_back(std::move(t));
+            continue;
+        }
+        scene.add(std::make_shared<PointCloudUtil::PointCloud>(), PointCloudUtil::Mat4::identity(), f);
+    }
+    PointCloudUtil::PointCloud noCloud; // edit target when only tile databases are open
+
+    // Tile databases sit relative to the scene origin (or the first database's origin)
+    auto tileShift = [&](const PointCloudUtil::TileStreamer& t) {
+        const PointCloudUtil::Vec3d base = scene.bounds().valid ? scene.getOrigin() : tileSets[0]->getOrigin();
+        const PointCloudUtil::Vec3d d = t.getOrigin() - base;
+        return PointCloudUtil::Mat4::translation(static_cast<float>(d.x), static_cast<float>(d.y), static_cast<float>(d.z));
+    };
+    auto viewBounds = [&]() {
+        PointCloudUtil::Aabb box = scene.bounds();
+        for (const auto& t : tileSets) box.expand(t->bounds().transformed(tileShift(*t)));
+        return box;
+    };
+
+    struct ActiveLoad { size_t object; std::unique_ptr<PointCloudUtil::AsyncPlyLoader> loader; };
+    const size_t maxConcurrentLoads = 2;
+    std::vector<ActiveLoad> loads;
+    size_t nextToLoad = 0;
+    size_t loadedPoints = 0;
+    bool loading = true;
+    bool cancelAll = false;
+    size_t framedPoints = 0; // scene size when ax was last computed
+    AutoXform ax;
+    float loadProgress = 0.0f;
+
+    size_t active = 0;       // object receiving edits
+    bool tabWasDown = false;
 
     gCam.dist = 3.0f; // base distance; tweak as needed
     setCameraDiagonal(gCam, 1.f, 1.f, 1.f);
 
-    bool normalsReady = false;
     bool printedHelp = false;
 
     int fbw, fbh;
@@ -320,7 +377,73 @@ int main(int argc, char** argv) {
         glfwGetFramebufferSize(window, &fbw, &fbh);
         glViewport(0, 0, fbw, fbh);
 
-        handleInput(window, cloud, ax, normalsReady, printedHelp, inputPlyFile);
+        if (loading) {
+            if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS && !cancelAll) {
+                cancelAll = true;
+                for (auto& l : loads) l.loader->cancel();
+            }
+            while (!cancelAll && loads.size() < maxConcurrentLoads && nextToLoad < scene.size()) {
+                const std::string& name = scene.get(nextToLoad).name;
+                if (PointCloudUtil::fileExtension(name) != ".ply") {
+                    // No streaming reader for this format (e.g. LAS): load it in one go
+                    auto& cloud = scene.cloud(nextToLoad);
+                    if (!PointCloudUtil::loadPointCloud(cloud, name)) std::cerr << "Failed to load point cloud from file: " << name << std::endl;
+                    loadedPoints += cloud.size();
+                    ++nextToLoad;
+                    continue;
+                }
+                ActiveLoad l{ nextToLoad, std::make_unique<PointCloudUtil::AsyncPlyLoader>() };
+                l.loader->start(scene.get(nextToLoad).name);
+                loads.push_back(std::move(l));
+                ++nextToLoad;
+            }
+            float progress = 0.0f;
+            for (size_t i = 0; i < loads.size();) {
+                auto& l = loads[i];
+                const bool parserDone = l.loader->done(); // sample before draining so no chunk is missed
+                loadedPoints += l.loader->drainInto(scene.cloud(l.object));
+                if (!parserDone) { progress += l.loader->progress(); ++i; continue; }
+                l.loader->join();
+                auto& cloud = scene.cloud(l.object);
+                cloud.commitSnapshot();
+                if (!l.loader->succeeded()) {
+                    std::cerr << (l.loader->cancelled() ? "Loading cancelled: " : "Failed to load point cloud from file: ")
+                              << scene.get(l.object).name << " (" << cloud.size() << " points kept)" << std::endl;
+                }
+                loads.erase(loads.begin() + i);
+            }
+            // Re-frame as the scene grows (first chunk, then every doubling)
+            if (loadedPoints > 0 && loadedPoints >= 2 * framedPoints) {
+                ax = computeAutoXform(viewBounds(), 2.0f);
+                framedPoints = loadedPoints;
+            }
+            const size_t finishedFiles = nextToLoad - loads.size();
+            if (loads.empty() && (cancelAll || nextToLoad == scene.size())) {
+                loading = false;
+                ax = computeAutoXform(viewBounds(), 2.0f); // scale scene to ~[-1,1]
+                std::cout << "Loaded " << loadedPoints << " points from " << finishedFiles << " file(s). AutoXform center=("
+                          << ax.cx << "," << ax.cy << "," << ax.cz << ") scale=" << ax.scale << std::endl;
+                glfwSetWindowTitle(window, "Point Cloud Visualizer");
+            } else {
+                const float fraction = (finishedFiles + progress) / static_cast<float>(std::max<size_t>(scene.size(), 1));
+                loadProgress = fraction;
+                const std::string title = "Point Cloud Visualizer - loading " +
+                    std::to_string(static_cast<int>(fraction * 100.0f)) + "% (" +
+                    std::to_string(loadedPoints) + " points, Esc to cancel)";
+                glfwSetWindowTitle(window, title.c_str());
+            }
+        }
+
+        // Tab: next object (edge-triggered)
+        const bool tabDown = glfwGetKey(window, GLFW_KEY_TAB) == GLFW_PRESS;
+        if (tabDown && !tabWasDown && scene.size() > 1) {
+            active = (active + 1) % scene.size();
+            std::cout << "Editing: " << scene.get(active).name << std::endl;
+        }
+        tabWasDown = tabDown;
+
+        handleInput(window, viewBounds(), scene.size() ? scene.cloud(active) : noCloud,
+                    scene.size() ? scene.worldMatrix(active) : PointCloudUtil::Mat4::identity(), ax, printedHelp, !loading);
 
         // Render here
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -341,10 +464,44 @@ int main(int argc, char** argv) {
         glScalef(ax.scale, ax.scale, ax.scale);
         glTranslatef(-ax.cx, -ax.cy, -ax.cz);
 
-        renderPointCloud(cloud);
+        // Cull objects against the current view frustum (BVH over cached world bounds)
+        PointCloudUtil::Mat4 proj, view;
+        glGetFloatv(GL_PROJECTION_MATRIX, proj.m.data());
+        glGetFloatv(GL_MODELVIEW_MATRIX, view.m.data());
+        const auto frustum = PointCloudUtil::Frustum::fromMatrix(view * proj); // proj * view (A*B applies A first)
+        const size_t drawn = scene.forEachVisible(frustum, [&](size_t idx, const PointCloudUtil::Scene::Object& o) {
+            glPushMatrix();
+            glMultMatrixf(scene.worldMatrix(idx).m.data());
+            renderPointCloud(*o.cloud);
+            glPopMatrix();
+        });
+
+        // Stream tile databases: the camera eye in world units is e / scale + c
+        const float pixelsPerUnit = 0.5f * static_cast<float>(fbh) / std::tan(0.5f * 45.0f * static_cast<float>(M_PI) / 180.0f);
+        for (auto& t : tileSets) {
+            const PointCloudUtil::Mat4 shift = tileShift(*t);
+            float ex, ey, ez;
+            PointCloudUtil::transformPoint(PointCloudUtil::Mat4::translation(-shift.m[12], -shift.m[13], -shift.m[14]),
+                                           gCam.ex / ax.scale + ax.cx, gCam.ey / ax.scale + ax.cy, gCam.ez / ax.scale + ax.cz, ex, ey, ez);
+            t->update(PointCloudUtil::Frustum::fromMatrix(shift * view * proj), ex, ey, ez, pixelsPerUnit);
+            glPushMatrix();
+            glMultMatrixf(shift.m.data());
+            glBegin(GL_POINTS);
+            t->forEachDrawn([&](float cx, float cy, float cz, const PointCloudUtil::TilePoint* p, size_t n) {
+                for (size_t i = 0; i < n; ++i) {
+                    glColor3ub(p[i].r, p[i].g, p[i].b);
+                    glVertex3f(cx + p[i].x, cy + p[i].y, cz + p[i].z);
+                }
+            });
+            glEnd();
+            glPopMatrix();
+        }
+        if (drawn == 0 && tileSets.empty() && !scene.bounds().valid) renderPointCloud(PointCloudUtil::PointCloud()); // axis triad
 
         glPopMatrix();
 
+        if (loading) drawProgressBar(loadProgress);
+
         // Swap front and back buffers
         glfwSwapBuffers(window);
 
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace PointCloudUtil {
+
+// Sparse voxel grid made of 8x8x8 blocks stored back to back and found through an
+// open-addressed hash of their packed coordinates, so memory follows the observed
+// surface rather than the bounding volume. Blocks are allocated in bulk between
+// parallel passes (allocate() is serial) and stay put while workers update them.
+template <typename Voxel>
+class VoxelBlockHash {
+public:
+    static constexpr int kEdge = 8;
+    static constexpr int kVoxels = kEdge * kEdge * kEdge;
+    static constexpr uint32_t kNone = ~uint32_t(0);
+
+private:
+    static constexpr uint64_t kEmpty = ~uint64_t(0);
+
+    std::vector<Voxel> voxels;          // kVoxels per block, x fastest
+    std::vector<uint64_t> keys;         // packed block coordinates, per block
+    std::vector<uint64_t> slotKeys;     // key -> block table
+    std::vector<uint32_t> slotBlocks;
+    size_t mask = 0;
+
+    static uint64_t hash(uint64_t key) {
+        const uint64_t h = key * 0x9E3779B97F4A7C15ull;
+        return h ^ (h >> 29) ^ (h >> 47);
+    }
+
+    void insertSlot(uint64_t key, uint32_t block) {
+        size_t h = hash(key) & mask;
+        while (slotKeys[h] != kEmpty) h = (h + 1) & mask;
+        slotKeys[h] = key;
+        slotBlocks[h] = block;
+    }
+
+public:
+    // Block coordinates in +-2^20, 21 bits per axis
+    static uint64_t pack(int64_t x, int64_t y, int64_t z) {
+        return (static_cast<uint64_t>(x + (1 << 20)) << 42) | (static_cast<uint64_t>(y + (1 << 20)) << 21) |
+               static_cast<uint64_t>(z + (1 << 20));
+    }
+    static void unpack(uint64_t key, int64_t& x, int64_t& y, int64_t& z) {
+        x = static_cast<int64_t>(key >> 42) - (1 << 20);
+        y = static_cast<int64_t>((key >> 21) & 0x1FFFFF) - (1 << 20);
+        z = static_cast<int64_t>(key & 0x1FFFFF) - (1 << 20);
+    }
+    // Blocks of one phase ((x, y, z) mod 3 alike) are two or more blocks apart
+    static size_t phaseOf(uint64_t key) {
+        return static_cast<size_t>(((key >> 42) % 3) * 9 + (((key >> 21) & 0x1FFFFF) % 3) * 3 + (key & 0x1FFFFF) % 3);
+    }
+    static int64_t blockOf(int64_t v) { return v >= 0 ? v / kEdge : -((kEdge - 1 - v) / kEdge); }
+    static int localOf(int64_t v) { return static_cast<int>(v - blockOf(v) * kEdge); }
+    static uint64_t keyOf(int64_t x, int64_t y, int64_t z) { return pack(blockOf(x), blockOf(y), blockOf(z)); }
+    static int localIndex(int64_t x, int64_t y, int64_t z) { return (localOf(z) * kEdge + localOf(y)) * kEdge + localOf(x); }
+
+    size_t size() const { return keys.size(); }
+    uint64_t key(size_t block) const { return keys[block]; }
+    Voxel* block(size_t b) { return voxels.data() + b * kVoxels; }
+    const Voxel* block(size_t b) const { return voxels.data() + b * kVoxels; }
+
+    uint32_t find(uint64_t key) const {
+        if (slotKeys.empty()) return kNone;
+        for (size_t h = hash(key) & mask;; h = (h + 1) & mask) {
+            if (slotKeys[h] == key) return slotBlocks[h];
+            if (slotKeys[h] == kEmpty) return kNone;
+        }
+    }
+
+    // Voxel (x, y, z) in voxel coordinates; nullptr when its block was never allocated
+    const Voxel* voxel(int64_t x, int64_t y, int64_t z) const {
+        const uint32_t b = find(keyOf(x, y, z));
+        return b == kNone ? nullptr : block(b) + localIndex(x, y, z);
+    }
+    Voxel* voxel(int64_t x, int64_t y, int64_t z) {
+        const uint32_t b = find(keyOf(x, y, z));
+        return b == kNone ? nullptr : block(b) + localIndex(x, y, z);
+    }
+
+    // Allocate the blocks of 'wanted' (sorted, unique) not present yet, filled with
+    // 'init'; returns how many were new
+    size_t allocate(const std::vector<uint64_t>& wanted, const Voxel& init = Voxel{}) {
+        size_t fresh = 0;
+        for (uint64_t k : wanted) fresh += find(k) == kNone;
+        if (fresh == 0) return 0;
+        const size_t blocks = keys.size() + fresh;
+        if (blocks * 2 > slotKeys.size()) {
+            size_t cap = 1024;
+            while (cap < blocks * 2) cap <<= 1;
+            slotKeys.assign(cap, kEmpty);
+            slotBlocks.assign(cap, kNone);
+            mask = cap - 1;
+            for (size_t b = 0; b < keys.size(); ++b) insertSlot(keys[b], static_cast<uint32_t>(b));
+        }
+        for (uint64_t k : wanted) {
+            if (find(k) != kNone) continue;
+            insertSlot(k, static_cast<uint32_t>(keys.size()));
+            keys.push_back(k);
+        }
+        voxels.resize(keys.size() * kVoxels, init);
+        return fresh;
+    }
+
+    size_t memoryBytes() const {
+        return voxels.capacity() * sizeof(Voxel) + keys.capacity() * 8 + slotKeys.capacity() * 8 + slotBlocks.capacity() * 4;
+    }
+    void clear() { voxels.clear(); keys.clear(); slotKeys.clear(); slotBlocks.clear(); mask = 0; }
+};
+
+} // namespace PointCloudUtil
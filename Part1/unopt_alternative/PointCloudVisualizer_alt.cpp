@@ -81,8 +81,8 @@ void errorCallback(int error, const char* description) {
 }
 
 // Render point cloud
-void renderPointCloud(const PointCloudUtil::PointCloud cloud) {
-    std::vector<PointCloudUtil::Point> points = cloud.getPoints();
+void renderPointCloud(const PointCloudUtil::PointCloud& cloud) {
+    const std::vector<PointCloudUtil::Point>& points = cloud.getPoints();
     if (points.empty()) {
         // Fallback: draw axis triad so we can see something
         glLineWidth(2.0f);
@@ -144,7 +144,7 @@ inline void rotateAroundPivot(PointCloudUtil::PointCloud& cloud, float angleDeg,
     cloud.translate( ax.cx,  ax.cy,  ax.cz);
 }
 
-void handleInput(GLFWwindow* window, PointCloudUtil::PointCloud& cloud, AutoXform& ax, bool& normalsReady, bool& printedHelp, const std::string& inputPlyFile) {
+void handleInput(GLFWwindow* window, PointCloudUtil::PointCloud& cloud, AutoXform& ax, bool& normalsReady, bool& printedHelp) {
     bool changed = false;
 
     // Print controls once
@@ -196,7 +196,7 @@ void handleInput(GLFWwindow* window, PointCloudUtil::PointCloud& cloud, AutoXfor
 
     // Recenter & rescale to view (recompute ax)
     if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) {
-        auto pts = cloud.getPoints();
+        const auto& pts = cloud.getPoints();
         ax = computeAutoXform(pts, 2.0f);
         std::cout << "Recentered. New AutoXform center=(" << ax.cx << "," << ax.cy << "," << ax.cz
                   << ") scale=" << ax.scale << std::endl;
@@ -223,9 +223,8 @@ void handleInput(GLFWwindow* window, PointCloudUtil::PointCloud& cloud, AutoXfor
     // Reset to original points and recompute view auto-centering/scaling
     if (glfwGetKey(window, GLFW_KEY_U) == GLFW_PRESS) {
         cloud.resetToOriginal();
-        cloud.loadFromPLY(inputPlyFile); // reload
 
-        auto pts2 = cloud.getPoints();
+        const auto& pts2 = cloud.getPoints();
         ax = computeAutoXform(pts2, 2.0f);
         std::cout << "Reset to original points and recentered view.\n";
     }
@@ -280,7 +279,7 @@ int main(int argc, char** argv) {
 
     // Load point cloud data
     PointCloudUtil::PointCloud cloud = loadPointCloud(inputPlyFile);
-    std::vector<PointCloudUtil::Point> pts = cloud.getPoints();
+    const std::vector<PointCloudUtil::Point>& pts = cloud.getPoints();
     AutoXform ax = computeAutoXform(pts, 2.0f); // scale cloud to ~[-1,1]
     std::cout << "AutoXform center=(" << ax.cx << "," << ax.cy << "," << ax.cz
               << ") scale=" << ax.scale << std::endl;
@@ -299,7 +298,7 @@ int main(int argc, char** argv) {
         glfwGetFramebufferSize(window, &fbw, &fbh);
         glViewport(0, 0, fbw, fbh);
 
-        handleInput(window, cloud, ax, normalsReady, printedHelp, inputPlyFile);
+        handleInput(window, cloud, ax, normalsReady, printedHelp);
 
         // Render here
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);